@@ -0,0 +1,322 @@
+/**
+ *  @file       bench_ca.c
+ *
+ *  @brief      Host comparison of per-connection CA parsing and one shared parsed CA chain
+ *
+ *  Every connection of esp-tls given cacert_buf parses the PEM root
+ *  certificate into its own mbedtls_x509_crt (strlen, base64 decoding,
+ *  ASN.1 parsing, allocations) and frees it on close. The firmware
+ *  embeds the root as DER and parses it once into the global CA store,
+ *  so a connection only points its configuration at the shared chain.
+ *  The per-connection CA step is measured for the PEM certificate, for
+ *  the DER certificate parsed per connection and for the shared chain:
+ *  CPU time, allocations and peak heap per connection, and the heap the
+ *  shared chain keeps. mbedTLS allocations are counted through
+ *  mbedtls_platform_set_calloc_free() if MBEDTLS_PLATFORM_MEMORY is
+ *  enabled, otherwise by wrapping calloc() and free() at link time, which
+ *  sees a statically linked mbedTLS only. With --json every mode is
+ *  printed as a JSON line for compare.py.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+
+#include "mbedtls/version.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/x509_crt.h"
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+#include "mbedtls/platform.h"
+#endif
+
+#if MBEDTLS_VERSION_MAJOR < 3
+#error "mbedTLS 3.x (as in ESP-IDF 5) is required"
+#endif
+
+/******************** DEFINES ********************/
+
+#define BENCH_ROUNDS            2000        /**< Connections per mode */
+#define BENCH_PEM_SIZE_MAX      8192        /**< Largest PEM certificate */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  CA step of a connection
+ */
+typedef enum bench_mode_e
+{
+    BENCH_MODE_PEM = 0,         /**< PEM parsed per connection (esp-tls cacert_buf) */
+    BENCH_MODE_DER,             /**< DER parsed per connection */
+    BENCH_MODE_SHARED,          /**< Shared chain parsed once (global CA store) */
+    BENCH_MODE_QTY,
+} bench_mode_t;
+
+/**
+ *  @brief  Heap use of mbedTLS
+ */
+typedef struct bench_heap_s
+{
+    uint32_t allocs;            /**< calloc calls */
+    size_t current;             /**< Bytes allocated */
+    size_t peak;                /**< Largest bytes allocated */
+} bench_heap_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * const bench_mode_names[BENCH_MODE_QTY] = {
+    "pem_per_connection",
+    "der_per_connection",
+    "shared_chain",
+};
+
+static bench_heap_t bench_heap = {0};
+static bool bench_json = false;
+static unsigned char bench_pem[BENCH_PEM_SIZE_MAX];
+static unsigned char bench_der[BENCH_PEM_SIZE_MAX];
+static size_t bench_der_len = 0;
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+void * __real_calloc(size_t qty, size_t size);
+void __real_free(void * ptr);
+
+static void * bench_calloc(size_t qty, size_t size);
+static void bench_free(void * ptr);
+static int64_t bench_cpu_ns(void);
+static bool bench_connection(bench_mode_t mode, mbedtls_ssl_config * ptr_conf, mbedtls_x509_crt * ptr_shared);
+static bool bench_mode_run(bench_mode_t mode, mbedtls_x509_crt * ptr_shared);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Counted allocation
+ *
+ *  @param[in]  qty         Elements quantity
+ *  @param[in]  size        Element size
+ *
+ *  @return     Zeroed block, NULL if out of memory
+ */
+static void * bench_calloc(size_t qty, size_t size)
+{
+    void * ptr = __real_calloc(qty, size);
+
+    bench_heap.allocs++;
+    if (NULL != ptr)
+    {
+        bench_heap.current += malloc_usable_size(ptr);
+        if (bench_heap.current > bench_heap.peak)
+        {
+            bench_heap.peak = bench_heap.current;
+        }
+    }
+    return ptr;
+}
+
+/**
+ *  @brief      Counted release
+ *
+ *  @param[in]  ptr         Block (may be NULL)
+ */
+static void bench_free(void * ptr)
+{
+    if (NULL != ptr)
+    {
+        bench_heap.current -= malloc_usable_size(ptr);
+    }
+    __real_free(ptr);
+}
+
+void * __wrap_calloc(size_t qty, size_t size)
+{
+    return bench_calloc(qty, size);
+}
+
+void __wrap_free(void * ptr)
+{
+    bench_free(ptr);
+}
+
+/**
+ *  @brief      Process CPU time
+ *
+ *  @return     Nanoseconds
+ */
+static int64_t bench_cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ *  @brief      CA step of one connection: the chain is set up, used by the configuration and released
+ *
+ *  @param[in]  mode        CA step
+ *  @param[in]  ptr_conf    Connection configuration
+ *  @param[in]  ptr_shared  Shared chain
+ *
+ *  @return     true if the certificate is parsed
+ */
+static bool bench_connection(bench_mode_t mode, mbedtls_ssl_config * ptr_conf, mbedtls_x509_crt * ptr_shared)
+{
+    mbedtls_x509_crt crt;
+    int ret = 0;
+
+    if (BENCH_MODE_SHARED == mode)
+    {
+        mbedtls_ssl_conf_ca_chain(ptr_conf, ptr_shared, NULL);
+        return true;
+    }
+
+    mbedtls_x509_crt_init(&crt);
+    if (BENCH_MODE_PEM == mode)
+    {
+        /* PEM length includes '\0', as esp-tls takes it */
+        ret = mbedtls_x509_crt_parse(&crt, bench_pem, strlen((const char *) bench_pem) + 1);
+    }
+    else
+    {
+        ret = mbedtls_x509_crt_parse_der(&crt, bench_der, bench_der_len);
+    }
+    mbedtls_ssl_conf_ca_chain(ptr_conf, &crt, NULL);
+    mbedtls_ssl_conf_ca_chain(ptr_conf, NULL, NULL);
+    mbedtls_x509_crt_free(&crt);
+
+    return (0 == ret);
+}
+
+/**
+ *  @brief      Mode run and report
+ *
+ *  @param[in]  mode        CA step
+ *  @param[in]  ptr_shared  Shared chain
+ *
+ *  @return     true if every connection parsed the certificate
+ */
+static bool bench_mode_run(bench_mode_t mode, mbedtls_x509_crt * ptr_shared)
+{
+    mbedtls_ssl_config conf;
+    bool ok = true;
+
+    mbedtls_ssl_config_init(&conf);
+
+    /* Heap is counted from the state between connections */
+    size_t heap_base = bench_heap.current;
+    bench_heap.allocs = 0;
+    bench_heap.peak = heap_base;
+
+    int64_t start_ns = bench_cpu_ns();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++)
+    {
+        ok = bench_connection(mode, &conf, ptr_shared) && ok;
+    }
+    int64_t ns = (bench_cpu_ns() - start_ns) / BENCH_ROUNDS;
+    double allocs = (double) bench_heap.allocs / BENCH_ROUNDS;
+    size_t peak = bench_heap.peak - heap_base;
+    bool is_leaking = (bench_heap.current != heap_base);
+
+    mbedtls_ssl_config_free(&conf);
+    ok = ok && !is_leaking;
+
+    if (bench_json)
+    {
+        printf("{\"bench\":\"ca\",\"mode\":\"%s\",\"ns\":%lld,\"allocs\":%.2f,\"peak_heap_bytes\":%zu,\"ok\":%s}\n",
+               bench_mode_names[mode], (long long) ns, allocs, peak, ok ? "true" : "false");
+    }
+    else
+    {
+        printf("%-20s %10lld ns/connection %8.2f allocs/connection %8zu peak heap B%s\n",
+               bench_mode_names[mode], (long long) ns, allocs, peak, ok ? "" : ", FAILED");
+    }
+
+    return ok;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int main(int argc, char ** argv)
+{
+    const char * ptr_path = HOST_BENCH_CERT;
+    mbedtls_x509_crt shared;
+    bool ok = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--json"))
+        {
+            bench_json = true;
+        }
+        else
+        {
+            ptr_path = argv[i];
+        }
+    }
+
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+    mbedtls_platform_set_calloc_free(&bench_calloc, &bench_free);
+#endif
+
+    FILE * ptr_file = fopen(ptr_path, "rb");
+    if (NULL == ptr_file)
+    {
+        fprintf(stderr, "Cannot open %s\n", ptr_path);
+        return 1;
+    }
+    size_t len = fread(bench_pem, 1, sizeof(bench_pem) - 1, ptr_file);
+    fclose(ptr_file);
+    bench_pem[len] = '\0';
+
+    /* DER is taken from the parsed PEM, as pem_to_der.py makes it at build time */
+    mbedtls_x509_crt_init(&shared);
+    if ((0 != mbedtls_x509_crt_parse(&shared, bench_pem, len + 1)) || (shared.raw.len > sizeof(bench_der)))
+    {
+        fprintf(stderr, "Cannot parse %s\n", ptr_path);
+        return 1;
+    }
+    memcpy(bench_der, shared.raw.p, shared.raw.len);
+    bench_der_len = shared.raw.len;
+    mbedtls_x509_crt_free(&shared);
+
+    /* Shared chain: parsed once, kept for the whole uptime */
+    size_t heap_base = bench_heap.current;
+    bench_heap.allocs = 0;
+    int64_t start_ns = bench_cpu_ns();
+    mbedtls_x509_crt_init(&shared);
+    ok = (0 == mbedtls_x509_crt_parse_der(&shared, bench_der, bench_der_len));
+    int64_t setup_ns = bench_cpu_ns() - start_ns;
+    size_t shared_bytes = bench_heap.current - heap_base;
+
+    if (bench_json)
+    {
+        printf("{\"bench\":\"ca\",\"mode\":\"shared_chain_setup\",\"ns\":%lld,\"allocs\":%u,"
+               "\"peak_heap_bytes\":%zu,\"ok\":%s}\n",
+               (long long) setup_ns, bench_heap.allocs, shared_bytes, ok ? "true" : "false");
+    }
+    else
+    {
+        printf("%zu byte PEM, %zu byte DER root certificate, %u connections per mode\n",
+               len, bench_der_len, BENCH_ROUNDS);
+        printf("%-20s %10lld ns once %8u allocs once %8zu heap B kept\n",
+               "shared_chain_setup", (long long) setup_ns, bench_heap.allocs, shared_bytes);
+    }
+
+    for (bench_mode_t mode = BENCH_MODE_PEM; mode < BENCH_MODE_QTY; mode++)
+    {
+        ok = bench_mode_run(mode, &shared) && ok;
+    }
+    if (0 == shared_bytes)
+    {
+        fprintf(stderr, "mbedTLS allocations are not seen (shared library without MBEDTLS_PLATFORM_MEMORY)\n");
+    }
+    mbedtls_x509_crt_free(&shared);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,423 @@
+/**
+ *  @file       bench_engine.c
+ *
+ *  @brief      Host run of the fetch engine: N requests one after another and all at once
+ *
+ *  The firmware fetch engine is built with the esp-tls port on OpenSSL
+ *  and drives FETCH_ENGINE_SLOTS_MAX requests against a local TLS 1.2
+ *  server started in this process (RSA-2048 certificate, one thread per
+ *  connection). Requests run sequentially and then concurrently from one
+ *  thread, as weather_engine_bench() does on the device. Scenarios model
+ *  the server side: no delay, server latency before the first byte and
+ *  a rate limited link. Wall time, CPU time of the engine thread and
+ *  select() wakeups are reported; the server threads are not counted.
+ *  Exits with 1 if any request fails or returns a wrong body. With --json
+ *  every run is printed as a JSON line for compare.py.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+
+#include "esp_timer.h"
+#include "dns_cache.h"
+#include "fetch_engine.h"
+
+/******************** DEFINES ********************/
+
+#define BENCH_HOST              "localhost"     /**< Certificate common name */
+#define BENCH_TIMEOUT_MS        30000           /**< Single request timeout */
+#define BENCH_REQ_MAX           1024            /**< Longest request the server reads */
+#define BENCH_SERVER_CHUNK      4096            /**< Server write size */
+#define BENCH_CA_SIZE_MAX       8192            /**< Largest PEM certificate */
+
+#define BENCH_REQ               "GET /bench HTTP/1.1\r\nHost: " BENCH_HOST "\r\nConnection: close\r\n\r\n"
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Scenario: the server side of every request
+ */
+typedef struct bench_scenario_s
+{
+    const char * ptr_name;
+    int64_t latency_us;         /**< Server delay before the response */
+    uint32_t link_bps;          /**< Body transfer rate, bytes per second (0 - unlimited) */
+    size_t body_size;           /**< Response body size */
+} bench_scenario_t;
+
+/**
+ *  @brief  Request result
+ */
+typedef struct bench_result_s
+{
+    uint32_t body_bytes;        /**< Body bytes received */
+    int status;                 /**< HTTP status */
+    bool is_done;               /**< Completion callback was called */
+    esp_err_t err;              /**< Request result */
+} bench_result_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const bench_scenario_t bench_scenarios[] = {
+    { "local",          0,      0,      65536 },
+    { "server_latency", 120000, 0,      65536 },    /* First byte as in the bench_trace model */
+    { "slow_link",      0,      262144, 65536 },    /* 250 ms per body */
+};
+#define BENCH_SCENARIOS_QTY (sizeof(bench_scenarios) / sizeof(bench_scenarios[0]))
+
+static const bench_scenario_t * volatile bench_scenario_ptr = NULL;    /**< Scenario the server runs */
+static SSL_CTX * bench_server_ctx = NULL;
+static bool bench_json = false;
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static int64_t bench_cpu_us(void);
+static void * bench_server_conn(void * ptr_arg);
+static void * bench_server_accept(void * ptr_arg);
+static int bench_server_start(void);
+static void bench_body(const char * ptr_data, size_t len, void * ptr_arg);
+static void bench_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg);
+static bool bench_run(const bench_scenario_t * ptr_scenario, const esp_tls_cfg_t * ptr_tls_cfg, int port,
+                      bool is_concurrent);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      CPU time of the calling thread
+ *
+ *  @return     Microseconds
+ */
+static int64_t bench_cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ *  @brief      Server connection thread: handshake, request, delayed and rate limited response
+ *
+ *  @param[in]  ptr_arg     Connection socket
+ *
+ *  @return     NULL
+ */
+static void * bench_server_conn(void * ptr_arg)
+{
+    int sockfd = (int) (intptr_t) ptr_arg;
+    const bench_scenario_t * ptr_scenario = bench_scenario_ptr;
+    char req[BENCH_REQ_MAX];
+    size_t req_len = 0;
+
+    SSL * ptr_ssl = SSL_new(bench_server_ctx);
+    if ((NULL == ptr_ssl) || (1 != SSL_set_fd(ptr_ssl, sockfd)) || (1 != SSL_accept(ptr_ssl)))
+    {
+        goto exit;
+    }
+
+    /* Request ends with an empty line */
+    while ((req_len < sizeof(req) - 1) && ((req_len < 4) || (0 != memcmp(req + req_len - 4, "\r\n\r\n", 4))))
+    {
+        int ret = SSL_read(ptr_ssl, req + req_len, (int) (sizeof(req) - 1 - req_len));
+        if (ret <= 0)
+        {
+            goto exit;
+        }
+        req_len += ret;
+    }
+
+    if (ptr_scenario->latency_us > 0)
+    {
+        usleep(ptr_scenario->latency_us);
+    }
+
+    char chunk[BENCH_SERVER_CHUNK];
+    int len = snprintf(chunk, sizeof(chunk),
+                       "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n"
+                       "Connection: close\r\n\r\n",
+                       ptr_scenario->body_size);
+    if (len != SSL_write(ptr_ssl, chunk, len))
+    {
+        goto exit;
+    }
+
+    memset(chunk, 'x', sizeof(chunk));
+    for (size_t sent = 0; sent < ptr_scenario->body_size; sent += sizeof(chunk))
+    {
+        size_t size = ptr_scenario->body_size - sent;
+        size = (size < sizeof(chunk)) ? size : sizeof(chunk);
+        if (ptr_scenario->link_bps > 0)
+        {
+            usleep(size * 1000000ULL / ptr_scenario->link_bps);
+        }
+        if ((int) size != SSL_write(ptr_ssl, chunk, (int) size))
+        {
+            goto exit;
+        }
+    }
+    SSL_shutdown(ptr_ssl);
+
+exit:
+    SSL_free(ptr_ssl);
+    close(sockfd);
+    return NULL;
+}
+
+/**
+ *  @brief      Server accepting thread, every connection is served by its own thread
+ *
+ *  @param[in]  ptr_arg     Listening socket
+ *
+ *  @return     NULL
+ */
+static void * bench_server_accept(void * ptr_arg)
+{
+    int listenfd = (int) (intptr_t) ptr_arg;
+
+    for (;;)
+    {
+        int sockfd = accept(listenfd, NULL, NULL);
+        if (sockfd < 0)
+        {
+            continue;
+        }
+
+        pthread_t thread;
+        if (0 != pthread_create(&thread, NULL, &bench_server_conn, (void *) (intptr_t) sockfd))
+        {
+            close(sockfd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    return NULL;
+}
+
+/**
+ *  @brief      Local TLS server start on a loopback port chosen by the system
+ *
+ *  @return     Port, -1 on error
+ */
+static int bench_server_start(void)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+
+    bench_server_ctx = SSL_CTX_new(TLS_server_method());
+    if ((NULL == bench_server_ctx) ||
+        (1 != SSL_CTX_use_certificate_file(bench_server_ctx, HOST_BENCH_TLS_DIR "/cert.pem", SSL_FILETYPE_PEM)) ||
+        (1 != SSL_CTX_use_PrivateKey_file(bench_server_ctx, HOST_BENCH_TLS_DIR "/key.pem", SSL_FILETYPE_PEM)))
+    {
+        return -1;
+    }
+    SSL_CTX_set_max_proto_version(bench_server_ctx, TLS1_2_VERSION);
+
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if ((listenfd < 0) ||
+        (0 != bind(listenfd, (struct sockaddr *) &addr, sizeof(addr))) ||
+        (0 != listen(listenfd, FETCH_ENGINE_SLOTS_MAX)) ||
+        (0 != getsockname(listenfd, (struct sockaddr *) &addr, &addr_len)))
+    {
+        return -1;
+    }
+
+    pthread_t thread;
+    if (0 != pthread_create(&thread, NULL, &bench_server_accept, (void *) (intptr_t) listenfd))
+    {
+        return -1;
+    }
+    pthread_detach(thread);
+
+    return ntohs(addr.sin_port);
+}
+
+/**
+ *  @brief      Response body consumer (counts bytes only)
+ *
+ *  @param[in]  ptr_data    Body bytes pointer
+ *  @param[in]  len         Body bytes quantity
+ *  @param[in]  ptr_arg     Request result pointer
+ */
+static void bench_body(const char * ptr_data, size_t len, void * ptr_arg)
+{
+    (void) ptr_data;
+    ((bench_result_t *) ptr_arg)->body_bytes += len;
+}
+
+/**
+ *  @brief      Request completion
+ *
+ *  @param[in]  err         Request result
+ *  @param[in]  ptr_resp    Response parser
+ *  @param[in]  ptr_arg     Request result pointer
+ */
+static void bench_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg)
+{
+    bench_result_t * ptr_result = ptr_arg;
+
+    ptr_result->is_done = true;
+    ptr_result->err = err;
+    ptr_result->status = ptr_resp->status;
+}
+
+/**
+ *  @brief      FETCH_ENGINE_SLOTS_MAX requests of a scenario and report
+ *
+ *  @param[in]  ptr_scenario    Scenario pointer
+ *  @param[in]  ptr_tls_cfg     Client configuration
+ *  @param[in]  port            Server port
+ *  @param[in]  is_concurrent   All requests at once, otherwise one after another
+ *
+ *  @return     true if every request returned the whole body
+ */
+static bool bench_run(const bench_scenario_t * ptr_scenario, const esp_tls_cfg_t * ptr_tls_cfg, int port,
+                      bool is_concurrent)
+{
+    static fetch_engine_t engine;
+    bench_result_t results[FETCH_ENGINE_SLOTS_MAX];
+    const http_resp_cbs_t cbs = {
+        .header_cb = NULL,
+        .body_cb = &bench_body,
+    };
+    bool ok = true;
+
+    bench_scenario_ptr = ptr_scenario;
+    memset(results, 0x00, sizeof(results));
+    if (ESP_OK != fetch_engine_init(&engine, ptr_tls_cfg, BENCH_TIMEOUT_MS))
+    {
+        return false;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    int64_t start_cpu_us = bench_cpu_us();
+    for (uint32_t i = 0; i < FETCH_ENGINE_SLOTS_MAX; i++)
+    {
+        const fetch_req_t fetch_req = {
+            .ptr_host = BENCH_HOST,
+            .port = port,
+            .ptr_req = BENCH_REQ,
+            .req_len = sizeof(BENCH_REQ) - 1,
+            .ptr_cbs = &cbs,
+            .done_cb = &bench_done,
+            .ptr_arg = &results[i],
+        };
+        ok = (ESP_OK == fetch_engine_submit(&engine, &fetch_req)) && ok;
+        if (!is_concurrent)
+        {
+            fetch_engine_run(&engine);
+        }
+    }
+    fetch_engine_run(&engine);
+    int64_t cpu_us = bench_cpu_us() - start_cpu_us;
+    int64_t wall_us = esp_timer_get_time() - start_us;
+
+    for (uint32_t i = 0; i < FETCH_ENGINE_SLOTS_MAX; i++)
+    {
+        ok = ok && results[i].is_done && (ESP_OK == results[i].err) && (200 == results[i].status) &&
+             (results[i].body_bytes == ptr_scenario->body_size);
+    }
+
+    const char * ptr_mode = is_concurrent ? "concurrent" : "sequential";
+    if (bench_json)
+    {
+        printf("{\"bench\":\"engine\",\"scenario\":\"%s\",\"mode\":\"%s\",\"requests\":%u,"
+               "\"wall_us\":%lld,\"cpu_us\":%lld,\"wakeups\":%u,\"rx_bytes\":%llu,\"ok\":%s}\n",
+               ptr_scenario->ptr_name, ptr_mode, engine.stats.requests,
+               (long long) wall_us, (long long) cpu_us, engine.stats.wakeups,
+               (unsigned long long) engine.stats.rx_bytes, ok ? "true" : "false");
+    }
+    else
+    {
+        printf("%-16s %-11s %u requests (%u failed) in %7.1f ms, CPU %6.1f ms, %5u wakeups, %llu B/s%s\n",
+               ptr_scenario->ptr_name, ptr_mode, engine.stats.requests, engine.stats.failed,
+               wall_us / 1000.0, cpu_us / 1000.0, engine.stats.wakeups,
+               (unsigned long long) (engine.stats.rx_bytes * 1000000ULL / ((wall_us > 0) ? wall_us : 1)),
+               ok ? "" : ", FAILED");
+    }
+
+    return ok;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+/**
+ *  @brief      Resolver stand-in: every host is the local server
+ */
+esp_err_t dns_cache_resolve(const char * ptr_host, ip4_addr_t * ptr_addr)
+{
+    (void) ptr_host;
+    ptr_addr->addr = htonl(INADDR_LOOPBACK);
+    return ESP_OK;
+}
+
+/**
+ *  @brief      Resolver stand-in: nothing is cached
+ */
+void dns_cache_invalidate(const char * ptr_host)
+{
+    (void) ptr_host;
+}
+
+int main(int argc, char ** argv)
+{
+    static unsigned char ca[BENCH_CA_SIZE_MAX];
+    bool ok = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bench_json = bench_json || (0 == strcmp(argv[i], "--json"));
+    }
+
+    /* Server closes connections the engine may have given up on */
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Certificate is passed as PEM with its '\0', as the firmware embeds it */
+    FILE * ptr_file = fopen(HOST_BENCH_TLS_DIR "/cert.pem", "rb");
+    if (NULL == ptr_file)
+    {
+        fprintf(stderr, "Cannot open %s\n", HOST_BENCH_TLS_DIR "/cert.pem");
+        return 1;
+    }
+    size_t ca_len = fread(ca, 1, sizeof(ca) - 1, ptr_file);
+    fclose(ptr_file);
+    ca[ca_len] = '\0';
+
+    int port = bench_server_start();
+    if (port < 0)
+    {
+        fprintf(stderr, "Cannot start the local TLS server\n");
+        return 1;
+    }
+
+    const esp_tls_cfg_t tls_cfg = {
+        .cacert_buf = ca,
+        .cacert_bytes = ca_len + 1,
+    };
+    if (!bench_json)
+    {
+        printf("%u requests per run, TLS 1.2, RSA-2048 server certificate\n", FETCH_ENGINE_SLOTS_MAX);
+    }
+    for (size_t i = 0; i < BENCH_SCENARIOS_QTY; i++)
+    {
+        ok = bench_run(&bench_scenarios[i], &tls_cfg, port, false) && ok;
+        ok = bench_run(&bench_scenarios[i], &tls_cfg, port, true) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
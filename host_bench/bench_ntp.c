@@ -0,0 +1,252 @@
+/**
+ *  @file       bench_ntp.c
+ *
+ *  @brief      Host check of the parallel NTP client against local stand-ins
+ *
+ *  Every stand-in is a UDP NTP server on 127.0.0.1 with its own network
+ *  delay, loss and clock offset. Scenarios mix good, slow, lossy and
+ *  falseticking servers; for each one the time to sync, the answered
+ *  servers, the selected server and its offset error are reported.
+ *  Single-server scenarios show the former one-server behaviour. Exits
+ *  with 1 if a scenario selects a wrong server.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "ntp_client.h"
+
+/******************** DEFINES ********************/
+
+#define BENCH_DEADLINE_MS       1000                /**< Query deadline */
+#define BENCH_ROUNDS            5                   /**< Queries per scenario */
+#define BENCH_NTP_UNIX_EPOCH_S  2208988800ULL       /**< Seconds from 1900 to 1970 */
+#define BENCH_ROOT_DISPERSION   0x00000040          /**< 1 ms, 16.16 seconds */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Stand-in server
+ */
+typedef struct bench_server_s
+{
+    const char * ptr_name;
+    uint32_t delay_ms;          /**< Round trip added by the "network" */
+    bool is_lossy;              /**< Requests are dropped */
+    int64_t offset_us;          /**< Server clock minus true time */
+    int sock;
+    struct sockaddr_in addr;
+    pthread_t thread;
+} bench_server_t;
+
+/**
+ *  @brief  Scenario: servers by index and the servers that may be selected
+ */
+typedef struct bench_scenario_s
+{
+    const char * ptr_name;
+    int servers[NTP_CLIENT_SERVERS_MAX];
+    size_t servers_qty;
+    uint32_t good_mask;         /**< Servers (by scenario position) with a correct clock */
+} bench_scenario_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static bench_server_t bench_servers[] = {
+    { .ptr_name = "good_4ms",           .delay_ms = 4 },
+    { .ptr_name = "good_10ms",          .delay_ms = 10 },
+    { .ptr_name = "slow_400ms",         .delay_ms = 400 },
+    { .ptr_name = "lossy",              .delay_ms = 4,  .is_lossy = true },
+    { .ptr_name = "falseticker_+5s",    .delay_ms = 1,  .offset_us = 5000000 },
+};
+#define BENCH_SERVERS_QTY   (sizeof(bench_servers) / sizeof(bench_servers[0]))
+
+static const bench_scenario_t bench_scenarios[] = {
+    { "single_good",        { 0 },          1,  0x1 },
+    { "single_slow",        { 2 },          1,  0x1 },
+    { "single_lossy",       { 3 },          1,  0x0 },
+    { "slow_lossy_good",    { 2, 3, 1, 0 }, 4,  0xD },
+    { "falseticker",        { 4, 0, 1, 3 }, 4,  0x6 },
+};
+#define BENCH_SCENARIOS_QTY (sizeof(bench_scenarios) / sizeof(bench_scenarios[0]))
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static void bench_write_ntp(uint8_t * ptr_buf, int64_t time_us);
+static void * bench_server_run(void * ptr_arg);
+static bool bench_server_start(bench_server_t * ptr_server);
+static bool bench_scenario_run(const bench_scenario_t * ptr_scenario);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Unix microseconds to big-endian NTP timestamp
+ *
+ *  @param[out] ptr_buf     Destination (8 bytes)
+ *  @param[in]  time_us     Unix time, microseconds
+ */
+static void bench_write_ntp(uint8_t * ptr_buf, int64_t time_us)
+{
+    uint64_t value = (((uint64_t) (time_us / 1000000) + BENCH_NTP_UNIX_EPOCH_S) << 32) |
+                     (((uint64_t) (time_us % 1000000) << 32) / 1000000);
+
+    for (int i = 7; i >= 0; i--)
+    {
+        ptr_buf[i] = (uint8_t) value;
+        value >>= 8;
+    }
+}
+
+/**
+ *  @brief      Stand-in server thread: half of the delay before and after the server stamps
+ *
+ *  @param[in]  ptr_arg     Server pointer
+ *
+ *  @return     NULL
+ */
+static void * bench_server_run(void * ptr_arg)
+{
+    bench_server_t * ptr_server = (bench_server_t *) ptr_arg;
+    uint8_t packet[48];
+
+    for (;;)
+    {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = recvfrom(ptr_server->sock, packet, sizeof(packet), 0, (struct sockaddr *) &from, &from_len);
+        if (len < (ssize_t) sizeof(packet))
+        {
+            continue;
+        }
+        if (ptr_server->is_lossy)
+        {
+            continue;
+        }
+
+        usleep(ptr_server->delay_ms * 500);
+        memcpy(&packet[24], &packet[40], 8);    /* Originate is the request transmit */
+        packet[0] = 0x24;                       /* No leap warning, version 4, server */
+        packet[1] = 2;                          /* Stratum */
+        memset(&packet[4], 0x00, 12);
+        packet[11] = BENCH_ROOT_DISPERSION;
+        bench_write_ntp(&packet[32], ntp_client_now_us() + ptr_server->offset_us);
+        bench_write_ntp(&packet[40], ntp_client_now_us() + ptr_server->offset_us);
+        usleep(ptr_server->delay_ms * 500);
+        sendto(ptr_server->sock, packet, sizeof(packet), 0, (struct sockaddr *) &from, from_len);
+    }
+
+    return NULL;
+}
+
+/**
+ *  @brief      Stand-in server start on an ephemeral loopback port
+ *
+ *  @param[in]  ptr_server  Server pointer
+ *
+ *  @return     true on success
+ */
+static bool bench_server_start(bench_server_t * ptr_server)
+{
+    socklen_t addr_len = sizeof(ptr_server->addr);
+
+    ptr_server->sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    memset(&ptr_server->addr, 0x00, sizeof(ptr_server->addr));
+    ptr_server->addr.sin_family = AF_INET;
+    ptr_server->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ptr_server->addr.sin_port = 0;
+
+    return (ptr_server->sock >= 0) &&
+           (0 == bind(ptr_server->sock, (struct sockaddr *) &ptr_server->addr, sizeof(ptr_server->addr))) &&
+           (0 == getsockname(ptr_server->sock, (struct sockaddr *) &ptr_server->addr, &addr_len)) &&
+           (0 == pthread_create(&ptr_server->thread, NULL, &bench_server_run, ptr_server));
+}
+
+/**
+ *  @brief      Scenario queries and report
+ *
+ *  @param[in]  ptr_scenario    Scenario pointer
+ *
+ *  @return     true if every query selected a correct server (or none where none is correct)
+ */
+static bool bench_scenario_run(const bench_scenario_t * ptr_scenario)
+{
+    struct sockaddr_in addrs[NTP_CLIENT_SERVERS_MAX];
+    ntp_result_t result;
+    int64_t elapsed_us = 0;
+    int64_t error_us = 0;
+    uint32_t answered = 0;
+    uint32_t synced = 0;
+    bool ok = true;
+    int best = -1;
+
+    for (size_t i = 0; i < ptr_scenario->servers_qty; i++)
+    {
+        addrs[i] = bench_servers[ptr_scenario->servers[i]].addr;
+    }
+
+    for (uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        const ntp_sample_t * ptr_best = ntp_client_query(addrs, ptr_scenario->servers_qty, BENCH_DEADLINE_MS, &result);
+
+        elapsed_us += result.elapsed_us;
+        answered += result.answered;
+        if (NULL == ptr_best)
+        {
+            ok = ok && (0 == ptr_scenario->good_mask);
+            continue;
+        }
+        best = result.best;
+        synced++;
+        ok = ok && (0 != (ptr_scenario->good_mask & (1U << result.best)));
+        error_us += llabs(ptr_best->offset_us - bench_servers[ptr_scenario->servers[result.best]].offset_us);
+    }
+
+    printf("%-18s %8.1f ms to sync  %4.1f of %u answered  synced %u/%u  selected %-16s  offset error %6.1f us  %s\n",
+           ptr_scenario->ptr_name,
+           elapsed_us / 1000.0 / BENCH_ROUNDS,
+           (double) answered / BENCH_ROUNDS,
+           (unsigned int) ptr_scenario->servers_qty,
+           synced,
+           BENCH_ROUNDS,
+           (best < 0) ? "-" : bench_servers[ptr_scenario->servers[best]].ptr_name,
+           (synced > 0) ? (double) error_us / synced : 0.0,
+           ok ? "ok" : "WRONG");
+
+    return ok;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int main(void)
+{
+    bool ok = true;
+
+    for (size_t i = 0; i < BENCH_SERVERS_QTY; i++)
+    {
+        if (!bench_server_start(&bench_servers[i]))
+        {
+            fprintf(stderr, "Cannot start stand-in %s\n", bench_servers[i].ptr_name);
+            return 1;
+        }
+    }
+
+    printf("Deadline %u ms, %u queries per scenario\n", BENCH_DEADLINE_MS, BENCH_ROUNDS);
+    for (size_t i = 0; i < BENCH_SCENARIOS_QTY; i++)
+    {
+        ok = bench_scenario_run(&bench_scenarios[i]) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+/**
+ *  @file       bench_num.c
+ *
+ *  @brief      Host benchmark of JSON number decoding
+ *
+ *  Every number of a recorded forecast is decoded to tenths twice: with
+ *  strtod() and rounding, as a DOM parser does, and with the integer-only
+ *  decoder. Reports cycles per number (time stamp counter where the CPU
+ *  has one) and results that differ. On the host strtod() runs on an FPU;
+ *  the firmware runs the same measurement on the target with
+ *  WEATHER_NUMBER_BENCH.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "json_stream.h"
+#include "json_num.h"
+
+/******************** DEFINES ********************/
+
+#define BENCH_PASSES        200     /**< Document decodes per measurement */
+#define BENCH_PAYLOAD_MAX   262144  /**< Largest payload */
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BENCH_UNIT          "cycles"
+#elif defined(__riscv) && (__riscv_xlen == 64)
+#define BENCH_UNIT          "cycles"
+#else
+#define BENCH_UNIT          "ns"
+#endif
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+typedef struct bench_num_s
+{
+    uint64_t numbers;               /**< Numbers decoded */
+    uint64_t strtod_ticks;          /**< strtod() path ticks */
+    uint64_t scaled_ticks;          /**< Integer decoder ticks */
+    uint64_t empty_ticks;           /**< Counter overhead ticks */
+    uint32_t mismatches;            /**< Results that differ */
+    uint32_t failures;              /**< Numbers the integer decoder rejected */
+} bench_num_t;
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static inline uint64_t bench_ticks(void);
+static void bench_num_value(const char * ptr_path,
+                            json_stream_type_t type,
+                            const char * ptr_value,
+                            size_t len,
+                            void * ptr_arg);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Cycle counter, monotonic nanoseconds where there is none
+ *
+ *  @return     Ticks
+ */
+static inline uint64_t bench_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__riscv) && (__riscv_xlen == 64)
+    uint64_t cycles;
+    __asm__ volatile ("rdcycle %0" : "=r" (cycles));
+    return cycles;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ *  @brief      Tokenizer value consumer, every number is decoded both ways
+ *
+ *  @param[in]  ptr_path    Value path
+ *  @param[in]  type        Value type
+ *  @param[in]  ptr_value   Value text
+ *  @param[in]  len         Value text length
+ *  @param[in]  ptr_arg     Benchmark counters
+ */
+static void bench_num_value(const char * ptr_path,
+                            json_stream_type_t type,
+                            const char * ptr_value,
+                            size_t len,
+                            void * ptr_arg)
+{
+    bench_num_t * ptr_bench = (bench_num_t *) ptr_arg;
+    volatile int64_t sink;
+    int64_t scaled = 0;
+
+    if (JSON_STREAM_NUMBER != type)
+    {
+        return;
+    }
+
+    uint64_t start = bench_ticks();
+    ptr_bench->empty_ticks += bench_ticks() - start;
+
+    start = bench_ticks();
+    int64_t rounded = llround(strtod(ptr_value, NULL) * 10.0);
+    ptr_bench->strtod_ticks += bench_ticks() - start;
+    sink = rounded;
+
+    start = bench_ticks();
+    bool ok = json_num_scaled(ptr_value, len, 1, &scaled);
+    ptr_bench->scaled_ticks += bench_ticks() - start;
+    sink = scaled;
+    (void) sink;
+
+    ptr_bench->numbers++;
+    if (!ok)
+    {
+        ptr_bench->failures++;
+    }
+    else if (scaled != rounded)
+    {
+        /* Binary rounding of x * 10, e.g. 1.15 * 10 = 11.4999... */
+        if (0 == ptr_bench->mismatches)
+        {
+            printf("first mismatch at %s: \"%s\" strtod %lld, scaled %lld\n",
+                   ptr_path, ptr_value, (long long) rounded, (long long) scaled);
+        }
+        ptr_bench->mismatches++;
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int main(int argc, char ** argv)
+{
+    const char * ptr_path = (argc > 1) ? argv[1] : HOST_BENCH_PAYLOAD_DIR "/forecast.json";
+    static char data[BENCH_PAYLOAD_MAX];
+    bench_num_t bench;
+    json_stream_t json;
+
+    FILE * ptr_file = fopen(ptr_path, "rb");
+    if (NULL == ptr_file)
+    {
+        fprintf(stderr, "Cannot open %s\n", ptr_path);
+        return 1;
+    }
+    size_t len = fread(data, 1, sizeof(data), ptr_file);
+    fclose(ptr_file);
+
+    memset(&bench, 0x00, sizeof(bench));
+    for (uint32_t i = 0; i < BENCH_PASSES; i++)
+    {
+        json_stream_init(&json, &bench_num_value, &bench);
+        if (!json_stream_feed(&json, data, len) || !json_stream_finish(&json))
+        {
+            fprintf(stderr, "%s is malformed\n", ptr_path);
+            return 1;
+        }
+    }
+
+    uint64_t per_doc = bench.numbers / BENCH_PASSES;
+    double strtod_ticks = (double) (bench.strtod_ticks - bench.empty_ticks) / bench.numbers;
+    double scaled_ticks = (double) (bench.scaled_ticks - bench.empty_ticks) / bench.numbers;
+
+    printf("%s: %zu bytes, %llu numbers, %u passes\n", ptr_path, len, (unsigned long long) per_doc, BENCH_PASSES);
+    printf("strtod   %8.1f %s/number %10.0f %s/document\n",
+           strtod_ticks, BENCH_UNIT, strtod_ticks * per_doc, BENCH_UNIT);
+    printf("scaled   %8.1f %s/number %10.0f %s/document  %.1fx\n",
+           scaled_ticks, BENCH_UNIT, scaled_ticks * per_doc, BENCH_UNIT,
+           (scaled_ticks > 0) ? strtod_ticks / scaled_ticks : 0.0);
+    printf("results  %u differ, %u rejected\n",
+           bench.mismatches / BENCH_PASSES, bench.failures / BENCH_PASSES);
+
+    return 0;
+}
@@ -0,0 +1,305 @@
+/**
+ *  @file       bench_parse.c
+ *
+ *  @brief      Host benchmark of weather response parsers
+ *
+ *  Parses a recorded weather response many times with the key-path table
+ *  extractor and, if cJSON sources are available, with the cJSON DOM path
+ *  on the heap and on the response arena. Reports throughput and heap
+ *  allocations per parse; allocations are counted by wrapping malloc() and
+ *  friends at link time.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "weather_extract.h"
+#include "json_arena.h"
+
+#if HOST_BENCH_CJSON
+#include "cJSON.h"
+#endif
+
+/******************** DEFINES ********************/
+
+#define BENCH_ITERATIONS    20000   /**< Parses per measurement */
+#define BENCH_CHUNK_SIZE    1536    /**< Extractor feed size, as the firmware receiving buffer */
+#define BENCH_PAYLOAD_MAX   65536   /**< Largest payload */
+#define BENCH_ARENA_SIZE    65536   /**< cJSON arena size */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+typedef struct bench_heap_s
+{
+    uint32_t allocs;                /**< malloc/calloc/realloc calls */
+    uint32_t frees;                 /**< free calls */
+} bench_heap_t;
+
+typedef void (*bench_parse_t)(const char * ptr_data, size_t len, weather_record_t * ptr_record);
+
+/******************** GLOBAL VARIABLES ********************/
+
+static bench_heap_t bench_heap = {0};
+#if HOST_BENCH_CJSON
+static json_arena_t bench_arena;
+#endif
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t qty, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+void __real_free(void * ptr);
+
+static int64_t bench_now_ns(void);
+static void bench_parse_extract(const char * ptr_data, size_t len, weather_record_t * ptr_record);
+#if HOST_BENCH_CJSON
+static void bench_cjson_fields(const cJSON * ptr_root, weather_record_t * ptr_record);
+static void bench_parse_cjson(const char * ptr_data, size_t len, weather_record_t * ptr_record);
+static void bench_parse_cjson_arena(const char * ptr_data, size_t len, weather_record_t * ptr_record);
+#endif
+static void bench_run(const char * ptr_name, bench_parse_t parse, const char * ptr_data, size_t len);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+void * __wrap_malloc(size_t size)
+{
+    bench_heap.allocs++;
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t qty, size_t size)
+{
+    bench_heap.allocs++;
+    return __real_calloc(qty, size);
+}
+
+void * __wrap_realloc(void * ptr, size_t size)
+{
+    bench_heap.allocs++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void * ptr)
+{
+    if (NULL != ptr)
+    {
+        bench_heap.frees++;
+    }
+    __real_free(ptr);
+}
+
+/**
+ *  @brief      Monotonic time
+ *
+ *  @return     Nanoseconds
+ */
+static int64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ *  @brief      Key-path table extractor, fed in receiving buffer sized chunks
+ *
+ *  @param[in]  ptr_data    Document
+ *  @param[in]  len         Document length
+ *  @param[out] ptr_record  Destination
+ */
+static void bench_parse_extract(const char * ptr_data, size_t len, weather_record_t * ptr_record)
+{
+    weather_extract_t extract;
+
+    weather_extract_init(&extract, ptr_record);
+    for (size_t pos = 0; pos < len; pos += BENCH_CHUNK_SIZE)
+    {
+        weather_extract_feed(&extract, ptr_data + pos, (len - pos < BENCH_CHUNK_SIZE) ? len - pos : BENCH_CHUNK_SIZE);
+    }
+    weather_extract_finish(&extract);
+}
+
+#if HOST_BENCH_CJSON
+/**
+ *  @brief      Fields lookup in cJSON tree, the same fields as the extractor
+ *
+ *  @param[in]  ptr_root    Document tree (may be NULL)
+ *  @param[out] ptr_record  Destination
+ */
+static void bench_cjson_fields(const cJSON * ptr_root, weather_record_t * ptr_record)
+{
+    memset(ptr_record, 0x00, sizeof(*ptr_record));
+
+    cJSON * ptr_fact = cJSON_GetObjectItem(ptr_root, "fact");
+    cJSON * ptr_parts = cJSON_GetObjectItem(cJSON_GetObjectItem(ptr_root, "forecast"), "parts");
+    cJSON * ptr_part = cJSON_GetArrayItem(ptr_parts, 0);
+    cJSON * ptr_item = NULL;
+
+    if (cJSON_IsNumber(ptr_item = cJSON_GetObjectItem(ptr_fact, "obs_time")))
+    {
+        ptr_record->obs_time = (uint32_t) ptr_item->valuedouble;
+        ptr_record->fields |= WEATHER_RECORD_OBS_TIME;
+    }
+    if (cJSON_IsNumber(ptr_item = cJSON_GetObjectItem(ptr_fact, "temp")))
+    {
+        ptr_record->temp_dc = (int16_t) lround(ptr_item->valuedouble * 10.0);
+        ptr_record->fields |= WEATHER_RECORD_TEMP;
+    }
+    if (cJSON_IsNumber(ptr_item = cJSON_GetObjectItem(ptr_fact, "feels_like")))
+    {
+        ptr_record->feels_like_dc = (int16_t) lround(ptr_item->valuedouble * 10.0);
+        ptr_record->fields |= WEATHER_RECORD_FEELS_LIKE;
+    }
+    if (cJSON_IsNumber(ptr_item = cJSON_GetObjectItem(ptr_fact, "humidity")))
+    {
+        ptr_record->humidity = (uint8_t) ptr_item->valueint;
+        ptr_record->fields |= WEATHER_RECORD_HUMIDITY;
+    }
+    if (cJSON_IsNumber(ptr_item = cJSON_GetObjectItem(ptr_fact, "pressure_mm")))
+    {
+        ptr_record->pressure_dmm = (uint16_t) lround(ptr_item->valuedouble * 10.0);
+        ptr_record->fields |= WEATHER_RECORD_PRESSURE;
+    }
+    if (cJSON_IsString(ptr_item = cJSON_GetObjectItem(ptr_fact, "condition")))
+    {
+        ptr_record->condition = weather_condition_from_str(ptr_item->valuestring, strlen(ptr_item->valuestring));
+        ptr_record->fields |= WEATHER_RECORD_CONDITION;
+    }
+    if (cJSON_IsNumber(ptr_item = cJSON_GetObjectItem(ptr_fact, "wind_speed")))
+    {
+        ptr_record->wind_speed_dms = (uint16_t) lround(ptr_item->valuedouble * 10.0);
+        ptr_record->fields |= WEATHER_RECORD_WIND_SPEED;
+    }
+    if (cJSON_IsString(ptr_item = cJSON_GetObjectItem(ptr_fact, "wind_dir")))
+    {
+        ptr_record->wind_dir = weather_wind_dir_from_str(ptr_item->valuestring, strlen(ptr_item->valuestring));
+        ptr_record->fields |= WEATHER_RECORD_WIND_DIR;
+    }
+    if (cJSON_IsString(ptr_item = cJSON_GetObjectItem(ptr_part, "part_name")))
+    {
+        ptr_record->part_name = weather_part_from_str(ptr_item->valuestring, strlen(ptr_item->valuestring));
+        ptr_record->fields |= WEATHER_RECORD_PART_NAME;
+    }
+    if (cJSON_IsNumber(ptr_item = cJSON_GetObjectItem(ptr_part, "temp_avg")))
+    {
+        ptr_record->part_temp_dc = (int16_t) lround(ptr_item->valuedouble * 10.0);
+        ptr_record->fields |= WEATHER_RECORD_PART_TEMP;
+    }
+    if (cJSON_IsString(ptr_item = cJSON_GetObjectItem(ptr_part, "condition")))
+    {
+        ptr_record->part_condition = weather_condition_from_str(ptr_item->valuestring, strlen(ptr_item->valuestring));
+        ptr_record->fields |= WEATHER_RECORD_PART_CONDITION;
+    }
+}
+
+/**
+ *  @brief      cJSON DOM path on the heap
+ *
+ *  @param[in]  ptr_data    NULL-terminated document
+ *  @param[in]  len         Document length
+ *  @param[out] ptr_record  Destination
+ */
+static void bench_parse_cjson(const char * ptr_data, size_t len, weather_record_t * ptr_record)
+{
+    cJSON * ptr_root = cJSON_ParseWithLength(ptr_data, len);
+    bench_cjson_fields(ptr_root, ptr_record);
+    cJSON_Delete(ptr_root);
+}
+
+/**
+ *  @brief      cJSON DOM path on the response arena, as the firmware does
+ *
+ *  @param[in]  ptr_data    NULL-terminated document
+ *  @param[in]  len         Document length
+ *  @param[out] ptr_record  Destination
+ */
+static void bench_parse_cjson_arena(const char * ptr_data, size_t len, weather_record_t * ptr_record)
+{
+    cJSON_Hooks hooks = {
+        .malloc_fn = &json_arena_malloc,
+        .free_fn = &json_arena_free,
+    };
+
+    json_arena_begin(&bench_arena);
+    cJSON_InitHooks(&hooks);
+    bench_cjson_fields(cJSON_ParseWithLength(ptr_data, len), ptr_record);
+    cJSON_InitHooks(NULL);
+    json_arena_end(&bench_arena);
+}
+#endif
+
+/**
+ *  @brief      Measure one parser and print its line
+ *
+ *  @param[in]  ptr_name    Parser name
+ *  @param[in]  parse       Parser
+ *  @param[in]  ptr_data    NULL-terminated document
+ *  @param[in]  len         Document length
+ */
+static void bench_run(const char * ptr_name, bench_parse_t parse, const char * ptr_data, size_t len)
+{
+    weather_record_t record;
+    char json[256];
+
+    /* Warm up caches and check the result once */
+    parse(ptr_data, len, &record);
+
+    memset(&bench_heap, 0x00, sizeof(bench_heap));
+    int64_t start_ns = bench_now_ns();
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        parse(ptr_data, len, &record);
+    }
+    int64_t elapsed_ns = bench_now_ns() - start_ns;
+
+    weather_record_to_json(&record, json, sizeof(json));
+    printf("%-8s %10.1f KB/s %8.2f us/parse %8.2f allocs/parse %8.2f frees/parse\n         %s\n",
+           ptr_name,
+           (double) len * BENCH_ITERATIONS * 1e9 / 1024.0 / (double) elapsed_ns,
+           (double) elapsed_ns / 1000.0 / BENCH_ITERATIONS,
+           (double) bench_heap.allocs / BENCH_ITERATIONS,
+           (double) bench_heap.frees / BENCH_ITERATIONS,
+           json);
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int main(int argc, char ** argv)
+{
+    const char * ptr_path = (argc > 1) ? argv[1] : HOST_BENCH_PAYLOAD_DIR "/informers.json";
+    static char data[BENCH_PAYLOAD_MAX];
+
+    FILE * ptr_file = fopen(ptr_path, "rb");
+    if (NULL == ptr_file)
+    {
+        fprintf(stderr, "Cannot open %s\n", ptr_path);
+        return 1;
+    }
+    size_t len = fread(data, 1, sizeof(data) - 1, ptr_file);
+    fclose(ptr_file);
+    data[len] = '\0';
+
+    printf("%s: %zu bytes, %u parses\n", ptr_path, len, BENCH_ITERATIONS);
+    bench_run("extract", &bench_parse_extract, data, len);
+#if HOST_BENCH_CJSON
+    static uint64_t arena_buf[BENCH_ARENA_SIZE / sizeof(uint64_t)];
+    json_arena_init(&bench_arena, arena_buf, sizeof(arena_buf));
+
+    bench_run("cjson", &bench_parse_cjson, data, len);
+    bench_run("arena", &bench_parse_cjson_arena, data, len);
+    printf("arena    high-water %zu bytes, %u allocations failed\n", bench_arena.high_water, bench_arena.failures);
+#else
+    printf("cjson    skipped, cJSON sources not found\n");
+#endif
+
+    return 0;
+}
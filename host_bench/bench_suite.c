@@ -0,0 +1,749 @@
+/**
+ *  @file       bench_suite.c
+ *
+ *  @brief      Host benchmark of the whole response decoding pipeline
+ *
+ *  Every recorded response of the corpus (plain, chunked and compressed
+ *  variants of informers and forecast documents) is decoded the way the
+ *  firmware does it: HTTP parser, content decoder, streaming JSON
+ *  consumer. Each response is fed in one piece, in receiving buffer sized
+ *  reads and in short reads that split tokens, chunk headers and the gzip
+ *  header; every variant must give the same result as the plain one.
+ *  Malformed framing (oversized chunk sizes and Content-Length) must be
+ *  rejected by the parser however it is split.
+ *  Reports throughput, heap use and allocations per response, tokenizer
+ *  and consumer time per document and the time of every extracted field.
+ *  With --json every result is printed as a JSON line for compare.py.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <malloc.h>
+
+#include "http_resp.h"
+#include "http_inflate.h"
+#include "weather_extract.h"
+#include "forecast_model.h"
+
+/******************** DEFINES ********************/
+
+#define BENCH_MIN_NS            200000000LL /**< Shortest measurement */
+#define BENCH_MIN_ITERATIONS    5           /**< Fewest decodes per measurement */
+#define BENCH_FIELD_REPEAT      200000      /**< Stores per field measurement */
+#define BENCH_PAYLOAD_MAX       262144      /**< Largest corpus response */
+#define BENCH_CORPUS_MAX        64          /**< Largest corpus */
+#define BENCH_NAME_MAX          128         /**< Longest corpus file name */
+#define BENCH_PATH_MAX          512         /**< Longest corpus file path */
+#define BENCH_FIELDS_MAX        32          /**< Largest extractor table */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Document kinds
+ */
+typedef enum bench_kind_e
+{
+    BENCH_KIND_INFORMERS = 0,   /**< /v2/informers, key-path table extractor */
+    BENCH_KIND_FORECAST,        /**< /v2/forecast, generated column decoder */
+} bench_kind_t;
+
+/**
+ *  @brief  Read pattern
+ */
+typedef struct bench_read_s
+{
+    const char * ptr_name;      /**< Pattern name */
+    size_t size;                /**< Bytes per read */
+} bench_read_t;
+
+/**
+ *  @brief  Response the HTTP parser must reject
+ */
+typedef struct bench_malformed_s
+{
+    const char * ptr_name;
+    const char * ptr_resp;
+} bench_malformed_t;
+
+/**
+ *  @brief  Heap use, counted by wrapping malloc() and friends at link time
+ */
+typedef struct bench_heap_s
+{
+    uint32_t allocs;            /**< malloc/calloc/realloc calls */
+    size_t current;             /**< Bytes allocated */
+    size_t peak;                /**< Largest bytes allocated */
+} bench_heap_t;
+
+/**
+ *  @brief  Decoding pipeline, as the weather task has it
+ */
+typedef struct bench_pipe_s
+{
+    bench_kind_t kind;
+    http_resp_t resp;
+    http_inflate_t inflate;
+    weather_extract_t extract;
+    weather_record_t record;
+    forecast_decoder_t forecast;
+    forecast_model_t model;
+} bench_pipe_t;
+
+/**
+ *  @brief  Captured value of a table path
+ */
+typedef struct bench_field_s
+{
+    char value[JSON_STREAM_VALUE_MAX];
+    size_t len;
+    bool is_found;
+} bench_field_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const bench_read_t bench_reads[] = {
+    { "whole",      SIZE_MAX },     /* Response in one piece */
+    { "rx1536",     1536 },         /* Firmware receiving buffer */
+    { "short61",    61 },           /* Short reads splitting everything */
+};
+#define BENCH_READS_QTY     (sizeof(bench_reads) / sizeof(bench_reads[0]))
+
+static const bench_malformed_t bench_malformed[] = {
+    /* 17 digits: shifted past 64 bits the size wraps to 0, the last chunk */
+    { "chunk_size_wrap",    "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                            "10000000000000000\r\nx\r\n0\r\n\r\n" },
+    { "chunk_size_max",     "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                            "fffffffffffffffff\r\nx\r\n0\r\n\r\n" },
+    { "content_length_max", "HTTP/1.1 200 OK\r\nContent-Length: 99999999999999999999\r\n\r\nx" },
+};
+#define BENCH_MALFORMED_QTY (sizeof(bench_malformed) / sizeof(bench_malformed[0]))
+
+static bench_heap_t bench_heap = {0};
+static bool bench_json = false;
+static bench_pipe_t bench_pipe;
+static bench_pipe_t bench_reference;
+static char bench_data[BENCH_PAYLOAD_MAX];
+static bench_field_t bench_fields[BENCH_FIELDS_MAX];
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t qty, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+void __real_free(void * ptr);
+
+static void bench_heap_add(void * ptr);
+static int64_t bench_now_ns(void);
+static void bench_header(const char * ptr_name, const char * ptr_value, void * ptr_arg);
+static void bench_wire_body(const char * ptr_data, size_t len, void * ptr_arg);
+static void bench_body(const char * ptr_data, size_t len, void * ptr_arg);
+static bool bench_decode(bench_pipe_t * ptr_pipe, const char * ptr_data, size_t len, size_t read_size);
+static bool bench_same(const bench_pipe_t * ptr_pipe, const bench_pipe_t * ptr_reference);
+static void bench_pipeline(const char * ptr_file, const char * ptr_doc, bench_kind_t kind, size_t len, bool is_first);
+static void bench_tokenize_value(const char * ptr_path,
+                                 json_stream_type_t type,
+                                 const char * ptr_value,
+                                 size_t len,
+                                 void * ptr_arg);
+static void bench_capture_value(const char * ptr_path,
+                                json_stream_type_t type,
+                                const char * ptr_value,
+                                size_t len,
+                                void * ptr_arg);
+static void bench_document(const char * ptr_doc, bench_kind_t kind, const char * ptr_data, size_t len);
+static size_t bench_load(const char * ptr_path);
+static bool bench_malformed_run(const bench_malformed_t * ptr_case);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Account an allocated block
+ *
+ *  @param[in]  ptr         Block (may be NULL)
+ */
+static void bench_heap_add(void * ptr)
+{
+    if (NULL == ptr)
+    {
+        return;
+    }
+    bench_heap.current += malloc_usable_size(ptr);
+    if (bench_heap.current > bench_heap.peak)
+    {
+        bench_heap.peak = bench_heap.current;
+    }
+}
+
+void * __wrap_malloc(size_t size)
+{
+    void * ptr = __real_malloc(size);
+
+    bench_heap.allocs++;
+    bench_heap_add(ptr);
+    return ptr;
+}
+
+void * __wrap_calloc(size_t qty, size_t size)
+{
+    void * ptr = __real_calloc(qty, size);
+
+    bench_heap.allocs++;
+    bench_heap_add(ptr);
+    return ptr;
+}
+
+void * __wrap_realloc(void * ptr, size_t size)
+{
+    size_t old_size = (NULL != ptr) ? malloc_usable_size(ptr) : 0;
+    void * ptr_new = __real_realloc(ptr, size);
+
+    bench_heap.allocs++;
+    if ((NULL != ptr_new) || (0 == size))
+    {
+        bench_heap.current -= old_size;
+        bench_heap_add(ptr_new);
+    }
+    return ptr_new;
+}
+
+void __wrap_free(void * ptr)
+{
+    if (NULL != ptr)
+    {
+        bench_heap.current -= malloc_usable_size(ptr);
+    }
+    __real_free(ptr);
+}
+
+/**
+ *  @brief      Monotonic time
+ *
+ *  @return     Nanoseconds
+ */
+static int64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ *  @brief      Response header consumer, content coding selects the decoder
+ *
+ *  @param[in]  ptr_name    Header name
+ *  @param[in]  ptr_value   Header value
+ *  @param[in]  ptr_arg     Pipeline pointer
+ */
+static void bench_header(const char * ptr_name, const char * ptr_value, void * ptr_arg)
+{
+    bench_pipe_t * ptr_pipe = (bench_pipe_t *) ptr_arg;
+
+    if (0 == strcasecmp(ptr_name, "Content-Encoding"))
+    {
+        http_inflate_begin(&ptr_pipe->inflate, http_inflate_coding(ptr_value));
+    }
+}
+
+/**
+ *  @brief      Encoded body consumer
+ *
+ *  @param[in]  ptr_data    Body bytes pointer
+ *  @param[in]  len         Body bytes quantity
+ *  @param[in]  ptr_arg     Pipeline pointer
+ */
+static void bench_wire_body(const char * ptr_data, size_t len, void * ptr_arg)
+{
+    bench_pipe_t * ptr_pipe = (bench_pipe_t *) ptr_arg;
+
+    http_inflate_feed(ptr_data, len, &ptr_pipe->inflate);
+}
+
+/**
+ *  @brief      Decoded body consumer
+ *
+ *  @param[in]  ptr_data    Body bytes pointer
+ *  @param[in]  len         Body bytes quantity
+ *  @param[in]  ptr_arg     Pipeline pointer
+ */
+static void bench_body(const char * ptr_data, size_t len, void * ptr_arg)
+{
+    bench_pipe_t * ptr_pipe = (bench_pipe_t *) ptr_arg;
+
+    if (BENCH_KIND_INFORMERS == ptr_pipe->kind)
+    {
+        weather_extract_feed(&ptr_pipe->extract, ptr_data, len);
+    }
+    else
+    {
+        forecast_decoder_feed(&ptr_pipe->forecast, ptr_data, len);
+    }
+}
+
+/**
+ *  @brief      Decode one response
+ *
+ *  @param[in]  ptr_pipe    Pipeline pointer
+ *  @param[in]  ptr_data    Response bytes
+ *  @param[in]  len         Response length
+ *  @param[in]  read_size   Bytes per read
+ *
+ *  @return     true if the response and its document are complete and well-formed
+ */
+static bool bench_decode(bench_pipe_t * ptr_pipe, const char * ptr_data, size_t len, size_t read_size)
+{
+    static const http_resp_cbs_t resp_cbs = {
+        .header_cb = &bench_header,
+        .body_cb = &bench_wire_body,
+    };
+
+    http_inflate_begin(&ptr_pipe->inflate, HTTP_INFLATE_IDENTITY);
+    if (BENCH_KIND_INFORMERS == ptr_pipe->kind)
+    {
+        weather_extract_init(&ptr_pipe->extract, &ptr_pipe->record);
+    }
+    else
+    {
+        forecast_decoder_init(&ptr_pipe->forecast, &ptr_pipe->model);
+    }
+    http_resp_init(&ptr_pipe->resp, &resp_cbs, ptr_pipe);
+
+    for (size_t pos = 0; (pos < len) && !http_resp_is_done(&ptr_pipe->resp); pos += read_size)
+    {
+        size_t size = (len - pos < read_size) ? len - pos : read_size;
+        http_resp_feed(&ptr_pipe->resp, ptr_data + pos, size);
+        if (http_resp_is_error(&ptr_pipe->resp))
+        {
+            return false;
+        }
+    }
+
+    if (!http_resp_is_done(&ptr_pipe->resp) || (200 != ptr_pipe->resp.status) ||
+        !http_inflate_finish(&ptr_pipe->inflate))
+    {
+        return false;
+    }
+    if (BENCH_KIND_INFORMERS == ptr_pipe->kind)
+    {
+        return weather_extract_finish(&ptr_pipe->extract) &&
+               ((ptr_pipe->record.fields & WEATHER_RECORD_REQUIRED) == WEATHER_RECORD_REQUIRED);
+    }
+
+    return forecast_decoder_finish(&ptr_pipe->forecast) && (ptr_pipe->model.days > 0);
+}
+
+/**
+ *  @brief      Compare decoded results
+ *
+ *  @param[in]  ptr_pipe        Pipeline pointer
+ *  @param[in]  ptr_reference   Result of the plain response
+ *
+ *  @return     true if results are the same
+ */
+static bool bench_same(const bench_pipe_t * ptr_pipe, const bench_pipe_t * ptr_reference)
+{
+    if (BENCH_KIND_INFORMERS == ptr_pipe->kind)
+    {
+        return (0 == memcmp(&ptr_pipe->record, &ptr_reference->record, sizeof(ptr_pipe->record)));
+    }
+
+    return (0 == memcmp(&ptr_pipe->model, &ptr_reference->model, sizeof(ptr_pipe->model)));
+}
+
+/**
+ *  @brief      Measure one corpus response in every read pattern
+ *
+ *  @param[in]  ptr_file    Corpus file name
+ *  @param[in]  ptr_doc     Document name
+ *  @param[in]  kind        Document kind
+ *  @param[in]  len         Response length (in bench_data)
+ *  @param[in]  is_first    First variant of the document, its result is the reference
+ */
+static void bench_pipeline(const char * ptr_file, const char * ptr_doc, bench_kind_t kind, size_t len, bool is_first)
+{
+    bench_pipe.kind = kind;
+
+    for (size_t r = 0; r < BENCH_READS_QTY; r++)
+    {
+        const bench_read_t * ptr_read = &bench_reads[r];
+
+        /* Warm up caches and check the result once */
+        bool is_ok = bench_decode(&bench_pipe, bench_data, len, ptr_read->size);
+        if (is_ok && is_first && (0 == r))
+        {
+            bench_reference = bench_pipe;
+        }
+        is_ok = is_ok && bench_same(&bench_pipe, &bench_reference);
+
+        uint32_t iterations = 0;
+        size_t heap_base = bench_heap.current;
+        bench_heap.peak = heap_base;
+        bench_heap.allocs = 0;
+        int64_t start_ns = bench_now_ns();
+        int64_t elapsed_ns = 0;
+        while ((elapsed_ns < BENCH_MIN_NS) || (iterations < BENCH_MIN_ITERATIONS))
+        {
+            bench_decode(&bench_pipe, bench_data, len, ptr_read->size);
+            iterations++;
+            elapsed_ns = bench_now_ns() - start_ns;
+        }
+
+        double us_per_resp = (double) elapsed_ns / 1000.0 / iterations;
+        double wire_mbps = (double) len * iterations * 1000.0 / (double) elapsed_ns;
+        double json_mbps = (double) bench_pipe.inflate.out_bytes * iterations * 1000.0 / (double) elapsed_ns;
+        double allocs = (double) bench_heap.allocs / iterations;
+        size_t peak = bench_heap.peak - heap_base;
+
+        if (bench_json)
+        {
+            printf("{\"bench\":\"pipeline\",\"corpus\":\"%s\",\"doc\":\"%s\",\"reads\":\"%s\","
+                   "\"wire_bytes\":%zu,\"json_bytes\":%llu,\"iterations\":%u,"
+                   "\"us_per_resp\":%.3f,\"wire_mbps\":%.2f,\"json_mbps\":%.2f,"
+                   "\"allocs_per_resp\":%.2f,\"peak_heap_bytes\":%zu,\"ok\":%s}\n",
+                   ptr_file, ptr_doc, ptr_read->ptr_name,
+                   len, (unsigned long long) bench_pipe.inflate.out_bytes, iterations,
+                   us_per_resp, wire_mbps, json_mbps,
+                   allocs, peak, is_ok ? "true" : "false");
+        }
+        else
+        {
+            printf("%-30s %-8s %8zu %8llu %10.2f %9.1f %9.1f %7.2f %8zu  %s\n",
+                   ptr_file, ptr_read->ptr_name,
+                   len, (unsigned long long) bench_pipe.inflate.out_bytes,
+                   us_per_resp, wire_mbps, json_mbps,
+                   allocs, peak, is_ok ? "ok" : "MISMATCH");
+        }
+    }
+}
+
+/**
+ *  @brief      Tokenizer value consumer that does nothing, the parsing baseline
+ *
+ *  @param[in]  ptr_path    Value path
+ *  @param[in]  type        Value type
+ *  @param[in]  ptr_value   Value text
+ *  @param[in]  len         Value text length
+ *  @param[in]  ptr_arg     Values counter pointer
+ */
+static void bench_tokenize_value(const char * ptr_path,
+                                 json_stream_type_t type,
+                                 const char * ptr_value,
+                                 size_t len,
+                                 void * ptr_arg)
+{
+    (void) ptr_path;
+    (void) type;
+    (void) ptr_value;
+    (void) len;
+    (*(uint32_t *) ptr_arg)++;
+}
+
+/**
+ *  @brief      Tokenizer value consumer, keeps values of the extractor table paths
+ *
+ *  @param[in]  ptr_path    Value path
+ *  @param[in]  type        Value type
+ *  @param[in]  ptr_value   Value text
+ *  @param[in]  len         Value text length
+ *  @param[in]  ptr_arg     Captured values
+ */
+static void bench_capture_value(const char * ptr_path,
+                                json_stream_type_t type,
+                                const char * ptr_value,
+                                size_t len,
+                                void * ptr_arg)
+{
+    bench_field_t * ptr_fields = (bench_field_t *) ptr_arg;
+
+    (void) type;
+    for (size_t i = 0; (i < weather_paths_qty) && (i < BENCH_FIELDS_MAX); i++)
+    {
+        if (0 == strcmp(weather_paths[i].ptr_path, ptr_path))
+        {
+            memcpy(ptr_fields[i].value, ptr_value, len + 1);
+            ptr_fields[i].len = len;
+            ptr_fields[i].is_found = true;
+            return;
+        }
+    }
+}
+
+/**
+ *  @brief      Measure document consumers: tokenizer alone, full consumer and every table field
+ *
+ *  @param[in]  ptr_doc     Document name
+ *  @param[in]  kind        Document kind
+ *  @param[in]  ptr_data    Document (response body of the plain variant)
+ *  @param[in]  len         Document length
+ */
+static void bench_document(const char * ptr_doc, bench_kind_t kind, const char * ptr_data, size_t len)
+{
+    json_stream_t json;
+    uint32_t values = 0;
+    uint32_t iterations = 0;
+    int64_t start_ns = bench_now_ns();
+    int64_t tokenize_ns = 0;
+    int64_t consume_ns = 0;
+
+    while ((tokenize_ns < BENCH_MIN_NS) || (iterations < BENCH_MIN_ITERATIONS))
+    {
+        values = 0;
+        json_stream_init(&json, &bench_tokenize_value, &values);
+        json_stream_feed(&json, ptr_data, len);
+        json_stream_finish(&json);
+        iterations++;
+        tokenize_ns = bench_now_ns() - start_ns;
+    }
+    tokenize_ns /= iterations;
+
+    iterations = 0;
+    start_ns = bench_now_ns();
+    while ((consume_ns < BENCH_MIN_NS) || (iterations < BENCH_MIN_ITERATIONS))
+    {
+        if (BENCH_KIND_INFORMERS == kind)
+        {
+            weather_extract_init(&bench_pipe.extract, &bench_pipe.record);
+            weather_extract_feed(&bench_pipe.extract, ptr_data, len);
+            weather_extract_finish(&bench_pipe.extract);
+        }
+        else
+        {
+            forecast_decoder_init(&bench_pipe.forecast, &bench_pipe.model);
+            forecast_decoder_feed(&bench_pipe.forecast, ptr_data, len);
+            forecast_decoder_finish(&bench_pipe.forecast);
+        }
+        iterations++;
+        consume_ns = bench_now_ns() - start_ns;
+    }
+    consume_ns /= iterations;
+
+    if (bench_json)
+    {
+        printf("{\"bench\":\"document\",\"doc\":\"%s\",\"json_bytes\":%zu,\"values\":%u,"
+               "\"tokenize_ns\":%lld,\"consume_ns\":%lld,\"ns_per_value\":%.2f}\n",
+               ptr_doc, len, values, (long long) tokenize_ns, (long long) consume_ns,
+               (double) consume_ns / values);
+    }
+    else
+    {
+        printf("%-30s %8zu %8u %12lld %12lld %10.2f\n",
+               ptr_doc, len, values, (long long) tokenize_ns, (long long) consume_ns,
+               (double) consume_ns / values);
+    }
+
+    if (BENCH_KIND_INFORMERS != kind)
+    {
+        return;
+    }
+
+    /* Every table field: number decoding or code mapping and the store */
+    memset(bench_fields, 0x00, sizeof(bench_fields));
+    json_stream_init(&json, &bench_capture_value, bench_fields);
+    json_stream_feed(&json, ptr_data, len);
+    json_stream_finish(&json);
+    for (size_t i = 0; (i < weather_paths_qty) && (i < BENCH_FIELDS_MAX); i++)
+    {
+        const bench_field_t * ptr_field = &bench_fields[i];
+        weather_record_t record;
+
+        if (!ptr_field->is_found)
+        {
+            continue;
+        }
+        memset(&record, 0x00, sizeof(record));
+        start_ns = bench_now_ns();
+        for (uint32_t n = 0; n < BENCH_FIELD_REPEAT; n++)
+        {
+            weather_extract_store(&record, &weather_paths[i], ptr_field->value, ptr_field->len);
+            __asm__ volatile ("" : : "r" (&record) : "memory");
+        }
+        double ns = (double) (bench_now_ns() - start_ns) / BENCH_FIELD_REPEAT;
+
+        if (bench_json)
+        {
+            printf("{\"bench\":\"field\",\"doc\":\"%s\",\"path\":\"%s\",\"value\":\"%s\",\"ns\":%.2f}\n",
+                   ptr_doc, weather_paths[i].ptr_path, ptr_field->value, ns);
+        }
+        else
+        {
+            printf("    %-34s %-16s %8.2f ns\n", weather_paths[i].ptr_path, ptr_field->value, ns);
+        }
+    }
+}
+
+/**
+ *  @brief      Load corpus file into bench_data, NULL-terminated
+ *
+ *  @param[in]  ptr_path    File path
+ *
+ *  @return     File length, 0 if it cannot be read or does not fit
+ */
+static size_t bench_load(const char * ptr_path)
+{
+    FILE * ptr_file = fopen(ptr_path, "rb");
+    if (NULL == ptr_file)
+    {
+        return 0;
+    }
+    size_t len = fread(bench_data, 1, sizeof(bench_data) - 1, ptr_file);
+    bool is_whole = (0 != feof(ptr_file));
+    fclose(ptr_file);
+    bench_data[len] = '\0';
+
+    return is_whole ? len : 0;
+}
+
+/**
+ *  @brief      Malformed response check, fed whole and byte by byte
+ *
+ *  @param[in]  ptr_case    Response pointer
+ *
+ *  @return     true if the parser reports an error both ways
+ */
+static bool bench_malformed_run(const bench_malformed_t * ptr_case)
+{
+    http_resp_t resp;
+    size_t len = strlen(ptr_case->ptr_resp);
+    bool ok = true;
+
+    for (size_t read_size = len; read_size > 0; read_size = (1 == read_size) ? 0 : 1)
+    {
+        http_resp_init(&resp, NULL, NULL);
+        for (size_t pos = 0; (pos < len) && !http_resp_is_done(&resp) && !http_resp_is_error(&resp); pos += read_size)
+        {
+            http_resp_feed(&resp, ptr_case->ptr_resp + pos, (len - pos < read_size) ? len - pos : read_size);
+        }
+        ok = ok && http_resp_is_error(&resp) && !http_resp_is_done(&resp);
+    }
+
+    if (bench_json)
+    {
+        printf("{\"bench\":\"framing\",\"case\":\"%s\",\"ok\":%s}\n", ptr_case->ptr_name, ok ? "true" : "false");
+    }
+    else
+    {
+        printf("%-30s %s\n", ptr_case->ptr_name, ok ? "rejected" : "ACCEPTED");
+    }
+
+    return ok;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int main(int argc, char ** argv)
+{
+    const char * ptr_manifest = HOST_BENCH_CORPUS_DIR "/corpus.txt";
+    char dir[BENCH_PATH_MAX];
+    char files[BENCH_CORPUS_MAX][BENCH_NAME_MAX];
+    char docs[BENCH_CORPUS_MAX][BENCH_NAME_MAX];
+    size_t qty = 0;
+    int failures = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--json"))
+        {
+            bench_json = true;
+        }
+        else
+        {
+            ptr_manifest = argv[i];
+        }
+    }
+
+    FILE * ptr_file = fopen(ptr_manifest, "r");
+    if (NULL == ptr_file)
+    {
+        fprintf(stderr, "Cannot open %s\n", ptr_manifest);
+        return 1;
+    }
+    while ((qty < BENCH_CORPUS_MAX) && (2 == fscanf(ptr_file, "%127s %127s", files[qty], docs[qty])))
+    {
+        qty++;
+    }
+    fclose(ptr_file);
+
+    const char * ptr_slash = strrchr(ptr_manifest, '/');
+    snprintf(dir, sizeof(dir), "%.*s", (NULL != ptr_slash) ? (int) (ptr_slash - ptr_manifest) : 1,
+             (NULL != ptr_slash) ? ptr_manifest : ".");
+
+    /* Content decoder allocates its state and window once, as in the firmware */
+    size_t heap_base = bench_heap.current;
+    if (ESP_OK != http_inflate_init(&bench_pipe.inflate, &bench_body, &bench_pipe))
+    {
+        fprintf(stderr, "Cannot allocate content decoder\n");
+        return 1;
+    }
+
+    if (!bench_json)
+    {
+        printf("%-30s %-8s %8s %8s %10s %9s %9s %7s %8s\n",
+               "corpus", "reads", "wire B", "json B", "us/resp", "wire MB/s", "json MB/s", "allocs", "peak B");
+    }
+    for (size_t i = 0; i < qty; i++)
+    {
+        char path[BENCH_PATH_MAX + BENCH_NAME_MAX + 1];
+        bench_kind_t kind = (0 == strcmp(docs[i], "forecast")) ? BENCH_KIND_FORECAST : BENCH_KIND_INFORMERS;
+        bool is_first = (0 == i) || (0 != strcmp(docs[i], docs[i - 1]));
+
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+        size_t len = bench_load(path);
+        if (0 == len)
+        {
+            fprintf(stderr, "Cannot read %s\n", path);
+            failures++;
+            continue;
+        }
+        bench_pipeline(files[i], docs[i], kind, len, is_first);
+    }
+
+    if (bench_json)
+    {
+        printf("{\"bench\":\"setup\",\"heap_bytes\":%zu}\n", bench_heap.current - heap_base);
+    }
+    else
+    {
+        printf("pipeline setup heap: %zu bytes (content decoder state and window)\n\n", bench_heap.current - heap_base);
+        printf("%-30s %8s %8s %12s %12s %10s\n", "document", "json B", "values", "tokenize ns", "consume ns", "ns/value");
+    }
+    for (size_t i = 0; i < qty; i++)
+    {
+        char path[BENCH_PATH_MAX + BENCH_NAME_MAX + 1];
+
+        /* Plain variant of every document is measured without the HTTP layer */
+        if ((0 != i) && (0 == strcmp(docs[i], docs[i - 1])))
+        {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i]);
+        size_t len = bench_load(path);
+        const char * ptr_body = strstr(bench_data, "\r\n\r\n");
+        if ((0 == len) || (NULL == ptr_body))
+        {
+            continue;
+        }
+        ptr_body += 4;
+        bench_document(docs[i], (0 == strcmp(docs[i], "forecast")) ? BENCH_KIND_FORECAST : BENCH_KIND_INFORMERS,
+                       ptr_body, len - (ptr_body - bench_data));
+    }
+
+    http_inflate_deinit(&bench_pipe.inflate);
+
+    if (!bench_json)
+    {
+        printf("\n%-30s %s\n", "malformed response", "result");
+    }
+    for (size_t i = 0; i < BENCH_MALFORMED_QTY; i++)
+    {
+        failures += bench_malformed_run(&bench_malformed[i]) ? 0 : 1;
+    }
+
+    return (0 == failures) ? 0 : 1;
+}
@@ -0,0 +1,378 @@
+/**
+ *  @file       bench_tls.c
+ *
+ *  @brief      Host comparison of full and resumed TLS handshakes against openssl s_server
+ *
+ *  The client is mbedTLS configured as esp-tls does it on the device
+ *  (TLS 1.2, certificate verification against an RSA-2048 root). Local
+ *  openssl s_server stand-ins are started on loopback: one with the
+ *  session cache and tickets, one with both disabled. Every scenario
+ *  connects a number of times, offering the session of the previous
+ *  connection, and reports the wall and client CPU time of the handshake
+ *  and how many handshakes actually resumed. A handshake counts as
+ *  resumed by the same rule as tls_session_is_resumed() on the device:
+ *  the master secret of the offered session is kept. Exits with 1 if the
+ *  resumed count differs from the expected one, so the firmware counters
+ *  are checked against a server that rejects every offered session.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+/* Same private access as tls_session.c */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "mbedtls/version.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#if defined(MBEDTLS_USE_PSA_CRYPTO) || defined(MBEDTLS_SSL_PROTO_TLS1_3)
+#include "psa/crypto.h"
+#endif
+
+#if MBEDTLS_VERSION_MAJOR < 3
+#error "mbedTLS 3.x (as in ESP-IDF 5) is required"
+#endif
+
+/******************** DEFINES ********************/
+
+#define BENCH_ROUNDS            20          /**< Handshakes per scenario */
+#define BENCH_PORT_CACHING      "44330"     /**< Stand-in with session cache and tickets */
+#define BENCH_PORT_REJECTING    "44331"     /**< Stand-in without session cache and tickets */
+#define BENCH_HOST              "localhost" /**< Certificate common name */
+#define BENCH_START_TRIES       50          /**< Connection tries while a stand-in starts */
+#define BENCH_START_DELAY_US    100000      /**< Delay between the tries */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Scenario
+ */
+typedef struct bench_scenario_s
+{
+    const char * ptr_name;
+    const char * ptr_port;      /**< Stand-in port */
+    bool is_offering;           /**< Session of the previous connection is offered */
+    bool has_tickets;           /**< Client asks for session tickets */
+    bool is_resumable;          /**< Every offered session is expected to resume */
+} bench_scenario_t;
+
+/**
+ *  @brief  Handshake result
+ */
+typedef struct bench_handshake_s
+{
+    int64_t wall_us;            /**< Handshake wall time */
+    int64_t cpu_us;             /**< Client CPU time */
+    bool is_resumed;            /**< Offered session was resumed */
+} bench_handshake_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const bench_scenario_t bench_scenarios[] = {
+    { "full",               BENCH_PORT_CACHING,     false,  true,   false },
+    { "session_id",         BENCH_PORT_CACHING,     true,   false,  true },
+    { "ticket",             BENCH_PORT_CACHING,     true,   true,   true },
+    { "offered_rejected",   BENCH_PORT_REJECTING,   true,   true,   false },
+};
+#define BENCH_SCENARIOS_QTY (sizeof(bench_scenarios) / sizeof(bench_scenarios[0]))
+
+static mbedtls_entropy_context bench_entropy;
+static mbedtls_ctr_drbg_context bench_drbg;
+static mbedtls_x509_crt bench_ca;
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static int64_t bench_now_us(clockid_t clock);
+static pid_t bench_server_start(const char * ptr_port, bool is_rejecting);
+static bool bench_server_wait(const char * ptr_port);
+static int bench_handshake(const bench_scenario_t * ptr_scenario,
+                           mbedtls_ssl_session * ptr_session,
+                           bool has_session,
+                           bench_handshake_t * ptr_result);
+static bool bench_scenario_run(const bench_scenario_t * ptr_scenario);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Clock reading
+ *
+ *  @param[in]  clock       CLOCK_MONOTONIC or CLOCK_PROCESS_CPUTIME_ID
+ *
+ *  @return     Microseconds
+ */
+static int64_t bench_now_us(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ *  @brief      openssl s_server stand-in start
+ *
+ *  @param[in]  ptr_port        Port to accept on
+ *  @param[in]  is_rejecting    Session cache and tickets are disabled
+ *
+ *  @return     Process ID, -1 on error
+ */
+static pid_t bench_server_start(const char * ptr_port, bool is_rejecting)
+{
+    pid_t pid = fork();
+    if (0 != pid)
+    {
+        return pid;
+    }
+
+    int null_fd = open("/dev/null", O_RDWR);
+    dup2(null_fd, STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+    dup2(null_fd, STDERR_FILENO);
+    if (is_rejecting)
+    {
+        execl(HOST_BENCH_OPENSSL, "openssl", "s_server", "-accept", ptr_port, "-www", "-quiet",
+              "-cert", HOST_BENCH_TLS_DIR "/cert.pem", "-key", HOST_BENCH_TLS_DIR "/key.pem",
+              "-no_cache", "-no_ticket", (char *) NULL);
+    }
+    else
+    {
+        execl(HOST_BENCH_OPENSSL, "openssl", "s_server", "-accept", ptr_port, "-www", "-quiet",
+              "-cert", HOST_BENCH_TLS_DIR "/cert.pem", "-key", HOST_BENCH_TLS_DIR "/key.pem",
+              (char *) NULL);
+    }
+    _exit(127);
+}
+
+/**
+ *  @brief      Wait until a stand-in accepts connections
+ *
+ *  @param[in]  ptr_port    Stand-in port
+ *
+ *  @return     true if it accepts
+ */
+static bool bench_server_wait(const char * ptr_port)
+{
+    for (int i = 0; i < BENCH_START_TRIES; i++)
+    {
+        mbedtls_net_context net;
+        mbedtls_net_init(&net);
+        int ret = mbedtls_net_connect(&net, "127.0.0.1", ptr_port, MBEDTLS_NET_PROTO_TCP);
+        mbedtls_net_free(&net);
+        if (0 == ret)
+        {
+            return true;
+        }
+        usleep(BENCH_START_DELAY_US);
+    }
+
+    return false;
+}
+
+/**
+ *  @brief      One connection: TCP connect, TLS handshake, close
+ *
+ *  @param[in]  ptr_scenario    Scenario pointer
+ *  @param[in,out] ptr_session  Session to offer, replaced by the new one
+ *  @param[in]  has_session     ptr_session holds a session
+ *  @param[out] ptr_result      Handshake result
+ *
+ *  @return     0 on success, mbedTLS error code otherwise
+ */
+static int bench_handshake(const bench_scenario_t * ptr_scenario,
+                           mbedtls_ssl_session * ptr_session,
+                           bool has_session,
+                           bench_handshake_t * ptr_result)
+{
+    mbedtls_net_context net;
+    mbedtls_ssl_config conf;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_session session;
+
+    mbedtls_net_init(&net);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_session_init(&session);
+
+    int ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    if (0 == ret)
+    {
+        mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+        mbedtls_ssl_conf_ca_chain(&conf, &bench_ca, NULL);
+        mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &bench_drbg);
+        mbedtls_ssl_conf_max_tls_version(&conf, MBEDTLS_SSL_VERSION_TLS1_2);
+        mbedtls_ssl_conf_session_tickets(&conf, ptr_scenario->has_tickets ? MBEDTLS_SSL_SESSION_TICKETS_ENABLED
+                                                                          : MBEDTLS_SSL_SESSION_TICKETS_DISABLED);
+        ret = mbedtls_ssl_setup(&ssl, &conf);
+    }
+    if (0 == ret)
+    {
+        ret = mbedtls_ssl_set_hostname(&ssl, BENCH_HOST);
+    }
+    if ((0 == ret) && has_session)
+    {
+        ret = mbedtls_ssl_set_session(&ssl, ptr_session);
+    }
+
+    int64_t wall_us = bench_now_us(CLOCK_MONOTONIC);
+    int64_t cpu_us = bench_now_us(CLOCK_PROCESS_CPUTIME_ID);
+    if (0 == ret)
+    {
+        ret = mbedtls_net_connect(&net, "127.0.0.1", ptr_scenario->ptr_port, MBEDTLS_NET_PROTO_TCP);
+    }
+    if (0 == ret)
+    {
+        mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, NULL);
+        do {
+            ret = mbedtls_ssl_handshake(&ssl);
+        } while ((MBEDTLS_ERR_SSL_WANT_READ == ret) || (MBEDTLS_ERR_SSL_WANT_WRITE == ret));
+    }
+    ptr_result->wall_us = bench_now_us(CLOCK_MONOTONIC) - wall_us;
+    ptr_result->cpu_us = bench_now_us(CLOCK_PROCESS_CPUTIME_ID) - cpu_us;
+
+    if (0 == ret)
+    {
+        ret = mbedtls_ssl_get_session(&ssl, &session);
+    }
+    if (0 == ret)
+    {
+        ptr_result->is_resumed = has_session &&
+                                 (0 == memcmp(ptr_session->MBEDTLS_PRIVATE(master),
+                                              session.MBEDTLS_PRIVATE(master),
+                                              sizeof(session.MBEDTLS_PRIVATE(master))));
+        mbedtls_ssl_session_free(ptr_session);
+        *ptr_session = session;
+        mbedtls_ssl_close_notify(&ssl);
+    }
+    else
+    {
+        mbedtls_ssl_session_free(&session);
+    }
+
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&conf);
+    mbedtls_net_free(&net);
+
+    return ret;
+}
+
+/**
+ *  @brief      Scenario handshakes and report
+ *
+ *  @param[in]  ptr_scenario    Scenario pointer
+ *
+ *  @return     true if every handshake succeeded and resumed as expected
+ */
+static bool bench_scenario_run(const bench_scenario_t * ptr_scenario)
+{
+    mbedtls_ssl_session session;
+    bench_handshake_t result;
+    int64_t wall_us = 0;
+    int64_t cpu_us = 0;
+    uint32_t resumed = 0;
+    bool has_session = false;
+    int ret = 0;
+
+    mbedtls_ssl_session_init(&session);
+
+    /* The first session comes from a full handshake that is not counted */
+    if (ptr_scenario->is_offering)
+    {
+        ret = bench_handshake(ptr_scenario, &session, false, &result);
+        has_session = (0 == ret);
+    }
+    for (uint32_t i = 0; (0 == ret) && (i < BENCH_ROUNDS); i++)
+    {
+        ret = bench_handshake(ptr_scenario, &session, has_session && ptr_scenario->is_offering, &result);
+        wall_us += result.wall_us;
+        cpu_us += result.cpu_us;
+        resumed += result.is_resumed ? 1 : 0;
+        has_session = (0 == ret);
+    }
+    mbedtls_ssl_session_free(&session);
+
+    if (0 != ret)
+    {
+        printf("%-18s handshake failed: -0x%04X\n", ptr_scenario->ptr_name, (unsigned int) -ret);
+        return false;
+    }
+
+    bool ok = (resumed == (ptr_scenario->is_resumable ? BENCH_ROUNDS : 0));
+    printf("%-18s %8.2f ms wall  %8.2f ms client CPU  resumed %2u/%u  %s\n",
+           ptr_scenario->ptr_name,
+           wall_us / 1000.0 / BENCH_ROUNDS,
+           cpu_us / 1000.0 / BENCH_ROUNDS,
+           resumed,
+           BENCH_ROUNDS,
+           ok ? "ok" : "WRONG");
+
+    return ok;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int main(void)
+{
+    bool ok = true;
+
+#if defined(MBEDTLS_USE_PSA_CRYPTO) || defined(MBEDTLS_SSL_PROTO_TLS1_3)
+    psa_crypto_init();
+#endif
+    mbedtls_entropy_init(&bench_entropy);
+    mbedtls_ctr_drbg_init(&bench_drbg);
+    mbedtls_x509_crt_init(&bench_ca);
+    if ((0 != mbedtls_ctr_drbg_seed(&bench_drbg, mbedtls_entropy_func, &bench_entropy, NULL, 0)) ||
+        (0 != mbedtls_x509_crt_parse_file(&bench_ca, HOST_BENCH_TLS_DIR "/cert.pem")))
+    {
+        fprintf(stderr, "Cannot initialize mbedTLS\n");
+        return 1;
+    }
+
+    pid_t caching = bench_server_start(BENCH_PORT_CACHING, false);
+    pid_t rejecting = bench_server_start(BENCH_PORT_REJECTING, true);
+    if ((caching < 0) || (rejecting < 0) ||
+        !bench_server_wait(BENCH_PORT_CACHING) || !bench_server_wait(BENCH_PORT_REJECTING))
+    {
+        fprintf(stderr, "Cannot start openssl s_server stand-ins\n");
+        ok = false;
+    }
+
+    if (ok)
+    {
+        printf("%u handshakes per scenario, TLS 1.2, RSA-2048 server certificate\n", BENCH_ROUNDS);
+        for (size_t i = 0; i < BENCH_SCENARIOS_QTY; i++)
+        {
+            ok = bench_scenario_run(&bench_scenarios[i]) && ok;
+        }
+    }
+
+    if (caching > 0)
+    {
+        kill(caching, SIGTERM);
+        waitpid(caching, NULL, 0);
+    }
+    if (rejecting > 0)
+    {
+        kill(rejecting, SIGTERM);
+        waitpid(rejecting, NULL, 0);
+    }
+    mbedtls_x509_crt_free(&bench_ca);
+    mbedtls_ctr_drbg_free(&bench_drbg);
+    mbedtls_entropy_free(&bench_entropy);
+
+    return ok ? 0 : 1;
+}
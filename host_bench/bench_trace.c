@@ -0,0 +1,284 @@
+/**
+ *  @file       bench_trace.c
+ *
+ *  @brief      Host run of the boot and fetch phase timeline on a simulated clock
+ *
+ *  The firmware phase tracer runs on a simulated clock that is advanced
+ *  by a network model: cold boot (full scan, DHCP, NTP, full TLS
+ *  handshake), warm reset (cached access point and lease, restored
+ *  clock, DNS cache, TLS session resumption) and a keep-alive poll.
+ *  The response is fed to the key-path table extractor in receiving
+ *  buffer sized reads at the modelled link rate, the host CPU time of
+ *  every read is added to the clock, so parsing shows up as its own
+ *  share of the timeline. Network costs are model assumptions, not
+ *  measurements: the output is for comparing pipeline changes phase by
+ *  phase. With --json every phase is printed as a JSON line for
+ *  compare.py, followed by the tracer's own JSON report.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "phase_trace.h"
+#include "weather_extract.h"
+
+/******************** DEFINES ********************/
+
+#define BENCH_CHUNK_SIZE        1536        /**< Extractor feed size, as the firmware receiving buffer */
+#define BENCH_PAYLOAD_MAX       65536       /**< Largest payload */
+#define BENCH_STEPS_MAX         PHASE_TRACE_QTY
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Scenario step: the phase ends after its cost
+ *
+ *  The cost of PHASE_TRACE_LAST_BYTE is not used, the response takes
+ *  its size at the scenario link rate plus the parsing time of the reads.
+ */
+typedef struct bench_step_s
+{
+    phase_trace_id_t id;        /**< Phase */
+    int64_t cost_us;            /**< Simulated time since the previous step */
+} bench_step_t;
+
+/**
+ *  @brief  Scenario
+ */
+typedef struct bench_scenario_s
+{
+    const char * ptr_name;
+    uint32_t link_bps;          /**< Response transfer rate, bytes per second */
+    bench_step_t steps[BENCH_STEPS_MAX];
+    size_t steps_qty;
+} bench_scenario_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static int64_t bench_clock_us = 0;  /**< Simulated clock */
+static bool bench_json = false;
+
+static const bench_scenario_t bench_scenarios[] = {
+    {
+        "cold_boot", 50000,
+        {
+            { PHASE_TRACE_NVS_INIT,     30000 },
+            { PHASE_TRACE_WIFI_START,   250000 },
+            { PHASE_TRACE_ASSOCIATED,   2500000 },  /* Full scan of all channels */
+            { PHASE_TRACE_GOT_IP,       1200000 },  /* DHCP discover/offer/request/ack */
+            { PHASE_TRACE_TIME_VALID,   150000 },   /* Parallel NTP query */
+            { PHASE_TRACE_DNS,          60000 },
+            { PHASE_TRACE_CONNECT,      900000 },   /* TCP and full TLS handshake */
+            { PHASE_TRACE_REQUEST_SENT, 5000 },
+            { PHASE_TRACE_FIRST_BYTE,   120000 },
+            { PHASE_TRACE_LAST_BYTE,    0 },
+            { PHASE_TRACE_PARSE_DONE,   0 },
+            { PHASE_TRACE_DISPLAY_DONE, 2000 },
+        },
+        12,
+    },
+    {
+        "warm_reset", 50000,
+        {
+            { PHASE_TRACE_NVS_INIT,     30000 },
+            { PHASE_TRACE_TIME_VALID,   1000 },     /* RTC checkpoint */
+            { PHASE_TRACE_WIFI_START,   250000 },
+            { PHASE_TRACE_ASSOCIATED,   300000 },   /* Cached access point and channel */
+            { PHASE_TRACE_GOT_IP,       20000 },    /* Cached lease */
+            { PHASE_TRACE_DNS,          1000 },     /* DNS cache */
+            { PHASE_TRACE_CONNECT,      350000 },   /* TCP and TLS session resumption */
+            { PHASE_TRACE_REQUEST_SENT, 5000 },
+            { PHASE_TRACE_FIRST_BYTE,   120000 },
+            { PHASE_TRACE_LAST_BYTE,    0 },
+            { PHASE_TRACE_PARSE_DONE,   0 },
+            { PHASE_TRACE_DISPLAY_DONE, 2000 },
+        },
+        12,
+    },
+    {
+        "keep_alive_poll", 50000,
+        {
+            { PHASE_TRACE_REQUEST_SENT, 5000 },     /* Connection is reused */
+            { PHASE_TRACE_FIRST_BYTE,   120000 },
+            { PHASE_TRACE_LAST_BYTE,    0 },
+            { PHASE_TRACE_PARSE_DONE,   0 },
+            { PHASE_TRACE_DISPLAY_DONE, 2000 },
+        },
+        5,
+    },
+};
+#define BENCH_SCENARIOS_QTY (sizeof(bench_scenarios) / sizeof(bench_scenarios[0]))
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static int64_t bench_clock(void);
+static int64_t bench_cpu_us(void);
+static bool bench_receive(const bench_scenario_t * ptr_scenario, const char * ptr_data, size_t len,
+                          weather_extract_t * ptr_extract);
+static bool bench_scenario_run(const bench_scenario_t * ptr_scenario, const char * ptr_data, size_t len);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Simulated clock
+ *
+ *  @return     Microseconds
+ */
+static int64_t bench_clock(void)
+{
+    return bench_clock_us;
+}
+
+/**
+ *  @brief      Host CPU time
+ *
+ *  @return     Microseconds
+ */
+static int64_t bench_cpu_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/**
+ *  @brief      Response reads at the link rate, each one parsed as it arrives
+ *
+ *  @param[in]  ptr_scenario    Scenario pointer
+ *  @param[in]  ptr_data        Response body
+ *  @param[in]  len             Body length
+ *  @param[in]  ptr_extract     Extractor
+ *
+ *  @return     true if every read is accepted
+ */
+static bool bench_receive(const bench_scenario_t * ptr_scenario, const char * ptr_data, size_t len,
+                          weather_extract_t * ptr_extract)
+{
+    bool ok = true;
+
+    for (size_t pos = 0; pos < len; pos += BENCH_CHUNK_SIZE)
+    {
+        size_t chunk = (len - pos < BENCH_CHUNK_SIZE) ? len - pos : BENCH_CHUNK_SIZE;
+
+        /* The first read arrives with the first byte, the rest take their transfer time */
+        if (pos > 0)
+        {
+            bench_clock_us += (int64_t) chunk * 1000000 / ptr_scenario->link_bps;
+        }
+        int64_t start_us = bench_cpu_us();
+        ok = weather_extract_feed(ptr_extract, ptr_data + pos, chunk) && ok;
+        bench_clock_us += bench_cpu_us() - start_us;
+    }
+
+    return ok;
+}
+
+/**
+ *  @brief      Scenario run and report
+ *
+ *  @param[in]  ptr_scenario    Scenario pointer
+ *  @param[in]  ptr_data        Response body
+ *  @param[in]  len             Body length
+ *
+ *  @return     true if the response is parsed
+ */
+static bool bench_scenario_run(const bench_scenario_t * ptr_scenario, const char * ptr_data, size_t len)
+{
+    weather_record_t record;
+    weather_extract_t extract;
+    bool ok = true;
+
+    bench_clock_us = 0;
+    phase_trace_init(&bench_clock);
+    weather_extract_init(&extract, &record);
+
+    for (size_t i = 0; i < ptr_scenario->steps_qty; i++)
+    {
+        const bench_step_t * ptr_step = &ptr_scenario->steps[i];
+
+        bench_clock_us += ptr_step->cost_us;
+        if (PHASE_TRACE_LAST_BYTE == ptr_step->id)
+        {
+            ok = bench_receive(ptr_scenario, ptr_data, len, &extract) && ok;
+        }
+        else if (PHASE_TRACE_PARSE_DONE == ptr_step->id)
+        {
+            int64_t start_us = bench_cpu_us();
+            ok = weather_extract_finish(&extract) && ok;
+            bench_clock_us += bench_cpu_us() - start_us;
+        }
+        phase_trace_mark(ptr_step->id);
+    }
+    ok = ok && ((record.fields & WEATHER_RECORD_REQUIRED) == WEATHER_RECORD_REQUIRED);
+
+    if (!bench_json)
+    {
+        printf("\n%s (%zu byte response, %u B/s)%s\n",
+               ptr_scenario->ptr_name, len, ptr_scenario->link_bps, ok ? "" : ", PARSE FAILED");
+        phase_trace_dump(stdout);
+        return ok;
+    }
+
+    int64_t prev_us = 0;
+    for (size_t i = 0; i < ptr_scenario->steps_qty; i++)
+    {
+        int64_t at_us = 0;
+        phase_trace_first(ptr_scenario->steps[i].id, &at_us);
+        printf("{\"bench\":\"phase\",\"scenario\":\"%s\",\"phase\":\"%s\",\"at_us\":%lld,\"us\":%lld,\"ok\":%s}\n",
+               ptr_scenario->ptr_name,
+               phase_trace_name(ptr_scenario->steps[i].id),
+               (long long) at_us,
+               (long long) (at_us - prev_us),
+               ok ? "true" : "false");
+        prev_us = at_us;
+    }
+    phase_trace_json(stdout);
+
+    return ok;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int main(int argc, char ** argv)
+{
+    const char * ptr_path = HOST_BENCH_PAYLOAD_DIR "/informers.json";
+    static char data[BENCH_PAYLOAD_MAX];
+    bool ok = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--json"))
+        {
+            bench_json = true;
+        }
+        else
+        {
+            ptr_path = argv[i];
+        }
+    }
+
+    FILE * ptr_file = fopen(ptr_path, "rb");
+    if (NULL == ptr_file)
+    {
+        fprintf(stderr, "Cannot open %s\n", ptr_path);
+        return 1;
+    }
+    size_t len = fread(data, 1, sizeof(data) - 1, ptr_file);
+    fclose(ptr_file);
+    data[len] = '\0';
+
+    for (size_t i = 0; i < BENCH_SCENARIOS_QTY; i++)
+    {
+        ok = bench_scenario_run(&bench_scenarios[i], data, len) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#!/usr/bin/env python
+#
+# Compares two bench_suite (or bench_trace, bench_engine, bench_ca) --json result files and lists regressions:
+# time (us_per_resp, consume_ns, ns, wall_us, cpu_us) worse than the threshold, any growth
+# of allocations or peak heap, and results that stopped matching.
+# Exits with 1 if there is a regression, so it can gate a script.
+#
+# Usage: compare.py <baseline.jsonl> <current.jsonl> [threshold %, default 10]
+
+import json
+import sys
+
+# Measurement key fields and compared metrics of every result kind
+KEYS = {
+    'pipeline': (('corpus', 'reads'), ('us_per_resp',), ('allocs_per_resp', 'peak_heap_bytes')),
+    'document': (('doc',), ('tokenize_ns', 'consume_ns'), ()),
+    'field':    (('doc', 'path'), ('ns',), ()),
+    'setup':    ((), (), ('heap_bytes',)),
+    'phase':    (('scenario', 'phase'), ('us',), ()),
+    'engine':   (('scenario', 'mode'), ('wall_us', 'cpu_us'), ()),
+    'ca':       (('mode',), ('ns',), ('allocs', 'peak_heap_bytes')),
+    'framing':  (('case',), (), ()),
+}
+
+
+def load(path):
+    results = {}
+    with open(path, 'r') as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith('{'):
+                continue
+            result = json.loads(line)
+            kind = result.get('bench')
+            if kind not in KEYS:
+                continue
+            key = (kind,) + tuple(result[k] for k in KEYS[kind][0])
+            results[key] = result
+    return results
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        sys.exit('Usage: compare.py <baseline.jsonl> <current.jsonl> [threshold %]')
+
+    base = load(sys.argv[1])
+    current = load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) == 4 else 10.0
+    regressions = 0
+
+    for key in sorted(current, key=str):
+        now = current[key]
+        name = ' '.join(str(k) for k in key)
+        if now.get('ok') is False:
+            print('FAIL  %s: result differs from the plain response' % name)
+            regressions += 1
+        if key not in base:
+            print('NEW   %s' % name)
+            continue
+        was = base[key]
+        _, times, sizes = KEYS[key[0]]
+        for metric in times:
+            if was[metric] <= 0:
+                continue
+            change = (now[metric] - was[metric]) * 100.0 / was[metric]
+            if change > threshold:
+                print('SLOW  %s %s: %.2f -> %.2f (%+.1f%%)' % (name, metric, was[metric], now[metric], change))
+                regressions += 1
+            elif change < -threshold:
+                print('FAST  %s %s: %.2f -> %.2f (%+.1f%%)' % (name, metric, was[metric], now[metric], change))
+        for metric in sizes:
+            if now[metric] > was[metric]:
+                print('MORE  %s %s: %s -> %s' % (name, metric, was[metric], now[metric]))
+                regressions += 1
+
+    for key in sorted(set(base) - set(current), key=str):
+        print('GONE  %s' % ' '.join(str(k) for k in key))
+
+    print('%d regression(s), threshold %.0f%%' % (regressions, threshold))
+    sys.exit(1 if regressions else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,78 @@
+#!/usr/bin/env python
+#
+# Builds the benchmark corpus from the recorded response bodies: every
+# payload is wrapped into complete HTTP responses the way the server may
+# send it (plain, chunked, gzip, deflate, gzip chunked) and listed in a
+# manifest with the document kind, taken from the payload file name.
+# Output is deterministic, so results of different runs are comparable.
+#
+# Usage: make_corpus.py <output directory> <payload.json>...
+
+import gzip
+import os
+import sys
+import zlib
+
+HEAD = ('HTTP/1.1 200 OK\r\n'
+        'Server: nginx\r\n'
+        'Date: Mon, 16 Oct 2023 09:00:00 GMT\r\n'
+        'Content-Type: application/json; charset=utf-8\r\n'
+        'Connection: keep-alive\r\n'
+        'Cache-Control: max-age=60\r\n'
+        'ETag: "5f1c-corpus"\r\n')
+
+# Chunk sizes of chunked variants, uneven to land chunk borders anywhere
+CHUNKS = [1000, 4096, 333, 2048, 17]
+
+
+def response(body, coding=None, chunked=False):
+    head = HEAD
+    if coding is not None:
+        head += 'Content-Encoding: %s\r\n' % coding
+    if not chunked:
+        head += 'Content-Length: %d\r\n\r\n' % len(body)
+        return head.encode('ascii') + body
+
+    head += 'Transfer-Encoding: chunked\r\n\r\n'
+    out = [head.encode('ascii')]
+    pos = 0
+    i = 0
+    while pos < len(body):
+        size = CHUNKS[i % len(CHUNKS)]
+        piece = body[pos:pos + size]
+        out.append(b'%x\r\n' % len(piece) + piece + b'\r\n')
+        pos += size
+        i += 1
+    out.append(b'0\r\n\r\n')
+    return b''.join(out)
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit('Usage: make_corpus.py <output directory> <payload.json>...')
+
+    out_dir = sys.argv[1]
+    manifest = []
+    for path in sys.argv[2:]:
+        with open(path, 'rb') as f:
+            body = f.read()
+        name = os.path.splitext(os.path.basename(path))[0]
+        variants = [
+            ('identity', response(body)),
+            ('chunked', response(body, chunked=True)),
+            ('gzip', response(gzip.compress(body, 9, mtime=0), 'gzip')),
+            ('deflate', response(zlib.compress(body, 9), 'deflate')),
+            ('gzip_chunked', response(gzip.compress(body, 9, mtime=0), 'gzip', chunked=True)),
+        ]
+        for variant, data in variants:
+            file_name = '%s.%s.http' % (name, variant)
+            with open(os.path.join(out_dir, file_name), 'wb') as f:
+                f.write(data)
+            manifest.append('%s %s\n' % (file_name, name))
+
+    with open(os.path.join(out_dir, 'corpus.txt'), 'w') as f:
+        f.writelines(manifest)
+
+
+if __name__ == '__main__':
+    main()
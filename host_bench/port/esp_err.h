@@ -0,0 +1,62 @@
+/**
+ *  @file       esp_err.h
+ *
+ *  @brief      Host port of the ESP-IDF error codes used by the benchmarked modules
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define ESP_OK                0       /**< Success */
+#define ESP_FAIL              -1      /**< Generic failure */
+#define ESP_ERR_NO_MEM        0x101   /**< Out of memory */
+#define ESP_ERR_INVALID_ARG   0x102   /**< Invalid argument */
+#define ESP_ERR_INVALID_STATE 0x103   /**< Invalid state */
+#define ESP_ERR_TIMEOUT       0x107   /**< Operation timed out */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+typedef int esp_err_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Error code name
+ *
+ *  @param[in]  err         Error code
+ *
+ *  @return     Name
+ */
+static inline const char * esp_err_to_name(esp_err_t err)
+{
+    switch (err)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "ESP_FAIL";
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
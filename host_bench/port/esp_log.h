@@ -0,0 +1,24 @@
+/**
+ *  @file       esp_log.h
+ *
+ *  @brief      Host port of the ESP-IDF logging macros
+ *
+ *  Errors and warnings go to stderr, so they do not mix with benchmark
+ *  results; the rest is dropped.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+
+/******************** DEFINES ********************/
+
+#define ESP_LOGE(tag, format, ...)  fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  do { (void) (tag); } while (0)
+#define ESP_LOGD(tag, format, ...)  do { (void) (tag); } while (0)
+#define ESP_LOGV(tag, format, ...)  do { (void) (tag); } while (0)
@@ -0,0 +1,36 @@
+/**
+ *  @file       esp_timer.h
+ *
+ *  @brief      Host port of the ESP-IDF high resolution time
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Monotonic time
+ *
+ *  @return     Microseconds
+ */
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+#ifdef __cplusplus
+}
+#endif
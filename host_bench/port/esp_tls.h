@@ -0,0 +1,122 @@
+/**
+ *  @file       esp_tls.h
+ *
+ *  @brief      Host port of the esp-tls client interface used by the fetch engine
+ *
+ *  Only the non-blocking connection path is ported: a connection is
+ *  started with esp_tls_conn_new_async() and driven by the caller's
+ *  select(), read and write return the esp-tls WANT_READ/WANT_WRITE codes.
+ *  The implementation is on OpenSSL, the server certificate is verified
+ *  against cacert_buf and common_name as on the device.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define ESP_TLS_ERR_SSL_WANT_READ   -0x6900     /**< As MBEDTLS_ERR_SSL_WANT_READ */
+#define ESP_TLS_ERR_SSL_WANT_WRITE  -0x6880     /**< As MBEDTLS_ERR_SSL_WANT_WRITE */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Connection states
+ */
+typedef enum esp_tls_conn_state
+{
+    ESP_TLS_INIT = 0,           /**< Not connected yet */
+    ESP_TLS_CONNECTING,         /**< TCP connection in progress */
+    ESP_TLS_HANDSHAKE,          /**< TLS handshake in progress */
+    ESP_TLS_FAIL,               /**< Connection failed */
+    ESP_TLS_DONE,               /**< Connection established */
+} esp_tls_conn_state_t;
+
+/**
+ *  @brief  Connection configuration (the fields the firmware sets)
+ */
+typedef struct esp_tls_cfg
+{
+    const unsigned char * cacert_buf;   /**< PEM CA certificate with its '\0' */
+    unsigned int cacert_bytes;          /**< CA certificate size */
+    bool use_global_ca_store;           /**< Not supported on the host */
+    bool non_block;                     /**< Connection is non-blocking */
+    int timeout_ms;                     /**< TCP connection select() timeout */
+    const char * common_name;           /**< Server name to verify and send as SNI */
+} esp_tls_cfg_t;
+
+typedef struct esp_tls esp_tls_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Connection context allocation
+ *
+ *  @return     Context, NULL if out of memory
+ */
+esp_tls_t * esp_tls_init(void);
+
+/**
+ *  @brief      Advance a non-blocking connection
+ *
+ *  @param[in]  hostname    Server address
+ *  @param[in]  hostlen     Server address length
+ *  @param[in]  port        Server port
+ *  @param[in]  cfg         Connection configuration
+ *  @param[in]  tls         Connection context
+ *
+ *  @return     1 if established, 0 if in progress, -1 on error
+ */
+int esp_tls_conn_new_async(const char * hostname, int hostlen, int port, const esp_tls_cfg_t * cfg, esp_tls_t * tls);
+
+/**
+ *  @brief      Read decrypted data
+ *
+ *  @return     Bytes read, 0 on an orderly close, ESP_TLS_ERR_SSL_WANT_* or another negative code
+ */
+ssize_t esp_tls_conn_read(esp_tls_t * tls, void * data, size_t datalen);
+
+/**
+ *  @brief      Write data
+ *
+ *  @return     Bytes written, ESP_TLS_ERR_SSL_WANT_* or another negative code
+ */
+ssize_t esp_tls_conn_write(esp_tls_t * tls, const void * data, size_t datalen);
+
+/**
+ *  @brief      Connection socket
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t * tls, int * sockfd);
+
+/**
+ *  @brief      Connection state
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t esp_tls_get_conn_state(esp_tls_t * tls, esp_tls_conn_state_t * conn_state);
+
+/**
+ *  @brief      Close the connection and free the context
+ *
+ *  @return     0 on success
+ */
+int esp_tls_conn_destroy(esp_tls_t * tls);
+
+#ifdef __cplusplus
+}
+#endif
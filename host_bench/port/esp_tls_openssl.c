@@ -0,0 +1,298 @@
+/**
+ *  @file       esp_tls_openssl.c
+ *
+ *  @brief      Host port of the non-blocking esp-tls client on OpenSSL
+ *
+ *  Follows the esp-tls state machine: the TCP connection is awaited in a
+ *  select() of cfg->timeout_ms, then the handshake is stepped on the
+ *  non-blocking socket. As with the mbedTLS port of esp-tls on the device
+ *  (TLS 1.2), every connection parses the CA certificate into its own
+ *  context, only an orderly close (close_notify) reads as 0.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+#include <openssl/pem.h>
+#include <openssl/err.h>
+
+#include "esp_tls.h"
+
+/******************** DEFINES ********************/
+
+#define ESP_TLS_HOST_ADDR_MAX   16      /**< Dotted decimal IPv4 address with '\0' */
+#define ESP_TLS_ERR_SSL         -1      /**< Any other TLS or socket error */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+struct esp_tls
+{
+    esp_tls_conn_state_t conn_state;
+    int sockfd;
+    SSL_CTX * ptr_ctx;
+    SSL * ptr_ssl;
+};
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static int esp_tls_tcp_start(const char * hostname, int hostlen, int port, esp_tls_t * tls);
+static bool esp_tls_tcp_is_connected(const esp_tls_cfg_t * cfg, esp_tls_t * tls);
+static bool esp_tls_ssl_create(const esp_tls_cfg_t * cfg, esp_tls_t * tls);
+static ssize_t esp_tls_ssl_result(esp_tls_t * tls, int ret);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Non-blocking TCP connection start
+ *
+ *  @return     0 if in progress, -1 on error
+ */
+static int esp_tls_tcp_start(const char * hostname, int hostlen, int port, esp_tls_t * tls)
+{
+    char addr_str[ESP_TLS_HOST_ADDR_MAX];
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_port = htons(port) };
+
+    if ((hostlen <= 0) || ((size_t) hostlen >= sizeof(addr_str)))
+    {
+        return -1;
+    }
+    memcpy(addr_str, hostname, hostlen);
+    addr_str[hostlen] = '\0';
+    if (1 != inet_pton(AF_INET, addr_str, &addr.sin_addr))
+    {
+        return -1;
+    }
+
+    tls->sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (tls->sockfd < 0)
+    {
+        return -1;
+    }
+    fcntl(tls->sockfd, F_SETFL, fcntl(tls->sockfd, F_GETFL, 0) | O_NONBLOCK);
+    if ((0 != connect(tls->sockfd, (struct sockaddr *) &addr, sizeof(addr))) && (EINPROGRESS != errno))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ *  @brief      TCP connection completion check, waits for cfg->timeout_ms at most
+ *
+ *  @return     true if connected
+ */
+static bool esp_tls_tcp_is_connected(const esp_tls_cfg_t * cfg, esp_tls_t * tls)
+{
+    fd_set wset;
+    struct timeval timeout = {
+        .tv_sec = cfg->timeout_ms / 1000,
+        .tv_usec = (cfg->timeout_ms % 1000) * 1000,
+    };
+
+    FD_ZERO(&wset);
+    FD_SET(tls->sockfd, &wset);
+    return (select(tls->sockfd + 1, NULL, &wset, NULL, &timeout) > 0);
+}
+
+/**
+ *  @brief      TLS context of the connection
+ *
+ *  @return     true on success
+ */
+static bool esp_tls_ssl_create(const esp_tls_cfg_t * cfg, esp_tls_t * tls)
+{
+    tls->ptr_ctx = SSL_CTX_new(TLS_client_method());
+    if (NULL == tls->ptr_ctx)
+    {
+        return false;
+    }
+    SSL_CTX_set_min_proto_version(tls->ptr_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_max_proto_version(tls->ptr_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(tls->ptr_ctx, SSL_VERIFY_PEER, NULL);
+
+    if (NULL != cfg->cacert_buf)
+    {
+        BIO * ptr_bio = BIO_new_mem_buf(cfg->cacert_buf, (int) cfg->cacert_bytes);
+        X509 * ptr_ca = (NULL != ptr_bio) ? PEM_read_bio_X509(ptr_bio, NULL, NULL, NULL) : NULL;
+        bool is_added = (NULL != ptr_ca) && (1 == X509_STORE_add_cert(SSL_CTX_get_cert_store(tls->ptr_ctx), ptr_ca));
+        X509_free(ptr_ca);
+        BIO_free(ptr_bio);
+        if (!is_added)
+        {
+            return false;
+        }
+    }
+
+    tls->ptr_ssl = SSL_new(tls->ptr_ctx);
+    if ((NULL == tls->ptr_ssl) || (1 != SSL_set_fd(tls->ptr_ssl, tls->sockfd)))
+    {
+        return false;
+    }
+    if (NULL != cfg->common_name)
+    {
+        SSL_set_tlsext_host_name(tls->ptr_ssl, cfg->common_name);
+        SSL_set1_host(tls->ptr_ssl, cfg->common_name);
+    }
+
+    return true;
+}
+
+/**
+ *  @brief      OpenSSL call result in esp-tls terms
+ *
+ *  @return     Bytes quantity, 0 on an orderly close, ESP_TLS_ERR_SSL_WANT_* or ESP_TLS_ERR_SSL
+ */
+static ssize_t esp_tls_ssl_result(esp_tls_t * tls, int ret)
+{
+    if (ret > 0)
+    {
+        return ret;
+    }
+
+    switch (SSL_get_error(tls->ptr_ssl, ret))
+    {
+    case SSL_ERROR_WANT_READ:
+        return ESP_TLS_ERR_SSL_WANT_READ;
+    case SSL_ERROR_WANT_WRITE:
+        return ESP_TLS_ERR_SSL_WANT_WRITE;
+    case SSL_ERROR_ZERO_RETURN:
+        return 0;
+    default:
+        ERR_clear_error();
+        return ESP_TLS_ERR_SSL;
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_tls_t * esp_tls_init(void)
+{
+    esp_tls_t * tls = calloc(1, sizeof(esp_tls_t));
+    if (NULL != tls)
+    {
+        tls->sockfd = -1;
+    }
+    return tls;
+}
+
+int esp_tls_conn_new_async(const char * hostname, int hostlen, int port, const esp_tls_cfg_t * cfg, esp_tls_t * tls)
+{
+    switch (tls->conn_state)
+    {
+    case ESP_TLS_INIT:
+        if (!cfg->non_block || (0 != esp_tls_tcp_start(hostname, hostlen, port, tls)))
+        {
+            tls->conn_state = ESP_TLS_FAIL;
+            return -1;
+        }
+        tls->conn_state = ESP_TLS_CONNECTING;
+        /* fall through */
+
+    case ESP_TLS_CONNECTING:
+    {
+        if (!esp_tls_tcp_is_connected(cfg, tls))
+        {
+            return 0;
+        }
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if ((0 != getsockopt(tls->sockfd, SOL_SOCKET, SO_ERROR, &error, &len)) || (0 != error) ||
+            !esp_tls_ssl_create(cfg, tls))
+        {
+            tls->conn_state = ESP_TLS_FAIL;
+            return -1;
+        }
+        tls->conn_state = ESP_TLS_HANDSHAKE;
+    }
+        /* fall through */
+
+    case ESP_TLS_HANDSHAKE:
+    {
+        ssize_t ret = esp_tls_ssl_result(tls, SSL_connect(tls->ptr_ssl));
+        if ((ESP_TLS_ERR_SSL_WANT_READ == ret) || (ESP_TLS_ERR_SSL_WANT_WRITE == ret))
+        {
+            return 0;
+        }
+        if (ret <= 0)
+        {
+            tls->conn_state = ESP_TLS_FAIL;
+            return -1;
+        }
+        tls->conn_state = ESP_TLS_DONE;
+        return 1;
+    }
+
+    case ESP_TLS_DONE:
+        return 1;
+
+    default:
+        return -1;
+    }
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t * tls, void * data, size_t datalen)
+{
+    if (ESP_TLS_DONE != tls->conn_state)
+    {
+        return ESP_TLS_ERR_SSL;
+    }
+    return esp_tls_ssl_result(tls, SSL_read(tls->ptr_ssl, data, (int) datalen));
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t * tls, const void * data, size_t datalen)
+{
+    if (ESP_TLS_DONE != tls->conn_state)
+    {
+        return ESP_TLS_ERR_SSL;
+    }
+    return esp_tls_ssl_result(tls, SSL_write(tls->ptr_ssl, data, (int) datalen));
+}
+
+esp_err_t esp_tls_get_conn_sockfd(esp_tls_t * tls, int * sockfd)
+{
+    if ((NULL == tls) || (NULL == sockfd))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *sockfd = tls->sockfd;
+    return ESP_OK;
+}
+
+esp_err_t esp_tls_get_conn_state(esp_tls_t * tls, esp_tls_conn_state_t * conn_state)
+{
+    if ((NULL == tls) || (NULL == conn_state))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *conn_state = tls->conn_state;
+    return ESP_OK;
+}
+
+int esp_tls_conn_destroy(esp_tls_t * tls)
+{
+    if (NULL == tls)
+    {
+        return -1;
+    }
+    SSL_free(tls->ptr_ssl);
+    SSL_CTX_free(tls->ptr_ctx);
+    if (tls->sockfd >= 0)
+    {
+        close(tls->sockfd);
+    }
+    free(tls);
+    return 0;
+}
@@ -0,0 +1,48 @@
+/**
+ *  @file       ip_addr.h
+ *
+ *  @brief      Host port of the lwIP IPv4 address type
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  IPv4 address in network byte order
+ */
+typedef struct ip4_addr
+{
+    uint32_t addr;
+} ip4_addr_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Dotted decimal text of an address
+ *
+ *  @param[in]  ptr_addr    Address
+ *  @param[out] ptr_buf     Text buffer
+ *  @param[in]  buflen      Text buffer size
+ *
+ *  @return     Text, NULL if the buffer is too small
+ */
+static inline char * ip4addr_ntoa_r(const ip4_addr_t * ptr_addr, char * ptr_buf, int buflen)
+{
+    return (char *) inet_ntop(AF_INET, &ptr_addr->addr, ptr_buf, (socklen_t) buflen);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,18 @@
+/**
+ *  @file       sockets.h
+ *
+ *  @brief      Host port of the lwIP socket interface: the BSD sockets of the host
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
@@ -0,0 +1,96 @@
+/**
+ *  @file       miniz.h
+ *
+ *  @brief      Host port of the ROM tinfl interface on top of zlib
+ *
+ *  Only the calls http_inflate makes are provided. Output semantics are
+ *  the same (any output buffer, partial input), so the decoding pipeline
+ *  runs unchanged; absolute inflate times are zlib's, not the ROM's. zlib
+ *  state is allocated inside the library and is not in the counted heap,
+ *  the ROM decompressor state (about 11 KB) is.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <zlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define TINFL_LZ_DICT_SIZE              32768   /**< Deflate window size */
+
+#define TINFL_FLAG_PARSE_ZLIB_HEADER    1       /**< Stream has zlib header and trailer */
+#define TINFL_FLAG_HAS_MORE_INPUT       2       /**< More input follows */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+/**
+ *  @brief  Decompression status
+ */
+typedef enum tinfl_status_e
+{
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2,
+} tinfl_status;
+
+/**
+ *  @brief  Decompressor (allocated by the caller without initialization)
+ */
+typedef struct tinfl_decompressor_s
+{
+    void * ptr_self;            /**< Points to itself once zlib state is allocated */
+    bool is_started;            /**< Stream format is chosen by the first call */
+    z_stream stream;            /**< zlib inflater */
+} tinfl_decompressor;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Start a new stream
+ *
+ *  @param[out] ptr_decomp  Decompressor pointer
+ */
+void tinfl_init(tinfl_decompressor * ptr_decomp);
+
+/**
+ *  @brief      Decompress the next piece of the stream
+ *
+ *  @param[in]      ptr_decomp      Decompressor pointer
+ *  @param[in]      ptr_in          Input bytes
+ *  @param[in,out]  ptr_in_size     Input bytes available / consumed
+ *  @param[in]      ptr_out_start   Output window start (unused)
+ *  @param[out]     ptr_out_next    Output position
+ *  @param[in,out]  ptr_out_size    Output space available / produced
+ *  @param[in]      flags           TINFL_FLAG_* flags
+ *
+ *  @return     Status
+ */
+tinfl_status tinfl_decompress(tinfl_decompressor * ptr_decomp,
+                              const mz_uint8 * ptr_in,
+                              size_t * ptr_in_size,
+                              mz_uint8 * ptr_out_start,
+                              mz_uint8 * ptr_out_next,
+                              size_t * ptr_out_size,
+                              const mz_uint32 flags);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+/**
+ *  @file       miniz_zlib.c
+ *
+ *  @brief      Host port of the ROM tinfl interface on top of zlib
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+
+#include "miniz.h"
+
+/******************** DEFINES ********************/
+
+#define MINIZ_ZLIB_WINDOW_BITS  15  /**< 32 KB window, negative for raw deflate */
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void tinfl_init(tinfl_decompressor * ptr_decomp)
+{
+    /* The caller mallocs the decompressor, zlib state is created once */
+    if (ptr_decomp->ptr_self != ptr_decomp)
+    {
+        memset(&ptr_decomp->stream, 0x00, sizeof(ptr_decomp->stream));
+        if (Z_OK == inflateInit2(&ptr_decomp->stream, -MINIZ_ZLIB_WINDOW_BITS))
+        {
+            ptr_decomp->ptr_self = ptr_decomp;
+        }
+    }
+    ptr_decomp->is_started = false;
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor * ptr_decomp,
+                              const mz_uint8 * ptr_in,
+                              size_t * ptr_in_size,
+                              mz_uint8 * ptr_out_start,
+                              mz_uint8 * ptr_out_next,
+                              size_t * ptr_out_size,
+                              const mz_uint32 flags)
+{
+    z_stream * ptr_stream = &ptr_decomp->stream;
+
+    (void) ptr_out_start;
+    if (ptr_decomp->ptr_self != ptr_decomp)
+    {
+        return TINFL_STATUS_BAD_PARAM;
+    }
+    if (!ptr_decomp->is_started)
+    {
+        int window_bits = (flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? MINIZ_ZLIB_WINDOW_BITS : -MINIZ_ZLIB_WINDOW_BITS;
+        if (Z_OK != inflateReset2(ptr_stream, window_bits))
+        {
+            return TINFL_STATUS_FAILED;
+        }
+        ptr_decomp->is_started = true;
+    }
+
+    ptr_stream->next_in = (Bytef *) ptr_in;
+    ptr_stream->avail_in = (uInt) *ptr_in_size;
+    ptr_stream->next_out = ptr_out_next;
+    ptr_stream->avail_out = (uInt) *ptr_out_size;
+
+    int ret = inflate(ptr_stream, Z_NO_FLUSH);
+
+    *ptr_in_size -= ptr_stream->avail_in;
+    *ptr_out_size -= ptr_stream->avail_out;
+
+    if (Z_STREAM_END == ret)
+    {
+        return TINFL_STATUS_DONE;
+    }
+    if ((Z_OK != ret) && (Z_BUF_ERROR != ret))
+    {
+        return (Z_DATA_ERROR == ret) ? TINFL_STATUS_FAILED : TINFL_STATUS_BAD_PARAM;
+    }
+
+    return (0 == ptr_stream->avail_out) ? TINFL_STATUS_HAS_MORE_OUTPUT : TINFL_STATUS_NEEDS_MORE_INPUT;
+}
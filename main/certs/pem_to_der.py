@@ -0,0 +1,30 @@
+#!/usr/bin/env python
+#
+# Converts the first PEM certificate of the input file to DER, so the
+# firmware embeds a ready to parse binary instead of a base64 string.
+#
+# Usage: pem_to_der.py <input.pem> <output.der>
+
+import base64
+import re
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('Usage: pem_to_der.py <input.pem> <output.der>')
+
+    with open(sys.argv[1], 'r') as f:
+        pem = f.read()
+
+    match = re.search(r'-----BEGIN CERTIFICATE-----(.+?)-----END CERTIFICATE-----', pem, re.S)
+    if match is None:
+        sys.exit('No certificate in ' + sys.argv[1])
+
+    der = base64.b64decode(''.join(match.group(1).split()))
+    with open(sys.argv[2], 'wb') as f:
+        f.write(der)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,128 @@
+/**
+ *  @file       clock_drift.c
+ *
+ *  @brief      Local clock drift model and adaptive sync interval
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "clock_drift.h"
+
+/******************** DEFINES ********************/
+
+#define CLOCK_DRIFT_PPB_SCALE   1000000000LL    /**< Parts per billion */
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static void clock_drift_interval_update(clock_drift_t * ptr_drift, int64_t span_us);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Next interval from the residual rate of the corrected clock
+ *
+ *  The interval is half of the time the residual rate needs to reach the
+ *  error bound, grows at most twice per sync and stays within limits.
+ *
+ *  @param[in]  ptr_drift   Model context pointer
+ *  @param[in]  span_us     Reference span of the last error measurement
+ */
+static void clock_drift_interval_update(clock_drift_t * ptr_drift, int64_t span_us)
+{
+    int64_t rate_ppb = llabs(ptr_drift->last_error_us) * CLOCK_DRIFT_PPB_SCALE / span_us;
+    if (rate_ppb < CLOCK_DRIFT_RATE_FLOOR_PPB)
+    {
+        rate_ppb = CLOCK_DRIFT_RATE_FLOOR_PPB;
+    }
+
+    /* bound [us] / rate [1e-9] = bound * 1000 / rate [s], halved for margin */
+    int64_t interval_s = (int64_t) ptr_drift->cfg.error_bound_ms * 1000 * 500 / rate_ppb;
+    if (interval_s > 2 * (int64_t) ptr_drift->state.interval_s)
+    {
+        interval_s = 2 * (int64_t) ptr_drift->state.interval_s;
+    }
+    if (interval_s > ptr_drift->cfg.interval_max_s)
+    {
+        interval_s = ptr_drift->cfg.interval_max_s;
+    }
+    if (interval_s < ptr_drift->cfg.interval_min_s)
+    {
+        interval_s = ptr_drift->cfg.interval_min_s;
+    }
+    ptr_drift->state.interval_s = (uint32_t) interval_s;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void clock_drift_init(clock_drift_t * ptr_drift, const clock_drift_cfg_t * ptr_cfg, const clock_drift_state_t * ptr_state)
+{
+    memset(ptr_drift, 0x00, sizeof(*ptr_drift));
+    ptr_drift->cfg = *ptr_cfg;
+    ptr_drift->state.interval_s = ptr_cfg->interval_min_s;
+    if ((NULL != ptr_state) &&
+        (llabs(ptr_state->drift_ppb) <= CLOCK_DRIFT_PPB_MAX) &&
+        (ptr_state->interval_s >= ptr_cfg->interval_min_s) &&
+        (ptr_state->interval_s <= ptr_cfg->interval_max_s))
+    {
+        ptr_drift->state = *ptr_state;
+    }
+}
+
+bool clock_drift_sample(clock_drift_t * ptr_drift, int64_t ref_us, int64_t local_us)
+{
+    if (!ptr_drift->has_anchor)
+    {
+        ptr_drift->has_anchor = true;
+        ptr_drift->anchor_ref_us = ref_us;
+        ptr_drift->anchor_local_us = local_us;
+        return false;
+    }
+
+    int64_t span_ref_us = ref_us - ptr_drift->anchor_ref_us;
+    int64_t span_local_us = local_us - ptr_drift->anchor_local_us;
+    if (span_ref_us < CLOCK_DRIFT_SPAN_MIN_S * 1000000LL)
+    {
+        /* Too short to tell drift from sample noise, the anchor is kept so spans add up */
+        return false;
+    }
+
+    ptr_drift->anchor_ref_us = ref_us;
+    ptr_drift->anchor_local_us = local_us;
+    int64_t measured_ppb = (span_local_us - span_ref_us) * CLOCK_DRIFT_PPB_SCALE / span_ref_us;
+    if (llabs(measured_ppb) > CLOCK_DRIFT_PPB_MAX)
+    {
+        return false;
+    }
+
+    /* What the corrected clock was off by: it ran at the rate of the previous estimate */
+    ptr_drift->last_error_us = (measured_ppb - ptr_drift->state.drift_ppb) * span_ref_us / CLOCK_DRIFT_PPB_SCALE;
+
+    /* Estimate is averaged over the observed span, so one noisy sync weighs little */
+    int64_t span_s = span_ref_us / 1000000LL;
+    int64_t weight_s = ptr_drift->state.weight_s;
+    ptr_drift->state.drift_ppb = (int32_t) ((ptr_drift->state.drift_ppb * weight_s + measured_ppb * span_s) /
+                                            (weight_s + span_s));
+    weight_s += span_s;
+    ptr_drift->state.weight_s = (weight_s > CLOCK_DRIFT_WEIGHT_MAX_S) ? CLOCK_DRIFT_WEIGHT_MAX_S : (uint32_t) weight_s;
+    ptr_drift->samples++;
+
+    clock_drift_interval_update(ptr_drift, span_ref_us);
+
+    return true;
+}
+
+int64_t clock_drift_correction(clock_drift_t * ptr_drift, int64_t period_us)
+{
+    /* ppb * us / 10^6 = ns */
+    ptr_drift->correction_ns -= (int64_t) ptr_drift->state.drift_ppb * period_us / 1000000;
+
+    int64_t correction_us = ptr_drift->correction_ns / 1000;
+    ptr_drift->correction_ns -= correction_us * 1000;
+
+    return correction_us;
+}
@@ -0,0 +1,619 @@
+/**
+ *  @file       dns_cache.c
+ *
+ *  @brief      IPv4 resolver cache kept in RTC memory
+ *
+ *  lwIP resolver does not report record TTL, so A queries are sent to the
+ *  DHCP provided DNS server directly. lwIP resolver is used as a fallback
+ *  with a default TTL.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "lwip/dns.h"
+
+#include "dns_cache.h"
+
+/******************** DEFINES ********************/
+
+#define DNS_CACHE_MAGIC             0x444E5343UL    /**< RTC memory content marker */
+#define DNS_CACHE_PORT              53              /**< DNS server port */
+#define DNS_CACHE_MSG_MAX           512             /**< Longest UDP DNS message */
+#define DNS_CACHE_HEADER_SIZE       12              /**< DNS message header size */
+#define DNS_CACHE_RX_TRIES          3               /**< Foreign datagrams tolerated per query */
+#define DNS_CACHE_TYPE_A            1               /**< A record type */
+#define DNS_CACHE_TYPE_CNAME        5               /**< CNAME record type */
+#define DNS_CACHE_CLASS_IN          1               /**< Internet class */
+
+#define DNS_CACHE_REFRESH_TASK_NAME         "DNS refresh"   /**< Background refresh task name */
+#define DNS_CACHE_REFRESH_TASK_STACK_SIZE   3072            /**< Background refresh task stack size */
+#define DNS_CACHE_REFRESH_TASK_PRIORITY     3               /**< Background refresh task priority */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Cache entry
+ */
+typedef struct dns_cache_entry_s
+{
+    char host[DNS_CACHE_HOST_MAX];  /**< Host name (empty if entry is free) */
+    uint32_t addr;                  /**< IPv4 address (network byte order) */
+    uint32_t ttl_s;                 /**< Record TTL */
+    int64_t resolved_s;             /**< Resolution time (system time) */
+} dns_cache_entry_t;
+
+/**
+ *  @brief  Cache layout in RTC memory
+ */
+typedef struct dns_cache_rtc_s
+{
+    uint32_t magic;                             /**< DNS_CACHE_MAGIC if content is valid */
+    uint32_t crc;                               /**< Entries checksum */
+    dns_cache_entry_t entries[DNS_CACHE_SIZE];  /**< Entries */
+} dns_cache_rtc_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * TAG = "dns_cache";
+
+/**< Not initialized on boot, garbage after power-on is rejected by checksum */
+static RTC_NOINIT_ATTR dns_cache_rtc_t rtc_cache;
+
+static SemaphoreHandle_t cache_mutex = NULL;
+static bool refreshing[DNS_CACHE_SIZE];
+static dns_cache_stats_t cache_stats;
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static uint32_t dns_cache_crc(void);
+static int dns_cache_find(const char * ptr_host);
+static void dns_cache_store(const char * ptr_host, uint32_t addr, uint32_t ttl_s);
+static size_t dns_cache_skip_name(const uint8_t * ptr_msg, size_t len, size_t pos);
+static esp_err_t dns_cache_parse(const uint8_t * ptr_msg,
+                                 size_t len,
+                                 uint16_t id,
+                                 uint32_t * ptr_addr,
+                                 uint32_t * ptr_ttl_s);
+static esp_err_t dns_cache_query_server(const char * ptr_host,
+                                        const ip4_addr_t * ptr_server,
+                                        uint32_t * ptr_addr,
+                                        uint32_t * ptr_ttl_s);
+static esp_err_t dns_cache_query(const char * ptr_host, uint32_t * ptr_addr, uint32_t * ptr_ttl_s);
+static void dns_cache_refresh_task(void * ptr_params);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Entries checksum
+ *
+ *  @return     CRC32 of entries
+ */
+static uint32_t dns_cache_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *) rtc_cache.entries, sizeof(rtc_cache.entries));
+}
+
+/**
+ *  @brief      Find entry of the host (mutex must be taken)
+ *
+ *  @param[in]  ptr_host    Host name
+ *
+ *  @return     Entry index, -1 if host is not cached
+ */
+static int dns_cache_find(const char * ptr_host)
+{
+    for (int i = 0; i < DNS_CACHE_SIZE; i++)
+    {
+        if (0 == strcmp(rtc_cache.entries[i].host, ptr_host))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ *  @brief      Store resolved address, replaces the oldest entry if cache is full
+ *              (mutex must be taken)
+ *
+ *  @param[in]  ptr_host    Host name
+ *  @param[in]  addr        IPv4 address
+ *  @param[in]  ttl_s       Record TTL
+ */
+static void dns_cache_store(const char * ptr_host, uint32_t addr, uint32_t ttl_s)
+{
+    int idx = dns_cache_find(ptr_host);
+    for (int i = 0; (idx < 0) && (i < DNS_CACHE_SIZE); i++)
+    {
+        if ('\0' == rtc_cache.entries[i].host[0])
+        {
+            idx = i;
+        }
+    }
+    /* Entries being refreshed are not evicted, refresh task refers them by index */
+    if (idx < 0)
+    {
+        for (int i = 0; i < DNS_CACHE_SIZE; i++)
+        {
+            if (!refreshing[i] &&
+                ((idx < 0) || (rtc_cache.entries[i].resolved_s < rtc_cache.entries[idx].resolved_s)))
+            {
+                idx = i;
+            }
+        }
+        if (idx < 0)
+        {
+            return;
+        }
+    }
+
+    if (ttl_s < DNS_CACHE_TTL_MIN_S)
+    {
+        ttl_s = DNS_CACHE_TTL_MIN_S;
+    }
+    else if (ttl_s > DNS_CACHE_TTL_MAX_S)
+    {
+        ttl_s = DNS_CACHE_TTL_MAX_S;
+    }
+
+    dns_cache_entry_t * ptr_entry = &rtc_cache.entries[idx];
+    strcpy(ptr_entry->host, ptr_host);
+    ptr_entry->addr = addr;
+    ptr_entry->ttl_s = ttl_s;
+    ptr_entry->resolved_s = time(NULL);
+    rtc_cache.crc = dns_cache_crc();
+}
+
+/**
+ *  @brief      Skip (possibly compressed) name in DNS message
+ *
+ *  @param[in]  ptr_msg     DNS message
+ *  @param[in]  len         DNS message length
+ *  @param[in]  pos         Name offset
+ *
+ *  @return     Offset after the name, 0 if message is malformed
+ */
+static size_t dns_cache_skip_name(const uint8_t * ptr_msg, size_t len, size_t pos)
+{
+    while (pos < len)
+    {
+        uint8_t label_len = ptr_msg[pos];
+        if (0 == label_len)
+        {
+            return pos + 1;
+        }
+        if ((label_len & 0xC0) == 0xC0)
+        {
+            return (pos + 2 <= len) ? (pos + 2) : 0;
+        }
+        pos += 1 + label_len;
+    }
+
+    return 0;
+}
+
+/**
+ *  @brief      DNS response parsing
+ *
+ *  TTL of the result is the smallest TTL along the CNAME chain.
+ *
+ *  @param[in]  ptr_msg     DNS message
+ *  @param[in]  len         DNS message length
+ *  @param[in]  id          Query ID
+ *  @param[out] ptr_addr    First IPv4 address
+ *  @param[out] ptr_ttl_s   Address TTL
+ *
+ *  @return     ESP_OK on success,
+ *              ESP_ERR_INVALID_RESPONSE if message is not a response to the query,
+ *              ESP_ERR_NOT_FOUND if there is no address
+ */
+static esp_err_t dns_cache_parse(const uint8_t * ptr_msg,
+                                 size_t len,
+                                 uint16_t id,
+                                 uint32_t * ptr_addr,
+                                 uint32_t * ptr_ttl_s)
+{
+    if ((len < DNS_CACHE_HEADER_SIZE) ||
+        (((ptr_msg[0] << 8) | ptr_msg[1]) != id) ||
+        (0 == (ptr_msg[2] & 0x80)))
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if ((ptr_msg[3] & 0x0F) != 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint16_t qd_count = (ptr_msg[4] << 8) | ptr_msg[5];
+    uint16_t an_count = (ptr_msg[6] << 8) | ptr_msg[7];
+    size_t pos = DNS_CACHE_HEADER_SIZE;
+
+    for (uint16_t i = 0; i < qd_count; i++)
+    {
+        pos = dns_cache_skip_name(ptr_msg, len, pos);
+        if ((0 == pos) || (pos + 4 > len))
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        pos += 4;
+    }
+
+    uint32_t ttl_min = UINT32_MAX;
+    for (uint16_t i = 0; i < an_count; i++)
+    {
+        pos = dns_cache_skip_name(ptr_msg, len, pos);
+        if ((0 == pos) || (pos + 10 > len))
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        const uint8_t * ptr_rr = ptr_msg + pos;
+        uint16_t type = (ptr_rr[0] << 8) | ptr_rr[1];
+        uint16_t class = (ptr_rr[2] << 8) | ptr_rr[3];
+        uint32_t ttl = ((uint32_t) ptr_rr[4] << 24) | ((uint32_t) ptr_rr[5] << 16) |
+                       ((uint32_t) ptr_rr[6] << 8) | ptr_rr[7];
+        uint16_t rd_len = (ptr_rr[8] << 8) | ptr_rr[9];
+        pos += 10;
+        if (pos + rd_len > len)
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        if (DNS_CACHE_CLASS_IN == class)
+        {
+            if ((DNS_CACHE_TYPE_A == type) || (DNS_CACHE_TYPE_CNAME == type))
+            {
+                ttl_min = (ttl < ttl_min) ? ttl : ttl_min;
+            }
+            if ((DNS_CACHE_TYPE_A == type) && (4 == rd_len))
+            {
+                memcpy(ptr_addr, ptr_msg + pos, sizeof(*ptr_addr));
+                *ptr_ttl_s = ttl_min;
+                return ESP_OK;
+            }
+        }
+        pos += rd_len;
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+/**
+ *  @brief      A query to the DNS server
+ *
+ *  @param[in]  ptr_host    Host name
+ *  @param[in]  ptr_server  DNS server address
+ *  @param[out] ptr_addr    IPv4 address
+ *  @param[out] ptr_ttl_s   Address TTL
+ *
+ *  @return     ESP_OK on success
+ */
+static esp_err_t dns_cache_query_server(const char * ptr_host,
+                                        const ip4_addr_t * ptr_server,
+                                        uint32_t * ptr_addr,
+                                        uint32_t * ptr_ttl_s)
+{
+    uint8_t msg[DNS_CACHE_MSG_MAX];
+    uint16_t id = (uint16_t) esp_random();
+    size_t pos = 0;
+
+    /* Header: ID, recursion desired, one question */
+    memset(msg, 0x00, DNS_CACHE_HEADER_SIZE);
+    msg[0] = id >> 8;
+    msg[1] = id & 0xFF;
+    msg[2] = 0x01;
+    msg[5] = 1;
+    pos = DNS_CACHE_HEADER_SIZE;
+
+    /* Question: host name as labels, type A, class IN */
+    const char * ptr_label = ptr_host;
+    while ('\0' != *ptr_label)
+    {
+        size_t label_len = strcspn(ptr_label, ".");
+        if ((0 == label_len) || (label_len > 63) || (pos + 1 + label_len + 5 > sizeof(msg)))
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+        msg[pos++] = (uint8_t) label_len;
+        memcpy(msg + pos, ptr_label, label_len);
+        pos += label_len;
+        ptr_label += label_len;
+        if ('.' == *ptr_label)
+        {
+            ptr_label++;
+        }
+    }
+    msg[pos++] = 0;
+    msg[pos++] = 0;
+    msg[pos++] = DNS_CACHE_TYPE_A;
+    msg[pos++] = 0;
+    msg[pos++] = DNS_CACHE_CLASS_IN;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0)
+    {
+        return ESP_FAIL;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = DNS_CACHE_TIMEOUT_MS / 1000,
+        .tv_usec = (DNS_CACHE_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_CACHE_PORT),
+        .sin_addr.s_addr = ptr_server->addr,
+    };
+    esp_err_t err = ESP_ERR_TIMEOUT;
+    if (sendto(sock, msg, pos, 0, (struct sockaddr *) &server, sizeof(server)) == (int) pos)
+    {
+        for (int i = 0; i < DNS_CACHE_RX_TRIES; i++)
+        {
+            int len = recv(sock, msg, sizeof(msg), 0);
+            if (len <= 0)
+            {
+                break;
+            }
+            err = dns_cache_parse(msg, len, id, ptr_addr, ptr_ttl_s);
+            if (ESP_ERR_INVALID_RESPONSE != err)
+            {
+                break;
+            }
+        }
+    }
+    close(sock);
+
+    return err;
+}
+
+/**
+ *  @brief      Host name resolution bypassing the cache
+ *
+ *  @param[in]  ptr_host    Host name
+ *  @param[out] ptr_addr    IPv4 address
+ *  @param[out] ptr_ttl_s   Address TTL
+ *
+ *  @return     ESP_OK on success
+ */
+static esp_err_t dns_cache_query(const char * ptr_host, uint32_t * ptr_addr, uint32_t * ptr_ttl_s)
+{
+    const ip_addr_t * ptr_server = dns_getserver(0);
+    if ((NULL != ptr_server) && IP_IS_V4(ptr_server) && !ip_addr_isany(ptr_server))
+    {
+        esp_err_t err = dns_cache_query_server(ptr_host, ip_2_ip4(ptr_server), ptr_addr, ptr_ttl_s);
+        if (ESP_OK == err)
+        {
+            return ESP_OK;
+        }
+        ESP_LOGW(TAG, "Direct query for %s failed: %s", ptr_host, esp_err_to_name(err));
+    }
+
+    const struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_STREAM,
+    };
+    struct addrinfo * ptr_res = NULL;
+    if ((0 != getaddrinfo(ptr_host, NULL, &hints, &ptr_res)) || (NULL == ptr_res))
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *ptr_addr = ((struct sockaddr_in *) ptr_res->ai_addr)->sin_addr.s_addr;
+    *ptr_ttl_s = DNS_CACHE_TTL_DEFAULT_S;
+    freeaddrinfo(ptr_res);
+
+    return ESP_OK;
+}
+
+/**
+ *  @brief      Background refresh of expired entry
+ *
+ *  @param[in]  ptr_params  Entry index
+ */
+static void dns_cache_refresh_task(void * ptr_params)
+{
+    int idx = (int) (intptr_t) ptr_params;
+    char host[DNS_CACHE_HOST_MAX];
+    uint32_t addr = 0;
+    uint32_t ttl_s = 0;
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    strcpy(host, rtc_cache.entries[idx].host);
+    xSemaphoreGive(cache_mutex);
+
+    esp_err_t err = dns_cache_query(host, &addr, &ttl_s);
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    if (ESP_OK == err)
+    {
+        dns_cache_store(host, addr, ttl_s);
+        cache_stats.refreshes++;
+    }
+    else
+    {
+        cache_stats.failures++;
+    }
+    refreshing[idx] = false;
+    xSemaphoreGive(cache_mutex);
+
+    if (ESP_OK != err)
+    {
+        ESP_LOGW(TAG, "Refresh of %s failed, stale address is kept", host);
+    }
+    vTaskDelete(NULL);
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_err_t dns_cache_init(void)
+{
+    if (NULL == cache_mutex)
+    {
+        cache_mutex = xSemaphoreCreateMutex();
+        if (NULL == cache_mutex)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    if ((DNS_CACHE_MAGIC != rtc_cache.magic) || (dns_cache_crc() != rtc_cache.crc))
+    {
+        memset(&rtc_cache, 0x00, sizeof(rtc_cache));
+        rtc_cache.magic = DNS_CACHE_MAGIC;
+        rtc_cache.crc = dns_cache_crc();
+        ESP_LOGI(TAG, "Cache is empty");
+    }
+    else
+    {
+        for (int i = 0; i < DNS_CACHE_SIZE; i++)
+        {
+            if ('\0' != rtc_cache.entries[i].host[0])
+            {
+                ESP_LOGI(TAG, "Restored %s, TTL %u s", rtc_cache.entries[i].host, rtc_cache.entries[i].ttl_s);
+            }
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t dns_cache_resolve(const char * ptr_host, ip4_addr_t * ptr_addr)
+{
+    uint32_t addr = 0;
+    uint32_t ttl_s = 0;
+
+    if ((NULL == ptr_host) || (NULL == ptr_addr))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (NULL == cache_mutex)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (ip4addr_aton(ptr_host, ptr_addr))
+    {
+        return ESP_OK;
+    }
+    if (strlen(ptr_host) >= DNS_CACHE_HOST_MAX)
+    {
+        esp_err_t err = dns_cache_query(ptr_host, &addr, &ttl_s);
+        ptr_addr->addr = addr;
+        return err;
+    }
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    int idx = dns_cache_find(ptr_host);
+    if (idx >= 0)
+    {
+        const dns_cache_entry_t * ptr_entry = &rtc_cache.entries[idx];
+        /* Negative age means the clock was set back, the entry cannot be trusted */
+        int64_t age_s = time(NULL) - ptr_entry->resolved_s;
+        if ((age_s >= 0) && (age_s < (int64_t) ptr_entry->ttl_s + DNS_CACHE_STALE_MAX_S))
+        {
+            ptr_addr->addr = ptr_entry->addr;
+            if (age_s < ptr_entry->ttl_s)
+            {
+                cache_stats.hits++;
+            }
+            else
+            {
+                cache_stats.stale_hits++;
+                if (!refreshing[idx])
+                {
+                    refreshing[idx] = (pdPASS == xTaskCreate(&dns_cache_refresh_task,
+                                                             DNS_CACHE_REFRESH_TASK_NAME,
+                                                             DNS_CACHE_REFRESH_TASK_STACK_SIZE,
+                                                             (void *) (intptr_t) idx,
+                                                             DNS_CACHE_REFRESH_TASK_PRIORITY,
+                                                             NULL));
+                }
+            }
+            xSemaphoreGive(cache_mutex);
+            return ESP_OK;
+        }
+    }
+    cache_stats.misses++;
+    xSemaphoreGive(cache_mutex);
+
+    /* Other hosts may be served while this one is being resolved */
+    esp_err_t err = dns_cache_query(ptr_host, &addr, &ttl_s);
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    if (ESP_OK == err)
+    {
+        dns_cache_store(ptr_host, addr, ttl_s);
+        ptr_addr->addr = addr;
+    }
+    else
+    {
+        cache_stats.failures++;
+    }
+    xSemaphoreGive(cache_mutex);
+
+    if (ESP_OK != err)
+    {
+        ESP_LOGE(TAG, "Cannot resolve %s", ptr_host);
+    }
+    return err;
+}
+
+void dns_cache_invalidate(const char * ptr_host)
+{
+    if (NULL == cache_mutex)
+    {
+        return;
+    }
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    int idx = dns_cache_find(ptr_host);
+    if ((idx >= 0) && !refreshing[idx])
+    {
+        memset(&rtc_cache.entries[idx], 0x00, sizeof(rtc_cache.entries[idx]));
+        rtc_cache.crc = dns_cache_crc();
+    }
+    xSemaphoreGive(cache_mutex);
+}
+
+void dns_cache_get_stats(dns_cache_stats_t * ptr_stats)
+{
+    if (NULL == cache_mutex)
+    {
+        memset(ptr_stats, 0x00, sizeof(*ptr_stats));
+        return;
+    }
+
+    xSemaphoreTake(cache_mutex, portMAX_DELAY);
+    *ptr_stats = cache_stats;
+    xSemaphoreGive(cache_mutex);
+}
+
+void dns_cache_log_stats(void)
+{
+    dns_cache_stats_t stats;
+    dns_cache_get_stats(&stats);
+
+    ESP_LOGI(TAG, "Hits: %u, stale hits: %u, misses: %u, refreshes: %u, failures: %u",
+             stats.hits,
+             stats.stale_hits,
+             stats.misses,
+             stats.refreshes,
+             stats.failures);
+}
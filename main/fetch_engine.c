@@ -0,0 +1,343 @@
+/**
+ *  @file       fetch_engine.c
+ *
+ *  @brief      Non-blocking multiplexed HTTPS fetch engine
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+
+#include "lwip/sockets.h"
+
+#include "dns_cache.h"
+#include "fetch_engine.h"
+
+/******************** DEFINES ********************/
+
+/**< esp_tls select() timeout while connecting; it blocks forever if 0, the engine keeps its own deadline */
+#define FETCH_ENGINE_TLS_TIMEOUT_MS 1
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * TAG = "fetch_engine";
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static void fetch_engine_finish(fetch_engine_t * ptr_engine, fetch_slot_t * ptr_slot, esp_err_t err);
+static void fetch_engine_step(fetch_engine_t * ptr_engine, fetch_slot_t * ptr_slot);
+static bool fetch_engine_wants_write(fetch_slot_t * ptr_slot);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Complete request, notify the consumer and release the slot
+ *
+ *  Slot is released after the callback, so a request submitted from the
+ *  callback takes another slot.
+ *
+ *  @param[in]  ptr_engine  Engine context pointer
+ *  @param[in]  ptr_slot    Request slot pointer
+ *  @param[in]  err         Request result
+ */
+static void fetch_engine_finish(fetch_engine_t * ptr_engine, fetch_slot_t * ptr_slot, esp_err_t err)
+{
+    if (NULL != ptr_slot->ptr_tls)
+    {
+        esp_tls_conn_destroy(ptr_slot->ptr_tls);
+        ptr_slot->ptr_tls = NULL;
+    }
+
+    if (ESP_OK == err)
+    {
+        ptr_engine->stats.completed++;
+    }
+    else
+    {
+        ptr_engine->stats.failed++;
+        ESP_LOGW(TAG, "Request to %s failed: %s", ptr_slot->req.ptr_host, esp_err_to_name(err));
+    }
+
+    if (NULL != ptr_slot->req.done_cb)
+    {
+        ptr_slot->req.done_cb(err, &ptr_slot->resp, ptr_slot->req.ptr_arg);
+    }
+    ptr_slot->state = FETCH_STATE_FREE;
+}
+
+/**
+ *  @brief      Advance request as far as possible without blocking
+ *
+ *  @param[in]  ptr_engine  Engine context pointer
+ *  @param[in]  ptr_slot    Request slot pointer
+ */
+static void fetch_engine_step(fetch_engine_t * ptr_engine, fetch_slot_t * ptr_slot)
+{
+    int ret = 0;
+
+    switch (ptr_slot->state)
+    {
+    case FETCH_STATE_CONNECT:
+        ret = esp_tls_conn_new_async(ptr_slot->addr_str,
+                                     strlen(ptr_slot->addr_str),
+                                     ptr_slot->req.port,
+                                     &ptr_slot->tls_cfg,
+                                     ptr_slot->ptr_tls);
+        if (ret < 0)
+        {
+            dns_cache_invalidate(ptr_slot->req.ptr_host);
+            fetch_engine_finish(ptr_engine, ptr_slot, ESP_FAIL);
+            return;
+        }
+        if (0 == ret)
+        {
+            return;
+        }
+        ptr_slot->state = FETCH_STATE_WRITE;
+        ptr_slot->written = 0;
+        /* fall through */
+
+    case FETCH_STATE_WRITE:
+        while (ptr_slot->written < ptr_slot->req.req_len)
+        {
+            ret = esp_tls_conn_write(ptr_slot->ptr_tls,
+                                     ptr_slot->req.ptr_req + ptr_slot->written,
+                                     ptr_slot->req.req_len - ptr_slot->written);
+            if (ret >= 0)
+            {
+                ptr_slot->written += ret;
+            }
+            else if ((ESP_TLS_ERR_SSL_WANT_WRITE == ret) || (ESP_TLS_ERR_SSL_WANT_READ == ret))
+            {
+                return;
+            }
+            else
+            {
+                fetch_engine_finish(ptr_engine, ptr_slot, ESP_FAIL);
+                return;
+            }
+        }
+        http_resp_init(&ptr_slot->resp, ptr_slot->req.ptr_cbs, ptr_slot->req.ptr_arg);
+        ptr_slot->state = FETCH_STATE_READ;
+        /* fall through */
+
+    case FETCH_STATE_READ:
+    {
+        /* Read until TLS layer has no complete record, then wait in select() again */
+        char buf[FETCH_ENGINE_RX_BUF_SIZE];
+        for (;;)
+        {
+            ret = esp_tls_conn_read(ptr_slot->ptr_tls, buf, sizeof(buf));
+            if ((ESP_TLS_ERR_SSL_WANT_READ == ret) || (ESP_TLS_ERR_SSL_WANT_WRITE == ret))
+            {
+                return;
+            }
+            if (ret < 0)
+            {
+                /* TLS error: a close-delimited body is truncated, not complete */
+                fetch_engine_finish(ptr_engine, ptr_slot, ESP_FAIL);
+                return;
+            }
+            if (0 == ret)
+            {
+                http_resp_eof(&ptr_slot->resp);
+                break;
+            }
+            ptr_engine->stats.rx_bytes += ret;
+            http_resp_feed(&ptr_slot->resp, buf, ret);
+            if (http_resp_is_done(&ptr_slot->resp) || http_resp_is_error(&ptr_slot->resp))
+            {
+                break;
+            }
+        }
+        fetch_engine_finish(ptr_engine, ptr_slot, http_resp_is_done(&ptr_slot->resp) ? ESP_OK : ESP_FAIL);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+/**
+ *  @brief      Socket event the request is waiting for
+ *
+ *  TCP connection completion is signalled by writability. Handshake and
+ *  response wait for server data; ClientHello always fits socket buffer,
+ *  so handshake does not wait for writability.
+ *
+ *  @param[in]  ptr_slot    Request slot pointer
+ *
+ *  @return     true if writability is awaited, false if readability
+ */
+static bool fetch_engine_wants_write(fetch_slot_t * ptr_slot)
+{
+    if (FETCH_STATE_CONNECT == ptr_slot->state)
+    {
+        esp_tls_conn_state_t conn_state = ESP_TLS_INIT;
+        esp_tls_get_conn_state(ptr_slot->ptr_tls, &conn_state);
+        return (ESP_TLS_CONNECTING == conn_state);
+    }
+
+    return (FETCH_STATE_WRITE == ptr_slot->state);
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_err_t fetch_engine_init(fetch_engine_t * ptr_engine, const esp_tls_cfg_t * ptr_tls_cfg, int timeout_ms)
+{
+    if ((NULL == ptr_engine) || (NULL == ptr_tls_cfg) || (timeout_ms <= 0))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(ptr_engine, 0x00, sizeof(*ptr_engine));
+    ptr_engine->tls_cfg = *ptr_tls_cfg;
+    ptr_engine->tls_cfg.non_block = true;
+    ptr_engine->tls_cfg.timeout_ms = FETCH_ENGINE_TLS_TIMEOUT_MS;
+    ptr_engine->timeout_ms = timeout_ms;
+
+    return ESP_OK;
+}
+
+esp_err_t fetch_engine_submit(fetch_engine_t * ptr_engine, const fetch_req_t * ptr_req)
+{
+    fetch_slot_t * ptr_slot = NULL;
+
+    for (uint32_t i = 0; i < FETCH_ENGINE_SLOTS_MAX; i++)
+    {
+        if (FETCH_STATE_FREE == ptr_engine->slots[i].state)
+        {
+            ptr_slot = &ptr_engine->slots[i];
+            break;
+        }
+    }
+    if (NULL == ptr_slot)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ip4_addr_t addr;
+    esp_err_t err = dns_cache_resolve(ptr_req->ptr_host, &addr);
+    if (ESP_OK != err)
+    {
+        return err;
+    }
+
+    memset(ptr_slot, 0x00, sizeof(*ptr_slot));
+    ptr_slot->ptr_tls = esp_tls_init();
+    if (NULL == ptr_slot->ptr_tls)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    ip4addr_ntoa_r(&addr, ptr_slot->addr_str, sizeof(ptr_slot->addr_str));
+    ptr_slot->req = *ptr_req;
+    ptr_slot->tls_cfg = ptr_engine->tls_cfg;
+    ptr_slot->tls_cfg.common_name = ptr_req->ptr_host;
+    ptr_slot->deadline_us = esp_timer_get_time() + ptr_engine->timeout_ms * 1000LL;
+    ptr_slot->state = FETCH_STATE_CONNECT;
+    ptr_engine->stats.requests++;
+
+    /* Start TCP connection right away */
+    fetch_engine_step(ptr_engine, ptr_slot);
+
+    return ESP_OK;
+}
+
+uint32_t fetch_engine_poll(fetch_engine_t * ptr_engine, int timeout_ms)
+{
+    fd_set rset;
+    fd_set wset;
+    int maxfd = -1;
+    int sockfd = -1;
+    int64_t now_us = esp_timer_get_time();
+    int64_t wait_us = timeout_ms * 1000LL;
+
+    FD_ZERO(&rset);
+    FD_ZERO(&wset);
+
+    for (uint32_t i = 0; i < FETCH_ENGINE_SLOTS_MAX; i++)
+    {
+        fetch_slot_t * ptr_slot = &ptr_engine->slots[i];
+        if (FETCH_STATE_FREE == ptr_slot->state)
+        {
+            continue;
+        }
+        if (now_us >= ptr_slot->deadline_us)
+        {
+            fetch_engine_finish(ptr_engine, ptr_slot, ESP_ERR_TIMEOUT);
+            continue;
+        }
+        if ((esp_tls_get_conn_sockfd(ptr_slot->ptr_tls, &sockfd) != ESP_OK) || (sockfd < 0))
+        {
+            fetch_engine_finish(ptr_engine, ptr_slot, ESP_FAIL);
+            continue;
+        }
+
+        FD_SET(sockfd, fetch_engine_wants_write(ptr_slot) ? &wset : &rset);
+        maxfd = (sockfd > maxfd) ? sockfd : maxfd;
+        if (ptr_slot->deadline_us - now_us < wait_us)
+        {
+            wait_us = ptr_slot->deadline_us - now_us;
+        }
+    }
+
+    if (maxfd < 0)
+    {
+        return 0;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = wait_us / 1000000,
+        .tv_usec = wait_us % 1000000,
+    };
+    int ready = select(maxfd + 1, &rset, &wset, NULL, &timeout);
+    ptr_engine->stats.wakeups++;
+
+    uint32_t active = 0;
+    for (uint32_t i = 0; i < FETCH_ENGINE_SLOTS_MAX; i++)
+    {
+        fetch_slot_t * ptr_slot = &ptr_engine->slots[i];
+        if (FETCH_STATE_FREE == ptr_slot->state)
+        {
+            continue;
+        }
+        if ((ready > 0) &&
+            (esp_tls_get_conn_sockfd(ptr_slot->ptr_tls, &sockfd) == ESP_OK) &&
+            (sockfd >= 0) &&
+            (FD_ISSET(sockfd, &rset) || FD_ISSET(sockfd, &wset)))
+        {
+            fetch_engine_step(ptr_engine, ptr_slot);
+        }
+        if (FETCH_STATE_FREE != ptr_slot->state)
+        {
+            active++;
+        }
+    }
+
+    return active;
+}
+
+void fetch_engine_run(fetch_engine_t * ptr_engine)
+{
+    while (fetch_engine_poll(ptr_engine, ptr_engine->timeout_ms) > 0)
+    {
+    }
+}
+
+void fetch_engine_abort(fetch_engine_t * ptr_engine)
+{
+    for (uint32_t i = 0; i < FETCH_ENGINE_SLOTS_MAX; i++)
+    {
+        if (FETCH_STATE_FREE != ptr_engine->slots[i].state)
+        {
+            fetch_engine_finish(ptr_engine, &ptr_engine->slots[i], ESP_FAIL);
+        }
+    }
+}
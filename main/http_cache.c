@@ -0,0 +1,203 @@
+/**
+ *  @file       http_cache.c
+ *
+ *  @brief      HTTP response cache metadata (validators and freshness)
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "http_cache.h"
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static void http_cache_meta_reset(http_cache_meta_t * ptr_meta);
+static void http_cache_control(http_cache_meta_t * ptr_meta, const char * ptr_value);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Metadata reset
+ *
+ *  @param[out] ptr_meta    Metadata pointer
+ */
+static void http_cache_meta_reset(http_cache_meta_t * ptr_meta)
+{
+    memset(ptr_meta, 0x00, sizeof(*ptr_meta));
+    ptr_meta->max_age_s = -1;
+}
+
+/**
+ *  @brief      Cache-Control directives parsing
+ *
+ *  @param[out] ptr_meta    Metadata pointer
+ *  @param[in]  ptr_value   Cache-Control header value
+ */
+static void http_cache_control(http_cache_meta_t * ptr_meta, const char * ptr_value)
+{
+    while (*ptr_value != '\0')
+    {
+        while ((*ptr_value == ' ') || (*ptr_value == ','))
+        {
+            ptr_value++;
+        }
+
+        size_t len = strcspn(ptr_value, ",");
+        if (0 == strncasecmp(ptr_value, "max-age=", 8))
+        {
+            const char * ptr_num = ptr_value + 8;
+            if (*ptr_num == '"')
+            {
+                ptr_num++;
+            }
+            ptr_meta->max_age_s = strtol(ptr_num, NULL, 10);
+        }
+        else if ((len >= 8) && (0 == strncasecmp(ptr_value, "no-store", 8)))
+        {
+            ptr_meta->no_store = true;
+        }
+        else if ((len >= 8) && (0 == strncasecmp(ptr_value, "no-cache", 8)))
+        {
+            ptr_meta->no_cache = true;
+        }
+        ptr_value += len;
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void http_cache_init(http_cache_t * ptr_cache)
+{
+    memset(ptr_cache, 0x00, sizeof(*ptr_cache));
+    http_cache_meta_reset(&ptr_cache->meta);
+    http_cache_meta_reset(&ptr_cache->pending);
+}
+
+bool http_cache_is_fresh(http_cache_t * ptr_cache, int64_t now_us)
+{
+    if (!ptr_cache->valid || (now_us >= ptr_cache->fresh_until_us))
+    {
+        return false;
+    }
+
+    ptr_cache->hits++;
+    return true;
+}
+
+size_t http_cache_build_request(const http_cache_t * ptr_cache,
+                                const char * ptr_head,
+                                char * ptr_buf,
+                                size_t size)
+{
+    const char * ptr_etag = "";
+    const char * ptr_last_modified = "";
+
+    if (ptr_cache->valid)
+    {
+        ptr_etag = ptr_cache->meta.etag;
+        ptr_last_modified = ptr_cache->meta.last_modified;
+    }
+
+    int len = snprintf(ptr_buf, size, "%s%s%s%s%s%s%s\r\n",
+                       ptr_head,
+                       (*ptr_etag != '\0') ? "If-None-Match: " : "",
+                       ptr_etag,
+                       (*ptr_etag != '\0') ? "\r\n" : "",
+                       (*ptr_last_modified != '\0') ? "If-Modified-Since: " : "",
+                       ptr_last_modified,
+                       (*ptr_last_modified != '\0') ? "\r\n" : "");
+    if ((len < 0) || ((size_t) len >= size))
+    {
+        return 0;
+    }
+
+    return (size_t) len;
+}
+
+void http_cache_response_begin(http_cache_t * ptr_cache)
+{
+    http_cache_meta_reset(&ptr_cache->pending);
+}
+
+void http_cache_header(http_cache_t * ptr_cache, const char * ptr_name, const char * ptr_value)
+{
+    http_cache_meta_t * ptr_meta = &ptr_cache->pending;
+
+    /* Validators that do not fit are not used at all */
+    if (0 == strcasecmp(ptr_name, "ETag"))
+    {
+        if (strlen(ptr_value) < sizeof(ptr_meta->etag))
+        {
+            strcpy(ptr_meta->etag, ptr_value);
+        }
+    }
+    else if (0 == strcasecmp(ptr_name, "Last-Modified"))
+    {
+        if (strlen(ptr_value) < sizeof(ptr_meta->last_modified))
+        {
+            strcpy(ptr_meta->last_modified, ptr_value);
+        }
+    }
+    else if (0 == strcasecmp(ptr_name, "Cache-Control"))
+    {
+        http_cache_control(ptr_meta, ptr_value);
+    }
+    else if (0 == strcasecmp(ptr_name, "Age"))
+    {
+        ptr_meta->age_s = strtol(ptr_value, NULL, 10);
+    }
+}
+
+http_cache_result_t http_cache_response_end(http_cache_t * ptr_cache, int status, int64_t now_us)
+{
+    http_cache_meta_t * ptr_pending = &ptr_cache->pending;
+    int64_t fresh_s = 0;
+
+    if ((304 == status) && ptr_cache->valid)
+    {
+        /* 304 refreshes freshness, validators are kept unless resent */
+        if (ptr_pending->etag[0] != '\0')
+        {
+            strcpy(ptr_cache->meta.etag, ptr_pending->etag);
+        }
+        if (ptr_pending->last_modified[0] != '\0')
+        {
+            strcpy(ptr_cache->meta.last_modified, ptr_pending->last_modified);
+        }
+        ptr_cache->meta.max_age_s = ptr_pending->max_age_s;
+        ptr_cache->meta.age_s = ptr_pending->age_s;
+        ptr_cache->meta.no_cache = ptr_pending->no_cache;
+        ptr_cache->revalidations++;
+    }
+    else if ((200 == status) && !ptr_pending->no_store)
+    {
+        ptr_cache->meta = *ptr_pending;
+        ptr_cache->valid = true;
+        ptr_cache->updates++;
+    }
+    else
+    {
+        ptr_cache->valid = false;
+        return HTTP_CACHE_UNCACHEABLE;
+    }
+
+    if (!ptr_cache->meta.no_cache && (ptr_cache->meta.max_age_s > ptr_cache->meta.age_s))
+    {
+        fresh_s = ptr_cache->meta.max_age_s - ptr_cache->meta.age_s;
+    }
+    ptr_cache->fresh_until_us = now_us + fresh_s * 1000000LL;
+
+    return (304 == status) ? HTTP_CACHE_NOT_MODIFIED : HTTP_CACHE_UPDATED;
+}
+
+void http_cache_invalidate(http_cache_t * ptr_cache)
+{
+    ptr_cache->valid = false;
+    ptr_cache->fresh_until_us = 0;
+}
@@ -0,0 +1,335 @@
+/**
+ *  @file       http_inflate.c
+ *
+ *  @brief      Streaming gzip/deflate content decoding
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+
+#include "miniz.h"
+
+#include "http_inflate.h"
+
+/******************** DEFINES ********************/
+
+/**
+ *  Deflate back references reach up to 32 KB, so the circular window
+ *  must be as large as the one the server compresses with.
+ */
+#define HTTP_INFLATE_WINDOW_SIZE    TINFL_LZ_DICT_SIZE
+
+#define HTTP_INFLATE_GZIP_FEXTRA    0x04    /**< gzip extra field is present */
+#define HTTP_INFLATE_GZIP_FNAME     0x08    /**< gzip file name is present */
+#define HTTP_INFLATE_GZIP_FCOMMENT  0x10    /**< gzip comment is present */
+#define HTTP_INFLATE_GZIP_FHCRC     0x02    /**< gzip header CRC is present */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  gzip header parsing states
+ */
+typedef enum http_inflate_gzip_e
+{
+    HTTP_INFLATE_GZIP_ID1 = 0,
+    HTTP_INFLATE_GZIP_ID2,
+    HTTP_INFLATE_GZIP_CM,
+    HTTP_INFLATE_GZIP_FLG,
+    HTTP_INFLATE_GZIP_FIXED,
+    HTTP_INFLATE_GZIP_XLEN_LO,
+    HTTP_INFLATE_GZIP_XLEN_HI,
+    HTTP_INFLATE_GZIP_EXTRA,
+    HTTP_INFLATE_GZIP_NAME,
+    HTTP_INFLATE_GZIP_COMMENT,
+    HTTP_INFLATE_GZIP_HCRC,
+    HTTP_INFLATE_GZIP_DATA,
+} http_inflate_gzip_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * TAG = "http_inflate";
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static size_t http_inflate_gzip_header(http_inflate_t * ptr_inflate, const uint8_t * ptr_data, size_t len);
+static void http_inflate_gzip_next(http_inflate_t * ptr_inflate);
+static void http_inflate_data(http_inflate_t * ptr_inflate, const uint8_t * ptr_data, size_t len);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Switch to the next optional gzip header field
+ *
+ *  @param[in]  ptr_inflate Decoder context pointer
+ */
+static void http_inflate_gzip_next(http_inflate_t * ptr_inflate)
+{
+    uint8_t flags = ptr_inflate->gzip_flags;
+
+    switch (ptr_inflate->gzip_state)
+    {
+        case HTTP_INFLATE_GZIP_FIXED:
+            if (flags & HTTP_INFLATE_GZIP_FEXTRA)
+            {
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_XLEN_LO;
+                return;
+            }
+            /* fall through */
+        case HTTP_INFLATE_GZIP_EXTRA:
+            if (flags & HTTP_INFLATE_GZIP_FNAME)
+            {
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_NAME;
+                return;
+            }
+            /* fall through */
+        case HTTP_INFLATE_GZIP_NAME:
+            if (flags & HTTP_INFLATE_GZIP_FCOMMENT)
+            {
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_COMMENT;
+                return;
+            }
+            /* fall through */
+        case HTTP_INFLATE_GZIP_COMMENT:
+            if (flags & HTTP_INFLATE_GZIP_FHCRC)
+            {
+                ptr_inflate->gzip_skip = 2;
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_HCRC;
+                return;
+            }
+            /* fall through */
+        default:
+            ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_DATA;
+            return;
+    }
+}
+
+/**
+ *  @brief      gzip header parsing
+ *
+ *  @param[in]  ptr_inflate Decoder context pointer
+ *  @param[in]  ptr_data    Encoded bytes pointer
+ *  @param[in]  len         Encoded bytes quantity
+ *
+ *  @return     Consumed bytes quantity
+ */
+static size_t http_inflate_gzip_header(http_inflate_t * ptr_inflate, const uint8_t * ptr_data, size_t len)
+{
+    size_t pos = 0;
+
+    while ((pos < len) && (HTTP_INFLATE_GZIP_DATA != ptr_inflate->gzip_state) && !ptr_inflate->error)
+    {
+        uint8_t byte = ptr_data[pos++];
+
+        switch (ptr_inflate->gzip_state)
+        {
+            case HTTP_INFLATE_GZIP_ID1:
+                ptr_inflate->error = (0x1F != byte);
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_ID2;
+                break;
+            case HTTP_INFLATE_GZIP_ID2:
+                ptr_inflate->error = (0x8B != byte);
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_CM;
+                break;
+            case HTTP_INFLATE_GZIP_CM:
+                ptr_inflate->error = (8 != byte);
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_FLG;
+                break;
+            case HTTP_INFLATE_GZIP_FLG:
+                ptr_inflate->gzip_flags = byte;
+                ptr_inflate->gzip_skip = 6;     /* MTIME, XFL, OS */
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_FIXED;
+                break;
+            case HTTP_INFLATE_GZIP_XLEN_LO:
+                ptr_inflate->gzip_skip = byte;
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_XLEN_HI;
+                break;
+            case HTTP_INFLATE_GZIP_XLEN_HI:
+                ptr_inflate->gzip_skip |= (uint16_t) byte << 8;
+                ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_EXTRA;
+                if (0 == ptr_inflate->gzip_skip)
+                {
+                    http_inflate_gzip_next(ptr_inflate);
+                }
+                break;
+            case HTTP_INFLATE_GZIP_FIXED:
+            case HTTP_INFLATE_GZIP_EXTRA:
+            case HTTP_INFLATE_GZIP_HCRC:
+                if (0 == --ptr_inflate->gzip_skip)
+                {
+                    http_inflate_gzip_next(ptr_inflate);
+                }
+                break;
+            case HTTP_INFLATE_GZIP_NAME:
+            case HTTP_INFLATE_GZIP_COMMENT:
+                if (0 == byte)
+                {
+                    http_inflate_gzip_next(ptr_inflate);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return pos;
+}
+
+/**
+ *  @brief      Deflate data decoding into the circular window
+ *
+ *  @param[in]  ptr_inflate Decoder context pointer
+ *  @param[in]  ptr_data    Compressed bytes pointer
+ *  @param[in]  len         Compressed bytes quantity
+ */
+static void http_inflate_data(http_inflate_t * ptr_inflate, const uint8_t * ptr_data, size_t len)
+{
+    mz_uint32 flags = TINFL_FLAG_HAS_MORE_INPUT;
+    tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+
+    if (HTTP_INFLATE_DEFLATE == ptr_inflate->coding)
+    {
+        flags |= TINFL_FLAG_PARSE_ZLIB_HEADER;
+    }
+
+    while (!ptr_inflate->done && ((len > 0) || (TINFL_STATUS_HAS_MORE_OUTPUT == status)))
+    {
+        size_t in_size = len;
+        size_t out_size = HTTP_INFLATE_WINDOW_SIZE - ptr_inflate->window_pos;
+        uint8_t * ptr_out = ptr_inflate->ptr_window + ptr_inflate->window_pos;
+
+        status = tinfl_decompress((tinfl_decompressor *) ptr_inflate->ptr_decomp,
+                                  ptr_data, &in_size,
+                                  ptr_inflate->ptr_window, ptr_out, &out_size,
+                                  flags);
+        ptr_data += in_size;
+        len -= in_size;
+
+        if (out_size > 0)
+        {
+            ptr_inflate->out_bytes += out_size;
+            ptr_inflate->out_cb((const char *) ptr_out, out_size, ptr_inflate->ptr_out_arg);
+            ptr_inflate->window_pos = (ptr_inflate->window_pos + out_size) & (HTTP_INFLATE_WINDOW_SIZE - 1);
+        }
+
+        if (status < TINFL_STATUS_DONE)
+        {
+            ESP_LOGE(TAG, "Inflate failed: %d", status);
+            ptr_inflate->error = true;
+            return;
+        }
+        ptr_inflate->done = (TINFL_STATUS_DONE == status);
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_err_t http_inflate_init(http_inflate_t * ptr_inflate, http_resp_body_cb_t out_cb, void * ptr_out_arg)
+{
+    memset(ptr_inflate, 0x00, sizeof(*ptr_inflate));
+    ptr_inflate->out_cb = out_cb;
+    ptr_inflate->ptr_out_arg = ptr_out_arg;
+    ptr_inflate->ptr_decomp = malloc(sizeof(tinfl_decompressor));
+    ptr_inflate->ptr_window = malloc(HTTP_INFLATE_WINDOW_SIZE);
+
+    if ((NULL == ptr_inflate->ptr_decomp) || (NULL == ptr_inflate->ptr_window))
+    {
+        http_inflate_deinit(ptr_inflate);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void http_inflate_deinit(http_inflate_t * ptr_inflate)
+{
+    free(ptr_inflate->ptr_decomp);
+    free(ptr_inflate->ptr_window);
+    ptr_inflate->ptr_decomp = NULL;
+    ptr_inflate->ptr_window = NULL;
+}
+
+http_inflate_coding_t http_inflate_coding(const char * ptr_value)
+{
+    if ((0 == strcasecmp(ptr_value, "gzip")) || (0 == strcasecmp(ptr_value, "x-gzip")))
+    {
+        return HTTP_INFLATE_GZIP;
+    }
+    if (0 == strcasecmp(ptr_value, "deflate"))
+    {
+        return HTTP_INFLATE_DEFLATE;
+    }
+    if ((0 == strcasecmp(ptr_value, "identity")) || ('\0' == *ptr_value))
+    {
+        return HTTP_INFLATE_IDENTITY;
+    }
+
+    return HTTP_INFLATE_UNSUPPORTED;
+}
+
+void http_inflate_begin(http_inflate_t * ptr_inflate, http_inflate_coding_t coding)
+{
+    ptr_inflate->coding = coding;
+    ptr_inflate->window_pos = 0;
+    ptr_inflate->gzip_state = HTTP_INFLATE_GZIP_ID1;
+    ptr_inflate->gzip_flags = 0;
+    ptr_inflate->gzip_skip = 0;
+    ptr_inflate->done = false;
+    ptr_inflate->error = (HTTP_INFLATE_UNSUPPORTED == coding);
+    ptr_inflate->in_bytes = 0;
+    ptr_inflate->out_bytes = 0;
+
+    if ((HTTP_INFLATE_GZIP == coding) || (HTTP_INFLATE_DEFLATE == coding))
+    {
+        tinfl_init((tinfl_decompressor *) ptr_inflate->ptr_decomp);
+    }
+}
+
+void http_inflate_feed(const char * ptr_data, size_t len, void * ptr_arg)
+{
+    http_inflate_t * ptr_inflate = (http_inflate_t *) ptr_arg;
+    const uint8_t * ptr_bytes = (const uint8_t *) ptr_data;
+
+    ptr_inflate->in_bytes += len;
+
+    if (ptr_inflate->error)
+    {
+        return;
+    }
+
+    if (HTTP_INFLATE_IDENTITY == ptr_inflate->coding)
+    {
+        ptr_inflate->out_bytes += len;
+        ptr_inflate->out_cb(ptr_data, len, ptr_inflate->ptr_out_arg);
+        return;
+    }
+
+    if (HTTP_INFLATE_GZIP == ptr_inflate->coding)
+    {
+        size_t used = http_inflate_gzip_header(ptr_inflate, ptr_bytes, len);
+        ptr_bytes += used;
+        len -= used;
+    }
+
+    /* gzip trailer (CRC32, ISIZE) after the deflate stream is ignored */
+    if ((len > 0) && !ptr_inflate->error && !ptr_inflate->done)
+    {
+        http_inflate_data(ptr_inflate, ptr_bytes, len);
+    }
+}
+
+bool http_inflate_finish(const http_inflate_t * ptr_inflate)
+{
+    if (ptr_inflate->error)
+    {
+        return false;
+    }
+
+    return (HTTP_INFLATE_IDENTITY == ptr_inflate->coding) || ptr_inflate->done;
+}
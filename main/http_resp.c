@@ -0,0 +1,381 @@
+/**
+ *  @file       http_resp.c
+ *
+ *  @brief      Incremental HTTP/1.1 response parser
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include "http_resp.h"
+
+/******************** DEFINES ********************/
+
+#define HTTP_RESP_SIZE_MAX  (1ULL << 60)    /**< Upper bound for body and chunk sizes */
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static char * http_resp_trim(char * ptr_str);
+static bool http_resp_has_token(const char * ptr_value, const char * ptr_token);
+static void http_resp_status_line(http_resp_t * ptr_resp);
+static void http_resp_header_line(http_resp_t * ptr_resp);
+static void http_resp_headers_done(http_resp_t * ptr_resp);
+static void http_resp_chunk_size_line(http_resp_t * ptr_resp);
+static void http_resp_line(http_resp_t * ptr_resp);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Remove leading and trailing whitespaces in place
+ *
+ *  @param[in]  ptr_str     NULL-terminated string
+ *
+ *  @return     Pointer to the first non-space character
+ */
+static char * http_resp_trim(char * ptr_str)
+{
+    while ((*ptr_str == ' ') || (*ptr_str == '\t'))
+    {
+        ptr_str++;
+    }
+
+    size_t len = strlen(ptr_str);
+    while ((len > 0) && ((ptr_str[len - 1] == ' ') || (ptr_str[len - 1] == '\t')))
+    {
+        ptr_str[--len] = '\0';
+    }
+
+    return ptr_str;
+}
+
+/**
+ *  @brief      Search for a token in comma separated header value
+ *
+ *  @param[in]  ptr_value   Header value
+ *  @param[in]  ptr_token   Token to search (case insensitive)
+ *
+ *  @return     true if token is present
+ */
+static bool http_resp_has_token(const char * ptr_value, const char * ptr_token)
+{
+    size_t token_len = strlen(ptr_token);
+
+    while (*ptr_value != '\0')
+    {
+        while ((*ptr_value == ' ') || (*ptr_value == '\t') || (*ptr_value == ','))
+        {
+            ptr_value++;
+        }
+
+        size_t len = strcspn(ptr_value, ", \t");
+        if ((len == token_len) && (0 == strncasecmp(ptr_value, ptr_token, len)))
+        {
+            return true;
+        }
+        ptr_value += len;
+    }
+
+    return false;
+}
+
+/**
+ *  @brief      Status line processing
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ */
+static void http_resp_status_line(http_resp_t * ptr_resp)
+{
+    const char * ptr_line = ptr_resp->line;
+
+    /* Tolerate empty lines before status line */
+    if (0 == ptr_resp->line_len)
+    {
+        return;
+    }
+
+    if ((0 != strncmp(ptr_line, "HTTP/1.", 7)) ||
+        !isdigit((unsigned char) ptr_line[7]) ||
+        (ptr_line[8] != ' ') ||
+        !isdigit((unsigned char) ptr_line[9]) ||
+        !isdigit((unsigned char) ptr_line[10]) ||
+        !isdigit((unsigned char) ptr_line[11]))
+    {
+        ptr_resp->state = HTTP_RESP_STATE_ERROR;
+        return;
+    }
+
+    ptr_resp->status = (ptr_line[9] - '0') * 100 + (ptr_line[10] - '0') * 10 + (ptr_line[11] - '0');
+    ptr_resp->keep_alive = (ptr_line[7] != '0');
+    ptr_resp->state = HTTP_RESP_STATE_HEADER;
+}
+
+/**
+ *  @brief      Header line processing
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ */
+static void http_resp_header_line(http_resp_t * ptr_resp)
+{
+    if (0 == ptr_resp->line_len)
+    {
+        http_resp_headers_done(ptr_resp);
+        return;
+    }
+
+    /* Truncated value is worse than missing one */
+    if (ptr_resp->line_overflow)
+    {
+        return;
+    }
+
+    char * ptr_colon = strchr(ptr_resp->line, ':');
+    if (NULL == ptr_colon)
+    {
+        ptr_resp->state = HTTP_RESP_STATE_ERROR;
+        return;
+    }
+    *ptr_colon = '\0';
+
+    const char * ptr_name = http_resp_trim(ptr_resp->line);
+    const char * ptr_value = http_resp_trim(ptr_colon + 1);
+
+    if (0 == strcasecmp(ptr_name, "Content-Length"))
+    {
+        uint64_t value = 0;
+        const char * ptr_digit = ptr_value;
+        do
+        {
+            if (!isdigit((unsigned char) *ptr_digit) || (value > HTTP_RESP_SIZE_MAX))
+            {
+                ptr_resp->state = HTTP_RESP_STATE_ERROR;
+                return;
+            }
+            value = value * 10 + (*ptr_digit - '0');
+        } while (*(++ptr_digit) != '\0');
+        ptr_resp->content_length = (int64_t) value;
+    }
+    else if (0 == strcasecmp(ptr_name, "Transfer-Encoding"))
+    {
+        ptr_resp->chunked = http_resp_has_token(ptr_value, "chunked");
+    }
+    else if (0 == strcasecmp(ptr_name, "Connection"))
+    {
+        if (http_resp_has_token(ptr_value, "close"))
+        {
+            ptr_resp->keep_alive = false;
+        }
+        else if (http_resp_has_token(ptr_value, "keep-alive"))
+        {
+            ptr_resp->keep_alive = true;
+        }
+    }
+
+    if ((NULL != ptr_resp->ptr_cbs) && (NULL != ptr_resp->ptr_cbs->header_cb))
+    {
+        ptr_resp->ptr_cbs->header_cb(ptr_name, ptr_value, ptr_resp->ptr_arg);
+    }
+}
+
+/**
+ *  @brief      Body framing selection after the last header
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ */
+static void http_resp_headers_done(http_resp_t * ptr_resp)
+{
+    /* Interim response, the final one follows */
+    if ((ptr_resp->status >= 100) && (ptr_resp->status < 200))
+    {
+        ptr_resp->state = HTTP_RESP_STATE_STATUS;
+        ptr_resp->chunked = false;
+        ptr_resp->content_length = -1;
+        return;
+    }
+
+    if ((204 == ptr_resp->status) || (304 == ptr_resp->status))
+    {
+        ptr_resp->state = HTTP_RESP_STATE_DONE;
+    }
+    else if (ptr_resp->chunked)
+    {
+        ptr_resp->state = HTTP_RESP_STATE_CHUNK_SIZE;
+    }
+    else if (ptr_resp->content_length >= 0)
+    {
+        ptr_resp->remaining = (uint64_t) ptr_resp->content_length;
+        ptr_resp->state = (ptr_resp->remaining > 0) ? HTTP_RESP_STATE_BODY_LENGTH : HTTP_RESP_STATE_DONE;
+    }
+    else
+    {
+        /* Without body length the end of response is the end of connection */
+        ptr_resp->keep_alive = false;
+        ptr_resp->state = HTTP_RESP_STATE_BODY_EOF;
+    }
+}
+
+/**
+ *  @brief      Chunk size line processing
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ */
+static void http_resp_chunk_size_line(http_resp_t * ptr_resp)
+{
+    const char * ptr_digit = ptr_resp->line;
+    uint64_t size = 0;
+
+    if (!isxdigit((unsigned char) *ptr_digit))
+    {
+        ptr_resp->state = HTTP_RESP_STATE_ERROR;
+        return;
+    }
+
+    /* Chunk extensions after the size are ignored */
+    while (isxdigit((unsigned char) *ptr_digit))
+    {
+        if (size > (HTTP_RESP_SIZE_MAX >> 4))
+        {
+            ptr_resp->state = HTTP_RESP_STATE_ERROR;
+            return;
+        }
+        int digit = isdigit((unsigned char) *ptr_digit) ? (*ptr_digit - '0') : (tolower((unsigned char) *ptr_digit) - 'a' + 10);
+        size = (size << 4) | (uint64_t) digit;
+        ptr_digit++;
+    }
+
+    if (0 == size)
+    {
+        ptr_resp->state = HTTP_RESP_STATE_TRAILER;
+    }
+    else
+    {
+        ptr_resp->remaining = size;
+        ptr_resp->state = HTTP_RESP_STATE_CHUNK_DATA;
+    }
+}
+
+/**
+ *  @brief      Complete line dispatching
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ */
+static void http_resp_line(http_resp_t * ptr_resp)
+{
+    switch (ptr_resp->state)
+    {
+        case HTTP_RESP_STATE_STATUS:
+            http_resp_status_line(ptr_resp);
+            break;
+        case HTTP_RESP_STATE_HEADER:
+            http_resp_header_line(ptr_resp);
+            break;
+        case HTTP_RESP_STATE_CHUNK_SIZE:
+            http_resp_chunk_size_line(ptr_resp);
+            break;
+        case HTTP_RESP_STATE_CHUNK_END:
+            ptr_resp->state = (0 == ptr_resp->line_len) ? HTTP_RESP_STATE_CHUNK_SIZE : HTTP_RESP_STATE_ERROR;
+            break;
+        case HTTP_RESP_STATE_TRAILER:
+            if (0 == ptr_resp->line_len)
+            {
+                ptr_resp->state = HTTP_RESP_STATE_DONE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void http_resp_init(http_resp_t * ptr_resp, const http_resp_cbs_t * ptr_cbs, void * ptr_arg)
+{
+    memset(ptr_resp, 0x00, offsetof(http_resp_t, line));
+    ptr_resp->state = HTTP_RESP_STATE_STATUS;
+    ptr_resp->content_length = -1;
+    ptr_resp->ptr_cbs = ptr_cbs;
+    ptr_resp->ptr_arg = ptr_arg;
+}
+
+size_t http_resp_feed(http_resp_t * ptr_resp, const char * ptr_data, size_t len)
+{
+    size_t pos = 0;
+
+    while ((pos < len) &&
+           (HTTP_RESP_STATE_DONE != ptr_resp->state) &&
+           (HTTP_RESP_STATE_ERROR != ptr_resp->state))
+    {
+        if ((HTTP_RESP_STATE_BODY_LENGTH == ptr_resp->state) ||
+            (HTTP_RESP_STATE_CHUNK_DATA == ptr_resp->state) ||
+            (HTTP_RESP_STATE_BODY_EOF == ptr_resp->state))
+        {
+            size_t n = len - pos;
+            if ((HTTP_RESP_STATE_BODY_EOF != ptr_resp->state) && (n > ptr_resp->remaining))
+            {
+                n = (size_t) ptr_resp->remaining;
+            }
+
+            if ((NULL != ptr_resp->ptr_cbs) && (NULL != ptr_resp->ptr_cbs->body_cb))
+            {
+                ptr_resp->ptr_cbs->body_cb(ptr_data + pos, n, ptr_resp->ptr_arg);
+            }
+            ptr_resp->body_bytes += n;
+            pos += n;
+
+            if (HTTP_RESP_STATE_BODY_EOF != ptr_resp->state)
+            {
+                ptr_resp->remaining -= n;
+                if (0 == ptr_resp->remaining)
+                {
+                    ptr_resp->state = (HTTP_RESP_STATE_BODY_LENGTH == ptr_resp->state) ?
+                                      HTTP_RESP_STATE_DONE : HTTP_RESP_STATE_CHUNK_END;
+                }
+            }
+            continue;
+        }
+
+        const char * ptr_nl = memchr(ptr_data + pos, '\n', len - pos);
+        size_t n = (NULL != ptr_nl) ? (size_t) (ptr_nl - (ptr_data + pos)) : (len - pos);
+        size_t room = sizeof(ptr_resp->line) - 1 - ptr_resp->line_len;
+        if (n > room)
+        {
+            ptr_resp->line_overflow = true;
+        }
+        memcpy(ptr_resp->line + ptr_resp->line_len, ptr_data + pos, (n > room) ? room : n);
+        ptr_resp->line_len += (n > room) ? room : n;
+        pos += n;
+
+        if (NULL != ptr_nl)
+        {
+            pos++;
+            if ((ptr_resp->line_len > 0) && (ptr_resp->line[ptr_resp->line_len - 1] == '\r'))
+            {
+                ptr_resp->line_len--;
+            }
+            ptr_resp->line[ptr_resp->line_len] = '\0';
+            http_resp_line(ptr_resp);
+            ptr_resp->line_len = 0;
+            ptr_resp->line_overflow = false;
+        }
+    }
+
+    return pos;
+}
+
+bool http_resp_eof(http_resp_t * ptr_resp)
+{
+    if (HTTP_RESP_STATE_BODY_EOF == ptr_resp->state)
+    {
+        ptr_resp->state = HTTP_RESP_STATE_DONE;
+    }
+    else if (HTTP_RESP_STATE_DONE != ptr_resp->state)
+    {
+        ptr_resp->state = HTTP_RESP_STATE_ERROR;
+    }
+
+    return (HTTP_RESP_STATE_DONE == ptr_resp->state);
+}
@@ -0,0 +1,107 @@
+/**
+ *  @file       clock_drift.h
+ *
+ *  @brief      Local clock drift model and adaptive sync interval
+ *
+ *  Every sync gives a pair of reference time and monotonic local time.
+ *  The rate error of the local clock is measured between successive
+ *  pairs and averaged over the observed span, the clock is slewed by the
+ *  learned rate between syncs, and the next sync interval is chosen so
+ *  that the residual error stays below the configured bound. Platform
+ *  independent: times are passed in microseconds.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define CLOCK_DRIFT_SPAN_MIN_S      600             /**< Shorter spans between syncs do not update the model */
+#define CLOCK_DRIFT_WEIGHT_MAX_S    (14 * 86400)    /**< Observation span the estimate is averaged over */
+#define CLOCK_DRIFT_PPB_MAX         500000          /**< Larger rate errors (500 ppm) are rejected as bad samples */
+#define CLOCK_DRIFT_RATE_FLOOR_PPB  100             /**< Residual rate floor (sample noise), limits the interval growth */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Model configuration
+ */
+typedef struct clock_drift_cfg_s
+{
+    uint32_t error_bound_ms;    /**< Clock error to stay below between syncs */
+    uint32_t interval_min_s;    /**< Shortest sync interval (also used without a model) */
+    uint32_t interval_max_s;    /**< Longest sync interval */
+} clock_drift_cfg_t;
+
+/**
+ *  @brief  Learned state, kept across reboots (stored as is)
+ */
+typedef struct clock_drift_state_s
+{
+    int32_t drift_ppb;          /**< Local clock rate error, ppb, positive if the local clock is fast */
+    uint32_t weight_s;          /**< Observation span behind the estimate, 0 if there is no estimate */
+    uint32_t interval_s;        /**< Next sync interval */
+} clock_drift_state_t;
+
+/**
+ *  @brief  Model context
+ */
+typedef struct clock_drift_s
+{
+    clock_drift_cfg_t cfg;
+    clock_drift_state_t state;
+    bool has_anchor;            /**< Previous sync pair is known */
+    int64_t anchor_ref_us;      /**< Reference time of the previous sync */
+    int64_t anchor_local_us;    /**< Local time of the previous sync */
+    int64_t last_error_us;      /**< Error of the corrected clock found at the last sync */
+    int64_t correction_ns;      /**< Correction not applied yet (below one microsecond) */
+    uint32_t samples;           /**< Pairs that updated the model */
+} clock_drift_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Model initialization
+ *
+ *  @param[out] ptr_drift   Model context pointer
+ *  @param[in]  ptr_cfg     Configuration pointer
+ *  @param[in]  ptr_state   Stored state pointer, NULL if there is none
+ */
+void clock_drift_init(clock_drift_t * ptr_drift, const clock_drift_cfg_t * ptr_cfg, const clock_drift_state_t * ptr_state);
+
+/**
+ *  @brief      Sync pair: rate error is measured against the previous pair
+ *
+ *  @param[in]  ptr_drift   Model context pointer
+ *  @param[in]  ref_us      Reference (server) time, microseconds
+ *  @param[in]  local_us    Monotonic local time of the same moment, microseconds
+ *
+ *  @return     true if the model (and the next interval) is updated
+ */
+bool clock_drift_sample(clock_drift_t * ptr_drift, int64_t ref_us, int64_t local_us);
+
+/**
+ *  @brief      Clock correction for a period of local time
+ *
+ *  Fractions of a microsecond are carried over to the next call.
+ *
+ *  @param[in]  ptr_drift   Model context pointer
+ *  @param[in]  period_us   Local time passed since the previous call
+ *
+ *  @return     Microseconds to slew the clock by (negative if the clock is fast)
+ */
+int64_t clock_drift_correction(clock_drift_t * ptr_drift, int64_t period_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,92 @@
+/**
+ *  @file       dns_cache.h
+ *
+ *  @brief      IPv4 resolver cache kept in RTC memory
+ *
+ *  Resolved addresses are stored with their record TTL in RTC memory, so
+ *  they survive software resets and deep sleep. Expired entries are still
+ *  served for a while and refreshed in the background meanwhile.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#include "lwip/ip_addr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define DNS_CACHE_SIZE          4       /**< Cached host names quantity */
+#define DNS_CACHE_HOST_MAX      64      /**< Longest cached host name (with '\0') */
+#define DNS_CACHE_TTL_MIN_S     30      /**< Shorter TTLs are raised to this value */
+#define DNS_CACHE_TTL_MAX_S     86400   /**< Longer TTLs are cut to this value */
+#define DNS_CACHE_TTL_DEFAULT_S 300     /**< TTL of addresses resolved without TTL information */
+#define DNS_CACHE_STALE_MAX_S   86400   /**< How long an expired entry may still be served */
+#define DNS_CACHE_TIMEOUT_MS    3000    /**< DNS server response timeout */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Cache statistics
+ */
+typedef struct dns_cache_stats_s
+{
+    uint32_t hits;          /**< Fresh entry served */
+    uint32_t stale_hits;    /**< Expired entry served, background refresh started */
+    uint32_t misses;        /**< Synchronous resolution performed */
+    uint32_t refreshes;     /**< Background refreshes completed */
+    uint32_t failures;      /**< Resolutions failed */
+} dns_cache_stats_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Cache initialization, validates entries kept in RTC memory
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t dns_cache_init(void);
+
+/**
+ *  @brief      Resolve host name to IPv4 address
+ *
+ *  @param[in]  ptr_host    Host name
+ *  @param[out] ptr_addr    Resolved address
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t dns_cache_resolve(const char * ptr_host, ip4_addr_t * ptr_addr);
+
+/**
+ *  @brief      Drop cached address (e.g. the host is not reachable by it)
+ *
+ *  @param[in]  ptr_host    Host name
+ */
+void dns_cache_invalidate(const char * ptr_host);
+
+/**
+ *  @brief      Get cache statistics
+ *
+ *  @param[out] ptr_stats   Statistics
+ */
+void dns_cache_get_stats(dns_cache_stats_t * ptr_stats);
+
+/**
+ *  @brief      Print cache statistics
+ */
+void dns_cache_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
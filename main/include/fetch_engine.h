@@ -0,0 +1,159 @@
+/**
+ *  @file       fetch_engine.h
+ *
+ *  @brief      Non-blocking multiplexed HTTPS fetch engine
+ *
+ *  Drives several requests at once from a single task: every request has
+ *  its own non-blocking TLS connection and the task sleeps in select()
+ *  until any of the sockets is ready. Responses are streamed to the
+ *  consumer callbacks as they arrive.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_tls.h"
+
+#include "http_resp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define FETCH_ENGINE_SLOTS_MAX      4       /**< Requests in flight at once */
+#define FETCH_ENGINE_RX_BUF_SIZE    1536    /**< Receiving buffer size (on the polling task stack) */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Request completion callback
+ *
+ *  @param[in]  err         ESP_OK if the whole response was received
+ *  @param[in]  ptr_resp    Response parser (status code, framing)
+ *  @param[in]  ptr_arg     Request argument
+ */
+typedef void (*fetch_done_cb_t)(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg);
+
+/**
+ *  @brief  Request description
+ */
+typedef struct fetch_req_s
+{
+    const char * ptr_host;          /**< Server host name */
+    int port;                       /**< Server TLS port */
+    const char * ptr_req;           /**< Raw HTTP request (must stay valid until completion) */
+    size_t req_len;                 /**< Raw HTTP request length */
+    const http_resp_cbs_t * ptr_cbs; /**< Response consumer callbacks */
+    fetch_done_cb_t done_cb;        /**< Completion callback (may be NULL) */
+    void * ptr_arg;                 /**< Callbacks argument */
+} fetch_req_t;
+
+/**
+ *  @brief  Request slot states
+ */
+typedef enum fetch_state_e
+{
+    FETCH_STATE_FREE = 0,           /**< Slot is not used */
+    FETCH_STATE_CONNECT,            /**< TCP connection or TLS handshake in progress */
+    FETCH_STATE_WRITE,              /**< Sending request */
+    FETCH_STATE_READ,               /**< Receiving response */
+} fetch_state_t;
+
+/**
+ *  @brief  Request slot
+ */
+typedef struct fetch_slot_s
+{
+    fetch_state_t state;            /**< Slot state */
+    fetch_req_t req;                /**< Request description */
+    esp_tls_cfg_t tls_cfg;          /**< esp_tls configuration of this connection */
+    esp_tls_t * ptr_tls;            /**< TLS connection */
+    char addr_str[16];              /**< Server address being connected */
+    size_t written;                 /**< Request bytes sent */
+    int64_t deadline_us;            /**< Request must complete before this time */
+    http_resp_t resp;               /**< Response parser */
+} fetch_slot_t;
+
+/**
+ *  @brief  Engine statistics
+ */
+typedef struct fetch_engine_stats_s
+{
+    uint32_t requests;              /**< Requests submitted */
+    uint32_t completed;             /**< Requests completed successfully */
+    uint32_t failed;                /**< Requests failed or timed out */
+    uint32_t wakeups;               /**< select() returns */
+    uint64_t rx_bytes;              /**< Decrypted bytes received */
+} fetch_engine_stats_t;
+
+/**
+ *  @brief  Engine context
+ */
+typedef struct fetch_engine_s
+{
+    esp_tls_cfg_t tls_cfg;          /**< esp_tls configuration template */
+    int timeout_ms;                 /**< Single request timeout */
+    fetch_slot_t slots[FETCH_ENGINE_SLOTS_MAX]; /**< Request slots */
+    fetch_engine_stats_t stats;     /**< Engine statistics */
+} fetch_engine_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Engine initialization (no network activity)
+ *
+ *  @param[out] ptr_engine  Engine context pointer
+ *  @param[in]  ptr_tls_cfg esp_tls configuration template (CA, client certificate etc.)
+ *  @param[in]  timeout_ms  Single request timeout
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t fetch_engine_init(fetch_engine_t * ptr_engine, const esp_tls_cfg_t * ptr_tls_cfg, int timeout_ms);
+
+/**
+ *  @brief      Start a request
+ *
+ *  @param[in]  ptr_engine  Engine context pointer
+ *  @param[in]  ptr_req     Request description
+ *
+ *  @return     ESP_OK on success, ESP_ERR_NO_MEM if all slots are busy
+ */
+esp_err_t fetch_engine_submit(fetch_engine_t * ptr_engine, const fetch_req_t * ptr_req);
+
+/**
+ *  @brief      Wait for socket events once and advance ready requests
+ *
+ *  @param[in]  ptr_engine  Engine context pointer
+ *  @param[in]  timeout_ms  Longest wait
+ *
+ *  @return     Requests still in flight
+ */
+uint32_t fetch_engine_poll(fetch_engine_t * ptr_engine, int timeout_ms);
+
+/**
+ *  @brief      Drive all submitted requests to completion
+ *
+ *  @param[in]  ptr_engine  Engine context pointer
+ */
+void fetch_engine_run(fetch_engine_t * ptr_engine);
+
+/**
+ *  @brief      Abort all requests in flight
+ *
+ *  @param[in]  ptr_engine  Engine context pointer
+ */
+void fetch_engine_abort(fetch_engine_t * ptr_engine);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,142 @@
+/**
+ *  @file       http_cache.h
+ *
+ *  @brief      HTTP response cache metadata (validators and freshness)
+ *
+ *  Keeps ETag / Last-Modified validators and Cache-Control freshness of
+ *  the last response, builds conditional requests and classifies the
+ *  response. The cached record itself is owned by the caller. Platform
+ *  independent: time is passed in microseconds of a monotonic clock.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define HTTP_CACHE_ETAG_MAX             72  /**< Longest kept ETag (with quotes) */
+#define HTTP_CACHE_LAST_MODIFIED_MAX    32  /**< Longest kept Last-Modified date */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Response classification
+ */
+typedef enum http_cache_result_e
+{
+    HTTP_CACHE_UPDATED = 0,     /**< New body received and cached, caller must store the record */
+    HTTP_CACHE_NOT_MODIFIED,    /**< 304 received, cached record is still valid */
+    HTTP_CACHE_UNCACHEABLE,     /**< Response must not be cached or is an error */
+} http_cache_result_t;
+
+/**
+ *  @brief  Response validators and freshness
+ */
+typedef struct http_cache_meta_s
+{
+    char etag[HTTP_CACHE_ETAG_MAX];                     /**< ETag (empty if none) */
+    char last_modified[HTTP_CACHE_LAST_MODIFIED_MAX];   /**< Last-Modified (empty if none) */
+    int64_t max_age_s;                                  /**< Cache-Control max-age (-1 if none) */
+    int64_t age_s;                                      /**< Age header value */
+    bool no_store;                                      /**< Cache-Control: no-store */
+    bool no_cache;                                      /**< Cache-Control: no-cache */
+} http_cache_meta_t;
+
+/**
+ *  @brief  Cache context
+ */
+typedef struct http_cache_s
+{
+    bool valid;                 /**< Cached record exists */
+    http_cache_meta_t meta;     /**< Metadata of cached response */
+    int64_t fresh_until_us;     /**< Cached record expiration time */
+    http_cache_meta_t pending;  /**< Metadata of response being received */
+    uint32_t hits;              /**< Requests skipped as cached record was fresh */
+    uint32_t revalidations;     /**< 304 responses */
+    uint32_t updates;           /**< Full responses */
+} http_cache_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Cache initialization (no record)
+ *
+ *  @param[out] ptr_cache   Cache context pointer
+ */
+void http_cache_init(http_cache_t * ptr_cache);
+
+/**
+ *  @brief      Check that cached record may be used without network
+ *
+ *  Counts a hit if it is so.
+ *
+ *  @param[in]  ptr_cache   Cache context pointer
+ *  @param[in]  now_us      Current time
+ *
+ *  @return     true if cached record is fresh
+ */
+bool http_cache_is_fresh(http_cache_t * ptr_cache, int64_t now_us);
+
+/**
+ *  @brief      Build request with conditional headers
+ *
+ *  @param[in]  ptr_cache   Cache context pointer
+ *  @param[in]  ptr_head    Request line and headers without terminating empty line
+ *  @param[out] ptr_buf     Request buffer
+ *  @param[in]  size        Request buffer size
+ *
+ *  @return     Request length, 0 if buffer is too small
+ */
+size_t http_cache_build_request(const http_cache_t * ptr_cache,
+                                const char * ptr_head,
+                                char * ptr_buf,
+                                size_t size);
+
+/**
+ *  @brief      Prepare for a new response
+ *
+ *  @param[in]  ptr_cache   Cache context pointer
+ */
+void http_cache_response_begin(http_cache_t * ptr_cache);
+
+/**
+ *  @brief      Response header processing (call from HTTP header callback)
+ *
+ *  @param[in]  ptr_cache   Cache context pointer
+ *  @param[in]  ptr_name    Header name
+ *  @param[in]  ptr_value   Header value
+ */
+void http_cache_header(http_cache_t * ptr_cache, const char * ptr_name, const char * ptr_value);
+
+/**
+ *  @brief      Complete response processing
+ *
+ *  @param[in]  ptr_cache   Cache context pointer
+ *  @param[in]  status      Response status code
+ *  @param[in]  now_us      Response receiving time
+ *
+ *  @return     Response classification
+ */
+http_cache_result_t http_cache_response_end(http_cache_t * ptr_cache, int status, int64_t now_us);
+
+/**
+ *  @brief      Drop cached record (e.g. the body could not be decoded)
+ *
+ *  @param[in]  ptr_cache   Cache context pointer
+ */
+void http_cache_invalidate(http_cache_t * ptr_cache);
+
+#ifdef __cplusplus
+}
+#endif
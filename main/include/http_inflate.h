@@ -0,0 +1,124 @@
+/**
+ *  @file       http_inflate.h
+ *
+ *  @brief      Streaming gzip/deflate content decoding
+ *
+ *  Decodes Content-Encoding: gzip / deflate bodies chunk by chunk with the
+ *  ROM inflater and a fixed circular window, passing decoded bytes to the
+ *  consumer without inflating the whole body into RAM.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#include "http_resp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+/**< Accept-Encoding request header for supported codings */
+#define HTTP_INFLATE_ACCEPT_ENCODING    "Accept-Encoding: gzip, deflate\r\n"
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Content codings
+ */
+typedef enum http_inflate_coding_e
+{
+    HTTP_INFLATE_IDENTITY = 0,  /**< No coding, bytes are passed as is */
+    HTTP_INFLATE_GZIP,          /**< gzip (RFC 1952) */
+    HTTP_INFLATE_DEFLATE,       /**< zlib wrapped deflate (RFC 1950) */
+    HTTP_INFLATE_UNSUPPORTED,   /**< Unknown coding */
+} http_inflate_coding_t;
+
+/**
+ *  @brief  Decoder context
+ */
+typedef struct http_inflate_s
+{
+    http_inflate_coding_t coding;   /**< Current body coding */
+    http_resp_body_cb_t out_cb;     /**< Decoded bytes consumer */
+    void * ptr_out_arg;             /**< Decoded bytes consumer argument */
+    void * ptr_decomp;              /**< ROM inflater state */
+    uint8_t * ptr_window;           /**< Circular output window */
+    size_t window_pos;              /**< Write position in window */
+    uint8_t gzip_state;             /**< gzip header parsing state */
+    uint8_t gzip_flags;             /**< gzip header flags */
+    uint16_t gzip_skip;             /**< gzip header bytes to skip */
+    bool done;                      /**< Compressed stream is complete */
+    bool error;                     /**< Compressed stream is malformed */
+    uint64_t in_bytes;              /**< Encoded bytes received */
+    uint64_t out_bytes;             /**< Decoded bytes produced */
+} http_inflate_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Decoder initialization, allocates inflater state and window once
+ *
+ *  @param[out] ptr_inflate Decoder context pointer
+ *  @param[in]  out_cb      Decoded bytes consumer
+ *  @param[in]  ptr_out_arg Decoded bytes consumer argument
+ *
+ *  @return     ESP_OK on success, ESP_ERR_NO_MEM if allocation failed
+ */
+esp_err_t http_inflate_init(http_inflate_t * ptr_inflate, http_resp_body_cb_t out_cb, void * ptr_out_arg);
+
+/**
+ *  @brief      Decoder resources release
+ *
+ *  @param[in]  ptr_inflate Decoder context pointer
+ */
+void http_inflate_deinit(http_inflate_t * ptr_inflate);
+
+/**
+ *  @brief      Content-Encoding header value mapping
+ *
+ *  @param[in]  ptr_value   Content-Encoding header value
+ *
+ *  @return     Content coding
+ */
+http_inflate_coding_t http_inflate_coding(const char * ptr_value);
+
+/**
+ *  @brief      Prepare for a new body
+ *
+ *  @param[in]  ptr_inflate Decoder context pointer
+ *  @param[in]  coding      Body coding
+ */
+void http_inflate_begin(http_inflate_t * ptr_inflate, http_inflate_coding_t coding);
+
+/**
+ *  @brief      Decode the next body chunk (http_resp_body_cb_t compatible)
+ *
+ *  @param[in]  ptr_data    Encoded bytes pointer
+ *  @param[in]  len         Encoded bytes quantity
+ *  @param[in]  ptr_arg     Decoder context pointer
+ */
+void http_inflate_feed(const char * ptr_data, size_t len, void * ptr_arg);
+
+/**
+ *  @brief      Check that the whole body was decoded
+ *
+ *  @param[in]  ptr_inflate Decoder context pointer
+ *
+ *  @return     true if body is complete and well-formed
+ */
+bool http_inflate_finish(const http_inflate_t * ptr_inflate);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,154 @@
+/**
+ *  @file       http_resp.h
+ *
+ *  @brief      Incremental HTTP/1.1 response parser
+ *
+ *  Parses status line and headers, handles Content-Length and chunked
+ *  transfer coding and passes body bytes to the consumer as they arrive,
+ *  without buffering the whole body. Platform independent.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define HTTP_RESP_LINE_MAX  512     /**< Longest kept status/header line, the rest is dropped */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Parser states
+ */
+typedef enum http_resp_state_e
+{
+    HTTP_RESP_STATE_STATUS = 0,     /**< Status line */
+    HTTP_RESP_STATE_HEADER,         /**< Header lines */
+    HTTP_RESP_STATE_BODY_LENGTH,    /**< Body with known length */
+    HTTP_RESP_STATE_BODY_EOF,       /**< Body delimited by connection close */
+    HTTP_RESP_STATE_CHUNK_SIZE,     /**< Chunk size line */
+    HTTP_RESP_STATE_CHUNK_DATA,     /**< Chunk data */
+    HTTP_RESP_STATE_CHUNK_END,      /**< CRLF after chunk data */
+    HTTP_RESP_STATE_TRAILER,        /**< Trailer lines after last chunk */
+    HTTP_RESP_STATE_DONE,           /**< Response is complete */
+    HTTP_RESP_STATE_ERROR,          /**< Malformed response */
+} http_resp_state_t;
+
+/**
+ *  @brief  Header consumer callback
+ *
+ *  @param[in]  ptr_name    NULL-terminated header name
+ *  @param[in]  ptr_value   NULL-terminated header value without surrounding spaces
+ *  @param[in]  ptr_arg     User argument
+ */
+typedef void (*http_resp_header_cb_t)(const char * ptr_name, const char * ptr_value, void * ptr_arg);
+
+/**
+ *  @brief  Body data consumer callback
+ *
+ *  @param[in]  ptr_data    Body bytes pointer (transfer coding removed)
+ *  @param[in]  len         Body bytes quantity
+ *  @param[in]  ptr_arg     User argument
+ */
+typedef void (*http_resp_body_cb_t)(const char * ptr_data, size_t len, void * ptr_arg);
+
+/**
+ *  @brief  Response consumer callbacks (any may be NULL)
+ */
+typedef struct http_resp_cbs_s
+{
+    http_resp_header_cb_t header_cb;    /**< Called for every header */
+    http_resp_body_cb_t body_cb;        /**< Called for body bytes */
+} http_resp_cbs_t;
+
+/**
+ *  @brief  Parser context
+ */
+typedef struct http_resp_s
+{
+    http_resp_state_t state;        /**< Current state */
+    int status;                     /**< Status code */
+    bool keep_alive;                /**< Connection may be reused after response */
+    bool chunked;                   /**< Chunked transfer coding is used */
+    int64_t content_length;         /**< Content-Length value (-1 if absent) */
+    uint64_t remaining;             /**< Bytes left in the body or current chunk */
+    uint64_t body_bytes;            /**< Body bytes delivered to the consumer */
+    const http_resp_cbs_t * ptr_cbs; /**< Consumer callbacks */
+    void * ptr_arg;                 /**< Consumer callbacks argument */
+    size_t line_len;                /**< Bytes kept in line buffer */
+    bool line_overflow;             /**< Current line did not fit the buffer */
+    char line[HTTP_RESP_LINE_MAX];  /**< Line accumulation buffer */
+} http_resp_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Parser initialization for a new response
+ *
+ *  @param[out] ptr_resp    Parser context pointer
+ *  @param[in]  ptr_cbs     Consumer callbacks (may be NULL)
+ *  @param[in]  ptr_arg     Consumer callbacks argument
+ */
+void http_resp_init(http_resp_t * ptr_resp, const http_resp_cbs_t * ptr_cbs, void * ptr_arg);
+
+/**
+ *  @brief      Feed received bytes to the parser
+ *
+ *  Parsing stops as soon as the response is complete, so the bytes that
+ *  belong to the next response are not consumed.
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ *  @param[in]  ptr_data    Received bytes pointer
+ *  @param[in]  len         Received bytes quantity
+ *
+ *  @return     Consumed bytes quantity
+ */
+size_t http_resp_feed(http_resp_t * ptr_resp, const char * ptr_data, size_t len);
+
+/**
+ *  @brief      Notify the parser that the connection was closed by the server
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ *
+ *  @return     true if response is complete
+ */
+bool http_resp_eof(http_resp_t * ptr_resp);
+
+/**
+ *  @brief      Check that response is complete
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ *
+ *  @return     true if response is complete
+ */
+static inline bool http_resp_is_done(const http_resp_t * ptr_resp)
+{
+    return (HTTP_RESP_STATE_DONE == ptr_resp->state);
+}
+
+/**
+ *  @brief      Check that response is malformed
+ *
+ *  @param[in]  ptr_resp    Parser context pointer
+ *
+ *  @return     true if response cannot be parsed
+ */
+static inline bool http_resp_is_error(const http_resp_t * ptr_resp)
+{
+    return (HTTP_RESP_STATE_ERROR == ptr_resp->state);
+}
+
+#ifdef __cplusplus
+}
+#endif
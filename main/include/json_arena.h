@@ -0,0 +1,102 @@
+/**
+ *  @file       json_arena.h
+ *
+ *  @brief      Bump allocator for one parsed JSON document
+ *
+ *  Allocations are carved one after another from a fixed buffer and are
+ *  never freed one by one: the whole arena is released at once when the
+ *  document is done with. Hook adapters allow to plug the arena into
+ *  libraries with malloc/free style hooks (cJSON_InitHooks). Platform
+ *  independent.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define JSON_ARENA_ALIGN    8   /**< Allocation alignment (cJSON items hold double) */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Arena context
+ */
+typedef struct json_arena_s
+{
+    uint8_t * ptr_buf;          /**< Arena memory */
+    size_t size;                /**< Arena memory size */
+    size_t used;                /**< Bytes taken in current scope */
+    uint32_t allocs;            /**< Allocations in current scope */
+    size_t high_water;          /**< Most bytes ever taken in one scope */
+    uint32_t scopes;            /**< Scopes ended */
+    uint32_t failures;          /**< Allocations not fitted */
+} json_arena_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Arena initialization
+ *
+ *  @param[out] ptr_arena   Arena context pointer
+ *  @param[in]  ptr_buf     Arena memory (owned by caller)
+ *  @param[in]  size        Arena memory size
+ */
+void json_arena_init(json_arena_t * ptr_arena, void * ptr_buf, size_t size);
+
+/**
+ *  @brief      Allocate from arena
+ *
+ *  @param[in]  ptr_arena   Arena context pointer
+ *  @param[in]  size        Bytes quantity
+ *
+ *  @return     Memory pointer, NULL if arena is exhausted
+ */
+void * json_arena_alloc(json_arena_t * ptr_arena, size_t size);
+
+/**
+ *  @brief      Start scope: arena becomes the target of hook adapters
+ *
+ *  Only one arena may be in scope at a time.
+ *
+ *  @param[in]  ptr_arena   Arena context pointer
+ */
+void json_arena_begin(json_arena_t * ptr_arena);
+
+/**
+ *  @brief      End scope and release everything allocated in it, O(1)
+ *
+ *  @param[in]  ptr_arena   Arena context pointer
+ */
+void json_arena_end(json_arena_t * ptr_arena);
+
+/**
+ *  @brief      malloc() style hook, allocates from the arena in scope
+ *
+ *  @param[in]  size        Bytes quantity
+ *
+ *  @return     Memory pointer, NULL if arena is exhausted or not in scope
+ */
+void * json_arena_malloc(size_t size);
+
+/**
+ *  @brief      free() style hook, memory is returned when scope ends
+ *
+ *  @param[in]  ptr         Memory pointer
+ */
+void json_arena_free(void * ptr);
+
+#ifdef __cplusplus
+}
+#endif
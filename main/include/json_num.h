@@ -0,0 +1,50 @@
+/**
+ *  @file       json_num.h
+ *
+ *  @brief      Integer-only JSON number decoder
+ *
+ *  Decodes JSON number text straight into an integer scaled by a power of
+ *  ten (decidegrees, mm Hg * 10, m/s * 10 etc.) without floating point
+ *  and libm, which are software emulated on FPU-less cores. Platform
+ *  independent.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define JSON_NUM_DIGITS_MAX     19  /**< Significant digits kept (any int64_t), the rest are dropped */
+#define JSON_NUM_SCALE_MAX      9   /**< Largest decimal scale */
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Decode JSON number scaled by 10^scale
+ *
+ *  "-2.45" with scale 1 gives -25: the result is rounded half away from
+ *  zero. Exponent notation is accepted.
+ *
+ *  @param[in]  ptr_text    Number text (as written in document)
+ *  @param[in]  len         Number text length
+ *  @param[in]  scale       Decimal digits kept after the point (0..JSON_NUM_SCALE_MAX)
+ *  @param[out] ptr_value   Scaled value
+ *
+ *  @return     false if text is not a JSON number or scaled value overflows int64_t
+ */
+bool json_num_scaled(const char * ptr_text, size_t len, uint8_t scale, int64_t * ptr_value);
+
+#ifdef __cplusplus
+}
+#endif
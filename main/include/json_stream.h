@@ -0,0 +1,141 @@
+/**
+ *  @file       json_stream.h
+ *
+ *  @brief      Resumable SAX-style JSON tokenizer
+ *
+ *  Accepts the document in arbitrary chunks (e.g. straight from the
+ *  socket) and reports every scalar value together with its path, like
+ *  "fact.temp" or "forecasts[0].parts.day.temp_avg". Memory use is fixed
+ *  and does not depend on the document size. Platform independent.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define JSON_STREAM_DEPTH_MAX   16  /**< Deepest tracked nesting level */
+#define JSON_STREAM_PATH_MAX    96  /**< Longest tracked value path */
+#define JSON_STREAM_VALUE_MAX   64  /**< Longest reported scalar value */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Scalar value types
+ */
+typedef enum json_stream_type_e
+{
+    JSON_STREAM_STRING = 0,     /**< String (unescaped, UTF-8) */
+    JSON_STREAM_NUMBER,         /**< Number (as written in document) */
+    JSON_STREAM_TRUE,           /**< true literal */
+    JSON_STREAM_FALSE,          /**< false literal */
+    JSON_STREAM_NULL,           /**< null literal */
+} json_stream_type_t;
+
+/**
+ *  @brief  Scalar value consumer callback
+ *
+ *  Values and paths that do not fit the buffers are not reported.
+ *
+ *  @param[in]  ptr_path    NULL-terminated value path
+ *  @param[in]  type        Value type
+ *  @param[in]  ptr_value   NULL-terminated value text
+ *  @param[in]  len         Value text length
+ *  @param[in]  ptr_arg     User argument
+ */
+typedef void (*json_stream_value_cb_t)(const char * ptr_path,
+                                       json_stream_type_t type,
+                                       const char * ptr_value,
+                                       size_t len,
+                                       void * ptr_arg);
+
+/**
+ *  @brief  Tokenizer states
+ */
+typedef enum json_stream_state_e
+{
+    JSON_STREAM_STATE_VALUE = 0,    /**< Value expected */
+    JSON_STREAM_STATE_KEY_OR_END,   /**< Key or '}' expected */
+    JSON_STREAM_STATE_VALUE_OR_END, /**< Value or ']' expected */
+    JSON_STREAM_STATE_KEY,          /**< Key expected */
+    JSON_STREAM_STATE_COLON,        /**< ':' expected */
+    JSON_STREAM_STATE_NEXT,         /**< ',' or container end expected */
+    JSON_STREAM_STATE_STRING,       /**< Inside string */
+    JSON_STREAM_STATE_ESCAPE,       /**< After '\' inside string */
+    JSON_STREAM_STATE_UNICODE,      /**< Inside \\uXXXX escape */
+    JSON_STREAM_STATE_NUMBER,       /**< Inside number */
+    JSON_STREAM_STATE_LITERAL,      /**< Inside true/false/null */
+    JSON_STREAM_STATE_DONE,         /**< Document is complete */
+    JSON_STREAM_STATE_ERROR,        /**< Malformed document */
+} json_stream_state_t;
+
+/**
+ *  @brief  Tokenizer context
+ */
+typedef struct json_stream_s
+{
+    json_stream_state_t state;              /**< Current state */
+    json_stream_value_cb_t value_cb;        /**< Scalar value consumer */
+    void * ptr_arg;                         /**< Scalar value consumer argument */
+    uint8_t depth;                          /**< Current nesting level */
+    bool is_key;                            /**< String being read is an object key */
+    bool path_overflow;                     /**< Path of current value did not fit the buffer */
+    bool value_overflow;                    /**< Current value did not fit the buffer */
+    json_stream_type_t literal;             /**< Literal being read */
+    uint8_t literal_pos;                    /**< Matched literal characters */
+    uint8_t unicode_digits;                 /**< Hex digits read in \\uXXXX escape */
+    uint32_t unicode;                       /**< Code point being decoded */
+    uint32_t surrogate;                     /**< Pending high surrogate */
+    bool is_array[JSON_STREAM_DEPTH_MAX];   /**< Container type on every level */
+    uint32_t index[JSON_STREAM_DEPTH_MAX];  /**< Array element index on every level */
+    uint8_t path_len[JSON_STREAM_DEPTH_MAX + 1]; /**< Path length at every level start */
+    size_t value_len;                       /**< Bytes in value buffer */
+    char path[JSON_STREAM_PATH_MAX];        /**< Current path */
+    char value[JSON_STREAM_VALUE_MAX];      /**< Current value or key */
+} json_stream_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Tokenizer initialization for a new document
+ *
+ *  @param[out] ptr_json    Tokenizer context pointer
+ *  @param[in]  value_cb    Scalar value consumer
+ *  @param[in]  ptr_arg     Scalar value consumer argument
+ */
+void json_stream_init(json_stream_t * ptr_json, json_stream_value_cb_t value_cb, void * ptr_arg);
+
+/**
+ *  @brief      Feed the next chunk of the document
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  ptr_data    Document bytes pointer
+ *  @param[in]  len         Document bytes quantity
+ *
+ *  @return     false if document is malformed
+ */
+bool json_stream_feed(json_stream_t * ptr_json, const char * ptr_data, size_t len);
+
+/**
+ *  @brief      Notify the tokenizer that the document has ended
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *
+ *  @return     true if the document is complete and well-formed
+ */
+bool json_stream_finish(json_stream_t * ptr_json);
+
+#ifdef __cplusplus
+}
+#endif
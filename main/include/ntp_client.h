@@ -0,0 +1,92 @@
+/**
+ *  @file       ntp_client.h
+ *
+ *  @brief      Parallel NTP query of several servers with best-sample selection
+ *
+ *  One request is sent to every server at once over a single UDP socket
+ *  and replies are collected until a majority of servers or two agreeing
+ *  ones answered, or the deadline passed, so a slow or lossy server does
+ *  not set the time to sync. Samples are filtered as NTP does: a sample whose correctness
+ *  interval (offset +- root distance) does not overlap those of the
+ *  majority is a falseticker; the survivor with the shortest round trip
+ *  wins. Uses BSD sockets only (lwIP on the target, the host stack in
+ *  host builds).
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <netinet/in.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define NTP_CLIENT_SERVERS_MAX  4       /**< Servers queried at once */
+#define NTP_CLIENT_PORT         123     /**< NTP server port */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Time sample of one server
+ */
+typedef struct ntp_sample_s
+{
+    bool is_valid;              /**< Reply received and sane */
+    bool is_truechimer;         /**< Sample agrees with the majority */
+    uint8_t stratum;            /**< Server stratum */
+    int64_t offset_us;          /**< Server clock minus local clock */
+    int64_t delay_us;           /**< Round trip without server processing */
+    int64_t distance_us;        /**< Root distance: half of delays plus dispersion */
+    int64_t reply_us;           /**< Local time the reply was received after the requests were sent */
+} ntp_sample_t;
+
+/**
+ *  @brief  Query result
+ */
+typedef struct ntp_result_s
+{
+    ntp_sample_t samples[NTP_CLIENT_SERVERS_MAX];   /**< Samples in server order */
+    size_t servers_qty;                             /**< Servers queried */
+    uint32_t answered;                              /**< Valid replies */
+    uint32_t rejected;                              /**< Servers that replied unsynchronized or with a kiss-o'-death */
+    int best;                                       /**< Selected sample index, -1 if none */
+    int64_t elapsed_us;                             /**< Query duration */
+} ntp_result_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Local wall clock, microseconds since the Unix epoch
+ *
+ *  @return     Current time
+ */
+int64_t ntp_client_now_us(void);
+
+/**
+ *  @brief      Query servers in parallel and select the best sample
+ *
+ *  @param[in]  ptr_servers Server addresses (port included)
+ *  @param[in]  qty         Servers quantity (up to NTP_CLIENT_SERVERS_MAX)
+ *  @param[in]  deadline_ms Longest query duration
+ *  @param[out] ptr_result  Result pointer
+ *
+ *  @return     Selected sample, NULL if no server answered in time
+ */
+const ntp_sample_t * ntp_client_query(const struct sockaddr_in * ptr_servers,
+                                      size_t qty,
+                                      uint32_t deadline_ms,
+                                      ntp_result_t * ptr_result);
+
+#ifdef __cplusplus
+}
+#endif
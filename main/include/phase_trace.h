@@ -0,0 +1,113 @@
+/**
+ *  @file       phase_trace.h
+ *
+ *  @brief      Boot and fetch phase timeline
+ *
+ *  A phase mark is a stamp of the monotonic clock taken when the phase
+ *  ends. Marks go to a fixed ring buffer, so the latest fetches can
+ *  always be inspected, and the first mark of every phase is kept
+ *  aside as the boot timeline. Marking is lock-free and may be done
+ *  from any task. Platform independent: the clock is given at init,
+ *  esp_timer on the device and a simulated clock on the host.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define PHASE_TRACE_SIZE    64      /**< Ring buffer marks (a fetch takes about 8) */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Phases, in the order of a cold boot
+ */
+typedef enum phase_trace_id_e
+{
+    PHASE_TRACE_NVS_INIT = 0,   /**< NVS is initialized */
+    PHASE_TRACE_WIFI_START,     /**< Wi-Fi driver is started */
+    PHASE_TRACE_ASSOCIATED,     /**< Station is associated with the access point */
+    PHASE_TRACE_GOT_IP,         /**< IP address is obtained */
+    PHASE_TRACE_TIME_VALID,     /**< System time is valid */
+    PHASE_TRACE_DNS,            /**< Server address is resolved */
+    PHASE_TRACE_CONNECT,        /**< TCP connection and TLS handshake are done */
+    PHASE_TRACE_REQUEST_SENT,   /**< Requests are written */
+    PHASE_TRACE_FIRST_BYTE,     /**< First response byte is received */
+    PHASE_TRACE_LAST_BYTE,      /**< Last response byte is received */
+    PHASE_TRACE_PARSE_DONE,     /**< Response is decoded */
+    PHASE_TRACE_DISPLAY_DONE,   /**< Changes are displayed */
+    PHASE_TRACE_QTY,
+} phase_trace_id_t;
+
+/**
+ *  @brief  Monotonic clock, microseconds
+ */
+typedef int64_t (*phase_trace_clock_t)(void);
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Tracer initialization, all marks are dropped
+ *
+ *  @param[in]  clock       Monotonic clock
+ */
+void phase_trace_init(phase_trace_clock_t clock);
+
+/**
+ *  @brief      Phase end mark
+ *
+ *  @param[in]  id          Phase
+ */
+void phase_trace_mark(phase_trace_id_t id);
+
+/**
+ *  @brief      First mark of the phase (boot timeline)
+ *
+ *  @param[in]  id          Phase
+ *  @param[out] ptr_us      Clock value of the mark
+ *
+ *  @return     true if the phase was marked
+ */
+bool phase_trace_first(phase_trace_id_t id, int64_t * ptr_us);
+
+/**
+ *  @brief      Phase name
+ *
+ *  @param[in]  id          Phase
+ *
+ *  @return     Name, e.g. "got_ip"
+ */
+const char * phase_trace_name(phase_trace_id_t id);
+
+/**
+ *  @brief      Boot timeline and the ring buffer as text, one mark per line
+ *
+ *  @param[in]  ptr_file    Output stream
+ */
+void phase_trace_dump(FILE * ptr_file);
+
+/**
+ *  @brief      Boot timeline and the ring buffer as one JSON line
+ *
+ *  {"boot":{"nvs_init":us,...},"recent":[["dns",us],...]}, phases that
+ *  were not marked are left out of "boot".
+ *
+ *  @param[in]  ptr_file    Output stream
+ */
+void phase_trace_json(FILE * ptr_file);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,60 @@
+/**
+ *  @file       time_checkpoint.h
+ *
+ *  @brief      System time checkpoint kept across resets
+ *
+ *  A checkpoint is the system time, the RTC timer value of the same
+ *  moment and the largest error of that time. The RTC memory copy
+ *  survives every reset but power loss and the RTC timer keeps counting
+ *  meanwhile, so the time is restored with an error grown only by the RTC
+ *  clock inaccuracy over the elapsed time. The NVS copy survives power
+ *  loss, but the time spent powered off is unknown: it gives a lower
+ *  bound of the time only, still enough for certificate validity checks.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define TIME_CHECKPOINT_ERROR_UNKNOWN   (-1)    /**< Time is a lower bound only */
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Checkpoint of the current system time
+ *
+ *  @param[in]  error_us    Largest error of the system time now, TIME_CHECKPOINT_ERROR_UNKNOWN if unknown
+ *  @param[in]  is_durable  Write to NVS as well (survives power loss, wears flash)
+ *
+ *  @return     ESP_OK on success, NVS error otherwise
+ */
+esp_err_t time_checkpoint_save(int64_t error_us, bool is_durable);
+
+/**
+ *  @brief      Current time estimate from the last checkpoint
+ *
+ *  RTC memory copy is used if it is valid, NVS copy otherwise.
+ *
+ *  @param[out] ptr_wall_us     Time estimate, microseconds since the Unix epoch
+ *  @param[out] ptr_error_us    Largest error of the estimate, TIME_CHECKPOINT_ERROR_UNKNOWN if unknown
+ *
+ *  @return     ESP_OK on success, ESP_ERR_NOT_FOUND if there is no checkpoint
+ */
+esp_err_t time_checkpoint_restore(int64_t * ptr_wall_us, int64_t * ptr_error_us);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,118 @@
+/**
+ *  @file       time_source.h
+ *
+ *  @brief      Reference time estimate from samples of known accuracy
+ *
+ *  A sample is an interval the reference time certainly lies in at a
+ *  moment of the monotonic local clock: an NTP reply gives offset +- root
+ *  distance, an HTTP Date header gives one second of resolution plus the
+ *  request round trip. The kept interval is widened by the local clock
+ *  rate error bound as time goes and intersected with every new sample,
+ *  so Date headers with different sub-second phases narrow it down.
+ *  Platform independent: times are passed in microseconds.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define TIME_SOURCE_DRIFT_PPB   100000  /**< Local clock rate error bound while none is learned (100 ppm) */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Estimate context
+ */
+typedef struct time_source_s
+{
+    bool is_valid;              /**< Any sample is kept */
+    int64_t local_us;           /**< Local time of the last sample */
+    int64_t earliest_us;        /**< Reference time lower bound at local_us */
+    int64_t latest_us;          /**< Reference time upper bound at local_us */
+    uint32_t samples;           /**< Samples taken */
+    uint32_t conflicts;         /**< Samples that did not overlap the estimate and replaced it */
+    uint32_t drift_ppb;         /**< Local clock rate error bound the interval is widened by */
+} time_source_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Estimate initialization (no samples)
+ *
+ *  @param[out] ptr_source  Estimate context pointer
+ */
+void time_source_init(time_source_t * ptr_source);
+
+/**
+ *  @brief      Local clock rate error bound
+ *
+ *  Replaces TIME_SOURCE_DRIFT_PPB once the rate error is measured, e.g.
+ *  the learned drift with its uncertainty. Applies to the kept interval
+ *  as well.
+ *
+ *  @param[in]  ptr_source  Estimate context pointer
+ *  @param[in]  drift_ppb   Largest rate error of the local clock, ppb
+ */
+void time_source_set_drift(time_source_t * ptr_source, uint32_t drift_ppb);
+
+/**
+ *  @brief      Interval sample
+ *
+ *  @param[in]  ptr_source  Estimate context pointer
+ *  @param[in]  earliest_us Reference time lower bound, microseconds since the Unix epoch
+ *  @param[in]  latest_us   Reference time upper bound
+ *  @param[in]  local_us    Monotonic local time of the same moment (not older than the last sample)
+ */
+void time_source_add(time_source_t * ptr_source, int64_t earliest_us, int64_t latest_us, int64_t local_us);
+
+/**
+ *  @brief      HTTP Date header sample
+ *
+ *  The server stamps the Date between the request was sent and the
+ *  response header was received, truncated to whole seconds.
+ *
+ *  @param[in]  ptr_source  Estimate context pointer
+ *  @param[in]  ptr_date    Date header value (IMF-fixdate)
+ *  @param[in]  sent_us     Local time the request was sent
+ *  @param[in]  received_us Local time the response header was received
+ *
+ *  @return     true if the date is parsed and the sample taken
+ */
+bool time_source_add_http_date(time_source_t * ptr_source, const char * ptr_date, int64_t sent_us, int64_t received_us);
+
+/**
+ *  @brief      Reference time estimate
+ *
+ *  @param[in]  ptr_source  Estimate context pointer
+ *  @param[in]  local_us    Monotonic local time of the estimate
+ *  @param[out] ptr_ref_us  Reference time (middle of the interval)
+ *  @param[out] ptr_error_us Largest error of the reference time
+ *
+ *  @return     false if there are no samples
+ */
+bool time_source_estimate(const time_source_t * ptr_source, int64_t local_us, int64_t * ptr_ref_us, int64_t * ptr_error_us);
+
+/**
+ *  @brief      HTTP date parsing
+ *
+ *  @param[in]  ptr_date    IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+ *  @param[out] ptr_unix_s  Seconds since the Unix epoch
+ *
+ *  @return     true if the date is valid
+ */
+bool time_source_parse_http_date(const char * ptr_date, int64_t * ptr_unix_s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,21 +5,73 @@
  */
 #pragma once
 
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+#include "clock_drift.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 /**
- * @brief Update the system time from time stored in NVS.
+ * @brief Start the time sync task.
+ *
+ * The drift model is restored from NVS. Syncs are scheduled by the model:
+ * the interval grows while the drift corrected clock stays within the
+ * error bound. Servers are queried in parallel: the one the DHCP lease
+ * provides and the public pools, the best sample sets the clock. Must be
+ * called before Wi-Fi is started and before any other function of this module.
  */
+esp_err_t time_sync_init(const clock_drift_cfg_t *cfg);
 
-esp_err_t update_time_from_nvs(void);
+/**
+ * @brief Restore the system time from the last checkpoint, after any reset.
+ *
+ * Checkpoints of the time and its error are kept in RTC memory every minute
+ * and in NVS hourly and after every sync. After a reset other than power-on
+ * the time is restored with a bounded error. After power-on the NVS copy
+ * only gives a lower bound, which is still enough for certificate validity
+ * checks. The clock is left as is if it is already consistent with the
+ * checkpoint.
+ *
+ * @return ESP_OK if the time is known within the error bound,
+ *         ESP_ERR_INVALID_STATE if it is set but must be synced,
+ *         ESP_ERR_NOT_FOUND if there is no checkpoint.
+ */
+esp_err_t time_sync_restore(void);
 
 /**
- * @brief Fetch the current time from SNTP and stores it in NVS.
+ * @brief Request fetching the current time from NTP servers and storing it in NVS.
+ *
+ * Only signals the time sync task, so it returns in microseconds and may be
+ * used as an esp_timer callback.
  */
 void fetch_and_store_time_in_nvs(void*);
 
+/**
+ * @brief Take the Date header of an HTTPS response as a time sample.
+ *
+ * The sample is accurate to a second plus the round trip. While recent
+ * samples keep the time within the error bound, scheduled syncs use them
+ * and no NTP exchange is made.
+ *
+ * @param date        Date header value
+ * @param sent_us     esp_timer time the request was sent
+ * @param received_us esp_timer time the response header was received
+ */
+void time_sync_http_date(const char *date, int64_t sent_us, int64_t received_us);
+
+/**
+ * @brief Set bits of an application event group on every completed sync.
+ *
+ * Lets the application wait for a valid time together with its other
+ * startup dependencies.
+ */
+void time_sync_set_notify(EventGroupHandle_t group, EventBits_t bits);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,69 @@
+/**
+ *  @file       tls_session.h
+ *
+ *  @brief      TLS client session persistence in NVS
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_tls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Restore TLS client session saved in NVS
+ *
+ *  @param[in]  ptr_key         NVS key of the session
+ *  @param[out] pptr_session    Restored session (free with esp_tls_free_client_session())
+ *
+ *  @return     ESP_OK on success, ESP_ERR_NVS_NOT_FOUND if nothing is saved
+ */
+esp_err_t tls_session_load(const char * ptr_key, esp_tls_client_session_t ** pptr_session);
+
+/**
+ *  @brief      Serialize TLS client session and save it in NVS
+ *
+ *  @param[in]  ptr_key         NVS key of the session
+ *  @param[in]  ptr_session     Session to save
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t tls_session_store(const char * ptr_key, const esp_tls_client_session_t * ptr_session);
+
+/**
+ *  @brief      Remove TLS client session from NVS
+ *
+ *  @param[in]  ptr_key         NVS key of the session
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t tls_session_erase(const char * ptr_key);
+
+/**
+ *  @brief      Check that the handshake resumed the offered session
+ *
+ *  An offered session ID or ticket may be rejected by the server, which
+ *  then silently performs a full handshake. Only a resumed session keeps
+ *  the master secret of the offered one (TLS 1.2).
+ *
+ *  @param[in]  ptr_offered     Session offered in the handshake (may be NULL)
+ *  @param[in]  ptr_session     Session of the established connection (may be NULL)
+ *
+ *  @return     true if the session was resumed
+ */
+bool tls_session_is_resumed(const esp_tls_client_session_t * ptr_offered, const esp_tls_client_session_t * ptr_session);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,183 @@
+/**
+ *  @file       weather_change.h
+ *
+ *  @brief      Change detection of decoded weather and change-only notification
+ *
+ *  A snapshot keeps the last record of a location and its fingerprint
+ *  (FNV-1a of the canonical record). Every new record is diffed against
+ *  the snapshot field by field and each consumer is notified only of the
+ *  changed fields it subscribed to; unchanged records reach nobody.
+ *  Counters tell how much work was skipped. Data too large to keep a
+ *  previous copy of (the forecast model) is gated by fingerprint only.
+ *  Platform independent.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "weather_record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define WEATHER_CHANGE_HASH_SEED        2166136261U /**< FNV-1a offset basis */
+#define WEATHER_CHANGE_CONSUMERS_MAX    4           /**< Consumers of one change context */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Last delivered record of a location
+ */
+typedef struct weather_snapshot_s
+{
+    weather_record_t record;    /**< Record in canonical form */
+    uint32_t fingerprint;       /**< Record fingerprint */
+    bool is_valid;              /**< Snapshot holds a record */
+} weather_snapshot_t;
+
+/**
+ *  @brief      Consumer notification
+ *
+ *  @param[in]  index           Location index
+ *  @param[in]  ptr_snapshot    Snapshot with the new record
+ *  @param[in]  changed         WEATHER_RECORD_* flags of changed fields the consumer subscribed to
+ *  @param[in]  ptr_arg         Consumer argument
+ */
+typedef void (*weather_change_cb_t)(size_t index,
+                                    const weather_snapshot_t * ptr_snapshot,
+                                    uint16_t changed,
+                                    void * ptr_arg);
+
+/**
+ *  @brief  Consumer subscription and its counters
+ */
+typedef struct weather_consumer_s
+{
+    const char * ptr_name;      /**< Name for statistics */
+    weather_change_cb_t cb;     /**< Notification callback */
+    void * ptr_arg;             /**< Callback argument */
+    uint16_t fields;            /**< WEATHER_RECORD_* flags the consumer uses */
+    uint32_t notified;          /**< Notifications */
+    uint32_t skipped;           /**< Records not delivered as none of the consumer fields changed */
+    uint32_t fields_sent;       /**< Changed fields delivered */
+    uint32_t fields_skipped;    /**< Unchanged fields not delivered */
+} weather_consumer_t;
+
+/**
+ *  @brief  Change detection context
+ */
+typedef struct weather_change_s
+{
+    weather_consumer_t consumers[WEATHER_CHANGE_CONSUMERS_MAX];
+    size_t consumers_qty;
+    uint32_t updates;           /**< Records checked */
+    uint32_t unchanged;         /**< Records equal to the snapshot */
+} weather_change_t;
+
+/**
+ *  @brief  Fingerprint gate of data that is not diffed
+ */
+typedef struct weather_fingerprint_s
+{
+    uint32_t value;             /**< Fingerprint of the last changed data */
+    bool is_valid;              /**< Fingerprint is set */
+    uint32_t changes;           /**< Checks with changed data */
+    uint32_t repeats;           /**< Checks with the same data */
+} weather_fingerprint_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      FNV-1a hash
+ *
+ *  @param[in]  ptr_data    Data pointer
+ *  @param[in]  len         Data length
+ *  @param[in]  hash        WEATHER_CHANGE_HASH_SEED or hash of the preceding data
+ *
+ *  @return     Hash
+ */
+uint32_t weather_change_hash(const void * ptr_data, size_t len, uint32_t hash);
+
+/**
+ *  @brief      Record fingerprint, independent of values of fields that are not parsed
+ *
+ *  @param[in]  ptr_record  Record pointer
+ *
+ *  @return     Fingerprint
+ */
+uint32_t weather_record_fingerprint(const weather_record_t * ptr_record);
+
+/**
+ *  @brief      Change context initialization (no consumers)
+ *
+ *  @param[out] ptr_change  Change context pointer
+ */
+void weather_change_init(weather_change_t * ptr_change);
+
+/**
+ *  @brief      Consumer subscription
+ *
+ *  @param[in]  ptr_change  Change context pointer
+ *  @param[in]  ptr_name    Consumer name
+ *  @param[in]  fields      WEATHER_RECORD_* flags the consumer uses
+ *  @param[in]  cb          Notification callback
+ *  @param[in]  ptr_arg     Callback argument
+ *
+ *  @return     false if there are too many consumers
+ */
+bool weather_change_subscribe(weather_change_t * ptr_change,
+                              const char * ptr_name,
+                              uint16_t fields,
+                              weather_change_cb_t cb,
+                              void * ptr_arg);
+
+/**
+ *  @brief      Snapshot initialization, with a record known to consumers or empty
+ *
+ *  @param[out] ptr_snapshot    Snapshot pointer
+ *  @param[in]  ptr_record      Record pointer (restored from storage), NULL for none
+ */
+void weather_snapshot_init(weather_snapshot_t * ptr_snapshot, const weather_record_t * ptr_record);
+
+/**
+ *  @brief      Check new record against the snapshot and notify consumers of the changes
+ *
+ *  Every field of the first record is changed. The snapshot takes the
+ *  new record before consumers are called.
+ *
+ *  @param[in]  ptr_change      Change context pointer
+ *  @param[in]  ptr_snapshot    Location snapshot pointer
+ *  @param[in]  index           Location index (passed to consumers)
+ *  @param[in]  ptr_record      New record pointer
+ *
+ *  @return     WEATHER_RECORD_* flags of changed fields, 0 if nothing changed
+ */
+uint16_t weather_change_update(weather_change_t * ptr_change,
+                               weather_snapshot_t * ptr_snapshot,
+                               size_t index,
+                               const weather_record_t * ptr_record);
+
+/**
+ *  @brief      Check data against the last fingerprint
+ *
+ *  @param[in]  ptr_gate    Fingerprint gate pointer
+ *  @param[in]  ptr_data    Data pointer (deterministic bytes, padding included)
+ *  @param[in]  len         Data length
+ *
+ *  @return     true if data changed since the last check
+ */
+bool weather_fingerprint_update(weather_fingerprint_t * ptr_gate, const void * ptr_data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,156 @@
+/**
+ *  @file       weather_conn.h
+ *
+ *  @brief      Persistent keep-alive TLS connection manager
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+#include "esp_tls.h"
+
+#include "http_resp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define WEATHER_CONN_RX_BUF_SIZE    1536    /**< Receiving buffer size */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Response start callback (consumer must drop partial data of previous attempt)
+ *
+ *  @param[in]  ptr_arg     Request argument
+ */
+typedef void (*weather_conn_begin_cb_t)(void * ptr_arg);
+
+/**
+ *  @brief  Request completion callback (called once per request)
+ *
+ *  @param[in]  err         ESP_OK if the whole response was received
+ *  @param[in]  ptr_resp    Response parser (status code, framing)
+ *  @param[in]  ptr_arg     Request argument
+ */
+typedef void (*weather_conn_done_cb_t)(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg);
+
+/**
+ *  @brief  Pipelined request description
+ */
+typedef struct weather_conn_req_s
+{
+    const char * ptr_req;           /**< Raw HTTP request */
+    size_t req_len;                 /**< Raw HTTP request length */
+    const http_resp_cbs_t * ptr_cbs; /**< Response consumer callbacks */
+    weather_conn_begin_cb_t begin_cb; /**< Response start callback (may be NULL) */
+    weather_conn_done_cb_t done_cb; /**< Completion callback (may be NULL) */
+    void * ptr_arg;                 /**< Callbacks argument */
+} weather_conn_req_t;
+
+/**
+ *  @brief  Connection configuration
+ */
+typedef struct weather_conn_cfg_s
+{
+    const char * ptr_host;          /**< Server host name */
+    int port;                       /**< Server TLS port */
+    const unsigned char * ptr_cacert; /**< Root certificate buffer (NULL to use esp_tls global CA store) */
+    size_t cacert_bytes;            /**< Root certificate buffer size */
+    int timeout_ms;                 /**< Network operation timeout */
+    int64_t idle_timeout_us;        /**< Idle period after which connection is considered closed by server */
+    const char * ptr_session_key;   /**< NVS key to persist TLS session (NULL to keep it in RAM only) */
+} weather_conn_cfg_t;
+
+/**
+ *  @brief  Connection statistics
+ */
+typedef struct weather_conn_stats_s
+{
+    uint32_t requests;              /**< Requests issued */
+    uint32_t handshakes;            /**< Connection setups performed */
+    uint32_t offers;                /**< Connection setups offering saved TLS session */
+    uint32_t resumptions;           /**< Connection setups where the server resumed the offered session */
+    uint32_t reuses;                /**< Requests sent over an already opened connection */
+    uint32_t server_closes;         /**< Connections found closed by the server */
+    uint32_t idle_expires;          /**< Connections dropped after idle timeout */
+    uint32_t pipelined;             /**< Requests sent before the previous response was received */
+    int64_t handshake_us_total;     /**< Total time spent in connection setup */
+    int64_t resumption_us_total;    /**< Part of handshake_us_total spent in resumed setups */
+} weather_conn_stats_t;
+
+/**
+ *  @brief  Connection context
+ */
+typedef struct weather_conn_s
+{
+    weather_conn_cfg_t cfg;         /**< Connection configuration */
+    esp_tls_cfg_t tls_cfg;          /**< esp_tls configuration */
+    esp_tls_t * ptr_tls;            /**< Opened TLS connection (NULL if not connected) */
+    char addr_str[16];              /**< Server address being connected */
+    esp_tls_client_session_t * ptr_session; /**< TLS session for abbreviated handshake (NULL if none) */
+    int64_t last_used_us;           /**< Last successful exchange timestamp */
+    int64_t sent_us;                /**< Time the last requests started to be written */
+    bool keep_alive;                /**< Server allowed to reuse the connection */
+    http_resp_t resp;               /**< Last response parser (status code, framing) */
+    weather_conn_stats_t stats;     /**< Connection statistics */
+} weather_conn_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Connection context initialization (no network activity)
+ *
+ *  Restores TLS session saved in NVS if persistence is enabled.
+ *
+ *  @param[out] ptr_conn    Connection context pointer
+ *  @param[in]  ptr_cfg     Connection configuration pointer
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t weather_conn_init(weather_conn_t * ptr_conn, const weather_conn_cfg_t * ptr_cfg);
+
+/**
+ *  @brief      Send several requests at once and stream responses in order
+ *
+ *  All requests are written before the first response is read (HTTP/1.1
+ *  pipelining). If the server closes the connection early, requests left
+ *  without response are sent again over a new connection.
+ *
+ *  @param[in]  ptr_conn    Connection context pointer
+ *  @param[in]  ptr_reqs    Requests
+ *  @param[in]  reqs_qty    Requests quantity
+ *
+ *  @return     ESP_OK if all responses were received
+ */
+esp_err_t weather_conn_pipeline(weather_conn_t * ptr_conn,
+                                const weather_conn_req_t * ptr_reqs,
+                                size_t reqs_qty);
+
+/**
+ *  @brief      Close connection if opened
+ *
+ *  @param[in]  ptr_conn    Connection context pointer
+ */
+void weather_conn_close(weather_conn_t * ptr_conn);
+
+/**
+ *  @brief      Print connection reuse statistics
+ *
+ *  @param[in]  ptr_conn    Connection context pointer
+ */
+void weather_conn_log_stats(const weather_conn_t * ptr_conn);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,117 @@
+/**
+ *  @file       weather_extract.h
+ *
+ *  @brief      Weather fields extractor driven by a constant key-path table
+ *
+ *  Every scalar reported by the streaming tokenizer is looked up in a
+ *  compile-time table of JSON paths and stored straight into the packed
+ *  weather record. No heap is used. Platform independent.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json_stream.h"
+#include "weather_record.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Stored value kinds
+ */
+typedef enum weather_value_e
+{
+    WEATHER_VALUE_INT = 0,          /**< JSON number rounded to integer */
+    WEATHER_VALUE_TENTHS,           /**< JSON number multiplied by 10 */
+    WEATHER_VALUE_CONDITION,        /**< Condition code string into weather_condition_t */
+    WEATHER_VALUE_WIND_DIR,         /**< Wind direction string into weather_wind_dir_t */
+    WEATHER_VALUE_PART,             /**< Part of the day string into weather_part_t */
+} weather_value_t;
+
+/**
+ *  @brief  Key-path table entry
+ */
+typedef struct weather_path_s
+{
+    const char * ptr_path;          /**< JSON path as reported by the tokenizer */
+    uint8_t path_len;               /**< JSON path length */
+    uint8_t kind;                   /**< weather_value_t */
+    uint8_t offset;                 /**< Field offset in weather_record_t */
+    uint8_t size;                   /**< Field size (1, 2 or 4 bytes) */
+    bool is_signed;                 /**< Field is signed, values out of its exact range are rejected */
+    uint16_t flag;                  /**< WEATHER_RECORD_* flag */
+} weather_path_t;
+
+/**
+ *  @brief  Extractor context
+ */
+typedef struct weather_extract_s
+{
+    json_stream_t json;             /**< Streaming tokenizer */
+    weather_record_t * ptr_record;  /**< Destination */
+} weather_extract_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+extern const weather_path_t weather_paths[];    /**< Extracted paths */
+extern const size_t weather_paths_qty;          /**< Extracted paths quantity */
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Extractor initialization for a new document
+ *
+ *  @param[out] ptr_extract Extractor context pointer
+ *  @param[out] ptr_record  Destination (cleared)
+ */
+void weather_extract_init(weather_extract_t * ptr_extract, weather_record_t * ptr_record);
+
+/**
+ *  @brief      Feed the next chunk of the document
+ *
+ *  @param[in]  ptr_extract Extractor context pointer
+ *  @param[in]  ptr_data    Document bytes pointer
+ *  @param[in]  len         Document bytes quantity
+ *
+ *  @return     false if document is malformed
+ */
+bool weather_extract_feed(weather_extract_t * ptr_extract, const char * ptr_data, size_t len);
+
+/**
+ *  @brief      Notify the extractor that the document has ended
+ *
+ *  @param[in]  ptr_extract Extractor context pointer
+ *
+ *  @return     true if the document is complete and well-formed
+ */
+bool weather_extract_finish(weather_extract_t * ptr_extract);
+
+/**
+ *  @brief      Store value text into the field described by table entry
+ *
+ *  @param[out] ptr_record  Destination
+ *  @param[in]  ptr_path    Table entry
+ *  @param[in]  ptr_value   NULL-terminated value text
+ *  @param[in]  len         Value text length
+ *
+ *  @return     false if value is malformed or does not fit the field
+ */
+bool weather_extract_store(weather_record_t * ptr_record,
+                           const weather_path_t * ptr_path,
+                           const char * ptr_value,
+                           size_t len);
+
+#ifdef __cplusplus
+}
+#endif
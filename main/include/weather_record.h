@@ -0,0 +1,231 @@
+/**
+ *  @file       weather_record.h
+ *
+ *  @brief      Canonical packed weather record
+ *
+ *  Fixed-point values and enumerations only: strings from the weather
+ *  response are mapped once while parsing (condition codes with a
+ *  compile-time perfect hash) and never compared again. Display, storage
+ *  and export consume this record. Platform independent.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define WEATHER_RECORD_TEMP             (1U << 0)   /**< fact.temp is parsed */
+#define WEATHER_RECORD_FEELS_LIKE       (1U << 1)   /**< fact.feels_like is parsed */
+#define WEATHER_RECORD_HUMIDITY         (1U << 2)   /**< fact.humidity is parsed */
+#define WEATHER_RECORD_PRESSURE         (1U << 3)   /**< fact.pressure_mm is parsed */
+#define WEATHER_RECORD_CONDITION        (1U << 4)   /**< fact.condition is parsed */
+#define WEATHER_RECORD_WIND_SPEED       (1U << 5)   /**< fact.wind_speed is parsed */
+#define WEATHER_RECORD_WIND_DIR         (1U << 6)   /**< fact.wind_dir is parsed */
+#define WEATHER_RECORD_PART_NAME        (1U << 7)   /**< forecast.parts[0].part_name is parsed */
+#define WEATHER_RECORD_PART_TEMP        (1U << 8)   /**< forecast.parts[0].temp_avg is parsed */
+#define WEATHER_RECORD_PART_CONDITION   (1U << 9)   /**< forecast.parts[0].condition is parsed */
+#define WEATHER_RECORD_OBS_TIME         (1U << 10)  /**< fact.obs_time is parsed */
+/**< Fields required for display */
+#define WEATHER_RECORD_REQUIRED         (WEATHER_RECORD_TEMP | WEATHER_RECORD_CONDITION)
+#define WEATHER_RECORD_ALL              ((1U << 11) - 1)    /**< All fields */
+
+#define WEATHER_TENTHS_STR_SIZE         13          /**< "-214748364.8" with terminator */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Weather condition (Yandex condition codes)
+ */
+typedef enum weather_condition_e
+{
+    WEATHER_CONDITION_UNKNOWN = 0,
+    WEATHER_CONDITION_CLEAR,
+    WEATHER_CONDITION_PARTLY_CLOUDY,
+    WEATHER_CONDITION_CLOUDY,
+    WEATHER_CONDITION_OVERCAST,
+    WEATHER_CONDITION_DRIZZLE,
+    WEATHER_CONDITION_LIGHT_RAIN,
+    WEATHER_CONDITION_RAIN,
+    WEATHER_CONDITION_MODERATE_RAIN,
+    WEATHER_CONDITION_HEAVY_RAIN,
+    WEATHER_CONDITION_CONTINUOUS_HEAVY_RAIN,
+    WEATHER_CONDITION_SHOWERS,
+    WEATHER_CONDITION_WET_SNOW,
+    WEATHER_CONDITION_LIGHT_SNOW,
+    WEATHER_CONDITION_SNOW,
+    WEATHER_CONDITION_SNOW_SHOWERS,
+    WEATHER_CONDITION_HAIL,
+    WEATHER_CONDITION_THUNDERSTORM,
+    WEATHER_CONDITION_THUNDERSTORM_WITH_RAIN,
+    WEATHER_CONDITION_THUNDERSTORM_WITH_HAIL,
+    WEATHER_CONDITION_QTY,
+} weather_condition_t;
+
+/**
+ *  @brief  Wind direction
+ */
+typedef enum weather_wind_dir_e
+{
+    WEATHER_WIND_DIR_UNKNOWN = 0,
+    WEATHER_WIND_DIR_N,
+    WEATHER_WIND_DIR_NE,
+    WEATHER_WIND_DIR_E,
+    WEATHER_WIND_DIR_SE,
+    WEATHER_WIND_DIR_S,
+    WEATHER_WIND_DIR_SW,
+    WEATHER_WIND_DIR_W,
+    WEATHER_WIND_DIR_NW,
+    WEATHER_WIND_DIR_CALM,
+    WEATHER_WIND_DIR_QTY,
+} weather_wind_dir_t;
+
+/**
+ *  @brief  Forecast part of the day
+ */
+typedef enum weather_part_e
+{
+    WEATHER_PART_UNKNOWN = 0,
+    WEATHER_PART_NIGHT,
+    WEATHER_PART_MORNING,
+    WEATHER_PART_DAY,
+    WEATHER_PART_EVENING,
+    WEATHER_PART_QTY,
+} weather_part_t;
+
+/**
+ *  @brief  Weather record (packed, stored and exported as is)
+ */
+typedef struct __attribute__((packed)) weather_record_s
+{
+    uint32_t obs_time;              /**< Observation time, Unix seconds */
+    int16_t temp_dc;                /**< Temperature, 0.1 C */
+    int16_t feels_like_dc;          /**< Feels like temperature, 0.1 C */
+    int16_t part_temp_dc;           /**< Next forecast part average temperature, 0.1 C */
+    uint16_t pressure_dmm;          /**< Pressure, 0.1 mm Hg */
+    uint16_t wind_speed_dms;        /**< Wind speed, 0.1 m/s */
+    uint8_t humidity;               /**< Humidity, % */
+    uint8_t condition;              /**< weather_condition_t */
+    uint8_t wind_dir;               /**< weather_wind_dir_t */
+    uint8_t part_name;              /**< weather_part_t of next forecast part */
+    uint8_t part_condition;         /**< weather_condition_t of next forecast part */
+    uint16_t fields;                /**< WEATHER_RECORD_* flags of parsed fields */
+} weather_record_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Condition code to enumeration (perfect hash, one compare)
+ *
+ *  @param[in]  ptr_str     Condition code
+ *  @param[in]  len         Condition code length
+ *
+ *  @return     Condition, WEATHER_CONDITION_UNKNOWN if code is not known
+ */
+weather_condition_t weather_condition_from_str(const char * ptr_str, size_t len);
+
+/**
+ *  @brief      Condition code
+ *
+ *  @param[in]  condition   Condition
+ *
+ *  @return     Condition code ("unknown" if out of range)
+ */
+const char * weather_condition_name(uint8_t condition);
+
+/**
+ *  @brief      Wind direction code ("nw", "c" etc.) to enumeration
+ *
+ *  @param[in]  ptr_str     Direction code
+ *  @param[in]  len         Direction code length
+ *
+ *  @return     Wind direction, WEATHER_WIND_DIR_UNKNOWN if code is not known
+ */
+weather_wind_dir_t weather_wind_dir_from_str(const char * ptr_str, size_t len);
+
+/**
+ *  @brief      Wind direction code
+ *
+ *  @param[in]  wind_dir    Wind direction
+ *
+ *  @return     Direction code ("unknown" if out of range)
+ */
+const char * weather_wind_dir_name(uint8_t wind_dir);
+
+/**
+ *  @brief      Part of the day name ("evening" etc.) to enumeration
+ *
+ *  @param[in]  ptr_str     Part name
+ *  @param[in]  len         Part name length
+ *
+ *  @return     Part of the day, WEATHER_PART_UNKNOWN if name is not known
+ */
+weather_part_t weather_part_from_str(const char * ptr_str, size_t len);
+
+/**
+ *  @brief      Part of the day name
+ *
+ *  @param[in]  part        Part of the day
+ *
+ *  @return     Part name ("unknown" if out of range)
+ */
+const char * weather_part_name(uint8_t part);
+
+/**
+ *  @brief      Fixed-point tenths to decimal text ("-2.5")
+ *
+ *  @param[out] ptr_buf     Destination (WEATHER_TENTHS_STR_SIZE bytes)
+ *  @param[in]  value       Value in tenths
+ *
+ *  @return     Destination pointer
+ */
+char * weather_tenths_str(char * ptr_buf, int32_t value);
+
+/**
+ *  @brief      Export record as one-line JSON object
+ *
+ *  Only parsed fields are written.
+ *
+ *  @param[in]  ptr_record  Record pointer
+ *  @param[out] ptr_buf     Destination
+ *  @param[in]  size        Destination size
+ *
+ *  @return     Text length, 0 if it does not fit
+ */
+size_t weather_record_to_json(const weather_record_t * ptr_record, char * ptr_buf, size_t size);
+
+/**
+ *  @brief      Field-level difference of two records
+ *
+ *  A field differs if it is parsed in one record only or its values differ.
+ *
+ *  @param[in]  ptr_old     Previous record pointer
+ *  @param[in]  ptr_new     New record pointer
+ *
+ *  @return     WEATHER_RECORD_* flags of differing fields, 0 if records are equal
+ */
+uint16_t weather_record_diff(const weather_record_t * ptr_old, const weather_record_t * ptr_new);
+
+/**
+ *  @brief      Canonical form of a record: values of fields that are not parsed are zeroed
+ *
+ *  Records with the same content have the same bytes in canonical form.
+ *
+ *  @param[in]  ptr_record      Record pointer
+ *  @param[out] ptr_canonical   Canonical record pointer (may be the same)
+ */
+void weather_record_canonical(const weather_record_t * ptr_record, weather_record_t * ptr_canonical);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,96 @@
+/**
+ *  @file       wifi_cache.h
+ *
+ *  @brief      Last access point and DHCP lease kept across resets
+ *
+ *  The BSSID and channel of the last joined access point let the station
+ *  skip the full scan, the lease (address, gateway, DNS server) lets it
+ *  skip the DHCP exchange while the lease is valid. Kept in RTC memory
+ *  and NVS, so the access point is known after power loss as well.
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+#pragma once
+
+/********** INCLUDES **********/
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "esp_netif.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************** DEFINES ********************/
+
+#define WIFI_CACHE_LEASE_MARGIN_S   300     /**< Lease is not reused if it expires sooner */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Cached lease
+ */
+typedef struct wifi_cache_lease_s
+{
+    esp_netif_ip_info_t ip_info;    /**< Address, netmask and gateway */
+    esp_ip4_addr_t dns;             /**< DNS server */
+    int64_t expires_s;              /**< Lease expiration, system time */
+} wifi_cache_lease_t;
+
+/******************** PUBLIC FUNCTION PROTOTYPES ********************/
+
+/**
+ *  @brief      Cache initialization, validates RTC memory and falls back to NVS
+ *
+ *  @return     ESP_OK on success
+ */
+esp_err_t wifi_cache_init(void);
+
+/**
+ *  @brief      Last joined access point
+ *
+ *  @param[out] ptr_bssid   BSSID (6 bytes)
+ *  @param[out] ptr_channel Primary channel
+ *
+ *  @return     true if an access point is cached
+ */
+bool wifi_cache_get_ap(uint8_t * ptr_bssid, uint8_t * ptr_channel);
+
+/**
+ *  @brief      Lease that may be reused
+ *
+ *  @param[in]  now_s       Current system time (must be known, not a lower bound)
+ *  @param[out] ptr_lease   Lease pointer
+ *
+ *  @return     true if the lease is valid for at least WIFI_CACHE_LEASE_MARGIN_S
+ */
+bool wifi_cache_get_lease(int64_t now_s, wifi_cache_lease_t * ptr_lease);
+
+/**
+ *  @brief      Joined access point
+ *
+ *  @param[in]  ptr_bssid   BSSID (6 bytes)
+ *  @param[in]  channel     Primary channel
+ */
+void wifi_cache_store_ap(const uint8_t * ptr_bssid, uint8_t channel);
+
+/**
+ *  @brief      Lease obtained by the DHCP client of the interface
+ *
+ *  @param[in]  ptr_netif   Station interface
+ *  @param[in]  now_s       Current system time
+ */
+void wifi_cache_store_lease(esp_netif_t * ptr_netif, int64_t now_s);
+
+/**
+ *  @brief      Forget the access point and the lease (e.g. fast join failed)
+ */
+void wifi_cache_forget(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+/**
+ *  @file       json_arena.c
+ *
+ *  @brief      Bump allocator for one parsed JSON document
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+
+#include "json_arena.h"
+
+/******************** GLOBAL VARIABLES ********************/
+
+static json_arena_t * ptr_arena_scope = NULL;   /**< Target of hook adapters */
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void json_arena_init(json_arena_t * ptr_arena, void * ptr_buf, size_t size)
+{
+    memset(ptr_arena, 0x00, sizeof(*ptr_arena));
+    ptr_arena->ptr_buf = (uint8_t *) ptr_buf;
+    ptr_arena->size = size;
+}
+
+void * json_arena_alloc(json_arena_t * ptr_arena, size_t size)
+{
+    size_t start = (ptr_arena->used + JSON_ARENA_ALIGN - 1) & ~((size_t) JSON_ARENA_ALIGN - 1);
+
+    if ((start > ptr_arena->size) || (size > ptr_arena->size - start))
+    {
+        ptr_arena->failures++;
+        return NULL;
+    }
+
+    ptr_arena->used = start + size;
+    ptr_arena->allocs++;
+    if (ptr_arena->used > ptr_arena->high_water)
+    {
+        ptr_arena->high_water = ptr_arena->used;
+    }
+
+    return ptr_arena->ptr_buf + start;
+}
+
+void json_arena_begin(json_arena_t * ptr_arena)
+{
+    ptr_arena->used = 0;
+    ptr_arena->allocs = 0;
+    ptr_arena_scope = ptr_arena;
+}
+
+void json_arena_end(json_arena_t * ptr_arena)
+{
+    if (ptr_arena_scope == ptr_arena)
+    {
+        ptr_arena_scope = NULL;
+    }
+    ptr_arena->used = 0;
+    ptr_arena->scopes++;
+}
+
+void * json_arena_malloc(size_t size)
+{
+    if (NULL == ptr_arena_scope)
+    {
+        return NULL;
+    }
+
+    return json_arena_alloc(ptr_arena_scope, size);
+}
+
+void json_arena_free(void * ptr)
+{
+    (void) ptr;
+}
@@ -0,0 +1,215 @@
+/**
+ *  @file       json_num.c
+ *
+ *  @brief      Integer-only JSON number decoder
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include "json_num.h"
+
+/******************** DEFINES ********************/
+
+#define JSON_NUM_EXP_MAX    10000   /**< Exponent clamp, far beyond any representable value */
+
+/**< Digit check */
+#define JSON_NUM_IS_DIGIT(c)    (((c) >= '0') && ((c) <= '9'))
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const uint64_t json_num_pow10[] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL,
+};
+
+#define JSON_NUM_POW10_QTY  (sizeof(json_num_pow10) / sizeof(json_num_pow10[0]))
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static uint64_t json_num_div_round(uint64_t mantissa, uint32_t shift);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Divide by power of ten, rounding half away from zero
+ *
+ *  Weather values fit 32 bits, so the hardware divider is used for them
+ *  instead of the 64-bit division routine.
+ *
+ *  @param[in]  mantissa    Magnitude
+ *  @param[in]  shift       Power of ten (1..JSON_NUM_POW10_QTY - 1)
+ *
+ *  @return     Rounded quotient
+ */
+static uint64_t json_num_div_round(uint64_t mantissa, uint32_t shift)
+{
+    uint64_t divisor = json_num_pow10[shift];
+
+    if ((mantissa <= UINT32_MAX) && (divisor <= UINT32_MAX))
+    {
+        uint32_t quotient = (uint32_t) mantissa / (uint32_t) divisor;
+        uint32_t remainder = (uint32_t) mantissa % (uint32_t) divisor;
+        return quotient + ((remainder >= (uint32_t) divisor - remainder) ? 1 : 0);
+    }
+
+    uint64_t quotient = mantissa / divisor;
+    uint64_t remainder = mantissa % divisor;
+    return quotient + ((remainder >= divisor - remainder) ? 1 : 0);
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+bool json_num_scaled(const char * ptr_text, size_t len, uint8_t scale, int64_t * ptr_value)
+{
+    const char * ptr_end = ptr_text + len;
+    bool negative = false;
+    uint64_t mantissa = 0;      /* value = mantissa * 10^exp10 */
+    int32_t exp10 = 0;
+    uint32_t digits = 0;
+
+    if (scale > JSON_NUM_SCALE_MAX)
+    {
+        return false;
+    }
+
+    if ((ptr_text < ptr_end) && ('-' == *ptr_text))
+    {
+        negative = true;
+        ptr_text++;
+    }
+
+    /* Integer part: single 0 or digits without leading zeros */
+    if ((ptr_text >= ptr_end) || !JSON_NUM_IS_DIGIT(*ptr_text))
+    {
+        return false;
+    }
+    if ('0' == *ptr_text)
+    {
+        ptr_text++;
+    }
+    else
+    {
+        for (; (ptr_text < ptr_end) && JSON_NUM_IS_DIGIT(*ptr_text); ptr_text++)
+        {
+            if (digits < JSON_NUM_DIGITS_MAX)
+            {
+                mantissa = mantissa * 10 + (*ptr_text - '0');
+                digits++;
+            }
+            else
+            {
+                exp10++;
+            }
+        }
+    }
+
+    /* Fraction, leading zeros only move the exponent */
+    if ((ptr_text < ptr_end) && ('.' == *ptr_text))
+    {
+        ptr_text++;
+        if ((ptr_text >= ptr_end) || !JSON_NUM_IS_DIGIT(*ptr_text))
+        {
+            return false;
+        }
+        for (; (ptr_text < ptr_end) && JSON_NUM_IS_DIGIT(*ptr_text); ptr_text++)
+        {
+            if (digits < JSON_NUM_DIGITS_MAX)
+            {
+                mantissa = mantissa * 10 + (*ptr_text - '0');
+                exp10--;
+                if (0 != mantissa)
+                {
+                    digits++;
+                }
+            }
+        }
+    }
+
+    if ((ptr_text < ptr_end) && (('e' == *ptr_text) || ('E' == *ptr_text)))
+    {
+        bool exp_negative = false;
+        int32_t exp = 0;
+
+        ptr_text++;
+        if ((ptr_text < ptr_end) && (('-' == *ptr_text) || ('+' == *ptr_text)))
+        {
+            exp_negative = ('-' == *ptr_text);
+            ptr_text++;
+        }
+        if ((ptr_text >= ptr_end) || !JSON_NUM_IS_DIGIT(*ptr_text))
+        {
+            return false;
+        }
+        for (; (ptr_text < ptr_end) && JSON_NUM_IS_DIGIT(*ptr_text); ptr_text++)
+        {
+            if (exp < JSON_NUM_EXP_MAX)
+            {
+                exp = exp * 10 + (*ptr_text - '0');
+            }
+        }
+        exp10 += exp_negative ? -exp : exp;
+    }
+
+    if (ptr_text != ptr_end)
+    {
+        return false;
+    }
+
+    int32_t shift = exp10 + scale;
+    uint64_t limit = negative ? (1ULL << 63) : (uint64_t) INT64_MAX;
+
+    if (0 == mantissa)
+    {
+        *ptr_value = 0;
+        return true;
+    }
+    if (shift >= 0)
+    {
+        for (; shift > 0; shift--)
+        {
+            if (mantissa > limit / 10)
+            {
+                return false;
+            }
+            mantissa *= 10;
+        }
+    }
+    else if ((uint32_t) -shift < JSON_NUM_POW10_QTY)
+    {
+        mantissa = json_num_div_round(mantissa, (uint32_t) -shift);
+    }
+    else
+    {
+        /* At most JSON_NUM_DIGITS_MAX digits, less than half of the divisor */
+        mantissa = 0;
+    }
+
+    if (mantissa > limit)
+    {
+        return false;
+    }
+    /* -2^63 is not representable as positive int64_t */
+    *ptr_value = (negative && (0 != mantissa)) ? -(int64_t) (mantissa - 1) - 1 : (int64_t) mantissa;
+
+    return true;
+}
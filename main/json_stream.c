@@ -0,0 +1,535 @@
+/**
+ *  @file       json_stream.c
+ *
+ *  @brief      Resumable SAX-style JSON tokenizer
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <stdio.h>
+
+#include "json_stream.h"
+
+/******************** DEFINES ********************/
+
+#define JSON_STREAM_PATH_INVALID    0xFF    /**< Level path length marker for overflowed path */
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * const json_stream_literals[] = {
+    [JSON_STREAM_TRUE] = "true",
+    [JSON_STREAM_FALSE] = "false",
+    [JSON_STREAM_NULL] = "null",
+};
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static inline bool json_stream_is_space(char ch);
+static void json_stream_append(json_stream_t * ptr_json, char ch);
+static void json_stream_append_utf8(json_stream_t * ptr_json, uint32_t code);
+static void json_stream_set_member(json_stream_t * ptr_json, const char * ptr_name, size_t len, bool is_index);
+static void json_stream_value_start(json_stream_t * ptr_json);
+static void json_stream_value_end(json_stream_t * ptr_json);
+static void json_stream_emit(json_stream_t * ptr_json, json_stream_type_t type);
+static void json_stream_push(json_stream_t * ptr_json, bool is_array);
+static void json_stream_pop(json_stream_t * ptr_json, char ch);
+static bool json_stream_structural(json_stream_t * ptr_json, char ch);
+static bool json_stream_scalar(json_stream_t * ptr_json, char ch);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      JSON whitespace check
+ */
+static inline bool json_stream_is_space(char ch)
+{
+    return (ch == ' ') || (ch == '\t') || (ch == '\n') || (ch == '\r');
+}
+
+/**
+ *  @brief      Append character to value buffer
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  ch          Character
+ */
+static void json_stream_append(json_stream_t * ptr_json, char ch)
+{
+    if (ptr_json->value_len < sizeof(ptr_json->value) - 1)
+    {
+        ptr_json->value[ptr_json->value_len++] = ch;
+    }
+    else
+    {
+        ptr_json->value_overflow = true;
+    }
+}
+
+/**
+ *  @brief      Append code point to value buffer as UTF-8
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  code        Unicode code point
+ */
+static void json_stream_append_utf8(json_stream_t * ptr_json, uint32_t code)
+{
+    if (code < 0x80)
+    {
+        json_stream_append(ptr_json, (char) code);
+    }
+    else if (code < 0x800)
+    {
+        json_stream_append(ptr_json, (char) (0xC0 | (code >> 6)));
+        json_stream_append(ptr_json, (char) (0x80 | (code & 0x3F)));
+    }
+    else if (code < 0x10000)
+    {
+        json_stream_append(ptr_json, (char) (0xE0 | (code >> 12)));
+        json_stream_append(ptr_json, (char) (0x80 | ((code >> 6) & 0x3F)));
+        json_stream_append(ptr_json, (char) (0x80 | (code & 0x3F)));
+    }
+    else
+    {
+        json_stream_append(ptr_json, (char) (0xF0 | (code >> 18)));
+        json_stream_append(ptr_json, (char) (0x80 | ((code >> 12) & 0x3F)));
+        json_stream_append(ptr_json, (char) (0x80 | ((code >> 6) & 0x3F)));
+        json_stream_append(ptr_json, (char) (0x80 | (code & 0x3F)));
+    }
+}
+
+/**
+ *  @brief      Build path of the current member of innermost container
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  ptr_name    Object key (NULL for array element)
+ *  @param[in]  len         Object key length
+ *  @param[in]  is_index    Member is array element
+ */
+static void json_stream_set_member(json_stream_t * ptr_json, const char * ptr_name, size_t len, bool is_index)
+{
+    uint8_t level = ptr_json->depth - 1;
+    size_t base = ptr_json->path_len[level];
+    char index[12];
+
+    ptr_json->path_overflow = true;
+    if (JSON_STREAM_PATH_INVALID == base)
+    {
+        return;
+    }
+
+    if (is_index)
+    {
+        len = (size_t) snprintf(index, sizeof(index), "[%u]", (unsigned) ptr_json->index[level]);
+        ptr_name = index;
+    }
+    else if (base > 0)
+    {
+        if (base + 1 >= sizeof(ptr_json->path))
+        {
+            return;
+        }
+        ptr_json->path[base++] = '.';
+    }
+
+    if (base + len >= sizeof(ptr_json->path))
+    {
+        return;
+    }
+
+    memcpy(ptr_json->path + base, ptr_name, len);
+    ptr_json->path[base + len] = '\0';
+    ptr_json->path_overflow = false;
+}
+
+/**
+ *  @brief      Value beginning handling
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ */
+static void json_stream_value_start(json_stream_t * ptr_json)
+{
+    ptr_json->value_len = 0;
+    ptr_json->value_overflow = false;
+
+    if ((ptr_json->depth > 0) && ptr_json->is_array[ptr_json->depth - 1])
+    {
+        json_stream_set_member(ptr_json, NULL, 0, true);
+    }
+}
+
+/**
+ *  @brief      Value ending handling
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ */
+static void json_stream_value_end(json_stream_t * ptr_json)
+{
+    if (0 == ptr_json->depth)
+    {
+        ptr_json->state = JSON_STREAM_STATE_DONE;
+        return;
+    }
+
+    if (ptr_json->is_array[ptr_json->depth - 1])
+    {
+        ptr_json->index[ptr_json->depth - 1]++;
+    }
+    ptr_json->state = JSON_STREAM_STATE_NEXT;
+}
+
+/**
+ *  @brief      Scalar value reporting
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  type        Value type
+ */
+static void json_stream_emit(json_stream_t * ptr_json, json_stream_type_t type)
+{
+    ptr_json->value[ptr_json->value_len] = '\0';
+
+    if ((NULL != ptr_json->value_cb) && !ptr_json->path_overflow && !ptr_json->value_overflow)
+    {
+        ptr_json->value_cb(ptr_json->path, type, ptr_json->value, ptr_json->value_len, ptr_json->ptr_arg);
+    }
+
+    json_stream_value_end(ptr_json);
+}
+
+/**
+ *  @brief      Container opening
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  is_array    Container is array
+ */
+static void json_stream_push(json_stream_t * ptr_json, bool is_array)
+{
+    if (ptr_json->depth >= JSON_STREAM_DEPTH_MAX)
+    {
+        ptr_json->state = JSON_STREAM_STATE_ERROR;
+        return;
+    }
+
+    ptr_json->is_array[ptr_json->depth] = is_array;
+    ptr_json->index[ptr_json->depth] = 0;
+    ptr_json->path_len[ptr_json->depth] = ptr_json->path_overflow ?
+                                          JSON_STREAM_PATH_INVALID :
+                                          (uint8_t) strlen(ptr_json->path);
+    ptr_json->depth++;
+    ptr_json->state = is_array ? JSON_STREAM_STATE_VALUE_OR_END : JSON_STREAM_STATE_KEY_OR_END;
+}
+
+/**
+ *  @brief      Container closing
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  ch          Closing character
+ */
+static void json_stream_pop(json_stream_t * ptr_json, char ch)
+{
+    if ((0 == ptr_json->depth) || (ptr_json->is_array[ptr_json->depth - 1] != (ch == ']')))
+    {
+        ptr_json->state = JSON_STREAM_STATE_ERROR;
+        return;
+    }
+
+    ptr_json->depth--;
+    if ((ptr_json->depth > 0) && (JSON_STREAM_PATH_INVALID != ptr_json->path_len[ptr_json->depth]))
+    {
+        ptr_json->path[ptr_json->path_len[ptr_json->depth]] = '\0';
+    }
+    json_stream_value_end(ptr_json);
+}
+
+/**
+ *  @brief      Character processing outside of scalar values
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  ch          Character
+ *
+ *  @return     true if character is consumed
+ */
+static bool json_stream_structural(json_stream_t * ptr_json, char ch)
+{
+    if (json_stream_is_space(ch))
+    {
+        return true;
+    }
+
+    switch (ptr_json->state)
+    {
+        case JSON_STREAM_STATE_KEY_OR_END:
+        case JSON_STREAM_STATE_KEY:
+            if ((ch == '}') && (JSON_STREAM_STATE_KEY_OR_END == ptr_json->state))
+            {
+                json_stream_pop(ptr_json, ch);
+            }
+            else if (ch == '"')
+            {
+                ptr_json->value_len = 0;
+                ptr_json->value_overflow = false;
+                ptr_json->is_key = true;
+                ptr_json->state = JSON_STREAM_STATE_STRING;
+            }
+            else
+            {
+                ptr_json->state = JSON_STREAM_STATE_ERROR;
+            }
+            return true;
+
+        case JSON_STREAM_STATE_COLON:
+            ptr_json->state = (ch == ':') ? JSON_STREAM_STATE_VALUE : JSON_STREAM_STATE_ERROR;
+            return true;
+
+        case JSON_STREAM_STATE_NEXT:
+            if (ch == ',')
+            {
+                ptr_json->state = ptr_json->is_array[ptr_json->depth - 1] ?
+                                  JSON_STREAM_STATE_VALUE : JSON_STREAM_STATE_KEY;
+            }
+            else if ((ch == '}') || (ch == ']'))
+            {
+                json_stream_pop(ptr_json, ch);
+            }
+            else
+            {
+                ptr_json->state = JSON_STREAM_STATE_ERROR;
+            }
+            return true;
+
+        case JSON_STREAM_STATE_VALUE_OR_END:
+            if (ch == ']')
+            {
+                json_stream_pop(ptr_json, ch);
+                return true;
+            }
+            /* fall through */
+        case JSON_STREAM_STATE_VALUE:
+            json_stream_value_start(ptr_json);
+            if (ch == '{')
+            {
+                json_stream_push(ptr_json, false);
+            }
+            else if (ch == '[')
+            {
+                json_stream_push(ptr_json, true);
+            }
+            else if (ch == '"')
+            {
+                ptr_json->is_key = false;
+                ptr_json->state = JSON_STREAM_STATE_STRING;
+            }
+            else if ((ch == '-') || ((ch >= '0') && (ch <= '9')))
+            {
+                json_stream_append(ptr_json, ch);
+                ptr_json->state = JSON_STREAM_STATE_NUMBER;
+            }
+            else if ((ch == 't') || (ch == 'f') || (ch == 'n'))
+            {
+                ptr_json->literal = (ch == 't') ? JSON_STREAM_TRUE :
+                                    (ch == 'f') ? JSON_STREAM_FALSE : JSON_STREAM_NULL;
+                ptr_json->literal_pos = 1;
+                json_stream_append(ptr_json, ch);
+                ptr_json->state = JSON_STREAM_STATE_LITERAL;
+            }
+            else
+            {
+                ptr_json->state = JSON_STREAM_STATE_ERROR;
+            }
+            return true;
+
+        default:
+            /* Only whitespaces may follow the document */
+            ptr_json->state = JSON_STREAM_STATE_ERROR;
+            return true;
+    }
+}
+
+/**
+ *  @brief      Character processing inside strings, numbers and literals
+ *
+ *  @param[in]  ptr_json    Tokenizer context pointer
+ *  @param[in]  ch          Character
+ *
+ *  @return     true if character is consumed, false if it ends a number
+ *              and must be processed again
+ */
+static bool json_stream_scalar(json_stream_t * ptr_json, char ch)
+{
+    switch (ptr_json->state)
+    {
+        case JSON_STREAM_STATE_STRING:
+            if (ch == '"')
+            {
+                if (ptr_json->is_key)
+                {
+                    if (ptr_json->value_overflow)
+                    {
+                        ptr_json->path_overflow = true;
+                    }
+                    else
+                    {
+                        json_stream_set_member(ptr_json, ptr_json->value, ptr_json->value_len, false);
+                    }
+                    ptr_json->state = JSON_STREAM_STATE_COLON;
+                }
+                else
+                {
+                    json_stream_emit(ptr_json, JSON_STREAM_STRING);
+                }
+            }
+            else if (ch == '\\')
+            {
+                ptr_json->state = JSON_STREAM_STATE_ESCAPE;
+            }
+            else if ((unsigned char) ch < 0x20)
+            {
+                ptr_json->state = JSON_STREAM_STATE_ERROR;
+            }
+            else
+            {
+                json_stream_append(ptr_json, ch);
+            }
+            return true;
+
+        case JSON_STREAM_STATE_ESCAPE:
+        {
+            static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+            const char * ptr_esc = NULL;
+
+            ptr_json->state = JSON_STREAM_STATE_STRING;
+            if (ch == 'u')
+            {
+                ptr_json->unicode = 0;
+                ptr_json->unicode_digits = 0;
+                ptr_json->state = JSON_STREAM_STATE_UNICODE;
+                return true;
+            }
+            for (size_t i = 0; i < sizeof(escapes) - 1; i += 2)
+            {
+                if (escapes[i] == ch)
+                {
+                    ptr_esc = &escapes[i + 1];
+                    break;
+                }
+            }
+            if (NULL == ptr_esc)
+            {
+                ptr_json->state = JSON_STREAM_STATE_ERROR;
+                return true;
+            }
+            json_stream_append(ptr_json, *ptr_esc);
+            return true;
+        }
+
+        case JSON_STREAM_STATE_UNICODE:
+        {
+            uint32_t digit;
+            if ((ch >= '0') && (ch <= '9'))
+            {
+                digit = ch - '0';
+            }
+            else if ((ch >= 'a') && (ch <= 'f'))
+            {
+                digit = ch - 'a' + 10;
+            }
+            else if ((ch >= 'A') && (ch <= 'F'))
+            {
+                digit = ch - 'A' + 10;
+            }
+            else
+            {
+                ptr_json->state = JSON_STREAM_STATE_ERROR;
+                return true;
+            }
+
+            ptr_json->unicode = (ptr_json->unicode << 4) | digit;
+            if (++ptr_json->unicode_digits < 4)
+            {
+                return true;
+            }
+
+            ptr_json->state = JSON_STREAM_STATE_STRING;
+            if ((ptr_json->unicode >= 0xD800) && (ptr_json->unicode < 0xDC00))
+            {
+                ptr_json->surrogate = ptr_json->unicode;
+            }
+            else if ((ptr_json->unicode >= 0xDC00) && (ptr_json->unicode < 0xE000) && (0 != ptr_json->surrogate))
+            {
+                json_stream_append_utf8(ptr_json, 0x10000 + ((ptr_json->surrogate - 0xD800) << 10) + (ptr_json->unicode - 0xDC00));
+                ptr_json->surrogate = 0;
+            }
+            else
+            {
+                json_stream_append_utf8(ptr_json, ptr_json->unicode);
+                ptr_json->surrogate = 0;
+            }
+            return true;
+        }
+
+        case JSON_STREAM_STATE_NUMBER:
+            if (((ch >= '0') && (ch <= '9')) || (ch == '.') || (ch == 'e') || (ch == 'E') || (ch == '+') || (ch == '-'))
+            {
+                json_stream_append(ptr_json, ch);
+                return true;
+            }
+            json_stream_emit(ptr_json, JSON_STREAM_NUMBER);
+            return false;
+
+        case JSON_STREAM_STATE_LITERAL:
+        {
+            const char * ptr_literal = json_stream_literals[ptr_json->literal];
+            if (ch != ptr_literal[ptr_json->literal_pos])
+            {
+                ptr_json->state = JSON_STREAM_STATE_ERROR;
+                return true;
+            }
+            json_stream_append(ptr_json, ch);
+            if (ptr_literal[++ptr_json->literal_pos] == '\0')
+            {
+                json_stream_emit(ptr_json, ptr_json->literal);
+            }
+            return true;
+        }
+
+        default:
+            return json_stream_structural(ptr_json, ch);
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void json_stream_init(json_stream_t * ptr_json, json_stream_value_cb_t value_cb, void * ptr_arg)
+{
+    memset(ptr_json, 0x00, sizeof(*ptr_json));
+    ptr_json->state = JSON_STREAM_STATE_VALUE;
+    ptr_json->value_cb = value_cb;
+    ptr_json->ptr_arg = ptr_arg;
+}
+
+bool json_stream_feed(json_stream_t * ptr_json, const char * ptr_data, size_t len)
+{
+    size_t pos = 0;
+
+    while ((pos < len) && (JSON_STREAM_STATE_ERROR != ptr_json->state))
+    {
+        if (json_stream_scalar(ptr_json, ptr_data[pos]))
+        {
+            pos++;
+        }
+    }
+
+    return (JSON_STREAM_STATE_ERROR != ptr_json->state);
+}
+
+bool json_stream_finish(json_stream_t * ptr_json)
+{
+    /* Top level number has no terminating character */
+    if ((JSON_STREAM_STATE_NUMBER == ptr_json->state) && (0 == ptr_json->depth))
+    {
+        json_stream_emit(ptr_json, JSON_STREAM_NUMBER);
+    }
+
+    return (JSON_STREAM_STATE_DONE == ptr_json->state);
+}
@@ -0,0 +1,348 @@
+/**
+ *  @file       ntp_client.c
+ *
+ *  @brief      Parallel NTP query of several servers with best-sample selection
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+
+#include "ntp_client.h"
+
+/******************** DEFINES ********************/
+
+#define NTP_PACKET_SIZE         48              /**< NTP header without extensions */
+#define NTP_UNIX_EPOCH_S        2208988800ULL   /**< Seconds from 1900 to 1970 */
+#define NTP_REQUEST_LI_VN_MODE  0x23            /**< No leap warning, version 4, client */
+#define NTP_MODE_SERVER         4               /**< Server reply mode */
+#define NTP_LI_ALARM            3               /**< Leap indicator: clock is not synchronized */
+#define NTP_STRATUM_MAX         15              /**< Largest synchronized stratum */
+
+#define NTP_OFFSET_ORIGINATE    24              /**< Originate timestamp offset */
+#define NTP_OFFSET_RECEIVE      32              /**< Receive timestamp offset */
+#define NTP_OFFSET_TRANSMIT     40              /**< Transmit timestamp offset */
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static uint64_t ntp_from_us(int64_t time_us);
+static int64_t ntp_to_us(uint64_t ntp);
+static uint64_t ntp_read64(const uint8_t * ptr_buf);
+static uint32_t ntp_read32(const uint8_t * ptr_buf);
+static void ntp_write64(uint8_t * ptr_buf, uint64_t value);
+static bool ntp_parse(const uint8_t * ptr_buf, int64_t sent_us, int64_t received_us, ntp_sample_t * ptr_sample);
+static bool ntp_overlap(const ntp_sample_t * ptr_a, const ntp_sample_t * ptr_b);
+static bool ntp_agree(const ntp_result_t * ptr_result);
+static void ntp_select(ntp_result_t * ptr_result);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Unix microseconds to NTP timestamp (32.32 seconds since 1900)
+ *
+ *  @param[in]  time_us     Unix time, microseconds
+ *
+ *  @return     NTP timestamp
+ */
+static uint64_t ntp_from_us(int64_t time_us)
+{
+    uint64_t seconds = (uint64_t) (time_us / 1000000) + NTP_UNIX_EPOCH_S;
+    uint64_t fraction = ((uint64_t) (time_us % 1000000) << 32) / 1000000;
+
+    return (seconds << 32) | fraction;
+}
+
+/**
+ *  @brief      NTP timestamp to Unix microseconds
+ *
+ *  @param[in]  ntp         NTP timestamp
+ *
+ *  @return     Unix time, microseconds
+ */
+static int64_t ntp_to_us(uint64_t ntp)
+{
+    int64_t seconds = (int64_t) (ntp >> 32) - (int64_t) NTP_UNIX_EPOCH_S;
+    int64_t micros = (int64_t) (((ntp & 0xFFFFFFFFULL) * 1000000) >> 32);
+
+    return seconds * 1000000 + micros;
+}
+
+/**
+ *  @brief      Big-endian 64-bit read
+ */
+static uint64_t ntp_read64(const uint8_t * ptr_buf)
+{
+    return ((uint64_t) ntp_read32(ptr_buf) << 32) | ntp_read32(&ptr_buf[4]);
+}
+
+/**
+ *  @brief      Big-endian 32-bit read
+ */
+static uint32_t ntp_read32(const uint8_t * ptr_buf)
+{
+    return ((uint32_t) ptr_buf[0] << 24) | ((uint32_t) ptr_buf[1] << 16) |
+           ((uint32_t) ptr_buf[2] << 8) | (uint32_t) ptr_buf[3];
+}
+
+/**
+ *  @brief      Big-endian 64-bit write
+ */
+static void ntp_write64(uint8_t * ptr_buf, uint64_t value)
+{
+    for (int i = 7; i >= 0; i--)
+    {
+        ptr_buf[i] = (uint8_t) value;
+        value >>= 8;
+    }
+}
+
+/**
+ *  @brief      Reply check and sample computation
+ *
+ *  offset = ((T2 - T1) + (T3 - T4)) / 2, delay = (T4 - T1) - (T3 - T2)
+ *
+ *  @param[in]  ptr_buf     Reply packet (NTP_PACKET_SIZE bytes)
+ *  @param[in]  sent_us     Request send time (T1)
+ *  @param[in]  received_us Reply receive time (T4)
+ *  @param[out] ptr_sample  Sample pointer
+ *
+ *  @return     true if the server is synchronized
+ */
+static bool ntp_parse(const uint8_t * ptr_buf, int64_t sent_us, int64_t received_us, ntp_sample_t * ptr_sample)
+{
+    uint8_t leap = ptr_buf[0] >> 6;
+    uint8_t mode = ptr_buf[0] & 0x07;
+    uint8_t stratum = ptr_buf[1];
+    uint64_t transmit = ntp_read64(&ptr_buf[NTP_OFFSET_TRANSMIT]);
+
+    /* Stratum 0 is a kiss-o'-death */
+    if ((NTP_MODE_SERVER != mode) || (NTP_LI_ALARM == leap) ||
+        (0 == stratum) || (stratum > NTP_STRATUM_MAX) || (0 == transmit))
+    {
+        return false;
+    }
+
+    int64_t receive_us = ntp_to_us(ntp_read64(&ptr_buf[NTP_OFFSET_RECEIVE]));
+    int64_t transmit_us = ntp_to_us(transmit);
+    /* Root delay and dispersion are 16.16 seconds */
+    int64_t root_delay_us = ((int64_t) ntp_read32(&ptr_buf[4]) * 1000000) >> 16;
+    int64_t root_dispersion_us = ((int64_t) ntp_read32(&ptr_buf[8]) * 1000000) >> 16;
+
+    ptr_sample->stratum = stratum;
+    ptr_sample->offset_us = ((receive_us - sent_us) + (transmit_us - received_us)) / 2;
+    ptr_sample->delay_us = (received_us - sent_us) - (transmit_us - receive_us);
+    if (ptr_sample->delay_us < 0)
+    {
+        ptr_sample->delay_us = 0;
+    }
+    ptr_sample->distance_us = (ptr_sample->delay_us + root_delay_us) / 2 + root_dispersion_us;
+    ptr_sample->is_valid = true;
+
+    return true;
+}
+
+/**
+ *  @brief      Check that correctness intervals of two samples overlap
+ *
+ *  @param[in]  ptr_a       First sample pointer
+ *  @param[in]  ptr_b       Second sample pointer
+ *
+ *  @return     true if the samples agree
+ */
+static bool ntp_overlap(const ntp_sample_t * ptr_a, const ntp_sample_t * ptr_b)
+{
+    return llabs(ptr_a->offset_us - ptr_b->offset_us) <= ptr_a->distance_us + ptr_b->distance_us;
+}
+
+/**
+ *  @brief      Check that all valid samples agree with each other
+ *
+ *  @param[in]  ptr_result  Result pointer
+ *
+ *  @return     true if no valid sample disagrees with another one
+ */
+static bool ntp_agree(const ntp_result_t * ptr_result)
+{
+    for (size_t i = 0; i < ptr_result->servers_qty; i++)
+    {
+        for (size_t j = i + 1; j < ptr_result->servers_qty; j++)
+        {
+            if (ptr_result->samples[i].is_valid && ptr_result->samples[j].is_valid &&
+                !ntp_overlap(&ptr_result->samples[i], &ptr_result->samples[j]))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ *  @brief      Falseticker rejection and best sample selection
+ *
+ *  A sample is a truechimer if its correctness interval overlaps the
+ *  intervals of a majority of samples. If there is no majority (two
+ *  disagreeing servers), every sample is kept. The truechimer with the
+ *  shortest round trip is selected, its offset has the smallest error.
+ *
+ *  @param[in]  ptr_result  Result pointer
+ */
+static void ntp_select(ntp_result_t * ptr_result)
+{
+    ntp_sample_t * ptr_samples = ptr_result->samples;
+    uint32_t truechimers = 0;
+
+    for (size_t i = 0; i < ptr_result->servers_qty; i++)
+    {
+        uint32_t overlaps = 0;
+
+        if (!ptr_samples[i].is_valid)
+        {
+            continue;
+        }
+        for (size_t j = 0; j < ptr_result->servers_qty; j++)
+        {
+            if (ptr_samples[j].is_valid && ntp_overlap(&ptr_samples[i], &ptr_samples[j]))
+            {
+                overlaps++;
+            }
+        }
+        ptr_samples[i].is_truechimer = (2 * overlaps > ptr_result->answered);
+        truechimers += ptr_samples[i].is_truechimer ? 1 : 0;
+    }
+
+    ptr_result->best = -1;
+    for (size_t i = 0; i < ptr_result->servers_qty; i++)
+    {
+        if (!ptr_samples[i].is_valid || ((truechimers > 0) && !ptr_samples[i].is_truechimer))
+        {
+            continue;
+        }
+        if ((ptr_result->best < 0) || (ptr_samples[i].delay_us < ptr_samples[ptr_result->best].delay_us))
+        {
+            ptr_result->best = (int) i;
+        }
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+int64_t ntp_client_now_us(void)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (int64_t) now.tv_sec * 1000000 + now.tv_usec;
+}
+
+const ntp_sample_t * ntp_client_query(const struct sockaddr_in * ptr_servers,
+                                      size_t qty,
+                                      uint32_t deadline_ms,
+                                      ntp_result_t * ptr_result)
+{
+    uint8_t packet[NTP_PACKET_SIZE];
+    uint64_t originates[NTP_CLIENT_SERVERS_MAX];
+    int64_t sent_us[NTP_CLIENT_SERVERS_MAX];
+    int64_t start_us = ntp_client_now_us();
+    int64_t deadline_us = start_us + (int64_t) deadline_ms * 1000;
+
+    memset(ptr_result, 0x00, sizeof(*ptr_result));
+    ptr_result->best = -1;
+    ptr_result->servers_qty = (qty > NTP_CLIENT_SERVERS_MAX) ? NTP_CLIENT_SERVERS_MAX : qty;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0)
+    {
+        return NULL;
+    }
+
+    /* All requests go out back to back, each one is told apart by its transmit timestamp */
+    uint32_t pending = 0;
+    for (size_t i = 0; i < ptr_result->servers_qty; i++)
+    {
+        memset(packet, 0x00, sizeof(packet));
+        packet[0] = NTP_REQUEST_LI_VN_MODE;
+        sent_us[i] = ntp_client_now_us();
+        originates[i] = ntp_from_us(sent_us[i]) + i;
+        ntp_write64(&packet[NTP_OFFSET_TRANSMIT], originates[i]);
+        if (sendto(sock, packet, sizeof(packet), 0,
+                   (const struct sockaddr *) &ptr_servers[i], sizeof(ptr_servers[i])) == (ssize_t) sizeof(packet))
+        {
+            pending |= 1U << i;
+        }
+    }
+
+    /*
+     * Replies are awaited until a majority answered (enough to outvote a
+     * falseticker) or two and more agree, so a laggard is not waited for
+     */
+    uint32_t quorum = (uint32_t) ptr_result->servers_qty / 2 + 1;
+    while ((0 != pending) &&
+           (ptr_result->answered < quorum) &&
+           ((ptr_result->answered < 2) || !ntp_agree(ptr_result)))
+    {
+        int64_t left_us = deadline_us - ntp_client_now_us();
+        if (left_us <= 0)
+        {
+            break;
+        }
+
+        struct timeval timeout = {
+            .tv_sec = left_us / 1000000,
+            .tv_usec = left_us % 1000000,
+        };
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(sock, &readable);
+        if (select(sock + 1, &readable, NULL, NULL, &timeout) <= 0)
+        {
+            break;
+        }
+
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t len = recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *) &from, &from_len);
+        int64_t received_us = ntp_client_now_us();
+        if (len < (ssize_t) sizeof(packet))
+        {
+            continue;
+        }
+
+        /* A reply without our originate is stale or forged, the server is still waited for */
+        for (size_t i = 0; i < ptr_result->servers_qty; i++)
+        {
+            if ((0 == (pending & (1U << i))) ||
+                (from.sin_addr.s_addr != ptr_servers[i].sin_addr.s_addr) ||
+                (from.sin_port != ptr_servers[i].sin_port) ||
+                (ntp_read64(&packet[NTP_OFFSET_ORIGINATE]) != originates[i]))
+            {
+                continue;
+            }
+            pending &= ~(1U << i);
+            if (ntp_parse(packet, sent_us[i], received_us, &ptr_result->samples[i]))
+            {
+                ptr_result->samples[i].reply_us = received_us - start_us;
+                ptr_result->answered++;
+            }
+            else
+            {
+                ptr_result->rejected++;
+            }
+            break;
+        }
+    }
+    close(sock);
+
+    ptr_result->elapsed_us = ntp_client_now_us() - start_us;
+    ntp_select(ptr_result);
+
+    return (ptr_result->best < 0) ? NULL : &ptr_result->samples[ptr_result->best];
+}
@@ -0,0 +1,239 @@
+/**
+ *  @file       phase_trace.c
+ *
+ *  @brief      Boot and fetch phase timeline
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <stdatomic.h>
+
+#include "phase_trace.h"
+
+/******************** DEFINES ********************/
+
+#define PHASE_TRACE_UNMARKED    (-1)    /**< First mark value of a phase that was not marked */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Ring buffer mark
+ */
+typedef struct phase_trace_entry_s
+{
+    int64_t time_us;            /**< Clock value */
+    phase_trace_id_t id;        /**< Phase */
+    atomic_uint seq;            /**< Mark number + 1, written last, 0 while the entry is written */
+} phase_trace_entry_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * const phase_trace_names[PHASE_TRACE_QTY] = {
+    [PHASE_TRACE_NVS_INIT]      = "nvs_init",
+    [PHASE_TRACE_WIFI_START]    = "wifi_start",
+    [PHASE_TRACE_ASSOCIATED]    = "associated",
+    [PHASE_TRACE_GOT_IP]        = "got_ip",
+    [PHASE_TRACE_TIME_VALID]    = "time_valid",
+    [PHASE_TRACE_DNS]           = "dns",
+    [PHASE_TRACE_CONNECT]       = "connect",
+    [PHASE_TRACE_REQUEST_SENT]  = "request_sent",
+    [PHASE_TRACE_FIRST_BYTE]    = "first_byte",
+    [PHASE_TRACE_LAST_BYTE]     = "last_byte",
+    [PHASE_TRACE_PARSE_DONE]    = "parse_done",
+    [PHASE_TRACE_DISPLAY_DONE]  = "display_done",
+};
+
+static phase_trace_clock_t phase_trace_clock = NULL;
+static phase_trace_entry_t phase_trace_ring[PHASE_TRACE_SIZE];
+static atomic_uint phase_trace_count;                           /**< Marks taken since init */
+static _Atomic int64_t phase_trace_first_us[PHASE_TRACE_QTY];   /**< First marks, a phase may be marked from several tasks */
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static size_t phase_trace_boot_order(phase_trace_id_t * ptr_ids);
+static bool phase_trace_read(uint32_t n, phase_trace_entry_t * ptr_entry);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Marked phases in the order of their first marks
+ *
+ *  @param[out] ptr_ids     Phases (PHASE_TRACE_QTY)
+ *
+ *  @return     Marked phases quantity
+ */
+static size_t phase_trace_boot_order(phase_trace_id_t * ptr_ids)
+{
+    size_t qty = 0;
+
+    int64_t first_us[PHASE_TRACE_QTY];
+
+    for (int id = 0; id < PHASE_TRACE_QTY; id++)
+    {
+        first_us[id] = atomic_load(&phase_trace_first_us[id]);
+        if (PHASE_TRACE_UNMARKED == first_us[id])
+        {
+            continue;
+        }
+
+        size_t pos = qty++;
+        while ((pos > 0) && (first_us[ptr_ids[pos - 1]] > first_us[id]))
+        {
+            ptr_ids[pos] = ptr_ids[pos - 1];
+            pos--;
+        }
+        ptr_ids[pos] = (phase_trace_id_t) id;
+    }
+
+    return qty;
+}
+
+/**
+ *  @brief      Ring buffer mark reading
+ *
+ *  @param[in]  n           Mark number
+ *  @param[out] ptr_entry   Mark
+ *
+ *  @return     false if the mark is being written or already overwritten
+ */
+static bool phase_trace_read(uint32_t n, phase_trace_entry_t * ptr_entry)
+{
+    phase_trace_entry_t * ptr_slot = &phase_trace_ring[n % PHASE_TRACE_SIZE];
+
+    if (atomic_load_explicit(&ptr_slot->seq, memory_order_acquire) != n + 1)
+    {
+        return false;
+    }
+    ptr_entry->time_us = ptr_slot->time_us;
+    ptr_entry->id = ptr_slot->id;
+
+    return atomic_load_explicit(&ptr_slot->seq, memory_order_acquire) == n + 1;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void phase_trace_init(phase_trace_clock_t clock)
+{
+    phase_trace_clock = clock;
+    for (size_t i = 0; i < PHASE_TRACE_SIZE; i++)
+    {
+        atomic_store(&phase_trace_ring[i].seq, 0);
+    }
+    for (size_t i = 0; i < PHASE_TRACE_QTY; i++)
+    {
+        atomic_store(&phase_trace_first_us[i], PHASE_TRACE_UNMARKED);
+    }
+    atomic_store(&phase_trace_count, 0);
+}
+
+void phase_trace_mark(phase_trace_id_t id)
+{
+    if ((NULL == phase_trace_clock) || (id >= PHASE_TRACE_QTY))
+    {
+        return;
+    }
+
+    int64_t time_us = phase_trace_clock();
+    uint32_t n = atomic_fetch_add(&phase_trace_count, 1);
+    phase_trace_entry_t * ptr_slot = &phase_trace_ring[n % PHASE_TRACE_SIZE];
+
+    atomic_store_explicit(&ptr_slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    ptr_slot->time_us = time_us;
+    ptr_slot->id = id;
+    atomic_store_explicit(&ptr_slot->seq, n + 1, memory_order_release);
+
+    /* Only the first of concurrent marks is kept */
+    int64_t unmarked = PHASE_TRACE_UNMARKED;
+    atomic_compare_exchange_strong(&phase_trace_first_us[id], &unmarked, time_us);
+}
+
+bool phase_trace_first(phase_trace_id_t id, int64_t * ptr_us)
+{
+    if (id >= PHASE_TRACE_QTY)
+    {
+        return false;
+    }
+
+    int64_t first_us = atomic_load(&phase_trace_first_us[id]);
+    if (PHASE_TRACE_UNMARKED == first_us)
+    {
+        return false;
+    }
+    *ptr_us = first_us;
+
+    return true;
+}
+
+const char * phase_trace_name(phase_trace_id_t id)
+{
+    return (id < PHASE_TRACE_QTY) ? phase_trace_names[id] : "unknown";
+}
+
+void phase_trace_dump(FILE * ptr_file)
+{
+    phase_trace_id_t ids[PHASE_TRACE_QTY];
+    size_t qty = phase_trace_boot_order(ids);
+    int64_t prev_us = 0;
+
+    fprintf(ptr_file, "Boot timeline:\n");
+    for (size_t i = 0; i < qty; i++)
+    {
+        int64_t time_us = atomic_load(&phase_trace_first_us[ids[i]]);
+        fprintf(ptr_file, "  %-14s %10.1f ms  +%9.1f ms\n",
+                phase_trace_names[ids[i]], time_us / 1000.0, (time_us - prev_us) / 1000.0);
+        prev_us = time_us;
+    }
+
+    uint32_t count = atomic_load(&phase_trace_count);
+    uint32_t n = (count > PHASE_TRACE_SIZE) ? (count - PHASE_TRACE_SIZE) : 0;
+    bool has_prev = false;
+
+    fprintf(ptr_file, "Recent marks (%u of %u):\n", count - n, count);
+    for (; n < count; n++)
+    {
+        phase_trace_entry_t entry;
+        if (!phase_trace_read(n, &entry))
+        {
+            continue;
+        }
+        fprintf(ptr_file, "  %-14s %10.1f ms  +%9.1f ms\n",
+                phase_trace_names[entry.id], entry.time_us / 1000.0,
+                has_prev ? (entry.time_us - prev_us) / 1000.0 : 0.0);
+        prev_us = entry.time_us;
+        has_prev = true;
+    }
+}
+
+void phase_trace_json(FILE * ptr_file)
+{
+    phase_trace_id_t ids[PHASE_TRACE_QTY];
+    size_t qty = phase_trace_boot_order(ids);
+
+    fprintf(ptr_file, "{\"boot\":{");
+    for (size_t i = 0; i < qty; i++)
+    {
+        fprintf(ptr_file, "%s\"%s\":%lld", (i > 0) ? "," : "",
+                phase_trace_names[ids[i]], (long long) atomic_load(&phase_trace_first_us[ids[i]]));
+    }
+
+    uint32_t count = atomic_load(&phase_trace_count);
+    uint32_t n = (count > PHASE_TRACE_SIZE) ? (count - PHASE_TRACE_SIZE) : 0;
+    bool is_first = true;
+
+    fprintf(ptr_file, "},\"recent\":[");
+    for (; n < count; n++)
+    {
+        phase_trace_entry_t entry;
+        if (!phase_trace_read(n, &entry))
+        {
+            continue;
+        }
+        fprintf(ptr_file, "%s[\"%s\",%lld]", is_first ? "" : ",",
+                phase_trace_names[entry.id], (long long) entry.time_us);
+        is_first = false;
+    }
+    fprintf(ptr_file, "]}\n");
+}
@@ -11,8 +11,11 @@
 #include "sdkconfig.h"
 
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
+#include <math.h>
 #include <sys/time.h>
 
 #include "freertos/FreeRTOS.h"
@@ -29,6 +32,8 @@
 #include "esp_sntp.h"
 #include "esp_netif.h"
 #include "esp_tls.h"
+#include "esp_cpu.h"
+#include "esp_bit_defs.h"
 
 #include "nvs.h"
 #include "nvs_flash.h"
@@ -42,20 +47,38 @@
 #include "cJSON.h"
 
 #include "time_sync.h"
+#include "dns_cache.h"
+#include "wifi_cache.h"
+#include "phase_trace.h"
+#include "weather_conn.h"
+#include "weather_record.h"
+#include "weather_change.h"
+#include "weather_extract.h"
+#include "json_arena.h"
+#include "json_num.h"
+#include "http_cache.h"
+#include "http_inflate.h"
+#include "fetch_engine.h"
+#include "forecast_model.h"
 
 /******************** DEFINES ********************/
 
 #define API_YANDEX_HOST "api.weather.yandex.ru"                 /**< Host URL */
 #define API_YANDEX_URL  "https://" API_YANDEX_HOST "/"          /**< Host URL full */
-#define API_YANDEX_PORT "443"                                   /**< TLS port */
-#define API_YANDEX_PATH "/v2/informers?lat=59.9386&lon=30.3141" /**< Host path */
+#define API_YANDEX_PORT 443                                     /**< TLS port */
+#define API_YANDEX_PATH "/v2/informers?lat=%s&lon=%s"          /**< Host path format (latitude, longitude) */
 #define API_YANDEX_KEY  "822a9b7c-bfdf-4f43-93b8-ac085bb84c1d"  /**< Yandex API key */
-/**< Yandex API weather GET request */
-#define API_YANDEX_GET_REQ \
-    "GET " API_YANDEX_PATH " HTTP/1.1\r\n" \
+/**< Forecast path format (latitude, longitude), days and hours of the generated model */
+#define API_YANDEX_FORECAST_PATH "/v2/forecast?lat=%s&lon=%s&limit=7&hours=true&extra=false"
+/**< Yandex API GET request format for the path and connection option (without terminating empty line) */
+#define API_YANDEX_GET_REQ_CONN_FMT(path, conn) \
+    "GET " path " HTTP/1.1\r\n" \
     "Host: " API_YANDEX_HOST "\r\n"  \
     "X-Yandex-API-Key: " API_YANDEX_KEY "\r\n" \
-    "\r\n"
+    "Connection: " conn "\r\n" \
+    WEATHER_GET_ACCEPT_ENCODING
+/**< Yandex API GET request format for the path on the kept-alive connection */
+#define API_YANDEX_GET_REQ_FMT(path) API_YANDEX_GET_REQ_CONN_FMT(path, "keep-alive")
 
 
 #define APP_WIFI_SSID          "coreofbear" /**< WiFi SSID */
@@ -65,74 +88,284 @@
 #define WEATHER_GET_TASK_NAME       "Weather get task"  /**< Weather task stack size */
 #define WEATHER_GET_TASK_STACK_SIZE 8192                /**< Weather task stack size */
 #define WEATHER_GET_TASK_PRIORITY   5                   /**< Weather task priority */
-#define WEATHER_GET_RX_BUF_SIZE     1536                /**< Receiving buffer size for weather task */
+#define WEATHER_GET_REQ_BUF_SIZE    512                 /**< Request buffer size for weather task */
+#define WEATHER_GET_BODY_BUF_SIZE   4096                /**< Response body buffer size for cJSON parser */
+#define WEATHER_CJSON_ARENA_SIZE    12288               /**< cJSON tree arena size (see high-water in log) */
 #define WEATHER_GET_RX_TIMEOUT_S    10                  /**< Receiving timeout in seconds */
+#define WEATHER_GET_PERIOD_MS       30000               /**< Weather polling period in milliseconds */
+#define WEATHER_CONN_IDLE_TIMEOUT_S 55                  /**< Keep-alive connection idle timeout in seconds */
+#define WEATHER_CONN_SESSION_KEY    "tls_weather"       /**< NVS key of weather server TLS session */
+#define WEATHER_RECORD_NAMESPACE    "storage"           /**< NVS namespace shared with time_sync */
+#define WEATHER_RECORD_KEY_FMT      "wrec%u"            /**< NVS key format of location weather record */
+#define WEATHER_EXPORT_BUF_SIZE     256                 /**< Exported record text size */
+#define WEATHER_FORECAST_PERIOD_S   1800                /**< Forecast refresh period in seconds */
+#define WEATHER_DATE_STR_SIZE       16                  /**< Forecast day text size */
+#define WEATHER_HTTP_DATE_SIZE      32                  /**< Longest kept Date header (IMF-fixdate is 29 characters) */
+
+#define WEATHER_PARSER_STREAM       1                   /**< Weather parser: 1 - streaming extractor, 0 - cJSON */
+#define WEATHER_GET_COMPRESSION     1                   /**< Ask for gzip/deflate response body */
+#ifndef WEATHER_ENGINE_BENCH
+#define WEATHER_ENGINE_BENCH        0                   /**< Measure concurrent vs sequential fetches on start (idf.py -DWEATHER_ENGINE_BENCH=1) */
+#endif
+#ifndef WEATHER_NUMBER_BENCH
+#define WEATHER_NUMBER_BENCH        0                   /**< Measure number decoding on start (idf.py -DWEATHER_NUMBER_BENCH=1) */
+#endif
+#ifndef WEATHER_TIMER_JITTER
+#define WEATHER_TIMER_JITTER        0                   /**< Measure esp_timer dispatch delay (idf.py -DWEATHER_TIMER_JITTER=1) */
+#endif
+#define WEATHER_JITTER_PERIOD_US    10000               /**< Dispatch delay probe period in microseconds */
+
+#if WEATHER_GET_COMPRESSION
+#define WEATHER_GET_ACCEPT_ENCODING HTTP_INFLATE_ACCEPT_ENCODING
+#else
+#define WEATHER_GET_ACCEPT_ENCODING ""
+#endif
 
 #define APP_DELAY_COMMON_MS         5000                /**< Common used delay in milliseconds */
 
-/**< Time update period (1 day) */
-#define APP_TIME_UPDATE_PERIOD  (86400000000ULL)
-
-/**< Yandex Weather API root certificate */
-#define API_YANDEX_ROOT_CERT \
-"-----BEGIN CERTIFICATE-----\n" \
-"MIIETjCCAzagAwIBAgINAe5fIh38YjvUMzqFVzANBgkqhkiG9w0BAQsFADBMMSAw\n" \
-"HgYDVQQLExdHbG9iYWxTaWduIFJvb3QgQ0EgLSBSMzETMBEGA1UEChMKR2xvYmFs\n" \
-"U2lnbjETMBEGA1UEAxMKR2xvYmFsU2lnbjAeFw0xODExMjEwMDAwMDBaFw0yODEx\n" \
-"MjEwMDAwMDBaMFAxCzAJBgNVBAYTAkJFMRkwFwYDVQQKExBHbG9iYWxTaWduIG52\n" \
-"LXNhMSYwJAYDVQQDEx1HbG9iYWxTaWduIFJTQSBPViBTU0wgQ0EgMjAxODCCASIw\n" \
-"DQYJKoZIhvcNAQEBBQADggEPADCCAQoCggEBAKdaydUMGCEAI9WXD+uu3Vxoa2uP\n" \
-"UGATeoHLl+6OimGUSyZ59gSnKvuk2la77qCk8HuKf1UfR5NhDW5xUTolJAgvjOH3\n" \
-"idaSz6+zpz8w7bXfIa7+9UQX/dhj2S/TgVprX9NHsKzyqzskeU8fxy7quRU6fBhM\n" \
-"abO1IFkJXinDY+YuRluqlJBJDrnw9UqhCS98NE3QvADFBlV5Bs6i0BDxSEPouVq1\n" \
-"lVW9MdIbPYa+oewNEtssmSStR8JvA+Z6cLVwzM0nLKWMjsIYPJLJLnNvBhBWk0Cq\n" \
-"o8VS++XFBdZpaFwGue5RieGKDkFNm5KQConpFmvv73W+eka440eKHRwup08CAwEA\n" \
-"AaOCASkwggElMA4GA1UdDwEB/wQEAwIBhjASBgNVHRMBAf8ECDAGAQH/AgEAMB0G\n" \
-"A1UdDgQWBBT473/yzXhnqN5vjySNiPGHAwKz6zAfBgNVHSMEGDAWgBSP8Et/qC5F\n" \
-"JK5NUPpjmove4t0bvDA+BggrBgEFBQcBAQQyMDAwLgYIKwYBBQUHMAGGImh0dHA6\n" \
-"Ly9vY3NwMi5nbG9iYWxzaWduLmNvbS9yb290cjMwNgYDVR0fBC8wLTAroCmgJ4Yl\n" \
-"aHR0cDovL2NybC5nbG9iYWxzaWduLmNvbS9yb290LXIzLmNybDBHBgNVHSAEQDA+\n" \
-"MDwGBFUdIAAwNDAyBggrBgEFBQcCARYmaHR0cHM6Ly93d3cuZ2xvYmFsc2lnbi5j\n" \
-"b20vcmVwb3NpdG9yeS8wDQYJKoZIhvcNAQELBQADggEBAJmQyC1fQorUC2bbmANz\n" \
-"EdSIhlIoU4r7rd/9c446ZwTbw1MUcBQJfMPg+NccmBqixD7b6QDjynCy8SIwIVbb\n" \
-"0615XoFYC20UgDX1b10d65pHBf9ZjQCxQNqQmJYaumxtf4z1s4DfjGRzNpZ5eWl0\n" \
-"6r/4ngGPoJVpjemEuunl1Ig423g7mNA2eymw0lIYkN5SQwCuaifIFJ6GlazhgDEw\n" \
-"fpolu4usBCOmmQDo8dIm7A9+O4orkjgTHY+GzYZSR+Y0fFukAj6KYXwidlNalFMz\n" \
-"hriSqHKvoflShx8xpfywgVcvzfTO3PYkz6fiNJBonf6q8amaEsybwMbDqKWwIX7e\n" \
-"SPY=\n" \
-"-----END CERTIFICATE-----\n\n\0"
-    
+#define APP_READY_NETWORK_BIT       BIT0                /**< Station has an address */
+#define APP_READY_TIME_BIT          BIT1                /**< System time is known within the error bound */
+#define APP_READY_NETWORK_TIMEOUT_MS 30000              /**< Longest wait for an address */
+#define APP_READY_TIME_TIMEOUT_MS   5000                /**< Longest wait for a sync (a restored lower bound passes TLS checks) */
+
+#define APP_TIME_ERROR_BOUND_MS     1000                /**< Clock error allowed between time syncs */
+#define APP_TIME_SYNC_MIN_S         3600                /**< Shortest time sync interval (1 hour) */
+#define APP_TIME_SYNC_MAX_S         (7 * 86400)         /**< Longest time sync interval (1 week) */
+
 /******************** STRUCTURES, ENUMS, UNIONS ********************/
 
+/**
+ *  @brief  Startup dependency: a bit of the readiness group and how long to wait for it
+ */
+typedef struct app_ready_dep_s
+{
+    EventBits_t bit;
+    const char * ptr_name;
+    uint32_t timeout_ms;        /**< Counted from the moment the dependencies before it are satisfied */
+} app_ready_dep_t;
+
 typedef struct pogoda_ctx_s
 {
-    EventGroupHandle_t wifi_event_group;
+    EventGroupHandle_t ready_event_group;    /**< Readiness bits (APP_READY_*) */
     uint32_t try_num;
+    esp_netif_t * ptr_netif;        /**< Station interface */
+    bool is_ap_pinned;              /**< Cached access point is joined without a full scan */
+    bool is_lease_reused;           /**< Cached lease is applied instead of a DHCP exchange */
+    bool has_ip;                    /**< Address was obtained since boot */
+    wifi_cache_lease_t lease;       /**< Lease being reused */
+    esp_timer_handle_t lease_timer; /**< DHCP restart before the reused lease expires */
 } pogoda_ctx_t;
 
+typedef struct weather_body_s
+{
+#if WEATHER_PARSER_STREAM
+    weather_extract_t extract;
+#else
+    char buf[WEATHER_GET_BODY_BUF_SIZE];
+    size_t len;
+    json_arena_t arena;
+    uint64_t arena_buf[WEATHER_CJSON_ARENA_SIZE / sizeof(uint64_t)];
+#endif
+    forecast_decoder_t forecast;
+    bool is_forecast;           /**< Current response is decoded into the forecast model */
+    weather_record_t record;
+    http_inflate_t inflate;
+    int64_t batch_start_us;
+    const weather_conn_t * ptr_conn;    /**< Connection, its request send time bounds the Date stamp */
+    char date[WEATHER_HTTP_DATE_SIZE];  /**< Date header of the current response (empty if none) */
+    int64_t date_received_us;           /**< Time the Date header was received */
+} weather_body_t;
+
+typedef struct weather_location_s
+{
+    const char * ptr_name;
+    const char * ptr_lat;
+    const char * ptr_lon;
+} weather_location_t;
+
+typedef struct weather_place_s
+{
+    const weather_location_t * ptr_location;
+    const char * ptr_req_fmt;   /**< Request format (latitude, longitude) */
+    int64_t next_us;            /**< Earliest time of the next request */
+    http_cache_t cache;
+    weather_snapshot_t snapshot;    /**< Last record delivered to consumers */
+    char req[WEATHER_GET_REQ_BUF_SIZE];
+    weather_body_t * ptr_body;  /**< Shared, pipelined responses are decoded one after another */
+} weather_place_t;
+
+#if WEATHER_TIMER_JITTER
+typedef struct weather_jitter_s
+{
+    int64_t expected_us;        /**< Time the next probe callback is due */
+    uint32_t ticks;             /**< Callbacks since the last report */
+    int64_t sum_us;             /**< Sum of dispatch delays since the last report */
+    int64_t max_us;             /**< Longest dispatch delay since the last report */
+    int64_t max_total_us;       /**< Longest dispatch delay since start */
+} weather_jitter_t;
+#endif
+
+#if WEATHER_NUMBER_BENCH
+typedef struct weather_number_bench_s
+{
+    uint32_t numbers;
+    uint64_t strtod_cycles;
+    uint64_t scaled_cycles;
+    uint32_t mismatches;
+} weather_number_bench_t;
+#endif
+
 /******************** GLOBAL VARIABLES ********************/
 
 static pogoda_ctx_t global_ctx = {0};
 
+/**< Startup dependencies in the order they are satisfied, the weather fetch needs all of them.
+     Stored state (NVS, CA store, caches, clock) is loaded synchronously before them */
+static const app_ready_dep_t app_ready_deps[] = {
+    { APP_READY_NETWORK_BIT,    "network",  APP_READY_NETWORK_TIMEOUT_MS },
+    { APP_READY_TIME_BIT,       "time",     APP_READY_TIME_TIMEOUT_MS },
+};
+#define APP_READY_DEPS_QTY      (sizeof(app_ready_deps) / sizeof(app_ready_deps[0]))
+
+/**< Weather locations, all of them are requested over one connection */
+static const weather_location_t weather_locations[] = {
+    { "Saint-Petersburg",   "59.9386", "30.3141" },
+    { "Moscow",             "55.7558", "37.6173" },
+    { "Novosibirsk",        "55.0084", "82.9357" },
+    { "Yekaterinburg",      "56.8389", "60.6057" },
+};
+#define WEATHER_LOCATIONS_QTY   (sizeof(weather_locations) / sizeof(weather_locations[0]))
+
+/**< Forecast of the first location, one array per value for aggregation loops */
+static forecast_model_t weather_forecast;
+
+/**< Consumers of location records, notified of changed fields only */
+static weather_change_t weather_changes;
+
+/**< Forecast is displayed only if its fingerprint changed */
+static weather_fingerprint_t weather_forecast_gate;
+
+#if WEATHER_TIMER_JITTER
+/**< esp_timer dispatch delay, any long timer callback shows up here */
+static weather_jitter_t weather_jitter;
+#endif
+
+/**< Yandex Weather API root certificate (DER, converted at build time) */
+extern const uint8_t api_yandex_root_der_start[] asm("_binary_api_yandex_root_der_start");
+extern const uint8_t api_yandex_root_der_end[] asm("_binary_api_yandex_root_der_end");
+
+#if WEATHER_NUMBER_BENCH
+/**< Recorded /v2/forecast response (text, NULL-terminated) */
+extern const char forecast_json_start[] asm("_binary_forecast_json_start");
+extern const char forecast_json_end[] asm("_binary_forecast_json_end");
+#endif
+
 /******************** PRIVATE FUNCTION PROTOTYPES ********************/
 
 static void net_event_handler(void * ptr_arg, 
                                 esp_event_base_t event_base, 
                                 int32_t event_id, 
                                 void * ptr_event_data);
-static void wifi_init(void);
+static void wifi_lease_expire(void * ptr_arg);
+static void wifi_unpin(void);
+static void wifi_init(bool is_time_known);
+static bool app_wait_ready(EventBits_t bit, int64_t start_us);
+#if !WEATHER_PARSER_STREAM
+static void weather_parse_cjson(const char * ptr_str, json_arena_t * ptr_arena, weather_record_t * ptr_record);
+#endif
+static size_t weather_place_request(weather_place_t * ptr_place);
+static bool weather_place_enqueue(weather_place_t * ptr_place,
+                                  weather_conn_req_t * ptr_req,
+                                  const http_resp_cbs_t * ptr_cbs,
+                                  weather_conn_begin_cb_t begin_cb,
+                                  weather_conn_done_cb_t done_cb);
+static void weather_header_collect(const char * ptr_name, const char * ptr_value, void * ptr_arg);
+static void weather_time_sample(const weather_place_t * ptr_place);
+static void weather_body_feed(const char * ptr_data, size_t len, void * ptr_arg);
+static void weather_body_collect(const char * ptr_data, size_t len, void * ptr_arg);
+static void weather_resp_begin(void * ptr_arg);
+static void weather_resp_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg);
+static void weather_forecast_begin(void * ptr_arg);
+static void weather_forecast_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg);
+static void weather_forecast_drop(weather_place_t * ptr_place);
 static void weather_get_task(void * ptr_params);
-static void weather_display(const char * ptr_str);
+static void weather_display(const char * ptr_name, const weather_record_t * ptr_record, uint16_t fields);
+static void weather_display_changes(size_t index,
+                                    const weather_snapshot_t * ptr_snapshot,
+                                    uint16_t changed,
+                                    void * ptr_arg);
+static void weather_forecast_show(const char * ptr_name);
+static void weather_forecast_display(const char * ptr_name, const forecast_model_t * ptr_model);
+static void weather_export(size_t index, const weather_snapshot_t * ptr_snapshot, uint16_t changed, void * ptr_arg);
+static void weather_record_save(size_t index, const weather_snapshot_t * ptr_snapshot, uint16_t changed, void * ptr_arg);
+static void weather_change_log_stats(void);
+static bool weather_record_load(size_t index, weather_record_t * ptr_record);
+static esp_err_t ca_store_init(void);
+#if WEATHER_ENGINE_BENCH
+static void weather_bench_body(const char * ptr_data, size_t len, void * ptr_arg);
+static void weather_bench_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg);
+static void weather_engine_bench(void);
+#endif
+#if WEATHER_TIMER_JITTER
+static void weather_jitter_tick(void * ptr_arg);
+static void weather_jitter_start(void);
+static void weather_jitter_log(void);
+#endif
+#if WEATHER_NUMBER_BENCH
+static void weather_number_value(const char * ptr_path,
+                                 json_stream_type_t type,
+                                 const char * ptr_value,
+                                 size_t len,
+                                 void * ptr_arg);
+static void weather_number_bench(void);
+#endif
 
 /******************** PRIVATE FUNCTIONS ********************/
 
+/**
+ *  @brief      Reused lease is about to expire, DHCP takes over
+ *
+ *  @param[in]  ptr_arg     Argument pointer (don't used)
+ */
+static void wifi_lease_expire(void * ptr_arg)
+{
+    if (global_ctx.is_lease_reused)
+    {
+        global_ctx.is_lease_reused = false;
+        esp_netif_dhcpc_start(global_ctx.ptr_netif);
+    }
+}
+
+/**
+ *  @brief      Fast join fallback: full scan and DHCP from now on
+ */
+static void wifi_unpin(void)
+{
+    wifi_config_t wifi_config;
+
+    if (global_ctx.is_ap_pinned)
+    {
+        global_ctx.is_ap_pinned = false;
+        esp_wifi_get_config(WIFI_IF_STA, &wifi_config);
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    }
+    if (global_ctx.is_lease_reused)
+    {
+        global_ctx.is_lease_reused = false;
+        esp_timer_stop(global_ctx.lease_timer);
+        esp_netif_dhcpc_start(global_ctx.ptr_netif);
+    }
+}
+
 /**
  *  @brief      Network operations handler
  *
  *  @param[in]  ptr_arg         Argument pointer (don't used)
  *  @param[in]  event_base      Event base
  *  @param[in]  event_id        Event ID
- *  @param[in]  ptr_event_data  Event data pointer (don't used)
+ *  @param[in]  ptr_event_data  Event data pointer
  */  
 static void net_event_handler(void * ptr_arg, 
                                 esp_event_base_t event_base, 
@@ -143,9 +376,36 @@ static void net_event_handler(void * ptr_arg,
     {
         esp_wifi_connect();
     }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+    {
+        const wifi_event_sta_connected_t * ptr_event = (const wifi_event_sta_connected_t *) ptr_event_data;
+
+        phase_trace_mark(PHASE_TRACE_ASSOCIATED);
+        wifi_cache_store_ap(ptr_event->bssid, ptr_event->channel);
+        if (global_ctx.is_lease_reused)
+        {
+            /* Default handler has just started DHCP, the lease replaces it and IP event follows */
+            esp_netif_dns_info_t dns = { .ip.u_addr.ip4 = global_ctx.lease.dns, .ip.type = ESP_IPADDR_TYPE_V4 };
+            esp_netif_dhcpc_stop(global_ctx.ptr_netif);
+            esp_netif_set_ip_info(global_ctx.ptr_netif, &global_ctx.lease.ip_info);
+            esp_netif_set_dns_info(global_ctx.ptr_netif, ESP_NETIF_DNS_MAIN, &dns);
+        }
+    }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) 
     {
-        if (global_ctx.try_num < APP_WIFI_CONN_TRY_QTY) 
+        xEventGroupClearBits(global_ctx.ready_event_group, APP_READY_NETWORK_BIT);
+        if (global_ctx.is_ap_pinned || global_ctx.is_lease_reused)
+        {
+            /* Cached access point is gone or the lease is refused: they are not tried again */
+            if (!global_ctx.has_ip)
+            {
+                ESP_LOGW("Get", "Fast join failed, falling back to a full scan and DHCP");
+                wifi_cache_forget();
+            }
+            wifi_unpin();
+            esp_wifi_connect();
+        }
+        else if (global_ctx.try_num < APP_WIFI_CONN_TRY_QTY) 
         {
             esp_wifi_connect();
             global_ctx.try_num++;
@@ -153,22 +413,46 @@ static void net_event_handler(void * ptr_arg,
     } 
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) 
     {
+        phase_trace_mark(PHASE_TRACE_GOT_IP);
         global_ctx.try_num = 0;
+        if (!global_ctx.has_ip)
+        {
+            global_ctx.has_ip = true;
+            ESP_LOGI("Get", "Got IP %lld ms after boot (cached access point: %s, cached lease: %s)",
+                     esp_timer_get_time() / 1000,
+                     global_ctx.is_ap_pinned ? "yes" : "no",
+                     global_ctx.is_lease_reused ? "yes" : "no");
+        }
+        if (!global_ctx.is_lease_reused)
+        {
+            wifi_cache_store_lease(global_ctx.ptr_netif, time(NULL));
+        }
+        xEventGroupSetBits(global_ctx.ready_event_group, APP_READY_NETWORK_BIT);
+        if (0 == (xEventGroupGetBits(global_ctx.ready_event_group) & APP_READY_TIME_BIT))
+        {
+            /* However late the network comes up, the clock is synced as soon as it can be */
+            ESP_LOGI("Get", "Requesting time sync");
+            fetch_and_store_time_in_nvs(NULL);
+        }
     }
 }
 
 /**
  *  @brief WiFi initializaiton and connecting function
+ *
+ *  The cached access point is joined on its channel without a full scan,
+ *  the cached lease is applied instead of DHCP while it is valid.
+ *
+ *  @param[in]  is_time_known   System time is known within the error bound (lease validity can be checked)
  */
-static void wifi_init(void)
+static void wifi_init(bool is_time_known)
 {
-    global_ctx.wifi_event_group = xEventGroupCreate();
     global_ctx.try_num = 0;
 
     ESP_ERROR_CHECK(esp_netif_init());
 
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    global_ctx.ptr_netif = esp_netif_create_default_wifi_sta();
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
@@ -194,9 +478,464 @@ static void wifi_init(void)
             .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
         },
     };
+    ESP_ERROR_CHECK(wifi_cache_init());
+    global_ctx.is_ap_pinned = wifi_cache_get_ap(wifi_config.sta.bssid, &wifi_config.sta.channel);
+    wifi_config.sta.bssid_set = global_ctx.is_ap_pinned;
+
+    /* One clock reading for the validity check and the timer, so a second boundary cannot make the period negative */
+    time_t now = time(NULL);
+    global_ctx.is_lease_reused = is_time_known && wifi_cache_get_lease(now, &global_ctx.lease);
+    if (global_ctx.is_lease_reused)
+    {
+        const esp_timer_create_args_t lease_timer_args = {
+            .callback = &wifi_lease_expire,
+            .name = "wifi_lease",
+        };
+        int64_t left_s = global_ctx.lease.expires_s - now - WIFI_CACHE_LEASE_MARGIN_S;
+        ESP_ERROR_CHECK(esp_timer_create(&lease_timer_args, &global_ctx.lease_timer));
+        ESP_ERROR_CHECK(esp_timer_start_once(global_ctx.lease_timer, (left_s > 0) ? left_s * 1000000LL : 0));
+    }
+
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
     ESP_ERROR_CHECK(esp_wifi_start());
+    phase_trace_mark(PHASE_TRACE_WIFI_START);
+}
+
+/**
+ *  @brief      Wait for a startup dependency, at most for its timeout
+ *
+ *  @param[in]  bit         Dependency bit (APP_READY_*)
+ *  @param[in]  start_us    Boot sequence start (for the log)
+ *
+ *  @return     true if the dependency is satisfied, false if its wait timed out
+ */
+static bool app_wait_ready(EventBits_t bit, int64_t start_us)
+{
+    const app_ready_dep_t * ptr_dep = NULL;
+    for (size_t i = 0; i < APP_READY_DEPS_QTY; i++)
+    {
+        if (app_ready_deps[i].bit == bit)
+        {
+            ptr_dep = &app_ready_deps[i];
+        }
+    }
+
+    EventBits_t bits = xEventGroupWaitBits(global_ctx.ready_event_group, bit, pdFALSE, pdTRUE,
+                                           ptr_dep->timeout_ms / portTICK_PERIOD_MS);
+    bool is_ready = (0 != (bits & bit));
+    if (is_ready)
+    {
+        ESP_LOGI("Get", "Startup: %s is ready in %lld ms", ptr_dep->ptr_name, (esp_timer_get_time() - start_us) / 1000);
+    }
+    else
+    {
+        ESP_LOGW("Get", "Startup: %s is not ready in %u ms, going on without it", ptr_dep->ptr_name, ptr_dep->timeout_ms);
+    }
+
+    return is_ready;
+}
+
+#if !WEATHER_PARSER_STREAM
+/**
+ *  @brief      Weather parse function (cJSON DOM)
+ *
+ *  The tree is allocated from the response arena, so parsing does not
+ *  fragment the heap and the whole tree is released at once.
+ *
+ *  @param[in]  ptr_str     NULL-terminated string pointer
+ *  @param[in]  ptr_arena   Response arena pointer
+ *  @param[out] ptr_record  Weather record pointer
+ */
+static void weather_parse_cjson(const char * ptr_str, json_arena_t * ptr_arena, weather_record_t * ptr_record)
+{
+    if (NULL == ptr_str)
+    {
+        ESP_LOGE("Display", "NULL string pointer");
+        return;
+    }
+
+    cJSON_Hooks hooks = {
+        .malloc_fn = &json_arena_malloc,
+        .free_fn = &json_arena_free,
+    };
+    uint32_t failures = ptr_arena->failures;
+    json_arena_begin(ptr_arena);
+    cJSON_InitHooks(&hooks);
+
+    cJSON * ptr_json_root = cJSON_Parse(ptr_str);
+    cJSON * ptr_json_fact = cJSON_GetObjectItem(ptr_json_root, "fact");
+    cJSON * ptr_json_condition = cJSON_GetObjectItem(ptr_json_fact, "condition");
+    cJSON * ptr_json_temp = cJSON_GetObjectItem(ptr_json_fact, "temp");
+    if (cJSON_IsString(ptr_json_condition) && cJSON_IsNumber(ptr_json_temp))
+    {
+        ptr_record->condition = weather_condition_from_str(ptr_json_condition->valuestring,
+                                                           strlen(ptr_json_condition->valuestring));
+        ptr_record->temp_dc = (int16_t) (ptr_json_temp->valueint * 10);
+        ptr_record->fields |= WEATHER_RECORD_CONDITION | WEATHER_RECORD_TEMP;
+    }
+    else
+    {
+        ESP_LOGE("Display", "Cannot parse weather response");
+    }
+
+    if (ptr_arena->failures != failures)
+    {
+        ESP_LOGW("Get", "cJSON arena is exhausted (%u bytes)", (unsigned int) ptr_arena->size);
+    }
+    ESP_LOGI("Get", "cJSON arena: %u bytes in %u allocations, high-water %u of %u bytes",
+             (unsigned int) ptr_arena->used,
+             ptr_arena->allocs,
+             (unsigned int) ptr_arena->high_water,
+             (unsigned int) ptr_arena->size);
+
+    /* Tree is released at once on every path, no cJSON_Delete() walk */
+    cJSON_InitHooks(NULL);
+    json_arena_end(ptr_arena);
+}
+#endif
+/**
+ *  @brief      Request for the place with conditional headers
+ *
+ *  @param[in]  ptr_place   Place context pointer
+ *
+ *  @return     Request length, 0 if it does not fit the buffer
+ */
+static size_t weather_place_request(weather_place_t * ptr_place)
+{
+    char head[WEATHER_GET_REQ_BUF_SIZE];
+    int len = snprintf(head, sizeof(head), ptr_place->ptr_req_fmt,
+                       ptr_place->ptr_location->ptr_lat,
+                       ptr_place->ptr_location->ptr_lon);
+    if ((len < 0) || ((size_t) len >= sizeof(head)))
+    {
+        return 0;
+    }
+
+    return http_cache_build_request(&ptr_place->cache, head, ptr_place->req, sizeof(ptr_place->req));
+}
+
+/**
+ *  @brief      Add the place request to the batch
+ *
+ *  @param[in]  ptr_place   Place context pointer
+ *  @param[out] ptr_req     Batch request
+ *  @param[in]  ptr_cbs     Response parser callbacks
+ *  @param[in]  begin_cb    Response start callback
+ *  @param[in]  done_cb     Response completion callback
+ *
+ *  @return     false if the request does not fit the buffer
+ */
+static bool weather_place_enqueue(weather_place_t * ptr_place,
+                                  weather_conn_req_t * ptr_req,
+                                  const http_resp_cbs_t * ptr_cbs,
+                                  weather_conn_begin_cb_t begin_cb,
+                                  weather_conn_done_cb_t done_cb)
+{
+    size_t req_len = weather_place_request(ptr_place);
+    if (0 == req_len)
+    {
+        ESP_LOGE("Get", "%s: request does not fit the buffer", ptr_place->ptr_location->ptr_name);
+        return false;
+    }
+    ptr_req->ptr_req = ptr_place->req;
+    ptr_req->req_len = req_len;
+    ptr_req->ptr_cbs = ptr_cbs;
+    ptr_req->begin_cb = begin_cb;
+    ptr_req->done_cb = done_cb;
+    ptr_req->ptr_arg = ptr_place;
+
+    return true;
+}
+
+/**
+ *  @brief      Response header consuming function
+ *
+ *  @param[in]  ptr_name    Header name
+ *  @param[in]  ptr_value   Header value
+ *  @param[in]  ptr_arg     Place context pointer
+ */
+static void weather_header_collect(const char * ptr_name, const char * ptr_value, void * ptr_arg)
+{
+    weather_place_t * ptr_place = (weather_place_t *) ptr_arg;
+
+    http_cache_header(&ptr_place->cache, ptr_name, ptr_value);
+
+    if (0 == strcasecmp(ptr_name, "Content-Encoding"))
+    {
+        http_inflate_coding_t coding = http_inflate_coding(ptr_value);
+        if (HTTP_INFLATE_UNSUPPORTED == coding)
+        {
+            ESP_LOGW("Get", "Unsupported response coding: %s", ptr_value);
+        }
+        http_inflate_begin(&ptr_place->ptr_body->inflate, coding);
+    }
+    else if ((0 == strcasecmp(ptr_name, "Date")) && (strlen(ptr_value) < sizeof(ptr_place->ptr_body->date)))
+    {
+        /* Taken as a time sample once the response is complete */
+        strcpy(ptr_place->ptr_body->date, ptr_value);
+        ptr_place->ptr_body->date_received_us = esp_timer_get_time();
+    }
+}
+
+/**
+ *  @brief      Date header of a complete response as a time sample
+ *
+ *  The server stamped it after the requests were sent and before the
+ *  header was received, so the time is known within the round trip.
+ *
+ *  @param[in]  ptr_place   Place context pointer
+ */
+static void weather_time_sample(const weather_place_t * ptr_place)
+{
+    const weather_body_t * ptr_body = ptr_place->ptr_body;
+
+    /* A response served by an intermediate cache carries the Date of its origin */
+    if ((ptr_body->date[0] != '\0') && (0 == ptr_place->cache.pending.age_s))
+    {
+        time_sync_http_date(ptr_body->date, ptr_body->ptr_conn->sent_us, ptr_body->date_received_us);
+    }
+}
+
+/**
+ *  @brief      Encoded response body consuming function
+ *
+ *  @param[in]  ptr_data    Body bytes pointer
+ *  @param[in]  len         Body bytes quantity
+ *  @param[in]  ptr_arg     Place context pointer
+ */
+static void weather_body_feed(const char * ptr_data, size_t len, void * ptr_arg)
+{
+    weather_place_t * ptr_place = (weather_place_t *) ptr_arg;
+
+    http_inflate_feed(ptr_data, len, &ptr_place->ptr_body->inflate);
+}
+
+/**
+ *  @brief      Decoded response body consuming function
+ *
+ *  @param[in]  ptr_data    Body bytes pointer
+ *  @param[in]  len         Body bytes quantity
+ *  @param[in]  ptr_arg     Body context pointer
+ */
+static void weather_body_collect(const char * ptr_data, size_t len, void * ptr_arg)
+{
+    weather_body_t * ptr_body = (weather_body_t *) ptr_arg;
+
+    if (ptr_body->is_forecast)
+    {
+        forecast_decoder_feed(&ptr_body->forecast, ptr_data, len);
+        return;
+    }
+#if WEATHER_PARSER_STREAM
+    /* Parse while receiving, no body buffering */
+    weather_extract_feed(&ptr_body->extract, ptr_data, len);
+#else
+    if (len > sizeof(ptr_body->buf) - 1 - ptr_body->len)
+    {
+        ESP_LOGW("Get", "Response body is too long, truncated");
+        len = sizeof(ptr_body->buf) - 1 - ptr_body->len;
+    }
+    memcpy(ptr_body->buf + ptr_body->len, ptr_data, len);
+    ptr_body->len += len;
+    ptr_body->buf[ptr_body->len] = '\0';
+#endif
+}
+
+/**
+ *  @brief      Response start, the shared body decoder is reset for the place
+ *
+ *  @param[in]  ptr_arg     Place context pointer
+ */
+static void weather_resp_begin(void * ptr_arg)
+{
+    weather_place_t * ptr_place = (weather_place_t *) ptr_arg;
+    weather_body_t * ptr_body = ptr_place->ptr_body;
+
+    ptr_body->is_forecast = false;
+#if WEATHER_PARSER_STREAM
+    weather_extract_init(&ptr_body->extract, &ptr_body->record);
+#else
+    memset(&ptr_body->record, 0x00, sizeof(ptr_body->record));
+    ptr_body->len = 0;
+    ptr_body->buf[0] = '\0';
+#endif
+    http_inflate_begin(&ptr_body->inflate, HTTP_INFLATE_IDENTITY);
+    http_cache_response_begin(&ptr_place->cache);
+    ptr_body->date[0] = '\0';
+}
+
+/**
+ *  @brief      Response completion, responses arrive in request order
+ *
+ *  @param[in]  err         Request result
+ *  @param[in]  ptr_resp    Response parser
+ *  @param[in]  ptr_arg     Place context pointer
+ */
+static void weather_resp_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg)
+{
+    weather_place_t * ptr_place = (weather_place_t *) ptr_arg;
+    weather_body_t * ptr_body = ptr_place->ptr_body;
+    const char * ptr_name = ptr_place->ptr_location->ptr_name;
+
+    if (ESP_OK != err)
+    {
+        ESP_LOGE("Get", "%s: weather request failed: %s", ptr_name, esp_err_to_name(err));
+        return;
+    }
+
+    weather_time_sample(ptr_place);
+    if (HTTP_CACHE_NOT_MODIFIED == http_cache_response_end(&ptr_place->cache,
+                                                               ptr_resp->status,
+                                                               esp_timer_get_time()))
+    {
+        ESP_LOGI("Get", "%s: weather is not modified", ptr_name);
+        weather_change_update(&weather_changes, &ptr_place->snapshot,
+                              ptr_place->ptr_location - weather_locations, &ptr_place->snapshot.record);
+    }
+    else if (200 != ptr_resp->status)
+    {
+        ESP_LOGE("Get", "%s: weather request HTTP status: %d", ptr_name, ptr_resp->status);
+    }
+    else
+    {
+        ESP_LOGI("Get", "%s: body %llu bytes received, %llu bytes decoded (%s), done in %lld ms",
+                 ptr_name,
+                 ptr_body->inflate.in_bytes,
+                 ptr_body->inflate.out_bytes,
+                 (HTTP_INFLATE_IDENTITY == ptr_body->inflate.coding) ? "uncompressed" : "compressed",
+                 (esp_timer_get_time() - ptr_body->batch_start_us) / 1000);
+        bool is_decoded = true;
+        if (!http_inflate_finish(&ptr_body->inflate))
+        {
+            ESP_LOGW("Get", "%s: weather response body cannot be decoded", ptr_name);
+            is_decoded = false;
+        }
+#if WEATHER_PARSER_STREAM
+        if (!weather_extract_finish(&ptr_body->extract))
+        {
+            ESP_LOGW("Get", "%s: weather response JSON is malformed", ptr_name);
+            is_decoded = false;
+        }
+#else
+        weather_parse_cjson(strchr(ptr_body->buf, '{'), &ptr_body->arena, &ptr_body->record);
+#endif
+        phase_trace_mark(PHASE_TRACE_PARSE_DONE);
+        if (!is_decoded)
+        {
+            /* Fields of a truncated body may be present but wrong, a 304 must not keep them */
+            http_cache_invalidate(&ptr_place->cache);
+        }
+        else if ((ptr_body->record.fields & WEATHER_RECORD_REQUIRED) == WEATHER_RECORD_REQUIRED)
+        {
+            if (0 == weather_change_update(&weather_changes, &ptr_place->snapshot,
+                                           ptr_place->ptr_location - weather_locations, &ptr_body->record))
+            {
+                ESP_LOGI("Get", "%s: weather is unchanged", ptr_name);
+            }
+        }
+        else
+        {
+            ESP_LOGE("Display", "%s: cannot parse weather response", ptr_name);
+            http_cache_invalidate(&ptr_place->cache);
+        }
+    }
+}
+
+/**
+ *  @brief      Forecast response start, the body goes to the generated decoder
+ *
+ *  @param[in]  ptr_arg     Place context pointer
+ */
+static void weather_forecast_begin(void * ptr_arg)
+{
+    weather_place_t * ptr_place = (weather_place_t *) ptr_arg;
+    weather_body_t * ptr_body = ptr_place->ptr_body;
+
+    ptr_body->is_forecast = true;
+    forecast_decoder_init(&ptr_body->forecast, &weather_forecast);
+    http_inflate_begin(&ptr_body->inflate, HTTP_INFLATE_IDENTITY);
+    http_cache_response_begin(&ptr_place->cache);
+    ptr_body->date[0] = '\0';
+}
+
+/**
+ *  @brief      Forecast response completion
+ *
+ *  @param[in]  err         Request result
+ *  @param[in]  ptr_resp    Response parser
+ *  @param[in]  ptr_arg     Place context pointer
+ */
+static void weather_forecast_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg)
+{
+    weather_place_t * ptr_place = (weather_place_t *) ptr_arg;
+    weather_body_t * ptr_body = ptr_place->ptr_body;
+    const char * ptr_name = ptr_place->ptr_location->ptr_name;
+
+    if (ESP_OK != err)
+    {
+        ESP_LOGE("Get", "%s: forecast request failed: %s", ptr_name, esp_err_to_name(err));
+        weather_forecast_drop(ptr_place);
+        return;
+    }
+
+    weather_time_sample(ptr_place);
+    if (HTTP_CACHE_NOT_MODIFIED == http_cache_response_end(&ptr_place->cache,
+                                                               ptr_resp->status,
+                                                               esp_timer_get_time()))
+    {
+        ESP_LOGI("Get", "%s: forecast is not modified", ptr_name);
+        weather_forecast_show(ptr_name);
+    }
+    else if (200 != ptr_resp->status)
+    {
+        ESP_LOGE("Get", "%s: forecast request HTTP status: %d", ptr_name, ptr_resp->status);
+        ptr_place->next_us = 0;
+    }
+    else
+    {
+        ESP_LOGI("Get", "%s: forecast body %llu bytes received, %llu bytes decoded, %u values, %u rejected",
+                 ptr_name,
+                 ptr_body->inflate.in_bytes,
+                 ptr_body->inflate.out_bytes,
+                 ptr_body->forecast.values,
+                 ptr_body->forecast.rejected);
+        bool is_decoded = true;
+        if (!http_inflate_finish(&ptr_body->inflate))
+        {
+            ESP_LOGW("Get", "%s: forecast response body cannot be decoded", ptr_name);
+            is_decoded = false;
+        }
+        if (!forecast_decoder_finish(&ptr_body->forecast))
+        {
+            ESP_LOGW("Get", "%s: forecast response JSON is malformed", ptr_name);
+            is_decoded = false;
+        }
+        phase_trace_mark(PHASE_TRACE_PARSE_DONE);
+        if (is_decoded && (weather_forecast.days > 0))
+        {
+            weather_forecast_show(ptr_name);
+        }
+        else
+        {
+            weather_forecast_drop(ptr_place);
+        }
+    }
+}
+
+/**
+ *  @brief      Truncated or malformed forecast is dropped with its validators
+ *
+ *  The decoder has already overwritten the model, a 304 on the next poll
+ *  would keep the broken one until the document changes upstream.
+ *
+ *  @param[in]  ptr_place   Place context pointer
+ */
+static void weather_forecast_drop(weather_place_t * ptr_place)
+{
+    http_cache_invalidate(&ptr_place->cache);
+    forecast_model_clear(&weather_forecast);
+    ptr_place->next_us = 0;
 }
 
 /**
@@ -206,104 +945,671 @@ static void wifi_init(void)
  */
 static void weather_get_task(void * ptr_params)
 {
-    char buf[WEATHER_GET_RX_BUF_SIZE];
+    static weather_conn_t conn;
+    static weather_body_t body;
+    static weather_place_t places[WEATHER_LOCATIONS_QTY];
+    static weather_place_t forecast_place;
+    static weather_conn_req_t reqs[WEATHER_LOCATIONS_QTY + 1];
+    bool is_trace_dumped = false;
 
-    esp_tls_cfg_t cfg = {
-        .cacert_buf = (const unsigned char *) API_YANDEX_ROOT_CERT,
-        .cacert_bytes = strlen(API_YANDEX_ROOT_CERT) + sizeof('\0'),
+    const weather_conn_cfg_t conn_cfg = {
+        .ptr_host = API_YANDEX_HOST,
+        .port = API_YANDEX_PORT,
+        .ptr_cacert = NULL,     /* Shared CA store is used */
+        .cacert_bytes = 0,
+        .timeout_ms = WEATHER_GET_RX_TIMEOUT_S * 1000,
+        .idle_timeout_us = WEATHER_CONN_IDLE_TIMEOUT_S * 1000000LL,
+        .ptr_session_key = WEATHER_CONN_SESSION_KEY,
     };
+    static const http_resp_cbs_t resp_cbs = {
+        .header_cb = &weather_header_collect,
+        .body_cb = &weather_body_feed,
+    };
+    ESP_ERROR_CHECK(weather_conn_init(&conn, &conn_cfg));
+    body.ptr_conn = &conn;
+    ESP_ERROR_CHECK(http_inflate_init(&body.inflate, &weather_body_collect, &body));
+#if !WEATHER_PARSER_STREAM
+    json_arena_init(&body.arena, body.arena_buf, sizeof(body.arena_buf));
+#endif
+    /* Observation time alone changes nothing on the display, and is not worth a flash write:
+       the stored record keeps the observation time of its last stored change */
+    weather_change_init(&weather_changes);
+    weather_change_subscribe(&weather_changes, "Display", WEATHER_RECORD_ALL & ~WEATHER_RECORD_OBS_TIME,
+                             &weather_display_changes, NULL);
+    weather_change_subscribe(&weather_changes, "Export", WEATHER_RECORD_ALL, &weather_export, NULL);
+    weather_change_subscribe(&weather_changes, "Storage", WEATHER_RECORD_ALL & ~WEATHER_RECORD_OBS_TIME,
+                             &weather_record_save, NULL);
+    for (size_t i = 0; i < WEATHER_LOCATIONS_QTY; i++)
+    {
+        weather_record_t record;
+
+        places[i].ptr_location = &weather_locations[i];
+        places[i].ptr_req_fmt = API_YANDEX_GET_REQ_FMT(API_YANDEX_PATH);
+        places[i].ptr_body = &body;
+        http_cache_init(&places[i].cache);
+        if (weather_record_load(i, &record))
+        {
+            ESP_LOGI("Get", "%s: last stored weather:", weather_locations[i].ptr_name);
+            weather_display(weather_locations[i].ptr_name, &record, record.fields);
+            weather_snapshot_init(&places[i].snapshot, &record);
+        }
+        else
+        {
+            weather_snapshot_init(&places[i].snapshot, NULL);
+        }
+    }
+    forecast_place.ptr_location = &weather_locations[0];
+    forecast_place.ptr_req_fmt = API_YANDEX_GET_REQ_FMT(API_YANDEX_FORECAST_PATH);
+    forecast_place.ptr_body = &body;
+    http_cache_init(&forecast_place.cache);
+
+#if WEATHER_ENGINE_BENCH
+    weather_engine_bench();
+#endif
+
+    for (;;)
+    {
+        size_t reqs_qty = 0;
+        uint32_t hits = 0;
+        uint32_t revalidations = 0;
+        uint32_t updates = 0;
 
-    esp_tls_t * ptr_tls = esp_tls_init();
-    if (NULL == ptr_tls)
+        for (size_t i = 0; i < WEATHER_LOCATIONS_QTY; i++)
+        {
+            weather_place_t * ptr_place = &places[i];
+            if (http_cache_is_fresh(&ptr_place->cache, esp_timer_get_time()))
+            {
+                ESP_LOGI("Get", "%s: cached weather is fresh, request skipped", ptr_place->ptr_location->ptr_name);
+                weather_change_update(&weather_changes, &ptr_place->snapshot, i, &ptr_place->snapshot.record);
+                continue;
+            }
+
+            if (weather_place_enqueue(ptr_place, &reqs[reqs_qty], &resp_cbs,
+                                      &weather_resp_begin, &weather_resp_done))
+            {
+                reqs_qty++;
+            }
+        }
+
+        /* Forecast rides along with the batch, but not more often than its period */
+        int64_t now_us = esp_timer_get_time();
+        if ((now_us >= forecast_place.next_us) && !http_cache_is_fresh(&forecast_place.cache, now_us))
+        {
+            if (weather_place_enqueue(&forecast_place, &reqs[reqs_qty], &resp_cbs,
+                                      &weather_forecast_begin, &weather_forecast_done))
+            {
+                forecast_place.next_us = now_us + WEATHER_FORECAST_PERIOD_S * 1000000LL;
+                reqs_qty++;
+            }
+        }
+
+        if (reqs_qty > 0)
+        {
+            /* All requests go over one connection, responses are matched by order */
+            ESP_LOGI("Get", "Requesting %u weather documents...", reqs_qty);
+            body.batch_start_us = esp_timer_get_time();
+            esp_err_t err = weather_conn_pipeline(&conn, reqs, reqs_qty);
+            ESP_LOGI("Get", "Batch of %u requests %s in %lld ms",
+                     reqs_qty,
+                     (ESP_OK == err) ? "completed" : "failed",
+                     (esp_timer_get_time() - body.batch_start_us) / 1000);
+            weather_conn_log_stats(&conn);
+            dns_cache_log_stats();
+
+            /* Full timeline once, then a JSON line per batch for scripts */
+            if (!is_trace_dumped)
+            {
+                phase_trace_dump(stdout);
+                is_trace_dumped = true;
+            }
+            phase_trace_json(stdout);
+        }
+
+        for (size_t i = 0; i < WEATHER_LOCATIONS_QTY; i++)
+        {
+            hits += places[i].cache.hits;
+            revalidations += places[i].cache.revalidations;
+            updates += places[i].cache.updates;
+        }
+        hits += forecast_place.cache.hits;
+        revalidations += forecast_place.cache.revalidations;
+        updates += forecast_place.cache.updates;
+        ESP_LOGI("Get", "Cache hits: %u, not modified: %u, updates: %u", hits, revalidations, updates);
+        weather_change_log_stats();
+#if WEATHER_TIMER_JITTER
+        weather_jitter_log();
+#endif
+        vTaskDelay(WEATHER_GET_PERIOD_MS / portTICK_PERIOD_MS);
+    }
+}
+
+/**
+ *  @brief      Weather display function
+ *
+ *  Lines of the given fields are printed, a line is printed if any of its
+ *  fields is given.
+ *
+ *  @param[in]  ptr_name    Location name
+ *  @param[in]  ptr_record  Weather record pointer
+ *  @param[in]  fields      WEATHER_RECORD_* flags of fields to display
+ */
+static void weather_display(const char * ptr_name, const weather_record_t * ptr_record, uint16_t fields)
+{
+    char num[WEATHER_TENTHS_STR_SIZE];
+    uint16_t shown = ptr_record->fields & fields;
+
+    printf("\n%s weather in %s:\n",
+           (ptr_record->fields & WEATHER_RECORD_ALL & ~WEATHER_RECORD_OBS_TIME & ~fields) ? "Changed" : "Current",
+           ptr_name);
+    if (shown & WEATHER_RECORD_CONDITION)
+    {
+        printf("\tCondition: %s\n", weather_condition_name(ptr_record->condition));
+    }
+    if (shown & WEATHER_RECORD_TEMP)
+    {
+        printf("\tTemperature: %s\n", weather_tenths_str(num, ptr_record->temp_dc));
+    }
+    if (shown & WEATHER_RECORD_FEELS_LIKE)
+    {
+        printf("\tFeels like: %s\n", weather_tenths_str(num, ptr_record->feels_like_dc));
+    }
+    if (shown & WEATHER_RECORD_HUMIDITY)
     {
-        ESP_LOGE("Get", "esp_tls_init()");
+        printf("\tHumidity: %u%%\n", ptr_record->humidity);
+    }
+    if (shown & WEATHER_RECORD_PRESSURE)
+    {
+        printf("\tPressure: %s mm Hg\n", weather_tenths_str(num, ptr_record->pressure_dmm));
+    }
+    if ((ptr_record->fields & WEATHER_RECORD_WIND_SPEED) &&
+        (fields & (WEATHER_RECORD_WIND_SPEED | WEATHER_RECORD_WIND_DIR)))
+    {
+        printf("\tWind: %s m/s %s\n",
+               weather_tenths_str(num, ptr_record->wind_speed_dms),
+               (ptr_record->fields & WEATHER_RECORD_WIND_DIR) ? weather_wind_dir_name(ptr_record->wind_dir) : "");
+    }
+    if (((ptr_record->fields & (WEATHER_RECORD_PART_NAME | WEATHER_RECORD_PART_TEMP)) ==
+         (WEATHER_RECORD_PART_NAME | WEATHER_RECORD_PART_TEMP)) &&
+        (fields & (WEATHER_RECORD_PART_NAME | WEATHER_RECORD_PART_TEMP | WEATHER_RECORD_PART_CONDITION)))
+    {
+        printf("\tNext (%s): %s, %s\n",
+               weather_part_name(ptr_record->part_name),
+               weather_tenths_str(num, ptr_record->part_temp_dc),
+               (ptr_record->fields & WEATHER_RECORD_PART_CONDITION) ?
+                   weather_condition_name(ptr_record->part_condition) : "");
+    }
+}
+
+/**
+ *  @brief      Display consumer, changed fields of a location are printed
+ *
+ *  @param[in]  index           Location index
+ *  @param[in]  ptr_snapshot    Snapshot with the new record
+ *  @param[in]  changed         Changed fields
+ *  @param[in]  ptr_arg         Not used
+ */
+static void weather_display_changes(size_t index,
+                                    const weather_snapshot_t * ptr_snapshot,
+                                    uint16_t changed,
+                                    void * ptr_arg)
+{
+    weather_display(weather_locations[index].ptr_name, &ptr_snapshot->record, changed);
+    phase_trace_mark(PHASE_TRACE_DISPLAY_DONE);
+}
+
+/**
+ *  @brief      Forecast display if the model changed since it was displayed last time
+ *
+ *  The model is too large to keep a copy for a diff, its fingerprint is
+ *  compared instead. The model is cleared before decoding, so equal
+ *  content gives equal bytes.
+ *
+ *  @param[in]  ptr_name    Location name
+ */
+static void weather_forecast_show(const char * ptr_name)
+{
+    if (!weather_fingerprint_update(&weather_forecast_gate, &weather_forecast, sizeof(weather_forecast)))
+    {
+        ESP_LOGI("Display", "%s: forecast is unchanged", ptr_name);
         return;
     }
+    weather_forecast_display(ptr_name, &weather_forecast);
+    phase_trace_mark(PHASE_TRACE_DISPLAY_DONE);
+}
+
+/**
+ *  @brief      Forecast display, a line per day aggregated over the columns
+ *
+ *  Hourly values of a day are contiguous, so every aggregate is one pass
+ *  over a short array. Days without hours are aggregated over parts.
+ *
+ *  @param[in]  ptr_name    Location name
+ *  @param[in]  ptr_model   Forecast model pointer
+ */
+static void weather_forecast_display(const char * ptr_name, const forecast_model_t * ptr_model)
+{
+    char temp_min_str[WEATHER_TENTHS_STR_SIZE];
+    char temp_max_str[WEATHER_TENTHS_STR_SIZE];
+    char prec_str[WEATHER_TENTHS_STR_SIZE];
+    char wind_str[WEATHER_TENTHS_STR_SIZE];
+    char date[WEATHER_DATE_STR_SIZE];
 
-    if (esp_tls_conn_http_new_sync(API_YANDEX_URL, &cfg, ptr_tls) == 1) {
-        ESP_LOGI("Get", "Connection established...");
-    } else {
-        ESP_LOGE("Get", "Connection failed...");
-        esp_tls_conn_destroy(ptr_tls);
+    if (0 == ptr_model->days)
+    {
         return;
-    }    
-    
-    size_t written_bytes = 0;
-    int32_t ret = 0;
-    do {
-        ret = esp_tls_conn_write(ptr_tls,
-                                 API_YANDEX_GET_REQ + written_bytes,
-                                 strlen(API_YANDEX_GET_REQ) - written_bytes);
-        if (ret >= 0) {
-            ESP_LOGI("Get", "%d bytes written", ret);
-            written_bytes += ret;
-        } else if (ret != ESP_TLS_ERR_SSL_WANT_READ  && ret != ESP_TLS_ERR_SSL_WANT_WRITE) {
-            ESP_LOGE("Get", "esp_tls_conn_write  returned: [0x%02X](%s)", ret, esp_err_to_name(ret));
-            esp_tls_conn_destroy(ptr_tls);
-            return;
-        }
-    } while (written_bytes < strlen(API_YANDEX_GET_REQ));
+    }
 
-    ESP_LOGI("Get", "Reading HTTP response...");
-    do {
-        int32_t len = sizeof(buf) - 1;
-        memset(buf, 0x00, sizeof(buf));
-        ret = esp_tls_conn_read(ptr_tls, (char *)buf, len);
+    printf("\nForecast for %s:\n", ptr_name);
+    for (uint32_t day = 0; day < ptr_model->days; day++)
+    {
+        const int16_t * ptr_temp_min;
+        const int16_t * ptr_temp_max;
+        const uint16_t * ptr_prec;
+        const uint16_t * ptr_wind;
+        uint32_t rows;
+        int32_t temp_min = INT16_MAX;
+        int32_t temp_max = INT16_MIN;
+        uint32_t prec = 0;
+        uint32_t wind = 0;
+
+        if (ptr_model->hour_qty[day] > 0)
+        {
+            rows = ptr_model->hour_qty[day];
+            ptr_temp_min = &ptr_model->hour_temp_dc[day * FORECAST_HOURS_MAX];
+            ptr_temp_max = ptr_temp_min;
+            ptr_prec = &ptr_model->hour_prec_dmm[day * FORECAST_HOURS_MAX];
+            ptr_wind = &ptr_model->hour_wind_speed_dms[day * FORECAST_HOURS_MAX];
+        }
+        else
+        {
+            rows = FORECAST_PARTS_QTY;
+            ptr_temp_min = &ptr_model->part_temp_min_dc[day * FORECAST_PARTS_QTY];
+            ptr_temp_max = &ptr_model->part_temp_max_dc[day * FORECAST_PARTS_QTY];
+            ptr_prec = &ptr_model->part_prec_dmm[day * FORECAST_PARTS_QTY];
+            ptr_wind = &ptr_model->part_wind_speed_dms[day * FORECAST_PARTS_QTY];
+        }
 
-        if (ret == ESP_TLS_ERR_SSL_WANT_WRITE  || ret == ESP_TLS_ERR_SSL_WANT_READ) {
+        for (uint32_t i = 0; i < rows; i++)
+        {
+            if ((FORECAST_NONE_INT16 != ptr_temp_min[i]) && (ptr_temp_min[i] < temp_min))
+            {
+                temp_min = ptr_temp_min[i];
+            }
+            if ((FORECAST_NONE_INT16 != ptr_temp_max[i]) && (ptr_temp_max[i] > temp_max))
+            {
+                temp_max = ptr_temp_max[i];
+            }
+            if (FORECAST_NONE_UINT16 != ptr_prec[i])
+            {
+                prec += ptr_prec[i];
+            }
+            if ((FORECAST_NONE_UINT16 != ptr_wind[i]) && (ptr_wind[i] > wind))
+            {
+                wind = ptr_wind[i];
+            }
+        }
+        if (temp_min > temp_max)
+        {
             continue;
-        } else if (ret <= 0) {
-            break;
         }
 
-        len = ret;
-        ESP_LOGD("Get", "%d bytes read", len);
-        /* Print response directly to stdout as it is read */
-        for (int i = 0; i < len; i++) {
-            putchar(buf[i]);
+        time_t date_ts = ptr_model->day_date_ts[day];
+        struct tm date_tm;
+        if ((FORECAST_NONE_UINT32 == ptr_model->day_date_ts[day]) ||
+            (0 == strftime(date, sizeof(date), "%a %d.%m", localtime_r(&date_ts, &date_tm))))
+        {
+            snprintf(date, sizeof(date), "Day %u", (unsigned int) day);
         }
-        putchar('\n'); // JSON output doesn't have a newline at end
+        printf("\t%s: %s..%s, %s, precipitation %s mm, wind up to %s m/s\n",
+               date,
+               weather_tenths_str(temp_min_str, temp_min),
+               weather_tenths_str(temp_max_str, temp_max),
+               weather_condition_name(ptr_model->part_condition[day * FORECAST_PARTS_QTY + FORECAST_PART_DAY]),
+               weather_tenths_str(prec_str, (int32_t) prec),
+               weather_tenths_str(wind_str, (int32_t) wind));
+    }
+}
 
-        weather_display(strchr(buf, '{'));
-    } while (1);    
+/**
+ *  @brief      Export consumer, changed fields are written as one-line JSON with the record fingerprint
+ *
+ *  @param[in]  index           Location index
+ *  @param[in]  ptr_snapshot    Snapshot with the new record
+ *  @param[in]  changed         Changed fields
+ *  @param[in]  ptr_arg         Not used
+ */
+static void weather_export(size_t index, const weather_snapshot_t * ptr_snapshot, uint16_t changed, void * ptr_arg)
+{
+    char buf[WEATHER_EXPORT_BUF_SIZE];
+    weather_record_t delta = ptr_snapshot->record;
 
-    esp_tls_conn_destroy(ptr_tls);
-    
-    printf("Exit\n");
-    vTaskDelay(APP_DELAY_COMMON_MS / portTICK_PERIOD_MS);
+    delta.fields &= changed;
+    if (0 == weather_record_to_json(&delta, buf, sizeof(buf)))
+    {
+        ESP_LOGW("Export", "%s: record does not fit the buffer", weather_locations[index].ptr_name);
+        return;
+    }
+    ESP_LOGI("Export", "%s %08x: %s", weather_locations[index].ptr_name, ptr_snapshot->fingerprint, buf);
 }
 
 /**
- *  @brief      Weather parse and display function
+ *  @brief      Storage consumer, location weather record is stored in NVS
  *
- *  @param[in]  ptr_str     NULL-terminater string pointer
+ *  @param[in]  index           Location index
+ *  @param[in]  ptr_snapshot    Snapshot with the new record
+ *  @param[in]  changed         Changed fields (not used, the whole record is stored)
+ *  @param[in]  ptr_arg         Not used
  */
-static void weather_display(const char * ptr_str)
+static void weather_record_save(size_t index, const weather_snapshot_t * ptr_snapshot, uint16_t changed, void * ptr_arg)
 {
-    if (NULL == ptr_str)
+    const weather_record_t * ptr_record = &ptr_snapshot->record;
+    nvs_handle_t handle;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+
+    snprintf(key, sizeof(key), WEATHER_RECORD_KEY_FMT, (unsigned int) index);
+    esp_err_t err = nvs_open(WEATHER_RECORD_NAMESPACE, NVS_READWRITE, &handle);
+    if (ESP_OK == err)
+    {
+        err = nvs_set_blob(handle, key, ptr_record, sizeof(*ptr_record));
+        if (ESP_OK == err)
+        {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (ESP_OK != err)
+    {
+        ESP_LOGW("Get", "Cannot store weather record %s: %s", key, esp_err_to_name(err));
+    }
+}
+
+/**
+ *  @brief      Load location weather record from NVS
+ *
+ *  @param[in]  index       Location index
+ *  @param[out] ptr_record  Weather record pointer
+ *
+ *  @return     true if a record of the current layout is stored
+ */
+static bool weather_record_load(size_t index, weather_record_t * ptr_record)
+{
+    nvs_handle_t handle;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t len = sizeof(*ptr_record);
+
+    snprintf(key, sizeof(key), WEATHER_RECORD_KEY_FMT, (unsigned int) index);
+    if (ESP_OK != nvs_open(WEATHER_RECORD_NAMESPACE, NVS_READONLY, &handle))
+    {
+        return false;
+    }
+    esp_err_t err = nvs_get_blob(handle, key, ptr_record, &len);
+    nvs_close(handle);
+
+    if ((ESP_OK != err) || (sizeof(*ptr_record) != len))
+    {
+        memset(ptr_record, 0x00, sizeof(*ptr_record));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ *  @brief      Log how much work change detection skipped
+ */
+static void weather_change_log_stats(void)
+{
+    ESP_LOGI("Get", "Records unchanged: %u of %u, forecast unchanged: %u of %u",
+             weather_changes.unchanged,
+             weather_changes.updates,
+             weather_forecast_gate.repeats,
+             weather_forecast_gate.repeats + weather_forecast_gate.changes);
+    for (size_t i = 0; i < weather_changes.consumers_qty; i++)
+    {
+        const weather_consumer_t * ptr_consumer = &weather_changes.consumers[i];
+        ESP_LOGI("Get", "%s: notified %u, skipped %u, fields sent %u, fields skipped %u",
+                 ptr_consumer->ptr_name,
+                 ptr_consumer->notified,
+                 ptr_consumer->skipped,
+                 ptr_consumer->fields_sent,
+                 ptr_consumer->fields_skipped);
+    }
+}
+
+/**
+ *  @brief      Shared CA store initialization
+ *
+ *  The chain is parsed once here and every TLS connection refers to it
+ *  instead of parsing its own copy during the handshake.
+ *
+ *  @return     ESP_OK on success
+ */
+static esp_err_t ca_store_init(void)
+{
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_tls_set_global_ca_store(api_yandex_root_der_start,
+                                                api_yandex_root_der_end - api_yandex_root_der_start);
+    if (ESP_OK == err)
+    {
+        ESP_LOGI("Get", "CA store initialized in %lld us (%u bytes DER)",
+                 esp_timer_get_time() - start_us,
+                 (unsigned int) (api_yandex_root_der_end - api_yandex_root_der_start));
+    }
+
+    return err;
+}
+
+#if WEATHER_ENGINE_BENCH
+/**
+ *  @brief      Benchmark response body consumer (counts bytes only)
+ *
+ *  @param[in]  ptr_data    Body bytes pointer
+ *  @param[in]  len         Body bytes quantity
+ *  @param[in]  ptr_arg     Body bytes counter pointer
+ */
+static void weather_bench_body(const char * ptr_data, size_t len, void * ptr_arg)
+{
+    *(uint32_t *) ptr_arg += len;
+}
+
+/**
+ *  @brief      Benchmark request completion
+ *
+ *  @param[in]  err         Request result
+ *  @param[in]  ptr_resp    Response parser
+ *  @param[in]  ptr_arg     Body bytes counter pointer
+ */
+static void weather_bench_done(esp_err_t err, const http_resp_t * ptr_resp, void * ptr_arg)
+{
+    ESP_LOGI("Bench", "Request done: %s, HTTP %d, %u body bytes",
+             esp_err_to_name(err), ptr_resp->status, *(uint32_t *) ptr_arg);
+}
+
+/**
+ *  @brief      Aggregate throughput of FETCH_ENGINE_SLOTS_MAX requests,
+ *              one after another and all at once from one task
+ */
+static void weather_engine_bench(void)
+{
+    static fetch_engine_t engine;
+    static uint32_t body_bytes[FETCH_ENGINE_SLOTS_MAX];
+    static char req[WEATHER_GET_REQ_BUF_SIZE];
+    /* Engine closes every connection once its response is complete, the server is told so */
+    int req_len = snprintf(req, sizeof(req), API_YANDEX_GET_REQ_CONN_FMT(API_YANDEX_PATH, "close") "\r\n",
+                           weather_locations[0].ptr_lat,
+                           weather_locations[0].ptr_lon);
+
+    const esp_tls_cfg_t tls_cfg = {
+        .use_global_ca_store = true,
+    };
+    const http_resp_cbs_t cbs = {
+        .header_cb = NULL,
+        .body_cb = &weather_bench_body,
+    };
+    ESP_ERROR_CHECK(fetch_engine_init(&engine, &tls_cfg, WEATHER_GET_RX_TIMEOUT_S * 1000));
+
+    for (uint32_t concurrent = 0; concurrent < 2; concurrent++)
+    {
+        memset(&engine.stats, 0x00, sizeof(engine.stats));
+        memset(body_bytes, 0x00, sizeof(body_bytes));
+        int64_t start_us = esp_timer_get_time();
+
+        for (uint32_t i = 0; i < FETCH_ENGINE_SLOTS_MAX; i++)
+        {
+            const fetch_req_t fetch_req = {
+                .ptr_host = API_YANDEX_HOST,
+                .port = API_YANDEX_PORT,
+                .ptr_req = req,
+                .req_len = req_len,
+                .ptr_cbs = &cbs,
+                .done_cb = &weather_bench_done,
+                .ptr_arg = &body_bytes[i],
+            };
+            ESP_ERROR_CHECK(fetch_engine_submit(&engine, &fetch_req));
+            if (!concurrent)
+            {
+                fetch_engine_run(&engine);
+            }
+        }
+        fetch_engine_run(&engine);
+
+        int64_t elapsed_us = esp_timer_get_time() - start_us;
+        ESP_LOGI("Bench", "%s: %u requests (%u failed) in %lld ms, %llu bytes, %llu B/s, %u wakeups",
+                 concurrent ? "Concurrent" : "Sequential",
+                 engine.stats.requests,
+                 engine.stats.failed,
+                 elapsed_us / 1000,
+                 engine.stats.rx_bytes,
+                 engine.stats.rx_bytes * 1000000ULL / ((elapsed_us > 0) ? elapsed_us : 1),
+                 engine.stats.wakeups);
+    }
+}
+#endif
+
+#if WEATHER_NUMBER_BENCH
+/**
+ *  @brief      Benchmark number consumer, decodes to tenths both ways
+ *
+ *  @param[in]  ptr_path    Value path
+ *  @param[in]  type        Value type
+ *  @param[in]  ptr_value   Value text
+ *  @param[in]  len         Value text length
+ *  @param[in]  ptr_arg     Benchmark counters pointer
+ */
+static void weather_number_value(const char * ptr_path,
+                                 json_stream_type_t type,
+                                 const char * ptr_value,
+                                 size_t len,
+                                 void * ptr_arg)
+{
+    weather_number_bench_t * ptr_bench = (weather_number_bench_t *) ptr_arg;
+    int64_t scaled = 0;
+
+    if (JSON_STREAM_NUMBER != type)
     {
-        ESP_LOGE("Display", "NULL string pointer");
         return;
     }
 
-    cJSON * ptr_json_root = cJSON_Parse(ptr_str);
-    cJSON * ptr_json_fact = cJSON_GetObjectItem(ptr_json_root, "fact");
-    cJSON * ptr_json_condition = cJSON_GetObjectItem(ptr_json_fact, "condition");
-    cJSON * ptr_json_temp = cJSON_GetObjectItem(ptr_json_fact, "temp");
-    if ((NULL == ptr_json_condition) ||
-        (NULL == ptr_json_temp))
+    esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+    int64_t rounded = llround(strtod(ptr_value, NULL) * 10.0);
+    ptr_bench->strtod_cycles += esp_cpu_get_cycle_count() - start;
+
+    start = esp_cpu_get_cycle_count();
+    json_num_scaled(ptr_value, len, 1, &scaled);
+    ptr_bench->scaled_cycles += esp_cpu_get_cycle_count() - start;
+
+    ptr_bench->numbers++;
+    if (scaled != rounded)
     {
-        ESP_LOGE("Display", "Cannot parse weather response");
+        ptr_bench->mismatches++;
+    }
+}
+
+/**
+ *  @brief      Cycles spent on numbers of a recorded forecast: strtod()
+ *              (soft-float) against the integer-only decoder
+ */
+static void weather_number_bench(void)
+{
+    static json_stream_t json;
+    weather_number_bench_t bench = {0};
+
+    json_stream_init(&json, &weather_number_value, &bench);
+    json_stream_feed(&json, forecast_json_start, forecast_json_end - forecast_json_start - 1);
+    if (!json_stream_finish(&json) || (0 == bench.numbers))
+    {
+        ESP_LOGE("Bench", "Recorded forecast is malformed");
         return;
     }
-    
-    printf("\nCurrent weather in Saint-Petersburg:\n");
-    printf("\tCondition: %s\n", ptr_json_condition->valuestring);
-    printf("\tTemperature: %d\n", ptr_json_temp->valueint);
 
-    cJSON_Delete(ptr_json_root);
+    ESP_LOGI("Bench", "%u numbers: strtod %llu cycles (%llu per number), scaled %llu cycles (%llu per number), %u differ",
+             bench.numbers,
+             bench.strtod_cycles,
+             bench.strtod_cycles / bench.numbers,
+             bench.scaled_cycles,
+             bench.scaled_cycles / bench.numbers,
+             bench.mismatches);
+}
+#endif
+
+#if WEATHER_TIMER_JITTER
+/**
+ *  @brief      Dispatch delay probe callback, the delay is measured from the due time
+ *
+ *  @param[in]  ptr_arg     Not used
+ */
+static void weather_jitter_tick(void * ptr_arg)
+{
+    int64_t delay_us = esp_timer_get_time() - weather_jitter.expected_us;
+
+    weather_jitter.expected_us += WEATHER_JITTER_PERIOD_US;
+    weather_jitter.ticks++;
+    weather_jitter.sum_us += delay_us;
+    if (delay_us > weather_jitter.max_us)
+    {
+        weather_jitter.max_us = delay_us;
+    }
+    if (delay_us > weather_jitter.max_total_us)
+    {
+        weather_jitter.max_total_us = delay_us;
+    }
+}
+
+/**
+ *  @brief      Dispatch delay probe start, a periodic timer in the shared esp_timer task
+ */
+static void weather_jitter_start(void)
+{
+    const esp_timer_create_args_t jitter_timer_args = {
+        .callback = &weather_jitter_tick,
+        .name = "jitter",
+    };
+    esp_timer_handle_t jitter_timer;
+
+    ESP_ERROR_CHECK(esp_timer_create(&jitter_timer_args, &jitter_timer));
+    weather_jitter.expected_us = esp_timer_get_time() + WEATHER_JITTER_PERIOD_US;
+    ESP_ERROR_CHECK(esp_timer_start_periodic(jitter_timer, WEATHER_JITTER_PERIOD_US));
 }
 
+/**
+ *  @brief      Log dispatch delay since the last report and restart the interval
+ */
+static void weather_jitter_log(void)
+{
+    if (0 == weather_jitter.ticks)
+    {
+        return;
+    }
+    ESP_LOGI("Bench", "Timer dispatch delay: mean %lld us, max %lld us (%lld us since start), %u callbacks",
+             weather_jitter.sum_us / weather_jitter.ticks,
+             weather_jitter.max_us,
+             weather_jitter.max_total_us,
+             weather_jitter.ticks);
+    weather_jitter.ticks = 0;
+    weather_jitter.sum_us = 0;
+    weather_jitter.max_us = 0;
+}
+#endif
 
 /******************** PUBLIC FUNCTIONS ********************/
 
@@ -312,6 +1618,10 @@ static void weather_display(const char * ptr_str)
  */
 void app_main(void)
 {
+    int64_t start_us = esp_timer_get_time();
+
+    phase_trace_init(&esp_timer_get_time);
+    global_ctx.ready_event_group = xEventGroupCreate();
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) 
     {
@@ -319,27 +1629,41 @@ void app_main(void)
       ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    phase_trace_mark(PHASE_TRACE_NVS_INIT);
+    ESP_ERROR_CHECK(dns_cache_init());
+    ESP_ERROR_CHECK(ca_store_init());
+#if WEATHER_TIMER_JITTER
+    weather_jitter_start();
+#endif
+#if WEATHER_NUMBER_BENCH
+    weather_number_bench();
+#endif
 
-    wifi_init();
-    vTaskDelay(APP_DELAY_COMMON_MS / portTICK_PERIOD_MS);
+    /* Time syncs are scheduled by the drift model, not by a fixed period.
+       Initialized before Wi-Fi so the NTP server of the DHCP lease is kept */
+    const clock_drift_cfg_t time_cfg = {
+        .error_bound_ms = APP_TIME_ERROR_BOUND_MS,
+        .interval_min_s = APP_TIME_SYNC_MIN_S,
+        .interval_max_s = APP_TIME_SYNC_MAX_S,
+    };
+    ESP_ERROR_CHECK(time_sync_init(&time_cfg));
+    time_sync_set_notify(global_ctx.ready_event_group, APP_READY_TIME_BIT);
 
-    if (esp_reset_reason() == ESP_RST_POWERON) {
-        ESP_LOGI("Get", "Updating time from NVS");
-        ESP_ERROR_CHECK(update_time_from_nvs());
+    /* Clock is usable at once after any reset, a sync is needed only if its error is unknown or too large */
+    esp_err_t time_err = time_sync_restore();
+    if (ESP_OK == time_err)
+    {
+        phase_trace_mark(PHASE_TRACE_TIME_VALID);
+        xEventGroupSetBits(global_ctx.ready_event_group, APP_READY_TIME_BIT);
     }
 
-    const esp_timer_create_args_t nvs_update_timer_args = {
-            .callback = &fetch_and_store_time_in_nvs,
-    };
+    wifi_init(ESP_OK == time_err);
 
-    esp_timer_handle_t nvs_update_timer;
-    ESP_ERROR_CHECK(esp_timer_create(&nvs_update_timer_args, &nvs_update_timer));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(nvs_update_timer, APP_TIME_UPDATE_PERIOD));
+    /* Readiness graph: network -> time -> weather fetch, each dependency has its own timeout.
+       The time sync is requested by the IP event handler */
+    app_wait_ready(APP_READY_NETWORK_BIT, start_us);
+    app_wait_ready(APP_READY_TIME_BIT, start_us);
 
-    vTaskDelay(APP_DELAY_COMMON_MS / portTICK_PERIOD_MS);
-    vTaskDelay(APP_DELAY_COMMON_MS / portTICK_PERIOD_MS);
-    vTaskDelay(APP_DELAY_COMMON_MS / portTICK_PERIOD_MS);
-    
     xTaskCreate(&weather_get_task, 
                 WEATHER_GET_TASK_NAME, 
                 WEATHER_GET_TASK_STACK_SIZE, 
@@ -351,4 +1675,3 @@ void app_main(void)
         vTaskDelay(APP_DELAY_COMMON_MS / portTICK_PERIOD_MS);
     }
 }
-
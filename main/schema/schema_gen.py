@@ -0,0 +1,559 @@
+#!/usr/bin/env python
+#
+# Generates a structure-of-arrays model and its streaming decoder from a
+# schema description, so the firmware decodes a large document straight
+# into contiguous columns without building a JSON tree.
+#
+# The schema names a root array of days, sub-rows of every day (named
+# object members like "parts.night" or array elements like "hours[3]")
+# and columns: JSON key, C type with decimal scale or string enumeration.
+# Every column becomes one array indexed by row, missing values are set
+# to a per-type marker (0 - unknown for enumerations).
+#
+# Usage: schema_gen.py <schema.json> <output directory>
+
+import json
+import os
+import sys
+
+# C type: (marker of missing value, value range check without the marker)
+TYPES = {
+    'int8':     ('INT8_MIN',    '(value <= INT8_MIN) || (value > INT8_MAX)'),
+    'uint8':    ('UINT8_MAX',   '(value < 0) || (value >= UINT8_MAX)'),
+    'int16':    ('INT16_MIN',   '(value <= INT16_MIN) || (value > INT16_MAX)'),
+    'uint16':   ('UINT16_MAX',  '(value < 0) || (value >= UINT16_MAX)'),
+    'int32':    ('INT32_MIN',   '(value <= INT32_MIN) || (value > INT32_MAX)'),
+    'uint32':   ('UINT32_MAX',  '(value < 0) || (value >= UINT32_MAX)'),
+}
+
+# Enumeration: string mapping function of weather_record.h
+ENUMS = {
+    'condition':    'weather_condition_from_str',
+    'wind_dir':     'weather_wind_dir_from_str',
+    'part':         'weather_part_from_str',
+}
+
+
+class Schema:
+    def __init__(self, path):
+        with open(path, 'r') as f:
+            desc = json.load(f)
+
+        self.source = os.path.basename(path)
+        self.model = desc['model']
+        self.prefix = self.model.upper()
+        self.brief = desc['brief']
+        self.root = desc['root']
+        self.day = None
+        self.rows = []
+        for name, row in desc['rows'].items():
+            row = dict(row, name=name, columns=[])
+            if 'object' in row:
+                row['qty'] = '%s_%sS_QTY' % (self.prefix, name.upper())
+                row['count'] = len(row['names'])
+                row['key'] = row['object']
+            elif 'array' in row:
+                row['qty'] = '%s_%sS_MAX' % (self.prefix, name.upper())
+                row['count'] = row['max']
+                row['key'] = row['array']
+            elif self.day is None:
+                row['qty'] = '%s_%sS_MAX' % (self.prefix, name.upper())
+                row['count'] = row['max']
+                self.day = row
+                continue
+            else:
+                sys.exit('Only one row may be the root array element: ' + name)
+            row['size'] = '%s_%s_ROWS' % (self.prefix, name.upper())
+            self.rows.append(row)
+        if self.day is None:
+            sys.exit('No root array row')
+        self.day['size'] = self.day['qty']
+
+        by_name = dict((row['name'], row) for row in self.rows + [self.day])
+        for column in desc['columns']:
+            if column['row'] not in by_name:
+                sys.exit('Unknown row of column ' + column['key'])
+            if 'enum' in column:
+                if column['enum'] not in ENUMS:
+                    sys.exit('Unknown enumeration: ' + column['enum'])
+                column['type'] = 'uint8'
+            elif column.get('type') not in TYPES:
+                sys.exit('Unknown type of column ' + column['key'])
+            column['field'] = '%s_%s' % (column['row'], column['name'])
+            column['ctype'] = column['type'] + '_t'
+            by_name[column['row']]['columns'].append(column)
+
+    def all_rows(self):
+        return [self.day] + self.rows
+
+    def uses_enums(self):
+        return any('enum' in c for row in self.all_rows() for c in row['columns'])
+
+
+def banner(name):
+    return '/******************** %s ********************/' % name
+
+
+def gen_header(s):
+    p = s.prefix
+    m = s.model
+    out = []
+    w = out.append
+
+    w('/**')
+    w(' *  @file       %s_model.h' % m)
+    w(' *')
+    w(' *  @brief      %s' % s.brief)
+    w(' *')
+    w(' *  Generated by schema_gen.py from %s, do not edit.' % s.source)
+    w(' */')
+    w('')
+    w('#pragma once')
+    w('')
+    w('/********** INCLUDES **********/')
+    w('')
+    w('#include <stdint.h>')
+    w('#include <stdbool.h>')
+    w('#include <stddef.h>')
+    w('')
+    w('#include "json_stream.h"')
+    w('')
+    w('#ifdef __cplusplus')
+    w('extern "C" {')
+    w('#endif')
+    w('')
+    w(banner('DEFINES'))
+    w('')
+    w('#define %-28s %-6d /**< Decoded days */' % (s.day['qty'], s.day['count']))
+    for row in s.rows:
+        what = 'Named' if 'object' in row else 'Decoded'
+        w('#define %-28s %-6d /**< %s %s rows of a day */' % (row['qty'], row['count'], what, row['name']))
+    for row in s.rows:
+        w('#define %-28s (%s * %s)' % (row['size'], s.day['qty'], row['qty']))
+    w('')
+    types = sorted(set(c['type'] for row in s.all_rows() for c in row['columns'] if 'enum' not in c))
+    for t in types:
+        w('#define %-28s %-10s /**< Missing %s value */' % ('%s_NONE_%s' % (p, t.upper()), TYPES[t][0], t))
+    w('')
+    w(banner('STRUCTURES, ENUMS, UNIONS'))
+    for row in s.rows:
+        if 'object' not in row:
+            continue
+        w('')
+        w('/**')
+        w(' *  @brief  %s rows of a day' % row['name'].capitalize())
+        w(' */')
+        w('typedef enum %s_%s_e' % (m, row['name']))
+        w('{')
+        for i, name in enumerate(row['names']):
+            w('    %s_%s_%s%s,' % (p, row['name'].upper(), name.upper(), ' = 0' if 0 == i else ''))
+        w('} %s_%s_t;' % (m, row['name']))
+    w('')
+    w('/**')
+    w(' *  @brief  Model, one array per column')
+    w(' *')
+    w(' *  Day columns are indexed by day, %s columns by' % ', '.join(r['name'] for r in s.rows))
+    w(' *  day * <rows of a day> + row.')
+    w(' */')
+    w('typedef struct %s_model_s' % m)
+    w('{')
+    w('    %-52s/**< Days decoded */' % 'uint8_t days;')
+    for row in s.rows:
+        if 'array' in row:
+            w('    %-52s/**< %s rows decoded per day */'
+              % ('uint8_t %s_qty[%s];' % (row['name'], s.day['qty']), row['name'].capitalize()))
+    for row in s.all_rows():
+        for c in row['columns']:
+            w('    %-52s/**< %s */' % ('%s %s[%s];' % (c['ctype'], c['field'], row['size']), c['brief']))
+    w('} %s_model_t;' % m)
+    w('')
+    w('/**')
+    w(' *  @brief  Streaming decoder context')
+    w(' */')
+    w('typedef struct %s_decoder_s' % m)
+    w('{')
+    w('    json_stream_t json;             /**< Tokenizer */')
+    w('    %-32s/**< Destination */' % ('%s_model_t * ptr_model;' % m))
+    w('    bool is_cleared;                /**< Model is cleared by the first value of the document */')
+    w('    uint32_t values;                /**< Values stored */')
+    w('    uint32_t rejected;              /**< Column values of wrong type or out of range */')
+    w('} %s_decoder_t;' % m)
+    w('')
+    w(banner('GLOBAL VARIABLES'))
+    for row in s.rows:
+        if 'object' in row:
+            w('')
+            w('/**< %s names, indexed by %s_%s_t */' % (row['name'].capitalize(), m, row['name']))
+            w('extern const char * const %s_%s_names[%s];' % (m, row['name'], row['qty']))
+    w('')
+    w(banner('PUBLIC FUNCTION PROTOTYPES'))
+    w('')
+    w('/**')
+    w(' *  @brief      Set every column value to missing')
+    w(' *')
+    w(' *  @param[out] ptr_model   Model pointer')
+    w(' */')
+    w('void %s_model_clear(%s_model_t * ptr_model);' % (m, m))
+    w('')
+    w('/**')
+    w(' *  @brief      Decoder initialization for a new document')
+    w(' *')
+    w(' *  The model is cleared when the first value arrives, so a response')
+    w(' *  without a body keeps the previous one.')
+    w(' *')
+    w(' *  @param[out] ptr_decoder Decoder context pointer')
+    w(' *  @param[in]  ptr_model   Destination model pointer')
+    w(' */')
+    w('void %s_decoder_init(%s_decoder_t * ptr_decoder, %s_model_t * ptr_model);' % (m, m, m))
+    w('')
+    w('/**')
+    w(' *  @brief      Feed the next chunk of the document')
+    w(' *')
+    w(' *  @param[in]  ptr_decoder Decoder context pointer')
+    w(' *  @param[in]  ptr_data    Document bytes pointer')
+    w(' *  @param[in]  len         Document bytes quantity')
+    w(' *')
+    w(' *  @return     false if document is malformed')
+    w(' */')
+    w('bool %s_decoder_feed(%s_decoder_t * ptr_decoder, const char * ptr_data, size_t len);' % (m, m))
+    w('')
+    w('/**')
+    w(' *  @brief      Notify the decoder that the document has ended')
+    w(' *')
+    w(' *  @param[in]  ptr_decoder Decoder context pointer')
+    w(' *')
+    w(' *  @return     true if the document is complete and well-formed')
+    w(' */')
+    w('bool %s_decoder_finish(%s_decoder_t * ptr_decoder);' % (m, m))
+    w('')
+    w('#ifdef __cplusplus')
+    w('}')
+    w('#endif')
+    return '\n'.join(out) + '\n'
+
+
+def gen_store(s, row, w):
+    m = s.model
+    p = s.prefix
+    numbers = [c for c in row['columns'] if 'enum' not in c]
+
+    w('')
+    w('/**')
+    w(' *  @brief      %s column value' % row['name'].capitalize())
+    w(' *')
+    w(' *  @param[out] ptr_model   Model pointer')
+    w(' *  @param[in]  row         Row index')
+    w(' *  @param[in]  ptr_key     Value key')
+    w(' *  @param[in]  type        Value type')
+    w(' *  @param[in]  ptr_value   Value text')
+    w(' *  @param[in]  len         Value text length')
+    w(' *')
+    w(' *  @return     Result')
+    w(' */')
+    w('static %s_store_t %s_store_%s(%s_model_t * ptr_model,' % (m, m, row['name'], m))
+    indent = ' ' * len('static %s_store_t %s_store_%s(' % (m, m, row['name']))
+    w('%ssize_t row,' % indent)
+    w('%sconst char * ptr_key,' % indent)
+    w('%sjson_stream_type_t type,' % indent)
+    w('%sconst char * ptr_value,' % indent)
+    w('%ssize_t len)' % indent)
+    w('{')
+    if numbers:
+        w('    int64_t value = 0;')
+        w('')
+    w('    switch (strlen(ptr_key))')
+    w('    {')
+    by_len = {}
+    for c in row['columns']:
+        by_len.setdefault(len(c['key']), []).append(c)
+    for key_len in sorted(by_len):
+        w('    case %d:' % key_len)
+        for c in by_len[key_len]:
+            w('        if (0 == memcmp(ptr_key, "%s", %d))' % (c['key'], key_len))
+            w('        {')
+            if 'enum' in c:
+                w('            if (JSON_STREAM_STRING != type)')
+                w('            {')
+                w('                return %s_STORE_REJECTED;' % p)
+                w('            }')
+                w('            ptr_model->%s[row] = (uint8_t) %s(ptr_value, len);' % (c['field'], ENUMS[c['enum']]))
+            else:
+                w('            if ((JSON_STREAM_NUMBER != type) ||')
+                w('                !json_num_scaled(ptr_value, len, %d, &value) ||' % c.get('scale', 0))
+                w('                %s)' % TYPES[c['type']][1])
+                w('            {')
+                w('                return %s_STORE_REJECTED;' % p)
+                w('            }')
+                w('            ptr_model->%s[row] = (%s) value;' % (c['field'], c['ctype']))
+            w('            return %s_STORE_DONE;' % p)
+            w('        }')
+        w('        break;')
+        w('')
+    w('    default:')
+    w('        break;')
+    w('    }')
+    w('')
+    w('    return %s_STORE_SKIPPED;' % p)
+    w('}')
+
+
+def gen_source(s):
+    p = s.prefix
+    m = s.model
+    root = s.root + '['
+    out = []
+    w = out.append
+
+    w('/**')
+    w(' *  @file       %s_model.c' % m)
+    w(' *')
+    w(' *  @brief      %s' % s.brief)
+    w(' *')
+    w(' *  Generated by schema_gen.py from %s, do not edit.' % s.source)
+    w(' */')
+    w('')
+    w('/********** INCLUDES **********/')
+    w('')
+    w('#include <string.h>')
+    w('')
+    w('#include "json_num.h"')
+    if s.uses_enums():
+        w('#include "weather_record.h"')
+    w('#include "%s_model.h"' % m)
+    w('')
+    w(banner('DEFINES'))
+    w('')
+    w('#define %s_INDEX_LIMIT  1000000 /**< Array index clamp, far beyond any row quantity */' % p)
+    w('')
+    w(banner('STRUCTURES, ENUMS, UNIONS'))
+    w('')
+    w('/**')
+    w(' *  @brief  Column value store result')
+    w(' */')
+    w('typedef enum %s_store_e' % m)
+    w('{')
+    w('    %s_STORE_SKIPPED = 0,   /**< Key is not a column */' % p)
+    w('    %s_STORE_DONE,          /**< Value is stored */' % p)
+    w('    %s_STORE_REJECTED,      /**< Value of wrong type or out of range */' % p)
+    w('} %s_store_t;' % m)
+    w('')
+    w(banner('GLOBAL VARIABLES'))
+    for row in s.rows:
+        if 'object' in row:
+            w('')
+            w('const char * const %s_%s_names[%s] = {' % (m, row['name'], row['qty']))
+            for name in row['names']:
+                w('    "%s",' % name)
+            w('};')
+    w('')
+    w(banner('PRIVATE FUNCTION PROTOTYPES'))
+    w('')
+    w('static const char * %s_index(const char * ptr_text, uint32_t * ptr_index);' % m)
+    for row in s.all_rows():
+        head = 'static %s_store_t %s_store_%s(' % (m, m, row['name'])
+        w('%s%s_model_t * ptr_model,' % (head, m))
+        indent = ' ' * len(head)
+        w('%ssize_t row,' % indent)
+        w('%sconst char * ptr_key,' % indent)
+        w('%sjson_stream_type_t type,' % indent)
+        w('%sconst char * ptr_value,' % indent)
+        w('%ssize_t len);' % indent)
+    head = 'static void %s_decoder_value(' % m
+    indent = ' ' * len(head)
+    w('%sconst char * ptr_path,' % head)
+    w('%sjson_stream_type_t type,' % indent)
+    w('%sconst char * ptr_value,' % indent)
+    w('%ssize_t len,' % indent)
+    w('%svoid * ptr_arg);' % indent)
+    w('')
+    w(banner('PRIVATE FUNCTIONS'))
+    w('')
+    w('/**')
+    w(' *  @brief      Array index of a path ("12]...")')
+    w(' *')
+    w(' *  @param[in]  ptr_text    Text after \'[\'')
+    w(' *  @param[out] ptr_index   Index')
+    w(' *')
+    w(' *  @return     Text after \']\', NULL if there is no index')
+    w(' */')
+    w('static const char * %s_index(const char * ptr_text, uint32_t * ptr_index)' % m)
+    w('{')
+    w('    uint32_t index = 0;')
+    w('')
+    w('    if ((*ptr_text < \'0\') || (*ptr_text > \'9\'))')
+    w('    {')
+    w('        return NULL;')
+    w('    }')
+    w('    for (; (*ptr_text >= \'0\') && (*ptr_text <= \'9\'); ptr_text++)')
+    w('    {')
+    w('        if (index < %s_INDEX_LIMIT)' % p)
+    w('        {')
+    w('            index = index * 10 + (*ptr_text - \'0\');')
+    w('        }')
+    w('    }')
+    w('    if (\']\' != *ptr_text)')
+    w('    {')
+    w('        return NULL;')
+    w('    }')
+    w('    *ptr_index = index;')
+    w('')
+    w('    return ptr_text + 1;')
+    w('}')
+    for row in s.all_rows():
+        gen_store(s, row, w)
+    w('')
+    w('/**')
+    w(' *  @brief      Tokenizer value consumer, path is split into day, row and key')
+    w(' *')
+    w(' *  @param[in]  ptr_path    Value path')
+    w(' *  @param[in]  type        Value type')
+    w(' *  @param[in]  ptr_value   Value text')
+    w(' *  @param[in]  len         Value text length')
+    w(' *  @param[in]  ptr_arg     Decoder context pointer')
+    w(' */')
+    w('%sconst char * ptr_path,' % head)
+    w('%sjson_stream_type_t type,' % indent)
+    w('%sconst char * ptr_value,' % indent)
+    w('%ssize_t len,' % indent)
+    w('%svoid * ptr_arg)' % indent)
+    w('{')
+    w('    %s_decoder_t * ptr_decoder = (%s_decoder_t *) ptr_arg;' % (m, m))
+    w('    %s_model_t * ptr_model = ptr_decoder->ptr_model;' % m)
+    w('    %s_store_t result = %s_STORE_SKIPPED;' % (m, p))
+    w('    uint32_t day = 0;')
+    w('    uint32_t index = 0;')
+    w('    const char * ptr_key;')
+    w('')
+    w('    if (!ptr_decoder->is_cleared)')
+    w('    {')
+    w('        /* Lazily, a response without a body keeps the previous model */')
+    w('        %s_model_clear(ptr_model);' % m)
+    w('        ptr_decoder->is_cleared = true;')
+    w('    }')
+    w('')
+    w('    if (0 != strncmp(ptr_path, "%s", %d))' % (root, len(root)))
+    w('    {')
+    w('        return;')
+    w('    }')
+    w('    ptr_key = %s_index(ptr_path + %d, &day);' % (m, len(root)))
+    w('    if ((NULL == ptr_key) || (\'.\' != *ptr_key) || (day >= %s))' % s.day['qty'])
+    w('    {')
+    w('        return;')
+    w('    }')
+    w('    ptr_key++;')
+    w('')
+    first = True
+    for row in s.rows:
+        w('    %sif (0 == strncmp(ptr_key, "%s%s", %d))'
+          % ('' if first else 'else ', row['key'], '.' if 'object' in row else '[', len(row['key']) + 1))
+        first = False
+        w('    {')
+        if 'object' in row:
+            w('        const char * ptr_name = ptr_key + %d;' % (len(row['key']) + 1))
+            w('')
+            w('        ptr_key = strchr(ptr_name, \'.\');')
+            w('        if (NULL == ptr_key)')
+            w('        {')
+            w('            return;')
+            w('        }')
+            w('        for (index = 0; index < %s; index++)' % row['qty'])
+            w('        {')
+            w('            const char * ptr_known = %s_%s_names[index];' % (m, row['name']))
+            w('            if ((strlen(ptr_known) == (size_t) (ptr_key - ptr_name)) &&')
+            w('                (0 == memcmp(ptr_known, ptr_name, ptr_key - ptr_name)))')
+            w('            {')
+            w('                break;')
+            w('            }')
+            w('        }')
+            w('        if (index >= %s)' % row['qty'])
+            w('        {')
+            w('            return;')
+            w('        }')
+            w('        result = %s_store_%s(ptr_model, day * %s + index, ptr_key + 1, type, ptr_value, len);'
+              % (m, row['name'], row['qty']))
+        else:
+            w('        ptr_key = %s_index(ptr_key + %d, &index);' % (m, len(row['key']) + 1))
+            w('        if ((NULL == ptr_key) || (\'.\' != *ptr_key) || (index >= %s))' % row['qty'])
+            w('        {')
+            w('            return;')
+            w('        }')
+            w('        result = %s_store_%s(ptr_model, day * %s + index, ptr_key + 1, type, ptr_value, len);'
+              % (m, row['name'], row['qty']))
+            w('        if ((%s_STORE_DONE == result) && (index >= ptr_model->%s_qty[day]))' % (p, row['name']))
+            w('        {')
+            w('            ptr_model->%s_qty[day] = (uint8_t) (index + 1);' % row['name'])
+            w('        }')
+        w('    }')
+    w('    else')
+    w('    {')
+    w('        result = %s_store_%s(ptr_model, day, ptr_key, type, ptr_value, len);' % (m, s.day['name']))
+    w('    }')
+    w('')
+    w('    if (%s_STORE_DONE == result)' % p)
+    w('    {')
+    w('        ptr_decoder->values++;')
+    w('        if (day >= ptr_model->days)')
+    w('        {')
+    w('            ptr_model->days = (uint8_t) (day + 1);')
+    w('        }')
+    w('    }')
+    w('    else if (%s_STORE_REJECTED == result)' % p)
+    w('    {')
+    w('        ptr_decoder->rejected++;')
+    w('    }')
+    w('}')
+    w('')
+    w(banner('PUBLIC FUNCTIONS'))
+    w('')
+    w('void %s_model_clear(%s_model_t * ptr_model)' % (m, m))
+    w('{')
+    w('    memset(ptr_model, 0x00, sizeof(*ptr_model));')
+    for row in s.all_rows():
+        marked = [c for c in row['columns'] if 'enum' not in c]
+        if not marked:
+            continue
+        w('    for (size_t i = 0; i < %s; i++)' % row['size'])
+        w('    {')
+        for c in marked:
+            w('        ptr_model->%s[i] = %s_NONE_%s;' % (c['field'], p, c['type'].upper()))
+        w('    }')
+    w('}')
+    w('')
+    w('void %s_decoder_init(%s_decoder_t * ptr_decoder, %s_model_t * ptr_model)' % (m, m, m))
+    w('{')
+    w('    ptr_decoder->ptr_model = ptr_model;')
+    w('    ptr_decoder->is_cleared = false;')
+    w('    ptr_decoder->values = 0;')
+    w('    ptr_decoder->rejected = 0;')
+    w('    json_stream_init(&ptr_decoder->json, &%s_decoder_value, ptr_decoder);' % m)
+    w('}')
+    w('')
+    w('bool %s_decoder_feed(%s_decoder_t * ptr_decoder, const char * ptr_data, size_t len)' % (m, m))
+    w('{')
+    w('    return json_stream_feed(&ptr_decoder->json, ptr_data, len);')
+    w('}')
+    w('')
+    w('bool %s_decoder_finish(%s_decoder_t * ptr_decoder)' % (m, m))
+    w('{')
+    w('    return json_stream_finish(&ptr_decoder->json);')
+    w('}')
+    return '\n'.join(out) + '\n'
+
+
+def write(path, text):
+    with open(path, 'w') as f:
+        f.write(text)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('Usage: schema_gen.py <schema.json> <output directory>')
+
+    schema = Schema(sys.argv[1])
+    out_dir = sys.argv[2]
+    write(os.path.join(out_dir, schema.model + '_model.h'), gen_header(schema))
+    write(os.path.join(out_dir, schema.model + '_model.c'), gen_source(schema))
+
+
+if __name__ == '__main__':
+    main()
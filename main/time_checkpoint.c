@@ -0,0 +1,184 @@
+/**
+ *  @file       time_checkpoint.c
+ *
+ *  @brief      System time checkpoint kept across resets
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_rtc_time.h"
+#include "nvs.h"
+
+#include "sdkconfig.h"
+
+#include "time_checkpoint.h"
+
+/******************** DEFINES ********************/
+
+#define TIME_CHECKPOINT_MAGIC       0x54434B50UL    /**< RTC memory content marker */
+#define TIME_CHECKPOINT_NAMESPACE   "storage"       /**< NVS namespace */
+#define TIME_CHECKPOINT_KEY         "time_ckpt"     /**< NVS key of the checkpoint */
+#define TIME_CHECKPOINT_LEGACY_KEY  "timestamp"     /**< NVS key of the former seconds-only timestamp */
+
+#if CONFIG_RTC_CLK_SRC_EXT_CRYS
+#define TIME_CHECKPOINT_RTC_PPM     100             /**< RTC timer inaccuracy, external 32 kHz crystal */
+#else
+#define TIME_CHECKPOINT_RTC_PPM     5000            /**< RTC timer inaccuracy, calibrated RC oscillator */
+#endif
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Checkpoint (stored in NVS as is)
+ */
+typedef struct time_checkpoint_s
+{
+    int64_t wall_us;            /**< System time, microseconds since the Unix epoch */
+    int64_t rtc_us;             /**< RTC timer value of the same moment */
+    int64_t error_us;           /**< Largest error of wall_us, TIME_CHECKPOINT_ERROR_UNKNOWN if unknown */
+} time_checkpoint_t;
+
+/**
+ *  @brief  Checkpoint layout in RTC memory
+ */
+typedef struct time_checkpoint_rtc_s
+{
+    uint32_t magic;             /**< TIME_CHECKPOINT_MAGIC if content is valid */
+    uint32_t crc;               /**< Checkpoint checksum */
+    time_checkpoint_t checkpoint;
+} time_checkpoint_rtc_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * TAG = "time_checkpoint";
+
+/**< Not initialized on boot, garbage after power-on is rejected by checksum */
+static RTC_NOINIT_ATTR time_checkpoint_rtc_t rtc_checkpoint;
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static uint32_t time_checkpoint_crc(void);
+static esp_err_t time_checkpoint_load(time_checkpoint_t * ptr_checkpoint);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Checkpoint checksum
+ *
+ *  @return     CRC32 of the RTC memory checkpoint
+ */
+static uint32_t time_checkpoint_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *) &rtc_checkpoint.checkpoint, sizeof(rtc_checkpoint.checkpoint));
+}
+
+/**
+ *  @brief      NVS checkpoint reading, the former timestamp is taken if there is none
+ *
+ *  @param[out] ptr_checkpoint  Checkpoint pointer
+ *
+ *  @return     ESP_OK on success
+ */
+static esp_err_t time_checkpoint_load(time_checkpoint_t * ptr_checkpoint)
+{
+    nvs_handle_t handle;
+    size_t len = sizeof(*ptr_checkpoint);
+    int64_t timestamp_s = 0;
+
+    esp_err_t err = nvs_open(TIME_CHECKPOINT_NAMESPACE, NVS_READONLY, &handle);
+    if (ESP_OK != err)
+    {
+        return err;
+    }
+    err = nvs_get_blob(handle, TIME_CHECKPOINT_KEY, ptr_checkpoint, &len);
+    if ((ESP_OK == err) && (sizeof(*ptr_checkpoint) != len))
+    {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    if ((ESP_OK != err) && (ESP_OK == nvs_get_i64(handle, TIME_CHECKPOINT_LEGACY_KEY, &timestamp_s)))
+    {
+        ptr_checkpoint->wall_us = timestamp_s * 1000000LL;
+        err = ESP_OK;
+    }
+    nvs_close(handle);
+
+    return err;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_err_t time_checkpoint_save(int64_t error_us, bool is_durable)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t rtc_us = (int64_t) esp_rtc_get_time_us();
+
+    rtc_checkpoint.checkpoint.wall_us = (int64_t) now.tv_sec * 1000000LL + now.tv_usec;
+    rtc_checkpoint.checkpoint.rtc_us = rtc_us;
+    rtc_checkpoint.checkpoint.error_us = error_us;
+    rtc_checkpoint.crc = time_checkpoint_crc();
+    rtc_checkpoint.magic = TIME_CHECKPOINT_MAGIC;
+    if (!is_durable)
+    {
+        return ESP_OK;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(TIME_CHECKPOINT_NAMESPACE, NVS_READWRITE, &handle);
+    if (ESP_OK == err)
+    {
+        err = nvs_set_blob(handle, TIME_CHECKPOINT_KEY, &rtc_checkpoint.checkpoint, sizeof(rtc_checkpoint.checkpoint));
+        if (ESP_OK == err)
+        {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (ESP_OK != err)
+    {
+        ESP_LOGE(TAG, "Error storing checkpoint: %s", esp_err_to_name(err));
+    }
+
+    return err;
+}
+
+esp_err_t time_checkpoint_restore(int64_t * ptr_wall_us, int64_t * ptr_error_us)
+{
+    int64_t rtc_us = (int64_t) esp_rtc_get_time_us();
+
+    /* RTC timer counts through every reset but power loss, it must not be behind the checkpoint */
+    if ((TIME_CHECKPOINT_MAGIC == rtc_checkpoint.magic) &&
+        (time_checkpoint_crc() == rtc_checkpoint.crc) &&
+        (rtc_us >= rtc_checkpoint.checkpoint.rtc_us))
+    {
+        int64_t elapsed_us = rtc_us - rtc_checkpoint.checkpoint.rtc_us;
+
+        *ptr_wall_us = rtc_checkpoint.checkpoint.wall_us + elapsed_us;
+        *ptr_error_us = rtc_checkpoint.checkpoint.error_us;
+        if (TIME_CHECKPOINT_ERROR_UNKNOWN != *ptr_error_us)
+        {
+            *ptr_error_us += elapsed_us * TIME_CHECKPOINT_RTC_PPM / 1000000;
+        }
+        ESP_LOGI(TAG, "Restored from RTC memory, %lld s since the checkpoint", elapsed_us / 1000000);
+        return ESP_OK;
+    }
+
+    time_checkpoint_t checkpoint;
+    if (ESP_OK != time_checkpoint_load(&checkpoint))
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *ptr_wall_us = checkpoint.wall_us;
+    *ptr_error_us = TIME_CHECKPOINT_ERROR_UNKNOWN;
+    ESP_LOGI(TAG, "Restored from NVS, time is a lower bound");
+
+    return ESP_OK;
+}
@@ -0,0 +1,178 @@
+/**
+ *  @file       time_source.c
+ *
+ *  @brief      Reference time estimate from samples of known accuracy
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+
+#include "time_source.h"
+
+/******************** DEFINES ********************/
+
+#define TIME_SOURCE_US_IN_S     1000000LL   /**< Microseconds in a second */
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * const time_source_months[12] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static int64_t time_source_days(int64_t year, uint32_t month, uint32_t day);
+static void time_source_widen(const time_source_t * ptr_source, int64_t local_us, int64_t * ptr_earliest_us, int64_t * ptr_latest_us);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Days since the Unix epoch of a civil date (proleptic Gregorian)
+ *
+ *  @param[in]  year        Year
+ *  @param[in]  month       Month, 1..12
+ *  @param[in]  day         Day of month, 1..31
+ *
+ *  @return     Days since 1970-01-01
+ */
+static int64_t time_source_days(int64_t year, uint32_t month, uint32_t day)
+{
+    /* Years start in March, so the leap day is the last day of a year */
+    year -= (month <= 2) ? 1 : 0;
+    int64_t era = year / 400;
+    int64_t year_of_era = year - era * 400;
+    int64_t month_of_year = (month > 2) ? ((int64_t) month - 3) : ((int64_t) month + 9);
+    int64_t day_of_year = (153 * month_of_year + 2) / 5 + day - 1;
+    int64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+    return era * 146097 + day_of_era - 719468;
+}
+
+/**
+ *  @brief      Kept interval moved to a later local time
+ *
+ *  @param[in]  ptr_source      Estimate context pointer
+ *  @param[in]  local_us        Local time
+ *  @param[out] ptr_earliest_us Reference time lower bound at local_us
+ *  @param[out] ptr_latest_us   Reference time upper bound at local_us
+ */
+static void time_source_widen(const time_source_t * ptr_source, int64_t local_us, int64_t * ptr_earliest_us, int64_t * ptr_latest_us)
+{
+    int64_t elapsed_us = (local_us > ptr_source->local_us) ? (local_us - ptr_source->local_us) : 0;
+    /* ppb * us / 10^9 = us */
+    int64_t drift_us = elapsed_us * ptr_source->drift_ppb / 1000000000;
+
+    *ptr_earliest_us = ptr_source->earliest_us + elapsed_us - drift_us;
+    *ptr_latest_us = ptr_source->latest_us + elapsed_us + drift_us;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void time_source_init(time_source_t * ptr_source)
+{
+    memset(ptr_source, 0x00, sizeof(*ptr_source));
+    ptr_source->drift_ppb = TIME_SOURCE_DRIFT_PPB;
+}
+
+void time_source_set_drift(time_source_t * ptr_source, uint32_t drift_ppb)
+{
+    ptr_source->drift_ppb = drift_ppb;
+}
+
+void time_source_add(time_source_t * ptr_source, int64_t earliest_us, int64_t latest_us, int64_t local_us)
+{
+    ptr_source->samples++;
+    if (ptr_source->is_valid)
+    {
+        int64_t kept_earliest_us;
+        int64_t kept_latest_us;
+        time_source_widen(ptr_source, local_us, &kept_earliest_us, &kept_latest_us);
+        if ((kept_latest_us >= earliest_us) && (kept_earliest_us <= latest_us))
+        {
+            earliest_us = (kept_earliest_us > earliest_us) ? kept_earliest_us : earliest_us;
+            latest_us = (kept_latest_us < latest_us) ? kept_latest_us : latest_us;
+        }
+        else
+        {
+            /* Reference or local clock jumped, the older samples are not trusted */
+            ptr_source->conflicts++;
+        }
+    }
+
+    ptr_source->is_valid = true;
+    ptr_source->local_us = local_us;
+    ptr_source->earliest_us = earliest_us;
+    ptr_source->latest_us = latest_us;
+}
+
+bool time_source_add_http_date(time_source_t * ptr_source, const char * ptr_date, int64_t sent_us, int64_t received_us)
+{
+    int64_t date_s;
+    if ((received_us < sent_us) || !time_source_parse_http_date(ptr_date, &date_s))
+    {
+        return false;
+    }
+
+    /* Stamped at [sent, received], truncated: at received the time is at most a second and the round trip later */
+    time_source_add(ptr_source,
+                    date_s * TIME_SOURCE_US_IN_S,
+                    (date_s + 1) * TIME_SOURCE_US_IN_S + (received_us - sent_us),
+                    received_us);
+
+    return true;
+}
+
+bool time_source_estimate(const time_source_t * ptr_source, int64_t local_us, int64_t * ptr_ref_us, int64_t * ptr_error_us)
+{
+    if (!ptr_source->is_valid)
+    {
+        return false;
+    }
+
+    int64_t earliest_us;
+    int64_t latest_us;
+    time_source_widen(ptr_source, local_us, &earliest_us, &latest_us);
+    *ptr_ref_us = earliest_us + (latest_us - earliest_us) / 2;
+    *ptr_error_us = (latest_us - earliest_us + 1) / 2;
+
+    return true;
+}
+
+bool time_source_parse_http_date(const char * ptr_date, int64_t * ptr_unix_s)
+{
+    char month_str[4];
+    unsigned int day;
+    unsigned int year;
+    unsigned int hour;
+    unsigned int minute;
+    unsigned int second;
+    int len = 0;
+
+    /* Obsolete RFC 850 and asctime formats are not sent by current servers */
+    if ((6 != sscanf(ptr_date, "%*3[A-Za-z], %2u %3[A-Za-z] %4u %2u:%2u:%2u GMT%n",
+                     &day, month_str, &year, &hour, &minute, &second, &len)) ||
+        (0 == len))
+    {
+        return false;
+    }
+
+    uint32_t month = 0;
+    while ((month < 12) && (0 != strcasecmp(month_str, time_source_months[month])))
+    {
+        month++;
+    }
+    if ((month == 12) || (day < 1) || (day > 31) || (year < 1970) ||
+        (hour > 23) || (minute > 59) || (second > 60))
+    {
+        return false;
+    }
+
+    *ptr_unix_s = time_source_days(year, month + 1, day) * 86400 + hour * 3600 + minute * 60 + second;
+
+    return true;
+}
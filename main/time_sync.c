@@ -10,9 +10,12 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_bit_defs.h"
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "nvs.h"
@@ -24,105 +27,442 @@
 #include "lwip/sys.h"
 #include "lwip/netdb.h"
 #include "lwip/dns.h"
+#include "dns_cache.h"
+#include "clock_drift.h"
+#include "ntp_client.h"
+#include "time_source.h"
+#include "time_checkpoint.h"
+#include "phase_trace.h"
 #include "time_sync.h"
 
 static const char *TAG = "time_sync";
 
 #define STORAGE_NAMESPACE "storage"
 
-void initialize_sntp(void)
+#define TIME_SYNC_TASK_NAME         "time_sync"
+#define TIME_SYNC_TASK_STACK_SIZE   3072
+#define TIME_SYNC_TASK_PRIORITY     3
+#define TIME_SYNC_DEADLINE_MS       3000    // whole query, DNS lookups included
+#define TIME_SYNC_RETRY_S           600     // next attempt after a failed sync
+#define TIME_SYNC_STEP_US           500000LL    // larger offsets are stepped, smaller ones slewed
+#define TIME_SYNC_CORRECTION_US     60000000LL  // learned drift is slewed out once a minute
+#define TIME_SYNC_DRIFT_KEY         "drift" // NVS key of the drift model
+#define TIME_SYNC_CHECKPOINT_NVS    60      // every 60th checkpoint (hourly) is written to NVS as well
+#define TIME_SYNC_DRIFT_MARGIN_PPB  10000   // learned drift is trusted within 10 ppm (temperature, aging)
+
+#define TIME_SYNC_REQUEST_BIT       BIT0    // sync is requested (timer callback)
+#define TIME_SYNC_CHECKPOINT_BIT    BIT1    // checkpoint is due (correction timer)
+
+// Kinds of samples the time estimate is made of
+#define TIME_SYNC_SAMPLE_CHECKPOINT BIT0    // checkpoint restored after a reset
+#define TIME_SYNC_SAMPLE_HTTP_DATE  BIT1    // Date header of an HTTPS response
+#define TIME_SYNC_SAMPLE_NTP        BIT2    // NTP exchange
+
+/*
+ * Sync states. The slow steps (DNS lookups, waiting for the replies, NVS
+ * write) run in the time_sync task, callbacks only set bits.
+ */
+typedef enum {
+    TIME_SYNC_STATE_IDLE = 0,
+    TIME_SYNC_STATE_QUERYING,
+    TIME_SYNC_STATE_STORING,
+} time_sync_state_t;
+
+// Queried together with the DHCP provided server, in order of preference
+static const char *const time_sync_server_names[] = {
+    "pool.ntp.org",
+    "time.google.com",
+    "time.cloudflare.com",
+};
+
+static EventGroupHandle_t time_sync_events;
+static volatile time_sync_state_t time_sync_state = TIME_SYNC_STATE_IDLE;
+static esp_timer_handle_t time_sync_timer;
+
+// Drift is written by the time_sync task and read by the correction timer (32-bit, atomic)
+static clock_drift_t time_sync_drift;
+
+// Written by the weather task (HTTP Date headers) and the time_sync task
+static time_source_t time_sync_source;
+static SemaphoreHandle_t time_sync_source_mutex;
+static uint32_t time_sync_source_kinds;    // TIME_SYNC_SAMPLE_* bits of the samples in the estimate
+static uint32_t time_sync_skipped;  // syncs served by HTTP Date samples
+static uint32_t time_sync_unconfirmed;  // syncs served by the checkpoint or an earlier NTP exchange alone
+static uint32_t time_sync_checkpoints;
+static EventGroupHandle_t time_sync_notify_group;  // application readiness bits set on every completed sync
+static EventBits_t time_sync_notify_bits;
+static bool time_sync_is_set;       // clock is synced or restored, a checkpoint of 1970 would replace a good one
+
+static esp_err_t time_sync_checkpoint(bool is_durable);
+static void store_drift_in_nvs(void);
+
+static size_t time_sync_add_server(struct sockaddr_in *servers, size_t qty, uint32_t addr)
 {
-    ESP_LOGI(TAG, "Initializing SNTP");
-    sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    sntp_setservername(0, "pool.ntp.org");
-#ifdef CONFIG_SNTP_TIME_SYNC_METHOD_SMOOTH
-    sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
-#endif
-    sntp_init();
+    for (size_t i = 0; i < qty; i++) {
+        if (servers[i].sin_addr.s_addr == addr) {
+            return qty;
+        }
+    }
+    memset(&servers[qty], 0, sizeof(servers[qty]));
+    servers[qty].sin_family = AF_INET;
+    servers[qty].sin_port = htons(NTP_CLIENT_PORT);
+    servers[qty].sin_addr.s_addr = addr;
+    return qty + 1;
 }
 
-static void obtain_time(void)
+// DHCP provided server first, then the named ones resolved through the RTC cache
+static size_t time_sync_servers(struct sockaddr_in *servers)
 {
-    /**
-     * NTP server address could be aquired via DHCP,
-     * see LWIP_DHCP_GET_NTP_SRV menuconfig option
-     */
-#ifdef LWIP_DHCP_GET_NTP_SRV
-    sntp_servermode_dhcp(1);
+    size_t qty = 0;
+
+#if LWIP_DHCP_GET_NTP_SRV
+    const ip_addr_t *dhcp_server = sntp_getserver(0);
+    if ((dhcp_server != NULL) && IP_IS_V4(dhcp_server) && !ip_addr_isany(dhcp_server)) {
+        qty = time_sync_add_server(servers, qty, ip_2_ip4(dhcp_server)->addr);
+    }
 #endif
+    for (size_t i = 0; (i < sizeof(time_sync_server_names) / sizeof(time_sync_server_names[0])) &&
+                       (qty < NTP_CLIENT_SERVERS_MAX); i++) {
+        ip4_addr_t addr;
+        if (dns_cache_resolve(time_sync_server_names[i], &addr) == ESP_OK) {
+            qty = time_sync_add_server(servers, qty, addr.addr);
+        }
+    }
+    return qty;
+}
 
-    // wait for time to be set
-    int retry = 0;
-    const int retry_count = 10;
-    while (sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET && ++retry < retry_count) {
-        ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
+// Steps or slews the system clock by the offset to the reference time
+static void time_sync_adjust(int64_t offset_us)
+{
+#ifdef CONFIG_SNTP_TIME_SYNC_METHOD_SMOOTH
+    if (llabs(offset_us) < TIME_SYNC_STEP_US) {
+        struct timeval delta = {
+            .tv_sec = offset_us / 1000000,
+            .tv_usec = offset_us % 1000000,
+        };
+        adjtime(&delta, NULL);
+        return;
     }
+#endif
+    int64_t ref_us = ntp_client_now_us() + offset_us;
+    struct timeval now = {
+        .tv_sec = ref_us / 1000000,
+        .tv_usec = ref_us % 1000000,
+    };
+    settimeofday(&now, NULL);
 }
 
-void fetch_and_store_time_in_nvs(void *args)
+// Called with the source mutex taken: a sample that did not overlap the estimate has replaced it
+static void time_sync_sample_taken(uint32_t kind, uint32_t conflicts)
 {
-    initialize_sntp();
-    obtain_time();
+    if (time_sync_source.conflicts != conflicts) {
+        time_sync_source_kinds = kind;
+    } else {
+        time_sync_source_kinds |= kind;
+    }
+}
 
-    nvs_handle_t my_handle;
-    esp_err_t err;
+// Called with the source mutex taken: once the model has weight, samples age by the learned drift and its margin
+static void time_sync_source_drift(void)
+{
+    if (time_sync_drift.state.weight_s > 0) {
+        time_source_set_drift(&time_sync_source, abs(time_sync_drift.state.drift_ppb) + TIME_SYNC_DRIFT_MARGIN_PPB);
+    }
+}
 
-    time_t now;
-    time(&now);
+static bool time_sync_estimate(int64_t local_us, int64_t *ref_us, int64_t *error_us, uint32_t *kinds)
+{
+    xSemaphoreTake(time_sync_source_mutex, portMAX_DELAY);
+    bool is_valid = time_source_estimate(&time_sync_source, local_us, ref_us, error_us);
+    if (kinds != NULL) {
+        *kinds = time_sync_source_kinds;
+    }
+    xSemaphoreGive(time_sync_source_mutex);
+    return is_valid;
+}
 
-    //Open
-    err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &my_handle);
-    if (err != ESP_OK) {
-        goto exit;
+// NTP exchange, returns true if the clock is set
+static bool time_sync_query(int64_t start_us)
+{
+    struct sockaddr_in servers[NTP_CLIENT_SERVERS_MAX];
+    size_t qty = time_sync_servers(servers);
+    int64_t lookup_ms = (esp_timer_get_time() - start_us) / 1000;
+    static ntp_result_t result;
+    const ntp_sample_t *best = NULL;
+    if ((qty > 0) && (lookup_ms < TIME_SYNC_DEADLINE_MS)) {
+        best = ntp_client_query(servers, qty, TIME_SYNC_DEADLINE_MS - lookup_ms, &result);
+    }
+    if (best == NULL) {
+        ESP_LOGW(TAG, "System time is not set in %lld ms: %u servers, none answered",
+                 (esp_timer_get_time() - start_us) / 1000, qty);
+        return false;
     }
 
-    //Write
-    err = nvs_set_i64(my_handle, "timestamp", now);
-    if (err != ESP_OK) {
-        goto exit;
+    int64_t local_us = esp_timer_get_time();
+    int64_t ref_us = ntp_client_now_us() + best->offset_us;
+    time_sync_adjust(best->offset_us);
+    ESP_LOGI(TAG, "System time is set in %lld ms: %u of %u servers answered, %s selected, "
+             "offset %lld ms, delay %lld ms",
+             (esp_timer_get_time() - start_us) / 1000, result.answered, qty,
+             inet_ntoa(servers[result.best].sin_addr),
+             best->offset_us / 1000, best->delay_us / 1000);
+
+    xSemaphoreTake(time_sync_source_mutex, portMAX_DELAY);
+    uint32_t conflicts = time_sync_source.conflicts;
+    time_source_add(&time_sync_source, ref_us - best->distance_us, ref_us + best->distance_us, local_us);
+    time_sync_sample_taken(TIME_SYNC_SAMPLE_NTP, conflicts);
+    xSemaphoreGive(time_sync_source_mutex);
+
+    // Date samples are too coarse to measure drift with, only NTP feeds the model
+    if (clock_drift_sample(&time_sync_drift, ref_us, local_us)) {
+        ESP_LOGI(TAG, "Clock was off by %lld ms, drift %d ppb, next sync in %u s",
+                 time_sync_drift.last_error_us / 1000,
+                 time_sync_drift.state.drift_ppb,
+                 time_sync_drift.state.interval_s);
+        store_drift_in_nvs();
+        xSemaphoreTake(time_sync_source_mutex, portMAX_DELAY);
+        time_sync_source_drift();
+        xSemaphoreGive(time_sync_source_mutex);
     }
+    return true;
+}
 
-    err = nvs_commit(my_handle);
-    if (err != ESP_OK) {
-        goto exit;
+static void time_sync_task(void *args)
+{
+    for (;;) {
+        EventBits_t requested = xEventGroupWaitBits(time_sync_events,
+                                                    TIME_SYNC_REQUEST_BIT | TIME_SYNC_CHECKPOINT_BIT,
+                                                    pdTRUE, pdFALSE, portMAX_DELAY);
+        if (!(requested & TIME_SYNC_REQUEST_BIT)) {
+            time_sync_checkpoints++;
+            time_sync_checkpoint((time_sync_checkpoints % TIME_SYNC_CHECKPOINT_NVS) == 0);
+            continue;
+        }
+
+        time_sync_state = TIME_SYNC_STATE_QUERYING;
+        int64_t start_us = esp_timer_get_time();
+
+        // An estimate within the error bound makes the NTP exchange unnecessary
+        int64_t ref_us;
+        int64_t error_us;
+        uint32_t kinds;
+        bool is_set;
+        if (time_sync_estimate(start_us, &ref_us, &error_us, &kinds) &&
+            (error_us <= time_sync_drift.cfg.error_bound_ms * 1000LL)) {
+            int64_t offset_us = ref_us - ntp_client_now_us();
+            if (llabs(offset_us) > error_us) {
+                time_sync_adjust(offset_us);
+            }
+            if (kinds & TIME_SYNC_SAMPLE_HTTP_DATE) {
+                time_sync_skipped++;
+                ESP_LOGI(TAG, "System time is confirmed by HTTP Date within %lld ms, clock was off by %lld ms, "
+                         "NTP skipped (%u times)", error_us / 1000, offset_us / 1000, time_sync_skipped);
+            } else {
+                // Nothing has checked the clock since: the estimate is still within the bound, not confirmed
+                time_sync_unconfirmed++;
+                ESP_LOGI(TAG, "System time is within %lld ms by the %s alone, NTP skipped (%u times)",
+                         error_us / 1000,
+                         (kinds & TIME_SYNC_SAMPLE_NTP) ? "last NTP sync" : "restored checkpoint",
+                         time_sync_unconfirmed);
+            }
+            is_set = true;
+        } else {
+            is_set = time_sync_query(start_us);
+        }
+
+        bool is_stored = false;
+        uint32_t next_s = TIME_SYNC_RETRY_S;
+        if (is_set) {
+            phase_trace_mark(PHASE_TRACE_TIME_VALID);
+            time_sync_is_set = true;
+            time_sync_state = TIME_SYNC_STATE_STORING;
+            is_stored = (time_sync_checkpoint(true) == ESP_OK);
+            next_s = time_sync_drift.state.interval_s;
+        }
+        esp_timer_stop(time_sync_timer);
+        esp_timer_start_once(time_sync_timer, next_s * 1000000ULL);
+
+        time_sync_state = TIME_SYNC_STATE_IDLE;
+        if (is_stored && (time_sync_notify_group != NULL)) {
+            xEventGroupSetBits(time_sync_notify_group, time_sync_notify_bits);
+        }
     }
+}
 
-    nvs_close(my_handle);
-    sntp_stop();
+// Current time with its error bound: estimate error plus how far the clock is from the estimate
+static esp_err_t time_sync_checkpoint(bool is_durable)
+{
+    if (!time_sync_is_set) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t ref_us;
+    int64_t error_us = TIME_CHECKPOINT_ERROR_UNKNOWN;
+    if (time_sync_estimate(esp_timer_get_time(), &ref_us, &error_us, NULL)) {
+        error_us += llabs(ntp_client_now_us() - ref_us);
+    }
+    esp_err_t err = time_checkpoint_save(error_us, is_durable);
+    if (is_durable && (err == ESP_OK)) {
+        ESP_LOGI(TAG, "Updated time checkpoint in NVS, error %lld ms",
+                 (error_us == TIME_CHECKPOINT_ERROR_UNKNOWN) ? -1LL : error_us / 1000);
+    }
+    return err;
+}
 
-exit:
+static void store_drift_in_nvs(void)
+{
+    nvs_handle_t my_handle;
+    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &my_handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(my_handle, TIME_SYNC_DRIFT_KEY, &time_sync_drift.state, sizeof(time_sync_drift.state));
+        if (err == ESP_OK) {
+            err = nvs_commit(my_handle);
+        }
+        nvs_close(my_handle);
+    }
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error updating time in nvs");
-    } else {
-        ESP_LOGI(TAG, "Updated time in NVS");
+        ESP_LOGW(TAG, "Error storing drift model: %s", esp_err_to_name(err));
     }
 }
 
-esp_err_t update_time_from_nvs(void)
+static void load_drift_from_nvs(const clock_drift_cfg_t *cfg)
 {
     nvs_handle_t my_handle;
-    esp_err_t err;
+    clock_drift_state_t state;
+    size_t len = sizeof(state);
+    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &my_handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(my_handle, TIME_SYNC_DRIFT_KEY, &state, &len);
+        nvs_close(my_handle);
+    }
+    if ((err == ESP_OK) && (len == sizeof(state))) {
+        clock_drift_init(&time_sync_drift, cfg, &state);
+        ESP_LOGI(TAG, "Drift model: %d ppb over %u s, sync interval %u s",
+                 state.drift_ppb, state.weight_s, time_sync_drift.state.interval_s);
+    } else {
+        clock_drift_init(&time_sync_drift, cfg, NULL);
+    }
+}
+
+// Slews the learned drift out of the system clock, adjtime only queues the adjustment
+static void time_sync_correct(void *args)
+{
+    int64_t correction_us = clock_drift_correction(&time_sync_drift, TIME_SYNC_CORRECTION_US);
+    if ((correction_us != 0) && (time_sync_state == TIME_SYNC_STATE_IDLE)) {
+        struct timeval delta = {
+            .tv_sec = correction_us / 1000000,
+            .tv_usec = correction_us % 1000000,
+        };
+        adjtime(&delta, NULL);
+    }
+    xEventGroupSetBits(time_sync_events, TIME_SYNC_CHECKPOINT_BIT);
+}
+
+esp_err_t time_sync_init(const clock_drift_cfg_t *cfg)
+{
+    time_sync_events = xEventGroupCreate();
+    time_sync_source_mutex = xSemaphoreCreateMutex();
+    if ((time_sync_events == NULL) || (time_sync_source_mutex == NULL)) {
+        return ESP_ERR_NO_MEM;
+    }
+    time_source_init(&time_sync_source);
+    load_drift_from_nvs(cfg);
+    time_sync_source_drift();
+#if LWIP_DHCP_GET_NTP_SRV
+    // The SNTP client is not started, it only keeps the server the DHCP lease provides
+    sntp_servermode_dhcp(1);
+#endif
 
-    err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &my_handle);
+    const esp_timer_create_args_t sync_timer_args = {
+        .callback = &fetch_and_store_time_in_nvs,
+        .name = "time_sync",
+    };
+    const esp_timer_create_args_t correction_timer_args = {
+        .callback = &time_sync_correct,
+        .name = "time_correct",
+    };
+    esp_timer_handle_t correction_timer;
+    esp_err_t err = esp_timer_create(&sync_timer_args, &time_sync_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_once(time_sync_timer, time_sync_drift.state.interval_s * 1000000ULL);
+    }
+    if (err == ESP_OK) {
+        err = esp_timer_create(&correction_timer_args, &correction_timer);
+    }
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(correction_timer, TIME_SYNC_CORRECTION_US);
+    }
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS");
-        goto exit;
+        return err;
     }
+    if (xTaskCreate(time_sync_task, TIME_SYNC_TASK_NAME, TIME_SYNC_TASK_STACK_SIZE,
+                    NULL, TIME_SYNC_TASK_PRIORITY, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
 
-    int64_t timestamp = 0;
+void fetch_and_store_time_in_nvs(void *args)
+{
+    // Runs in the esp_timer task: only the request bit is set, a sync in progress absorbs the request
+    if (time_sync_state == TIME_SYNC_STATE_IDLE) {
+        xEventGroupSetBits(time_sync_events, TIME_SYNC_REQUEST_BIT);
+    }
+}
 
-    err = nvs_get_i64(my_handle, "timestamp", &timestamp);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        fetch_and_store_time_in_nvs(NULL);
-        err = ESP_OK;
-    } else if (err == ESP_OK) {
-        struct timeval get_nvs_time;
-        get_nvs_time.tv_sec = timestamp;
-        settimeofday(&get_nvs_time, NULL);
+void time_sync_http_date(const char *date, int64_t sent_us, int64_t received_us)
+{
+    if (time_sync_source_mutex == NULL) {
+        return;
+    }
+    xSemaphoreTake(time_sync_source_mutex, portMAX_DELAY);
+    uint32_t conflicts = time_sync_source.conflicts;
+    bool is_taken = time_source_add_http_date(&time_sync_source, date, sent_us, received_us);
+    if (is_taken) {
+        time_sync_sample_taken(TIME_SYNC_SAMPLE_HTTP_DATE, conflicts);
+    }
+    xSemaphoreGive(time_sync_source_mutex);
+    if (!is_taken) {
+        ESP_LOGW(TAG, "Unexpected HTTP Date: %s", date);
     }
+}
 
-exit:
-    nvs_close(my_handle);
-    return err;
+void time_sync_set_notify(EventGroupHandle_t group, EventBits_t bits)
+{
+    time_sync_notify_bits = bits;
+    time_sync_notify_group = group;
+}
+
+esp_err_t time_sync_restore(void)
+{
+    int64_t wall_us;
+    int64_t error_us;
+    if (time_checkpoint_restore(&wall_us, &error_us) != ESP_OK) {
+        ESP_LOGI(TAG, "No time checkpoint");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // The clock may have been kept through the reset, then it is left as is
+    int64_t now_us = ntp_client_now_us();
+    bool is_known = (error_us != TIME_CHECKPOINT_ERROR_UNKNOWN);
+    if ((is_known && (llabs(now_us - wall_us) > error_us)) || (!is_known && (now_us < wall_us))) {
+        struct timeval tv = {
+            .tv_sec = wall_us / 1000000,
+            .tv_usec = wall_us % 1000000,
+        };
+        settimeofday(&tv, NULL);
+    }
+    time_sync_is_set = true;
+    if (!is_known) {
+        ESP_LOGI(TAG, "System time is restored, lower bound only");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // A bounded estimate is as good as any other sample until it ages out, but it confirms nothing
+    xSemaphoreTake(time_sync_source_mutex, portMAX_DELAY);
+    uint32_t conflicts = time_sync_source.conflicts;
+    time_source_add(&time_sync_source, wall_us - error_us, wall_us + error_us, esp_timer_get_time());
+    time_sync_sample_taken(TIME_SYNC_SAMPLE_CHECKPOINT, conflicts);
+    xSemaphoreGive(time_sync_source_mutex);
+    ESP_LOGI(TAG, "System time is restored within %lld ms", error_us / 1000);
+    return (error_us <= time_sync_drift.cfg.error_bound_ms * 1000LL) ? ESP_OK : ESP_ERR_INVALID_STATE;
 }
@@ -0,0 +1,231 @@
+/**
+ *  @file       tls_session.c
+ *
+ *  @brief      TLS client session persistence in NVS
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+/* Master secret is the only evidence that the server accepted the offered session */
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "sdkconfig.h"
+#include "esp_idf_version.h"
+#include "esp_log.h"
+#include "esp_tls.h"
+
+#include "nvs.h"
+
+#include "mbedtls/ssl.h"
+
+#include "tls_session.h"
+
+/******************** DEFINES ********************/
+
+#define STORAGE_NAMESPACE "storage"     /**< NVS namespace shared with time_sync */
+
+/**
+ *  esp-tls does not expose the client session structure, but it holds the
+ *  mbedTLS session as its only member, so the session pointer is the
+ *  esp_tls_client_session_t pointer.
+ */
+#define TLS_SESSION_MBEDTLS(ptr_session) ((const mbedtls_ssl_session *) (ptr_session))
+
+/* The session structure is private to esp-tls, so its layout is pinned to the checked releases */
+#if !CONFIG_ESP_TLS_USING_MBEDTLS || !CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+#error "TLS_SESSION_MBEDTLS needs esp-tls on mbedTLS with client session tickets"
+#endif
+#if (ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 0, 0)) || (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(6, 0, 0))
+#error "esp_tls_client_session_t layout is checked for ESP-IDF 5.x only, check TLS_SESSION_MBEDTLS"
+#endif
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * TAG = "tls_session";
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static bool tls_session_is_stored(nvs_handle_t handle, const char * ptr_key, const unsigned char * ptr_blob, size_t blob_len);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Check that NVS already holds the same serialized session
+ *
+ *  @param[in]  handle      Opened NVS handle
+ *  @param[in]  ptr_key     NVS key of the session
+ *  @param[in]  ptr_blob    Serialized session
+ *  @param[in]  blob_len    Serialized session length
+ *
+ *  @return     true if the stored blob is equal
+ */
+static bool tls_session_is_stored(nvs_handle_t handle, const char * ptr_key, const unsigned char * ptr_blob, size_t blob_len)
+{
+    size_t stored_len = 0;
+    if ((ESP_OK != nvs_get_blob(handle, ptr_key, NULL, &stored_len)) || (stored_len != blob_len))
+    {
+        return false;
+    }
+
+    unsigned char * ptr_stored = malloc(stored_len);
+    if (NULL == ptr_stored)
+    {
+        return false;
+    }
+    bool is_equal = (ESP_OK == nvs_get_blob(handle, ptr_key, ptr_stored, &stored_len)) &&
+                    (0 == memcmp(ptr_stored, ptr_blob, blob_len));
+    free(ptr_stored);
+
+    return is_equal;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_err_t tls_session_load(const char * ptr_key, esp_tls_client_session_t ** pptr_session)
+{
+    nvs_handle_t handle;
+    unsigned char * ptr_blob = NULL;
+    mbedtls_ssl_session * ptr_session = NULL;
+    size_t blob_len = 0;
+
+    *pptr_session = NULL;
+
+    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READONLY, &handle);
+    if (ESP_OK != err)
+    {
+        return err;
+    }
+
+    err = nvs_get_blob(handle, ptr_key, NULL, &blob_len);
+    if (ESP_OK != err)
+    {
+        goto exit;
+    }
+
+    ptr_blob = malloc(blob_len);
+    ptr_session = calloc(1, sizeof(mbedtls_ssl_session));
+    if ((NULL == ptr_blob) || (NULL == ptr_session))
+    {
+        err = ESP_ERR_NO_MEM;
+        goto exit;
+    }
+
+    err = nvs_get_blob(handle, ptr_key, ptr_blob, &blob_len);
+    if (ESP_OK != err)
+    {
+        goto exit;
+    }
+
+    mbedtls_ssl_session_init(ptr_session);
+    if (0 != mbedtls_ssl_session_load(ptr_session, ptr_blob, blob_len))
+    {
+        ESP_LOGW(TAG, "Saved session is not valid anymore");
+        mbedtls_ssl_session_free(ptr_session);
+        err = ESP_ERR_INVALID_VERSION;
+        goto exit;
+    }
+
+    *pptr_session = (esp_tls_client_session_t *) ptr_session;
+    ptr_session = NULL;
+    ESP_LOGI(TAG, "Restored TLS session (%u bytes)", blob_len);
+
+exit:
+    free(ptr_session);
+    free(ptr_blob);
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t tls_session_store(const char * ptr_key, const esp_tls_client_session_t * ptr_session)
+{
+    nvs_handle_t handle;
+    unsigned char * ptr_blob = NULL;
+    size_t blob_len = 0;
+
+    /* The first call only reports the serialized session size */
+    int ret = mbedtls_ssl_session_save(TLS_SESSION_MBEDTLS(ptr_session), NULL, 0, &blob_len);
+    if ((MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL != ret) || (0 == blob_len))
+    {
+        ESP_LOGE(TAG, "Cannot serialize session: -0x%04X", -ret);
+        return ESP_FAIL;
+    }
+
+    ptr_blob = malloc(blob_len);
+    if (NULL == ptr_blob)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (0 != mbedtls_ssl_session_save(TLS_SESSION_MBEDTLS(ptr_session), ptr_blob, blob_len, &blob_len))
+    {
+        free(ptr_blob);
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle);
+    if (ESP_OK != err)
+    {
+        free(ptr_blob);
+        return err;
+    }
+
+    /* A resumed session without a new ticket serializes the same, flash is not written */
+    if (tls_session_is_stored(handle, ptr_key, ptr_blob, blob_len))
+    {
+        nvs_close(handle);
+        free(ptr_blob);
+        ESP_LOGI(TAG, "TLS session is unchanged");
+        return ESP_OK;
+    }
+
+    err = nvs_set_blob(handle, ptr_key, ptr_blob, blob_len);
+    if (ESP_OK == err)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    free(ptr_blob);
+
+    if (ESP_OK != err)
+    {
+        ESP_LOGE(TAG, "Error saving session in NVS");
+    }
+    else
+    {
+        ESP_LOGI(TAG, "Saved TLS session (%u bytes)", blob_len);
+    }
+    return err;
+}
+
+esp_err_t tls_session_erase(const char * ptr_key)
+{
+    nvs_handle_t handle;
+
+    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle);
+    if (ESP_OK != err)
+    {
+        return err;
+    }
+
+    err = nvs_erase_key(handle, ptr_key);
+    if (ESP_OK == err)
+    {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+bool tls_session_is_resumed(const esp_tls_client_session_t * ptr_offered, const esp_tls_client_session_t * ptr_session)
+{
+    /* Abbreviated handshake keeps the master secret, a full one derives a new one */
+    return (NULL != ptr_offered) && (NULL != ptr_session) &&
+           (0 == memcmp(TLS_SESSION_MBEDTLS(ptr_offered)->MBEDTLS_PRIVATE(master),
+                        TLS_SESSION_MBEDTLS(ptr_session)->MBEDTLS_PRIVATE(master),
+                        sizeof(TLS_SESSION_MBEDTLS(ptr_session)->MBEDTLS_PRIVATE(master))));
+}
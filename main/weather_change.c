@@ -0,0 +1,145 @@
+/**
+ *  @file       weather_change.c
+ *
+ *  @brief      Change detection of decoded weather and change-only notification
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+
+#include "weather_change.h"
+
+/******************** DEFINES ********************/
+
+#define WEATHER_CHANGE_HASH_PRIME   16777619U   /**< FNV-1a prime */
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+uint32_t weather_change_hash(const void * ptr_data, size_t len, uint32_t hash)
+{
+    const uint8_t * ptr_bytes = (const uint8_t *) ptr_data;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= ptr_bytes[i];
+        hash *= WEATHER_CHANGE_HASH_PRIME;
+    }
+
+    return hash;
+}
+
+uint32_t weather_record_fingerprint(const weather_record_t * ptr_record)
+{
+    weather_record_t canonical;
+
+    weather_record_canonical(ptr_record, &canonical);
+    return weather_change_hash(&canonical, sizeof(canonical), WEATHER_CHANGE_HASH_SEED);
+}
+
+void weather_change_init(weather_change_t * ptr_change)
+{
+    memset(ptr_change, 0x00, sizeof(*ptr_change));
+}
+
+bool weather_change_subscribe(weather_change_t * ptr_change,
+                              const char * ptr_name,
+                              uint16_t fields,
+                              weather_change_cb_t cb,
+                              void * ptr_arg)
+{
+    if (ptr_change->consumers_qty >= WEATHER_CHANGE_CONSUMERS_MAX)
+    {
+        return false;
+    }
+
+    weather_consumer_t * ptr_consumer = &ptr_change->consumers[ptr_change->consumers_qty++];
+    memset(ptr_consumer, 0x00, sizeof(*ptr_consumer));
+    ptr_consumer->ptr_name = ptr_name;
+    ptr_consumer->cb = cb;
+    ptr_consumer->ptr_arg = ptr_arg;
+    ptr_consumer->fields = fields;
+
+    return true;
+}
+
+void weather_snapshot_init(weather_snapshot_t * ptr_snapshot, const weather_record_t * ptr_record)
+{
+    weather_record_t canonical;
+
+    if (NULL == ptr_record)
+    {
+        memset(ptr_snapshot, 0x00, sizeof(*ptr_snapshot));
+        return;
+    }
+
+    /* The record may be the snapshot one */
+    weather_record_canonical(ptr_record, &canonical);
+    ptr_snapshot->record = canonical;
+    ptr_snapshot->fingerprint = weather_change_hash(&canonical, sizeof(canonical), WEATHER_CHANGE_HASH_SEED);
+    ptr_snapshot->is_valid = true;
+}
+
+uint16_t weather_change_update(weather_change_t * ptr_change,
+                               weather_snapshot_t * ptr_snapshot,
+                               size_t index,
+                               const weather_record_t * ptr_record)
+{
+    uint16_t changed;
+
+    ptr_change->updates++;
+    if (ptr_snapshot->is_valid)
+    {
+        changed = weather_record_diff(&ptr_snapshot->record, ptr_record);
+    }
+    else
+    {
+        changed = ptr_record->fields & WEATHER_RECORD_ALL;
+    }
+
+    if (0 == changed)
+    {
+        ptr_change->unchanged++;
+    }
+    else
+    {
+        weather_snapshot_init(ptr_snapshot, ptr_record);
+    }
+
+    for (size_t i = 0; i < ptr_change->consumers_qty; i++)
+    {
+        weather_consumer_t * ptr_consumer = &ptr_change->consumers[i];
+        uint16_t used = ptr_snapshot->record.fields & ptr_consumer->fields;
+        uint16_t delivered = changed & ptr_consumer->fields;
+
+        ptr_consumer->fields_sent += (uint32_t) __builtin_popcount(delivered);
+        ptr_consumer->fields_skipped += (uint32_t) __builtin_popcount(used & ~delivered);
+        if (0 == delivered)
+        {
+            ptr_consumer->skipped++;
+            continue;
+        }
+        ptr_consumer->notified++;
+        ptr_consumer->cb(index, ptr_snapshot, delivered, ptr_consumer->ptr_arg);
+    }
+
+    return changed;
+}
+
+bool weather_fingerprint_update(weather_fingerprint_t * ptr_gate, const void * ptr_data, size_t len)
+{
+    uint32_t fingerprint = weather_change_hash(ptr_data, len, WEATHER_CHANGE_HASH_SEED);
+
+    if (ptr_gate->is_valid && (fingerprint == ptr_gate->value))
+    {
+        ptr_gate->repeats++;
+        return false;
+    }
+    ptr_gate->value = fingerprint;
+    ptr_gate->is_valid = true;
+    ptr_gate->changes++;
+
+    return true;
+}
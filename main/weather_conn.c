@@ -0,0 +1,552 @@
+/**
+ *  @file       weather_conn.c
+ *
+ *  @brief      Persistent keep-alive TLS connection manager
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <errno.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_tls.h"
+
+#include "lwip/sockets.h"
+
+#include "dns_cache.h"
+#include "tls_session.h"
+#include "phase_trace.h"
+#include "weather_conn.h"
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * TAG = "weather_conn";
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static esp_err_t weather_conn_open(weather_conn_t * ptr_conn);
+static bool weather_conn_save_session(weather_conn_t * ptr_conn);
+static bool weather_conn_is_alive(weather_conn_t * ptr_conn);
+static bool weather_conn_wait(weather_conn_t * ptr_conn, bool write);
+static esp_err_t weather_conn_exchange(weather_conn_t * ptr_conn,
+                                       const weather_conn_req_t * ptr_reqs,
+                                       size_t reqs_qty,
+                                       size_t * ptr_completed,
+                                       size_t * ptr_rx_total);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Full DNS + TCP + TLS connection setup
+ *
+ *  Server is connected by the cached address, host name is still used
+ *  for SNI and certificate verification.
+ *
+ *  @param[in]  ptr_conn    Connection context pointer
+ *
+ *  @return     ESP_OK on success
+ */
+static esp_err_t weather_conn_open(weather_conn_t * ptr_conn)
+{
+    ip4_addr_t addr;
+    esp_err_t err = dns_cache_resolve(ptr_conn->cfg.ptr_host, &addr);
+    if (ESP_OK != err)
+    {
+        return err;
+    }
+    ip4addr_ntoa_r(&addr, ptr_conn->addr_str, sizeof(ptr_conn->addr_str));
+    phase_trace_mark(PHASE_TRACE_DNS);
+
+    ptr_conn->ptr_tls = esp_tls_init();
+    if (NULL == ptr_conn->ptr_tls)
+    {
+        ESP_LOGE(TAG, "esp_tls_init()");
+        return ESP_ERR_NO_MEM;
+    }
+
+    bool resumption = (NULL != ptr_conn->ptr_session);
+    ptr_conn->tls_cfg.client_session = ptr_conn->ptr_session;
+
+    int64_t start_us = esp_timer_get_time();
+    if (esp_tls_conn_new_sync(ptr_conn->addr_str,
+                              strlen(ptr_conn->addr_str),
+                              ptr_conn->cfg.port,
+                              &ptr_conn->tls_cfg,
+                              ptr_conn->ptr_tls) != 1)
+    {
+        ESP_LOGE(TAG, "Connection to %s (%s) failed", ptr_conn->cfg.ptr_host, ptr_conn->addr_str);
+        esp_tls_conn_destroy(ptr_conn->ptr_tls);
+        ptr_conn->ptr_tls = NULL;
+
+        /* Server may have moved, resolve it again next time */
+        dns_cache_invalidate(ptr_conn->cfg.ptr_host);
+
+        /* Do not offer possibly broken session again */
+        if (resumption)
+        {
+            esp_tls_free_client_session(ptr_conn->ptr_session);
+            ptr_conn->ptr_session = NULL;
+            if (NULL != ptr_conn->cfg.ptr_session_key)
+            {
+                tls_session_erase(ptr_conn->cfg.ptr_session_key);
+            }
+        }
+        return ESP_FAIL;
+    }
+
+    phase_trace_mark(PHASE_TRACE_CONNECT);
+    int64_t handshake_us = esp_timer_get_time() - start_us;
+    bool is_resumed = weather_conn_save_session(ptr_conn);
+    ptr_conn->stats.handshakes++;
+    ptr_conn->stats.handshake_us_total += handshake_us;
+    if (resumption)
+    {
+        ptr_conn->stats.offers++;
+    }
+    if (is_resumed)
+    {
+        ptr_conn->stats.resumptions++;
+        ptr_conn->stats.resumption_us_total += handshake_us;
+    }
+    ptr_conn->keep_alive = true;
+    ESP_LOGI(TAG, "Connection established in %lld ms%s",
+             handshake_us / 1000,
+             is_resumed ? " (session resumed)" : (resumption ? " (offered session rejected)" : ""));
+
+    return ESP_OK;
+}
+
+/**
+ *  @brief      Keep the session of just established connection for the next one
+ *
+ *  @param[in]  ptr_conn    Connection context pointer
+ *
+ *  @return     true if the handshake resumed the offered session
+ */
+static bool weather_conn_save_session(weather_conn_t * ptr_conn)
+{
+    esp_tls_client_session_t * ptr_session = esp_tls_get_client_session(ptr_conn->ptr_tls);
+    if (NULL == ptr_session)
+    {
+        ESP_LOGW(TAG, "Cannot get TLS session");
+        return false;
+    }
+
+    bool is_resumed = tls_session_is_resumed(ptr_conn->ptr_session, ptr_session);
+    if (NULL != ptr_conn->ptr_session)
+    {
+        esp_tls_free_client_session(ptr_conn->ptr_session);
+    }
+    ptr_conn->ptr_session = ptr_session;
+
+    /* NVS copy is rewritten only if the session changed (tls_session_store() compares) */
+    if (NULL != ptr_conn->cfg.ptr_session_key)
+    {
+        tls_session_store(ptr_conn->cfg.ptr_session_key, ptr_session);
+    }
+
+    return is_resumed;
+}
+
+/**
+ *  @brief      Check that idle connection was not closed by the server
+ *
+ *  Idle keep-alive connection must not have any pending data. Either
+ *  FIN (recv() returns 0) or unsolicited bytes (TLS close_notify alert)
+ *  mean the server has dropped it.
+ *
+ *  @param[in]  ptr_conn    Connection context pointer
+ *
+ *  @return     true if connection is still usable
+ */
+static bool weather_conn_is_alive(weather_conn_t * ptr_conn)
+{
+    int sockfd = -1;
+    if ((esp_tls_get_conn_sockfd(ptr_conn->ptr_tls, &sockfd) != ESP_OK) || (sockfd < 0))
+    {
+        return false;
+    }
+
+    char byte;
+    int ret = recv(sockfd, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT);
+    if (ret >= 0)
+    {
+        return false;
+    }
+
+    return (errno == EWOULDBLOCK) || (errno == EAGAIN);
+}
+
+/**
+ *  @brief      Sleep until the socket is ready instead of retrying TLS call at once
+ *
+ *  @param[in]  ptr_conn    Connection context pointer
+ *  @param[in]  write       Wait for writability (readability otherwise)
+ *
+ *  @return     false if timeout expired or socket failed
+ */
+static bool weather_conn_wait(weather_conn_t * ptr_conn, bool write)
+{
+    int sockfd = -1;
+    if ((esp_tls_get_conn_sockfd(ptr_conn->ptr_tls, &sockfd) != ESP_OK) || (sockfd < 0))
+    {
+        return false;
+    }
+
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET(sockfd, &set);
+    struct timeval timeout = {
+        .tv_sec = ptr_conn->cfg.timeout_ms / 1000,
+        .tv_usec = (ptr_conn->cfg.timeout_ms % 1000) * 1000,
+    };
+
+    return select(sockfd + 1, write ? NULL : &set, write ? &set : NULL, NULL, &timeout) > 0;
+}
+
+/**
+ *  @brief      Pipelined requests/responses exchange over opened connection
+ *
+ *  @param[in]  ptr_conn        Connection context pointer
+ *  @param[in]  ptr_reqs        Requests
+ *  @param[in]  reqs_qty        Requests quantity
+ *  @param[out] ptr_completed   Requests completed (their done callbacks are called)
+ *  @param[out] ptr_rx_total    Received bytes quantity
+ *
+ *  @return     ESP_OK if all responses were received,
+ *              ESP_ERR_INVALID_STATE if connection died before any response byte
+ */
+static esp_err_t weather_conn_exchange(weather_conn_t * ptr_conn,
+                                       const weather_conn_req_t * ptr_reqs,
+                                       size_t reqs_qty,
+                                       size_t * ptr_completed,
+                                       size_t * ptr_rx_total)
+{
+    int32_t ret = 0;
+    size_t idx = 0;
+    bool is_read_failed = false;
+    *ptr_completed = 0;
+    *ptr_rx_total = 0;
+
+    /* Requests are small, all of them fit socket buffer before any response is read */
+    ptr_conn->sent_us = esp_timer_get_time();
+    for (size_t i = 0; i < reqs_qty; i++)
+    {
+        size_t written_bytes = 0;
+        do
+        {
+            ret = esp_tls_conn_write(ptr_conn->ptr_tls,
+                                     ptr_reqs[i].ptr_req + written_bytes,
+                                     ptr_reqs[i].req_len - written_bytes);
+            if (ret >= 0)
+            {
+                written_bytes += ret;
+            }
+            else if ((ret == ESP_TLS_ERR_SSL_WANT_READ  || ret == ESP_TLS_ERR_SSL_WANT_WRITE) &&
+                     weather_conn_wait(ptr_conn, ret == ESP_TLS_ERR_SSL_WANT_WRITE))
+            {
+                continue;
+            }
+            else
+            {
+                ESP_LOGW(TAG, "esp_tls_conn_write returned: [0x%02X](%s)", ret, esp_err_to_name(ret));
+                return ESP_ERR_INVALID_STATE;
+            }
+        } while (written_bytes < ptr_reqs[i].req_len);
+    }
+    phase_trace_mark(PHASE_TRACE_REQUEST_SENT);
+    ptr_conn->stats.pipelined += reqs_qty - 1;
+
+    char buf[WEATHER_CONN_RX_BUF_SIZE];
+    http_resp_t * ptr_resp = &ptr_conn->resp;
+    if (NULL != ptr_reqs[idx].begin_cb)
+    {
+        ptr_reqs[idx].begin_cb(ptr_reqs[idx].ptr_arg);
+    }
+    http_resp_init(ptr_resp, ptr_reqs[idx].ptr_cbs, ptr_reqs[idx].ptr_arg);
+
+    do
+    {
+        ret = esp_tls_conn_read(ptr_conn->ptr_tls, buf, sizeof(buf));
+        if ((ret == ESP_TLS_ERR_SSL_WANT_WRITE  || ret == ESP_TLS_ERR_SSL_WANT_READ) &&
+            weather_conn_wait(ptr_conn, ret == ESP_TLS_ERR_SSL_WANT_WRITE))
+        {
+            continue;
+        }
+        else if (ret < 0)
+        {
+            /* Timeout or TLS error: a close-delimited body is truncated, not complete */
+            if ((ret == ESP_TLS_ERR_SSL_WANT_WRITE) || (ret == ESP_TLS_ERR_SSL_WANT_READ))
+            {
+                ESP_LOGW(TAG, "Response timeout");
+            }
+            else
+            {
+                ESP_LOGW(TAG, "esp_tls_conn_read returned: [0x%02X](%s)", ret, esp_err_to_name(ret));
+            }
+            is_read_failed = true;
+            ptr_conn->keep_alive = false;
+            break;
+        }
+        else if (ret == 0)
+        {
+            /* Orderly close: response delimited by connection close completes here */
+            http_resp_eof(ptr_resp);
+            if (http_resp_is_done(ptr_resp))
+            {
+                phase_trace_mark(PHASE_TRACE_LAST_BYTE);
+                if (NULL != ptr_reqs[idx].done_cb)
+                {
+                    ptr_reqs[idx].done_cb(ESP_OK, ptr_resp, ptr_reqs[idx].ptr_arg);
+                }
+                idx++;
+                (*ptr_completed)++;
+            }
+            ptr_conn->keep_alive = false;
+            break;
+        }
+        if (0 == *ptr_rx_total)
+        {
+            phase_trace_mark(PHASE_TRACE_FIRST_BYTE);
+        }
+        *ptr_rx_total += ret;
+
+        /* One read may carry the tail of a response and the head of the next one */
+        size_t offset = 0;
+        do
+        {
+            offset += http_resp_feed(ptr_resp, buf + offset, ret - offset);
+            if (!http_resp_is_done(ptr_resp))
+            {
+                break;
+            }
+            if (idx + 1 == reqs_qty)
+            {
+                phase_trace_mark(PHASE_TRACE_LAST_BYTE);
+            }
+
+            if (NULL != ptr_reqs[idx].done_cb)
+            {
+                ptr_reqs[idx].done_cb(ESP_OK, ptr_resp, ptr_reqs[idx].ptr_arg);
+            }
+            idx++;
+            (*ptr_completed)++;
+            ptr_conn->keep_alive = ptr_conn->keep_alive && ptr_resp->keep_alive;
+            if ((idx == reqs_qty) || !ptr_conn->keep_alive)
+            {
+                if (offset < (size_t) ret)
+                {
+                    ESP_LOGW(TAG, "%u unexpected bytes after response", (size_t) ret - offset);
+                    ptr_conn->keep_alive = false;
+                }
+                break;
+            }
+
+            if (NULL != ptr_reqs[idx].begin_cb)
+            {
+                ptr_reqs[idx].begin_cb(ptr_reqs[idx].ptr_arg);
+            }
+            http_resp_init(ptr_resp, ptr_reqs[idx].ptr_cbs, ptr_reqs[idx].ptr_arg);
+        } while (offset < (size_t) ret);
+    } while ((idx < reqs_qty) && ptr_conn->keep_alive && !http_resp_is_error(ptr_resp));
+
+    if (0 == *ptr_rx_total)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (idx < reqs_qty)
+    {
+        if (http_resp_is_error(ptr_resp) || ptr_conn->keep_alive)
+        {
+            ESP_LOGE(TAG, "Response is malformed or truncated");
+        }
+        else if (!is_read_failed)
+        {
+            ESP_LOGI(TAG, "Server closed connection after %u of %u responses", idx, reqs_qty);
+        }
+        ptr_conn->keep_alive = false;
+        return ESP_FAIL;
+    }
+
+    ptr_conn->last_used_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_err_t weather_conn_init(weather_conn_t * ptr_conn, const weather_conn_cfg_t * ptr_cfg)
+{
+    if ((NULL == ptr_conn) || (NULL == ptr_cfg) || (NULL == ptr_cfg->ptr_host))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(ptr_conn, 0x00, sizeof(*ptr_conn));
+    ptr_conn->cfg = *ptr_cfg;
+    if (NULL != ptr_cfg->ptr_cacert)
+    {
+        ptr_conn->tls_cfg.cacert_buf = ptr_cfg->ptr_cacert;
+        ptr_conn->tls_cfg.cacert_bytes = ptr_cfg->cacert_bytes;
+    }
+    else
+    {
+        ptr_conn->tls_cfg.use_global_ca_store = true;
+    }
+    ptr_conn->tls_cfg.timeout_ms = ptr_cfg->timeout_ms;
+    ptr_conn->tls_cfg.common_name = ptr_cfg->ptr_host;
+
+    if (NULL != ptr_cfg->ptr_session_key)
+    {
+        tls_session_load(ptr_cfg->ptr_session_key, &ptr_conn->ptr_session);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t weather_conn_pipeline(weather_conn_t * ptr_conn,
+                                const weather_conn_req_t * ptr_reqs,
+                                size_t reqs_qty)
+{
+    esp_err_t err = ESP_FAIL;
+    size_t done = 0;
+    ptr_conn->stats.requests += reqs_qty;
+
+    /*
+     * New connection is tried while previous one made progress, or once
+     * if reused connection turned out to be dead before any response
+     */
+    while (done < reqs_qty)
+    {
+        bool reused = false;
+
+        if (NULL != ptr_conn->ptr_tls)
+        {
+            int64_t idle_us = esp_timer_get_time() - ptr_conn->last_used_us;
+            if (!ptr_conn->keep_alive)
+            {
+                weather_conn_close(ptr_conn);
+            }
+            else if (idle_us > ptr_conn->cfg.idle_timeout_us)
+            {
+                ESP_LOGI(TAG, "Connection idle for %lld s, reconnecting", idle_us / 1000000);
+                ptr_conn->stats.idle_expires++;
+                weather_conn_close(ptr_conn);
+            }
+            else if (!weather_conn_is_alive(ptr_conn))
+            {
+                ESP_LOGI(TAG, "Connection closed by server, reconnecting");
+                ptr_conn->stats.server_closes++;
+                weather_conn_close(ptr_conn);
+            }
+            else
+            {
+                reused = true;
+            }
+        }
+
+        if (NULL == ptr_conn->ptr_tls)
+        {
+            err = weather_conn_open(ptr_conn);
+            if (ESP_OK != err)
+            {
+                break;
+            }
+        }
+
+        size_t completed = 0;
+        size_t rx_total = 0;
+        err = weather_conn_exchange(ptr_conn, ptr_reqs + done, reqs_qty - done, &completed, &rx_total);
+        if (reused)
+        {
+            ptr_conn->stats.reuses += completed;
+        }
+        done += completed;
+        if (ESP_OK == err)
+        {
+            break;
+        }
+
+        weather_conn_close(ptr_conn);
+        if (completed > 0)
+        {
+            continue;
+        }
+        if (!reused || (ESP_ERR_INVALID_STATE != err))
+        {
+            break;
+        }
+        ESP_LOGI(TAG, "Reused connection dropped by server, retrying");
+        ptr_conn->stats.server_closes++;
+    }
+
+    for (size_t i = done; i < reqs_qty; i++)
+    {
+        if (NULL != ptr_reqs[i].done_cb)
+        {
+            ptr_reqs[i].done_cb(err, &ptr_conn->resp, ptr_reqs[i].ptr_arg);
+        }
+    }
+
+    if ((ESP_OK == err) && !ptr_conn->keep_alive)
+    {
+        weather_conn_close(ptr_conn);
+    }
+
+    return err;
+}
+
+void weather_conn_close(weather_conn_t * ptr_conn)
+{
+    if (NULL != ptr_conn->ptr_tls)
+    {
+        esp_tls_conn_destroy(ptr_conn->ptr_tls);
+        ptr_conn->ptr_tls = NULL;
+    }
+}
+
+void weather_conn_log_stats(const weather_conn_t * ptr_conn)
+{
+    const weather_conn_stats_t * ptr_stats = &ptr_conn->stats;
+    uint32_t full = ptr_stats->handshakes - ptr_stats->resumptions;
+    uint32_t rejected = ptr_stats->offers - ptr_stats->resumptions;
+    int64_t full_us_total = ptr_stats->handshake_us_total - ptr_stats->resumption_us_total;
+    int64_t handshake_avg_us = 0;
+    int64_t full_avg_us = 0;
+    int64_t resumption_avg_us = 0;
+    if (ptr_stats->handshakes > 0)
+    {
+        handshake_avg_us = ptr_stats->handshake_us_total / ptr_stats->handshakes;
+    }
+    if (full > 0)
+    {
+        full_avg_us = full_us_total / full;
+    }
+    if (ptr_stats->resumptions > 0)
+    {
+        resumption_avg_us = ptr_stats->resumption_us_total / ptr_stats->resumptions;
+    }
+
+    ESP_LOGI(TAG, "Requests: %u, handshakes: %u, reused: %u (%u%%), pipelined: %u, "
+                  "server closes: %u, idle expires: %u",
+             ptr_stats->requests,
+             ptr_stats->handshakes,
+             ptr_stats->reuses,
+             (ptr_stats->requests > 0) ? (ptr_stats->reuses * 100 / ptr_stats->requests) : 0,
+             ptr_stats->pipelined,
+             ptr_stats->server_closes,
+             ptr_stats->idle_expires);
+    ESP_LOGI(TAG, "Handshake avg: %lld ms, saved: %lld ms",
+             handshake_avg_us / 1000,
+             handshake_avg_us * ptr_stats->reuses / 1000);
+    ESP_LOGI(TAG, "Full handshakes: %u (avg %lld ms), resumed: %u (avg %lld ms), offered session rejected: %u",
+             full,
+             full_avg_us / 1000,
+             ptr_stats->resumptions,
+             resumption_avg_us / 1000,
+             rejected);
+}
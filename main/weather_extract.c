@@ -0,0 +1,170 @@
+/**
+ *  @file       weather_extract.c
+ *
+ *  @brief      Weather fields extractor driven by a constant key-path table
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+
+#include "json_num.h"
+#include "weather_extract.h"
+
+/******************** DEFINES ********************/
+
+/**< Table entry with path length computed at compile time */
+#define WEATHER_PATH(path, kind, field, is_signed, flag) \
+    { (path), sizeof(path) - 1, (kind), offsetof(weather_record_t, field), sizeof(((weather_record_t *) 0)->field), \
+      (is_signed), (flag) }
+
+/******************** GLOBAL VARIABLES ********************/
+
+const weather_path_t weather_paths[] = {
+    WEATHER_PATH("fact.obs_time",               WEATHER_VALUE_INT,          obs_time,        false, WEATHER_RECORD_OBS_TIME),
+    WEATHER_PATH("fact.temp",                   WEATHER_VALUE_TENTHS,       temp_dc,         true,  WEATHER_RECORD_TEMP),
+    WEATHER_PATH("fact.feels_like",             WEATHER_VALUE_TENTHS,       feels_like_dc,   true,  WEATHER_RECORD_FEELS_LIKE),
+    WEATHER_PATH("fact.humidity",               WEATHER_VALUE_INT,          humidity,        false, WEATHER_RECORD_HUMIDITY),
+    WEATHER_PATH("fact.pressure_mm",            WEATHER_VALUE_TENTHS,       pressure_dmm,    false, WEATHER_RECORD_PRESSURE),
+    WEATHER_PATH("fact.condition",              WEATHER_VALUE_CONDITION,    condition,       false, WEATHER_RECORD_CONDITION),
+    WEATHER_PATH("fact.wind_speed",             WEATHER_VALUE_TENTHS,       wind_speed_dms,  false, WEATHER_RECORD_WIND_SPEED),
+    WEATHER_PATH("fact.wind_dir",               WEATHER_VALUE_WIND_DIR,     wind_dir,        false, WEATHER_RECORD_WIND_DIR),
+    WEATHER_PATH("forecast.parts[0].part_name", WEATHER_VALUE_PART,         part_name,       false, WEATHER_RECORD_PART_NAME),
+    WEATHER_PATH("forecast.parts[0].temp_avg",  WEATHER_VALUE_TENTHS,       part_temp_dc,    true,  WEATHER_RECORD_PART_TEMP),
+    WEATHER_PATH("forecast.parts[0].condition", WEATHER_VALUE_CONDITION,    part_condition,  false, WEATHER_RECORD_PART_CONDITION),
+};
+
+const size_t weather_paths_qty = sizeof(weather_paths) / sizeof(weather_paths[0]);
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static bool weather_extract_put(uint8_t * ptr_field, size_t size, bool is_signed, int64_t value);
+static void weather_extract_value(const char * ptr_path,
+                                  json_stream_type_t type,
+                                  const char * ptr_value,
+                                  size_t len,
+                                  void * ptr_arg);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Integer into a little-endian field of 1, 2 or 4 bytes
+ *
+ *  @param[out] ptr_field   Field pointer (may be unaligned)
+ *  @param[in]  size        Field size
+ *  @param[in]  is_signed   Field is signed
+ *  @param[in]  value       Value
+ *
+ *  @return     false if value is out of the field range
+ */
+static bool weather_extract_put(uint8_t * ptr_field, size_t size, bool is_signed, int64_t value)
+{
+    int64_t min = is_signed ? -(1LL << (size * 8 - 1)) : 0;
+    int64_t max = is_signed ? (1LL << (size * 8 - 1)) - 1 : (1LL << (size * 8)) - 1;
+
+    if ((size > sizeof(uint32_t)) || (value < min) || (value > max))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        ptr_field[i] = (uint8_t) ((uint64_t) value >> (i * 8));
+    }
+
+    return true;
+}
+
+/**
+ *  @brief      Tokenizer value consumer, table lookup
+ *
+ *  @param[in]  ptr_path    Value path
+ *  @param[in]  type        Value type
+ *  @param[in]  ptr_value   Value text
+ *  @param[in]  len         Value text length
+ *  @param[in]  ptr_arg     Destination pointer
+ */
+static void weather_extract_value(const char * ptr_path,
+                                  json_stream_type_t type,
+                                  const char * ptr_value,
+                                  size_t len,
+                                  void * ptr_arg)
+{
+    weather_record_t * ptr_record = (weather_record_t *) ptr_arg;
+    size_t path_len = strlen(ptr_path);
+
+    for (size_t i = 0; i < weather_paths_qty; i++)
+    {
+        const weather_path_t * ptr_entry = &weather_paths[i];
+        if ((ptr_entry->path_len != path_len) || (0 != memcmp(ptr_entry->ptr_path, ptr_path, path_len)))
+        {
+            continue;
+        }
+
+        bool is_number = (WEATHER_VALUE_INT == ptr_entry->kind) || (WEATHER_VALUE_TENTHS == ptr_entry->kind);
+        if ((is_number && (JSON_STREAM_NUMBER == type)) || (!is_number && (JSON_STREAM_STRING == type)))
+        {
+            weather_extract_store(ptr_record, ptr_entry, ptr_value, len);
+        }
+        return;
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+void weather_extract_init(weather_extract_t * ptr_extract, weather_record_t * ptr_record)
+{
+    memset(ptr_record, 0x00, sizeof(*ptr_record));
+    ptr_extract->ptr_record = ptr_record;
+    json_stream_init(&ptr_extract->json, &weather_extract_value, ptr_record);
+}
+
+bool weather_extract_feed(weather_extract_t * ptr_extract, const char * ptr_data, size_t len)
+{
+    return json_stream_feed(&ptr_extract->json, ptr_data, len);
+}
+
+bool weather_extract_finish(weather_extract_t * ptr_extract)
+{
+    return json_stream_finish(&ptr_extract->json);
+}
+
+bool weather_extract_store(weather_record_t * ptr_record,
+                           const weather_path_t * ptr_path,
+                           const char * ptr_value,
+                           size_t len)
+{
+    int64_t value = 0;
+
+    switch (ptr_path->kind)
+    {
+    case WEATHER_VALUE_CONDITION:
+        value = weather_condition_from_str(ptr_value, len);
+        break;
+
+    case WEATHER_VALUE_WIND_DIR:
+        value = weather_wind_dir_from_str(ptr_value, len);
+        break;
+
+    case WEATHER_VALUE_PART:
+        value = weather_part_from_str(ptr_value, len);
+        break;
+
+    default:
+        /* Straight into fixed point, no soft-float on FPU-less cores */
+        if (!json_num_scaled(ptr_value, len, (WEATHER_VALUE_TENTHS == ptr_path->kind) ? 1 : 0, &value))
+        {
+            return false;
+        }
+        break;
+    }
+
+    if (!weather_extract_put((uint8_t *) ptr_record + ptr_path->offset, ptr_path->size, ptr_path->is_signed, value))
+    {
+        return false;
+    }
+    ptr_record->fields |= ptr_path->flag;
+
+    return true;
+}
@@ -0,0 +1,395 @@
+/**
+ *  @file       weather_record.c
+ *
+ *  @brief      Canonical packed weather record
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include "weather_record.h"
+
+/******************** DEFINES ********************/
+
+#define WEATHER_CONDITION_SLOTS 32  /**< Perfect hash table size (power of 2) */
+
+/**
+ *  @brief  Condition code hash: length, first and last characters
+ *
+ *  Multipliers are picked so that all known codes land in different slots.
+ *  A collision after adding a code is reported by -Woverride-init on the
+ *  slots table below.
+ */
+#define WEATHER_CONDITION_HASH(len, first, last) \
+    ((((uint32_t) (len)) * 19U + ((uint32_t) (first)) * 4U + (uint32_t) (last)) & (WEATHER_CONDITION_SLOTS - 1))
+
+/**< Slots table entry */
+#define WEATHER_CONDITION_SLOT(len, first, last, condition) \
+    [WEATHER_CONDITION_HASH(len, first, last)] = (condition)
+
+/**< Fields table entry */
+#define WEATHER_RECORD_FIELD(flag, member) \
+    { (flag), offsetof(weather_record_t, member), sizeof(((weather_record_t *) 0)->member) }
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Record field location
+ */
+typedef struct weather_record_field_s
+{
+    uint16_t flag;      /**< WEATHER_RECORD_* flag */
+    uint8_t offset;     /**< Offset in the record */
+    uint8_t size;       /**< Value size */
+} weather_record_field_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * const weather_condition_names[WEATHER_CONDITION_QTY] = {
+    [WEATHER_CONDITION_UNKNOWN]                 = "unknown",
+    [WEATHER_CONDITION_CLEAR]                   = "clear",
+    [WEATHER_CONDITION_PARTLY_CLOUDY]           = "partly-cloudy",
+    [WEATHER_CONDITION_CLOUDY]                  = "cloudy",
+    [WEATHER_CONDITION_OVERCAST]                = "overcast",
+    [WEATHER_CONDITION_DRIZZLE]                 = "drizzle",
+    [WEATHER_CONDITION_LIGHT_RAIN]              = "light-rain",
+    [WEATHER_CONDITION_RAIN]                    = "rain",
+    [WEATHER_CONDITION_MODERATE_RAIN]           = "moderate-rain",
+    [WEATHER_CONDITION_HEAVY_RAIN]              = "heavy-rain",
+    [WEATHER_CONDITION_CONTINUOUS_HEAVY_RAIN]   = "continuous-heavy-rain",
+    [WEATHER_CONDITION_SHOWERS]                 = "showers",
+    [WEATHER_CONDITION_WET_SNOW]                = "wet-snow",
+    [WEATHER_CONDITION_LIGHT_SNOW]              = "light-snow",
+    [WEATHER_CONDITION_SNOW]                    = "snow",
+    [WEATHER_CONDITION_SNOW_SHOWERS]            = "snow-showers",
+    [WEATHER_CONDITION_HAIL]                    = "hail",
+    [WEATHER_CONDITION_THUNDERSTORM]            = "thunderstorm",
+    [WEATHER_CONDITION_THUNDERSTORM_WITH_RAIN]  = "thunderstorm-with-rain",
+    [WEATHER_CONDITION_THUNDERSTORM_WITH_HAIL]  = "thunderstorm-with-hail",
+};
+
+/**< Condition by hash, empty slots are WEATHER_CONDITION_UNKNOWN */
+static const uint8_t weather_condition_slots[WEATHER_CONDITION_SLOTS] = {
+    WEATHER_CONDITION_SLOT(5,  'c', 'r', WEATHER_CONDITION_CLEAR),
+    WEATHER_CONDITION_SLOT(13, 'p', 'y', WEATHER_CONDITION_PARTLY_CLOUDY),
+    WEATHER_CONDITION_SLOT(6,  'c', 'y', WEATHER_CONDITION_CLOUDY),
+    WEATHER_CONDITION_SLOT(8,  'o', 't', WEATHER_CONDITION_OVERCAST),
+    WEATHER_CONDITION_SLOT(7,  'd', 'e', WEATHER_CONDITION_DRIZZLE),
+    WEATHER_CONDITION_SLOT(10, 'l', 'n', WEATHER_CONDITION_LIGHT_RAIN),
+    WEATHER_CONDITION_SLOT(4,  'r', 'n', WEATHER_CONDITION_RAIN),
+    WEATHER_CONDITION_SLOT(13, 'm', 'n', WEATHER_CONDITION_MODERATE_RAIN),
+    WEATHER_CONDITION_SLOT(10, 'h', 'n', WEATHER_CONDITION_HEAVY_RAIN),
+    WEATHER_CONDITION_SLOT(21, 'c', 'n', WEATHER_CONDITION_CONTINUOUS_HEAVY_RAIN),
+    WEATHER_CONDITION_SLOT(7,  's', 's', WEATHER_CONDITION_SHOWERS),
+    WEATHER_CONDITION_SLOT(8,  'w', 'w', WEATHER_CONDITION_WET_SNOW),
+    WEATHER_CONDITION_SLOT(10, 'l', 'w', WEATHER_CONDITION_LIGHT_SNOW),
+    WEATHER_CONDITION_SLOT(4,  's', 'w', WEATHER_CONDITION_SNOW),
+    WEATHER_CONDITION_SLOT(12, 's', 's', WEATHER_CONDITION_SNOW_SHOWERS),
+    WEATHER_CONDITION_SLOT(4,  'h', 'l', WEATHER_CONDITION_HAIL),
+    WEATHER_CONDITION_SLOT(12, 't', 'm', WEATHER_CONDITION_THUNDERSTORM),
+    WEATHER_CONDITION_SLOT(22, 't', 'n', WEATHER_CONDITION_THUNDERSTORM_WITH_RAIN),
+    WEATHER_CONDITION_SLOT(22, 't', 'l', WEATHER_CONDITION_THUNDERSTORM_WITH_HAIL),
+};
+
+static const char * const weather_wind_dir_names[WEATHER_WIND_DIR_QTY] = {
+    [WEATHER_WIND_DIR_UNKNOWN]  = "unknown",
+    [WEATHER_WIND_DIR_N]        = "n",
+    [WEATHER_WIND_DIR_NE]       = "ne",
+    [WEATHER_WIND_DIR_E]        = "e",
+    [WEATHER_WIND_DIR_SE]       = "se",
+    [WEATHER_WIND_DIR_S]        = "s",
+    [WEATHER_WIND_DIR_SW]       = "sw",
+    [WEATHER_WIND_DIR_W]        = "w",
+    [WEATHER_WIND_DIR_NW]       = "nw",
+    [WEATHER_WIND_DIR_CALM]     = "c",
+};
+
+static const char * const weather_part_names[WEATHER_PART_QTY] = {
+    [WEATHER_PART_UNKNOWN]  = "unknown",
+    [WEATHER_PART_NIGHT]    = "night",
+    [WEATHER_PART_MORNING]  = "morning",
+    [WEATHER_PART_DAY]      = "day",
+    [WEATHER_PART_EVENING]  = "evening",
+};
+
+/**< Every field of the record, compared and canonicalized by this table */
+static const weather_record_field_t weather_record_fields[] = {
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_OBS_TIME,       obs_time),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_TEMP,           temp_dc),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_FEELS_LIKE,     feels_like_dc),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_PART_TEMP,      part_temp_dc),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_PRESSURE,       pressure_dmm),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_WIND_SPEED,     wind_speed_dms),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_HUMIDITY,       humidity),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_CONDITION,      condition),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_WIND_DIR,       wind_dir),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_PART_NAME,      part_name),
+    WEATHER_RECORD_FIELD(WEATHER_RECORD_PART_CONDITION, part_condition),
+};
+#define WEATHER_RECORD_FIELDS_QTY   (sizeof(weather_record_fields) / sizeof(weather_record_fields[0]))
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static bool weather_json_append(char * ptr_buf, size_t size, size_t * ptr_len, const char * ptr_fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Formatted text appending
+ *
+ *  @param[out]     ptr_buf     Destination
+ *  @param[in]      size        Destination size
+ *  @param[in,out]  ptr_len     Destination text length
+ *  @param[in]      ptr_fmt     printf() format
+ *
+ *  @return     false if text does not fit
+ */
+static bool weather_json_append(char * ptr_buf, size_t size, size_t * ptr_len, const char * ptr_fmt, ...)
+{
+    va_list args;
+
+    va_start(args, ptr_fmt);
+    int len = vsnprintf(ptr_buf + *ptr_len, size - *ptr_len, ptr_fmt, args);
+    va_end(args);
+
+    if ((len < 0) || ((size_t) len >= size - *ptr_len))
+    {
+        return false;
+    }
+    *ptr_len += len;
+
+    return true;
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+weather_condition_t weather_condition_from_str(const char * ptr_str, size_t len)
+{
+    if (0 == len)
+    {
+        return WEATHER_CONDITION_UNKNOWN;
+    }
+
+    uint8_t condition = weather_condition_slots[WEATHER_CONDITION_HASH(len,
+                                                                       (uint8_t) ptr_str[0],
+                                                                       (uint8_t) ptr_str[len - 1])];
+    const char * ptr_name = weather_condition_names[condition];
+    if ((WEATHER_CONDITION_UNKNOWN == condition) ||
+        (0 != strncmp(ptr_name, ptr_str, len)) ||
+        ('\0' != ptr_name[len]))
+    {
+        return WEATHER_CONDITION_UNKNOWN;
+    }
+
+    return (weather_condition_t) condition;
+}
+
+const char * weather_condition_name(uint8_t condition)
+{
+    return weather_condition_names[(condition < WEATHER_CONDITION_QTY) ? condition : WEATHER_CONDITION_UNKNOWN];
+}
+
+weather_wind_dir_t weather_wind_dir_from_str(const char * ptr_str, size_t len)
+{
+    char first = (len > 0) ? ptr_str[0] : '\0';
+    char second = (len > 1) ? ptr_str[1] : '\0';
+
+    if (len > 2)
+    {
+        return WEATHER_WIND_DIR_UNKNOWN;
+    }
+
+    switch (first)
+    {
+    case 'n':
+        return ('\0' == second) ? WEATHER_WIND_DIR_N :
+               ('e' == second)  ? WEATHER_WIND_DIR_NE :
+               ('w' == second)  ? WEATHER_WIND_DIR_NW : WEATHER_WIND_DIR_UNKNOWN;
+    case 's':
+        return ('\0' == second) ? WEATHER_WIND_DIR_S :
+               ('e' == second)  ? WEATHER_WIND_DIR_SE :
+               ('w' == second)  ? WEATHER_WIND_DIR_SW : WEATHER_WIND_DIR_UNKNOWN;
+    case 'e':
+        return ('\0' == second) ? WEATHER_WIND_DIR_E : WEATHER_WIND_DIR_UNKNOWN;
+    case 'w':
+        return ('\0' == second) ? WEATHER_WIND_DIR_W : WEATHER_WIND_DIR_UNKNOWN;
+    case 'c':
+        return ('\0' == second) ? WEATHER_WIND_DIR_CALM : WEATHER_WIND_DIR_UNKNOWN;
+    default:
+        return WEATHER_WIND_DIR_UNKNOWN;
+    }
+}
+
+const char * weather_wind_dir_name(uint8_t wind_dir)
+{
+    return weather_wind_dir_names[(wind_dir < WEATHER_WIND_DIR_QTY) ? wind_dir : WEATHER_WIND_DIR_UNKNOWN];
+}
+
+weather_part_t weather_part_from_str(const char * ptr_str, size_t len)
+{
+    weather_part_t part = WEATHER_PART_UNKNOWN;
+
+    /* First letters differ, one compare confirms */
+    switch ((len > 0) ? ptr_str[0] : '\0')
+    {
+    case 'n':
+        part = WEATHER_PART_NIGHT;
+        break;
+    case 'm':
+        part = WEATHER_PART_MORNING;
+        break;
+    case 'd':
+        part = WEATHER_PART_DAY;
+        break;
+    case 'e':
+        part = WEATHER_PART_EVENING;
+        break;
+    default:
+        return WEATHER_PART_UNKNOWN;
+    }
+
+    if ((strlen(weather_part_names[part]) != len) || (0 != memcmp(weather_part_names[part], ptr_str, len)))
+    {
+        return WEATHER_PART_UNKNOWN;
+    }
+
+    return part;
+}
+
+const char * weather_part_name(uint8_t part)
+{
+    return weather_part_names[(part < WEATHER_PART_QTY) ? part : WEATHER_PART_UNKNOWN];
+}
+
+char * weather_tenths_str(char * ptr_buf, int32_t value)
+{
+    uint32_t magnitude = (value < 0) ? 0U - (uint32_t) value : (uint32_t) value;
+
+    snprintf(ptr_buf, WEATHER_TENTHS_STR_SIZE, "%s%u.%u",
+             (value < 0) ? "-" : "",
+             (unsigned int) (magnitude / 10),
+             (unsigned int) (magnitude % 10));
+
+    return ptr_buf;
+}
+
+size_t weather_record_to_json(const weather_record_t * ptr_record, char * ptr_buf, size_t size)
+{
+    char num[WEATHER_TENTHS_STR_SIZE];
+    size_t len = 0;
+    bool ok = weather_json_append(ptr_buf, size, &len, "{");
+
+    if (ptr_record->fields & WEATHER_RECORD_OBS_TIME)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"obs_time\":%u,", (unsigned int) ptr_record->obs_time);
+    }
+    if (ptr_record->fields & WEATHER_RECORD_TEMP)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"temp\":%s,", weather_tenths_str(num, ptr_record->temp_dc));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_FEELS_LIKE)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"feels_like\":%s,",
+                                       weather_tenths_str(num, ptr_record->feels_like_dc));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_HUMIDITY)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"humidity\":%u,", ptr_record->humidity);
+    }
+    if (ptr_record->fields & WEATHER_RECORD_PRESSURE)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"pressure_mm\":%s,",
+                                       weather_tenths_str(num, ptr_record->pressure_dmm));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_CONDITION)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"condition\":\"%s\",",
+                                       weather_condition_name(ptr_record->condition));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_WIND_SPEED)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"wind_speed\":%s,",
+                                       weather_tenths_str(num, ptr_record->wind_speed_dms));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_WIND_DIR)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"wind_dir\":\"%s\",",
+                                       weather_wind_dir_name(ptr_record->wind_dir));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_PART_NAME)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"part_name\":\"%s\",",
+                                       weather_part_name(ptr_record->part_name));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_PART_TEMP)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"part_temp\":%s,",
+                                       weather_tenths_str(num, ptr_record->part_temp_dc));
+    }
+    if (ptr_record->fields & WEATHER_RECORD_PART_CONDITION)
+    {
+        ok = ok && weather_json_append(ptr_buf, size, &len, "\"part_condition\":\"%s\",",
+                                       weather_condition_name(ptr_record->part_condition));
+    }
+
+    if (!ok)
+    {
+        return 0;
+    }
+    /* Replace the trailing comma (or append to the lone brace) */
+    if (',' == ptr_buf[len - 1])
+    {
+        len--;
+    }
+    ptr_buf[len] = '\0';
+    if (!weather_json_append(ptr_buf, size, &len, "}"))
+    {
+        return 0;
+    }
+
+    return len;
+}
+
+uint16_t weather_record_diff(const weather_record_t * ptr_old, const weather_record_t * ptr_new)
+{
+    const uint8_t * ptr_old_bytes = (const uint8_t *) ptr_old;
+    const uint8_t * ptr_new_bytes = (const uint8_t *) ptr_new;
+    uint16_t common = ptr_old->fields & ptr_new->fields;
+    uint16_t changed = (ptr_old->fields ^ ptr_new->fields) & WEATHER_RECORD_ALL;
+
+    for (size_t i = 0; i < WEATHER_RECORD_FIELDS_QTY; i++)
+    {
+        const weather_record_field_t * ptr_field = &weather_record_fields[i];
+        if ((common & ptr_field->flag) &&
+            (0 != memcmp(&ptr_old_bytes[ptr_field->offset], &ptr_new_bytes[ptr_field->offset], ptr_field->size)))
+        {
+            changed |= ptr_field->flag;
+        }
+    }
+
+    return changed;
+}
+
+void weather_record_canonical(const weather_record_t * ptr_record, weather_record_t * ptr_canonical)
+{
+    uint8_t * ptr_bytes = (uint8_t *) ptr_canonical;
+    weather_record_t record = *ptr_record;
+
+    memset(ptr_canonical, 0, sizeof(*ptr_canonical));
+    ptr_canonical->fields = record.fields & WEATHER_RECORD_ALL;
+    for (size_t i = 0; i < WEATHER_RECORD_FIELDS_QTY; i++)
+    {
+        const weather_record_field_t * ptr_field = &weather_record_fields[i];
+        if (record.fields & ptr_field->flag)
+        {
+            memcpy(&ptr_bytes[ptr_field->offset], &((const uint8_t *) &record)[ptr_field->offset], ptr_field->size);
+        }
+    }
+}
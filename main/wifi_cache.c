@@ -0,0 +1,199 @@
+/**
+ *  @file       wifi_cache.c
+ *
+ *  @brief      Last access point and DHCP lease kept across resets
+ *
+ *  @author     Mikhail Zaytsev
+ */
+
+/********** INCLUDES **********/
+
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_netif_net_stack.h"
+#include "nvs.h"
+
+#include "lwip/dhcp.h"
+
+#include "wifi_cache.h"
+
+/******************** DEFINES ********************/
+
+#define WIFI_CACHE_MAGIC        0x57494643UL    /**< RTC memory content marker */
+#define WIFI_CACHE_NAMESPACE    "storage"       /**< NVS namespace */
+#define WIFI_CACHE_KEY          "wifi_cache"    /**< NVS key */
+
+/******************** STRUCTURES, ENUMS, UNIONS ********************/
+
+/**
+ *  @brief  Cached access point and lease (stored in NVS as is)
+ */
+typedef struct wifi_cache_entry_s
+{
+    bool has_ap;                    /**< Access point is known */
+    bool has_lease;                 /**< Lease is known */
+    uint8_t bssid[6];               /**< Access point BSSID */
+    uint8_t channel;                /**< Access point primary channel */
+    wifi_cache_lease_t lease;       /**< Last lease */
+} wifi_cache_entry_t;
+
+/**
+ *  @brief  Cache layout in RTC memory
+ */
+typedef struct wifi_cache_rtc_s
+{
+    uint32_t magic;                 /**< WIFI_CACHE_MAGIC if content is valid */
+    uint32_t crc;                   /**< Entry checksum */
+    wifi_cache_entry_t entry;       /**< Entry */
+} wifi_cache_rtc_t;
+
+/******************** GLOBAL VARIABLES ********************/
+
+static const char * TAG = "wifi_cache";
+
+/**< Not initialized on boot, garbage after power-on is rejected by checksum */
+static RTC_NOINIT_ATTR wifi_cache_rtc_t rtc_cache;
+
+/******************** PRIVATE FUNCTION PROTOTYPES ********************/
+
+static uint32_t wifi_cache_crc(void);
+static void wifi_cache_commit(const wifi_cache_entry_t * ptr_entry);
+
+/******************** PRIVATE FUNCTIONS ********************/
+
+/**
+ *  @brief      Entry checksum
+ *
+ *  @return     CRC32 of the RTC memory entry
+ */
+static uint32_t wifi_cache_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *) &rtc_cache.entry, sizeof(rtc_cache.entry));
+}
+
+/**
+ *  @brief      Entry update in RTC memory and NVS, NVS is written only if the entry changed
+ *
+ *  @param[in]  ptr_entry   New entry
+ */
+static void wifi_cache_commit(const wifi_cache_entry_t * ptr_entry)
+{
+    if (0 == memcmp(ptr_entry, &rtc_cache.entry, sizeof(*ptr_entry)))
+    {
+        return;
+    }
+    rtc_cache.entry = *ptr_entry;
+    rtc_cache.crc = wifi_cache_crc();
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(WIFI_CACHE_NAMESPACE, NVS_READWRITE, &handle);
+    if (ESP_OK == err)
+    {
+        err = nvs_set_blob(handle, WIFI_CACHE_KEY, &rtc_cache.entry, sizeof(rtc_cache.entry));
+        if (ESP_OK == err)
+        {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (ESP_OK != err)
+    {
+        ESP_LOGW(TAG, "Error storing cache: %s", esp_err_to_name(err));
+    }
+}
+
+/******************** PUBLIC FUNCTIONS ********************/
+
+esp_err_t wifi_cache_init(void)
+{
+    if ((WIFI_CACHE_MAGIC == rtc_cache.magic) && (wifi_cache_crc() == rtc_cache.crc))
+    {
+        return ESP_OK;
+    }
+
+    /* Power loss: RTC memory is garbage, NVS copy is taken */
+    nvs_handle_t handle;
+    size_t len = sizeof(rtc_cache.entry);
+    esp_err_t err = nvs_open(WIFI_CACHE_NAMESPACE, NVS_READONLY, &handle);
+    if (ESP_OK == err)
+    {
+        err = nvs_get_blob(handle, WIFI_CACHE_KEY, &rtc_cache.entry, &len);
+        nvs_close(handle);
+    }
+    if ((ESP_OK != err) || (sizeof(rtc_cache.entry) != len))
+    {
+        memset(&rtc_cache.entry, 0x00, sizeof(rtc_cache.entry));
+        ESP_LOGI(TAG, "Cache is empty");
+    }
+    rtc_cache.magic = WIFI_CACHE_MAGIC;
+    rtc_cache.crc = wifi_cache_crc();
+
+    return ESP_OK;
+}
+
+bool wifi_cache_get_ap(uint8_t * ptr_bssid, uint8_t * ptr_channel)
+{
+    if (!rtc_cache.entry.has_ap)
+    {
+        return false;
+    }
+
+    memcpy(ptr_bssid, rtc_cache.entry.bssid, sizeof(rtc_cache.entry.bssid));
+    *ptr_channel = rtc_cache.entry.channel;
+
+    return true;
+}
+
+bool wifi_cache_get_lease(int64_t now_s, wifi_cache_lease_t * ptr_lease)
+{
+    if (!rtc_cache.entry.has_lease || (rtc_cache.entry.lease.expires_s - now_s < WIFI_CACHE_LEASE_MARGIN_S))
+    {
+        return false;
+    }
+
+    *ptr_lease = rtc_cache.entry.lease;
+
+    return true;
+}
+
+void wifi_cache_store_ap(const uint8_t * ptr_bssid, uint8_t channel)
+{
+    wifi_cache_entry_t entry = rtc_cache.entry;
+
+    /* Lease belongs to the network, not to the access point, so it is kept */
+    entry.has_ap = true;
+    memcpy(entry.bssid, ptr_bssid, sizeof(entry.bssid));
+    entry.channel = channel;
+    wifi_cache_commit(&entry);
+}
+
+void wifi_cache_store_lease(esp_netif_t * ptr_netif, int64_t now_s)
+{
+    wifi_cache_entry_t entry = rtc_cache.entry;
+    esp_netif_dns_info_t dns;
+    struct netif * ptr_lwip_netif = esp_netif_get_netif_impl(ptr_netif);
+    struct dhcp * ptr_dhcp = (NULL != ptr_lwip_netif) ? netif_dhcp_data(ptr_lwip_netif) : NULL;
+
+    /* Static configuration or infinite lease is not cached */
+    entry.has_lease = (NULL != ptr_dhcp) && (0 != ptr_dhcp->offered_t0_lease) &&
+                      (0xFFFFFFFFUL != ptr_dhcp->offered_t0_lease) &&
+                      (ESP_OK == esp_netif_get_ip_info(ptr_netif, &entry.lease.ip_info)) &&
+                      (ESP_OK == esp_netif_get_dns_info(ptr_netif, ESP_NETIF_DNS_MAIN, &dns));
+    if (entry.has_lease)
+    {
+        entry.lease.dns.addr = dns.ip.u_addr.ip4.addr;
+        entry.lease.expires_s = now_s + ptr_dhcp->offered_t0_lease;
+    }
+    wifi_cache_commit(&entry);
+}
+
+void wifi_cache_forget(void)
+{
+    wifi_cache_entry_t entry;
+
+    memset(&entry, 0x00, sizeof(entry));
+    wifi_cache_commit(&entry);
+}